@@ -0,0 +1,45 @@
+# This file is part of the PARIS reconstruction program.
+#
+# Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+#
+# PARIS is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# PARIS is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+
+# - Find clFFT
+# Find the clFFT include directory and library
+#
+# Use this module by invoking FIND_PACKAGE with the form:
+#
+#   FIND_PACKAGE(CLFFT [REQUIRED])
+#
+# Results are reported in the following variables:
+#
+#   CLFFT_FOUND
+#   CLFFT_INCLUDE_DIR
+#   CLFFT_LIBRARIES
+
+IF(CLFFT_INCLUDE_DIR)
+    # clFFT already found, don't look again
+    SET(CLFFT_FIND_QUIETLY TRUE)
+ENDIF(CLFFT_INCLUDE_DIR)
+
+FIND_PATH(CLFFT_INCLUDE_DIR clFFT.h)
+FIND_LIBRARY(CLFFT_LIBRARY clFFT)
+
+SET(CLFFT_LIBRARIES ${CLFFT_LIBRARY})
+
+# handle REQUIRED and QUIET parameters
+INCLUDE(FindPackageHandleStandardArgs)
+FIND_PACKAGE_HANDLE_STANDARD_ARGS(CLFFT DEFAULT_MSG CLFFT_INCLUDE_DIR CLFFT_LIBRARY)
+
+MARK_AS_ADVANCED(CLFFT_LIBRARIES CLFFT_INCLUDE_DIR CLFFT_LIBRARY)
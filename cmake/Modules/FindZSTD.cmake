@@ -0,0 +1,45 @@
+# This file is part of the PARIS reconstruction program.
+#
+# Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+#
+# PARIS is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# PARIS is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+
+# - Find zstd
+# Find the zstd include directory and library
+#
+# Use this module by invoking FIND_PACKAGE with the form:
+#
+#   FIND_PACKAGE(ZSTD [REQUIRED])
+#
+# Results are reported in the following variables:
+#
+#   ZSTD_FOUND
+#   ZSTD_INCLUDE_DIR
+#   ZSTD_LIBRARIES
+
+IF(ZSTD_INCLUDE_DIR)
+    # zstd already found, don't look again
+    SET(ZSTD_FIND_QUIETLY TRUE)
+ENDIF(ZSTD_INCLUDE_DIR)
+
+FIND_PATH(ZSTD_INCLUDE_DIR zstd.h)
+FIND_LIBRARY(ZSTD_LIBRARY zstd)
+
+SET(ZSTD_LIBRARIES ${ZSTD_LIBRARY})
+
+# handle REQUIRED and QUIET parameters
+INCLUDE(FindPackageHandleStandardArgs)
+FIND_PACKAGE_HANDLE_STANDARD_ARGS(ZSTD DEFAULT_MSG ZSTD_INCLUDE_DIR ZSTD_LIBRARY)
+
+MARK_AS_ADVANCED(ZSTD_LIBRARIES ZSTD_INCLUDE_DIR ZSTD_LIBRARY)
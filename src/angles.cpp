@@ -0,0 +1,84 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <locale>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/log/trivial.hpp>
+
+#include "angles.h"
+#include "exception.h"
+#include "table_cache.h"
+
+namespace paris
+{
+    auto read_angles(const std::string& path) -> angle_table
+    {
+        auto angles = std::vector<float>{};
+        if(table_cache::load(path, 1u, angles))
+            return std::make_shared<const std::vector<float>>(std::move(angles));
+
+        auto&& file = std::ifstream{path.c_str()};
+        if(!file.is_open())
+        {
+            BOOST_LOG_TRIVIAL(warning) << "Could not open angle file at " << path << ", using default values.";
+            return std::make_shared<const std::vector<float>>();
+        }
+
+        // independent of the global locale
+        auto line = std::string{};
+        auto line_num = std::size_t{0u};
+        while(std::getline(file, line))
+        {
+            ++line_num;
+            if(line.empty() || line.front() == '#')
+                continue;
+
+            std::replace(std::begin(line), std::end(line), ',', '.');
+            auto&& stream = std::istringstream{line};
+            stream.imbue(std::locale::classic());
+
+            auto angle = 0.f;
+            while(stream >> angle)
+                angles.push_back(angle);
+
+            if(!stream.eof())
+            {
+                BOOST_LOG_TRIVIAL(fatal) << "Could not parse line " << line_num << " of " << path;
+                throw stage_construction_error{"read_angles() failed"};
+            }
+        }
+
+        BOOST_LOG_TRIVIAL(info) << "Read " << angles.size() << " angles from " << path;
+        if(!angles.empty())
+            table_cache::store(path, 1u, angles);
+
+        return std::make_shared<const std::vector<float>>(std::move(angles));
+    }
+}
@@ -0,0 +1,42 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#ifndef PARIS_ANGLES_H_
+#define PARIS_ANGLES_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace paris
+{
+    // the angle [°] of every projection file, parsed once per run and shared read-only
+    using angle_table = std::shared_ptr<const std::vector<float>>;
+
+    /*
+     * Reads one angle per projection separated by whitespace, either with decimal points or decimal commas. Lines
+     * starting with '#' are comments. An empty table is returned if the file can't be opened.
+     */
+    auto read_angles(const std::string& path) -> angle_table;
+}
+
+#endif /* PARIS_ANGLES_H_ */
@@ -20,51 +20,51 @@
  * Authors: Jan Stephan <j.stephan@hzdr.de>
  */
 
-#include <cmath>
 #include <cstdint>
-
-#include <boost/log/trivial.hpp>
+#include <vector>
 
 #include "backend.h"
 #include "backprojection.h"
 #include "geometry.h"
+#include "metrics.h"
 #include "projection.h"
 #include "region_of_interest.h"
+#include "trajectory.h"
 #include "volume.h"
 
 namespace paris
 {
-    auto backproject(const backend::projection_device_type& p,
+    auto backproject(const std::vector<backend::projection_device_type>& p,
                      backend::volume_device_type& v,
                      std::uint32_t v_offset,
                      const detector_geometry& det_geo,
                      const volume_geometry& vol_geo,
                      bool enable_angles,
                      bool enable_roi,
-                     const region_of_interest& roi)
-        noexcept(true && noexcept(backend::backproject))
+                     const region_of_interest& roi,
+                     const trajectory* traj)
         -> void
     {
-        // the following constants are global -> initialise once
-        static const auto delta_s = det_geo.delta_s * det_geo.l_px_row;
-        static const auto delta_t = det_geo.delta_t * det_geo.l_px_col;
-
-        // get angular position of the current projection
-        auto phi = 0.f;
-        if(enable_angles)
-            phi = p.phi;
-        else
-            phi = static_cast<float>(p.idx) * det_geo.delta_phi;
+        auto&& t = metrics::timer{metrics::stage::backproject, p.size()};
 
-        // transform to radians
-        phi *= static_cast<float>(M_PI) / 180.f;
+        if(traj != nullptr)
+        {
+            auto m = std::vector<projection_matrix>{};
+            projection_matrices(p, *traj, m);
+            backend::backproject(p, v, v_offset, det_geo, vol_geo, enable_roi, roi, m);
+            metrics::count_voxel_updates(static_cast<std::uint64_t>(v.dim_x) * v.dim_y * v.dim_z * p.size());
+            return;
+        }
 
-        auto sin = std::sin(phi);
-        auto cos = std::cos(phi);
+        // detector offsets [mm]
+        const auto delta_s = det_geo.delta_s * det_geo.l_px_row;
+        const auto delta_t = det_geo.delta_t * det_geo.l_px_col;
 
-        if(p.idx % 10u == 0u)
-            BOOST_LOG_TRIVIAL(info) << "Processing projection #" << p.idx;
+        auto sin = std::vector<float>{};
+        auto cos = std::vector<float>{};
+        projection_angles(p, det_geo, enable_angles, sin, cos);
 
         backend::backproject(p, v, v_offset, det_geo, vol_geo, enable_roi, roi, sin, cos, delta_s, delta_t);
+        metrics::count_voxel_updates(static_cast<std::uint64_t>(v.dim_x) * v.dim_y * v.dim_z * p.size());
     }
 }
@@ -23,25 +23,89 @@
 #ifndef PARIS_BACKPROJECTION_H_
 #define PARIS_BACKPROJECTION_H_
 
+#include <cmath>
 #include <cstdint>
+#include <vector>
+
+#include <boost/log/trivial.hpp>
 
 #include "backend.h"
+#include "exception.h"
 #include "geometry.h"
 #include "projection.h"
 #include "region_of_interest.h"
+#include "trajectory.h"
 #include "volume.h"
 
 namespace paris
 {
-    auto backproject(const backend::projection_device_type& p,
+    // sine and cosine of each projection's angular position, usable with the projections of any backend
+    template <class Projection>
+    auto projection_angles(const std::vector<Projection>& p, const detector_geometry& det_geo, bool enable_angles,
+                           std::vector<float>& sin, std::vector<float>& cos) -> void
+    {
+        sin.clear();
+        cos.clear();
+        sin.reserve(p.size());
+        cos.reserve(p.size());
+
+        for(auto&& proj : p)
+        {
+            // get angular position of the current projection
+            auto phi = 0.f;
+            if(enable_angles)
+                phi = proj.phi;
+            else
+                phi = static_cast<float>(proj.idx) * det_geo.delta_phi;
+
+            // transform to radians
+            phi *= static_cast<float>(M_PI) / 180.f;
+
+            sin.push_back(std::sin(phi));
+            cos.push_back(std::cos(phi));
+
+            if(proj.idx % 10u == 0u)
+                BOOST_LOG_TRIVIAL(info) << "Processing projection #" << proj.idx;
+        }
+    }
+
+    // the projection matrix of each projection, usable with the projections of any backend
+    template <class Projection>
+    auto projection_matrices(const std::vector<Projection>& p, const trajectory& traj,
+                             std::vector<projection_matrix>& m) -> void
+    {
+        m.clear();
+        m.reserve(p.size());
+
+        for(auto&& proj : p)
+        {
+            if(proj.idx >= traj.size())
+            {
+                BOOST_LOG_TRIVIAL(fatal) << "There is no projection matrix for projection #" << proj.idx << ", only "
+                                         << traj.size() << " were given";
+                throw stage_runtime_error{"projection_matrices() failed"};
+            }
+
+            m.push_back(traj[proj.idx]);
+
+            if(proj.idx % 10u == 0u)
+                BOOST_LOG_TRIVIAL(info) << "Processing projection #" << proj.idx;
+        }
+    }
+
+    /*
+     * Backprojects a batch of at most backend::max_batch_size projections in one pass over the volume. The
+     * projections follow the given trajectory, or the circular one of det_geo if it is nullptr.
+     */
+    auto backproject(const std::vector<backend::projection_device_type>& p,
                      backend::volume_device_type& v,
                      std::uint32_t v_offset,
                      const detector_geometry& det_geo,
                      const volume_geometry& vol_geo,
                      bool enable_angles,
                      bool enable_roi,
-                     const region_of_interest& roi)
-        noexcept(true && noexcept(backend::backproject))
+                     const region_of_interest& roi,
+                     const trajectory* traj = nullptr)
         -> void;
 }
 
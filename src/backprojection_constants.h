@@ -44,6 +44,8 @@ namespace paris
 
             std::uint32_t proj_dim_x;
             std::uint32_t proj_dim_y;
+            std::uint32_t proj_first_row;   // detector row in the first row of the current batch
+            std::uint32_t proj_first_col;   // detector column in the first column of the current batch
 
             float l_px_x;
             float l_px_y;
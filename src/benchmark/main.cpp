@@ -0,0 +1,567 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+/*
+ * Benchmarks for the pipeline stages and the whole reconstruction on synthetic projections. Every result is
+ * printed and, with --output, appended as a CSV row tagged with the version and revision so runs of different
+ * commits can be compared directly.
+ *
+ * The geometry-dependent parts of the pipeline are set up once per process, --sweep therefore runs every
+ * configuration in a process of its own.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <boost/log/core.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/program_options.hpp>
+
+#include "../backend.h"
+#include "../backprojection.h"
+#include "../ddbvf.h"
+#include "../exception.h"
+#include "../filter_config.h"
+#include "../filtering.h"
+#include "../geometry.h"
+#include "../his.h"
+#include "../loader.h"
+#include "../make_volume.h"
+#include "../paris.h"
+#include "../reconstruction.h"
+#include "../subvolume_information.h"
+#include "../version.h"
+#include "../weighting.h"
+
+#include "phantom.h"
+
+#ifndef PARIS_REVISION
+#define PARIS_REVISION "unknown"
+#endif
+
+namespace
+{
+#if defined(PARIS_ENABLE_CUDA)
+    constexpr auto backend_name = "cuda";
+#elif defined(PARIS_ENABLE_OPENCL)
+    constexpr auto backend_name = "opencl";
+#elif defined(PARIS_ENABLE_OPENMP)
+    constexpr auto backend_name = "openmp";
+#else
+    constexpr auto backend_name = "generic";
+#endif
+
+    struct options
+    {
+        std::string geometry_path;
+        std::string phantom;
+        std::string mode;
+        std::string scratch;
+        std::string output;
+
+        std::uint32_t projections;
+        std::uint32_t repetitions;
+        std::uint32_t batch_size;
+        std::uint32_t pipeline_depth;
+        std::uint32_t subvolumes;
+        int compression;
+        float scale;
+
+        std::string sweep_scales;
+        std::string sweep_projections;
+        std::string sweep_subvolumes;
+    };
+
+    struct measurement
+    {
+        std::string benchmark;
+        std::vector<double> seconds;
+        double items;       // per run
+        std::string unit;   // of items / s
+    };
+
+    // the detector of doc/schaum.geo
+    auto schaum_geometry() noexcept -> paris::detector_geometry
+    {
+        return paris::detector_geometry{1016u, 401u, 0.2f, 0.2f, 4.6f, 0.f, 100.f, 207.5f, -0.25f};
+    }
+
+    // same format as the geometry files of the command line program
+    auto read_geometry(const std::string& path) -> paris::detector_geometry
+    {
+        auto det_geo = paris::detector_geometry{};
+
+        boost::program_options::options_description geom{"Geometry file"};
+        geom.add_options()
+                ("n_row", boost::program_options::value<std::uint32_t>(&det_geo.n_row)->required(), "")
+                ("n_col", boost::program_options::value<std::uint32_t>(&det_geo.n_col)->required(), "")
+                ("l_px_row", boost::program_options::value<float>(&det_geo.l_px_row)->required(), "")
+                ("l_px_col", boost::program_options::value<float>(&det_geo.l_px_col)->required(), "")
+                ("delta_s", boost::program_options::value<float>(&det_geo.delta_s)->required(), "")
+                ("delta_t", boost::program_options::value<float>(&det_geo.delta_t)->required(), "")
+                ("d_so", boost::program_options::value<float>(&det_geo.d_so)->required(), "")
+                ("d_od", boost::program_options::value<float>(&det_geo.d_od)->required(), "")
+                ("delta_phi", boost::program_options::value<float>(&det_geo.delta_phi)->required(), "");
+
+        auto&& file = std::ifstream{path.c_str()};
+        if(!file)
+        {
+            BOOST_LOG_TRIVIAL(fatal) << "Could not open the geometry file at " << path;
+            throw paris::stage_construction_error{"read_geometry() failed"};
+        }
+
+        auto geom_map = boost::program_options::variables_map{};
+        boost::program_options::store(boost::program_options::parse_config_file(file, geom), geom_map);
+        boost::program_options::notify(geom_map);
+        return det_geo;
+    }
+
+    // s times the pixels on the same detector area, the projections cover a full rotation
+    auto scale_detector(paris::detector_geometry det_geo, float s, std::uint32_t projections) noexcept
+        -> paris::detector_geometry
+    {
+        det_geo.n_row = std::max(static_cast<std::uint32_t>(static_cast<float>(det_geo.n_row) * s), 1u);
+        det_geo.n_col = std::max(static_cast<std::uint32_t>(static_cast<float>(det_geo.n_col) * s), 1u);
+        det_geo.l_px_row /= s;
+        det_geo.l_px_col /= s;
+        det_geo.delta_s *= s;
+        det_geo.delta_t *= s;
+        det_geo.delta_phi = std::copysign(360.f / static_cast<float>(projections), det_geo.delta_phi);
+        return det_geo;
+    }
+
+    auto parse_list(const std::string& str) -> std::vector<std::string>
+    {
+        auto items = std::vector<std::string>{};
+        auto&& stream = std::istringstream{str};
+        for(auto item = std::string{}; std::getline(stream, item, ',');)
+        {
+            if(!item.empty())
+                items.push_back(item);
+        }
+        return items;
+    }
+
+    // one untimed warm-up run -- FFT plans, pools and page cache -- then the timed repetitions
+    auto run(std::uint32_t repetitions, const std::function<void()>& setup, const std::function<void()>& body)
+        -> std::vector<double>
+    {
+        auto seconds = std::vector<double>{};
+        for(auto i = 0u; i <= repetitions; ++i)
+        {
+            setup();
+            auto start = std::chrono::steady_clock::now();
+            body();
+            auto stop = std::chrono::steady_clock::now();
+
+            if(i > 0u)
+                seconds.push_back(std::chrono::duration<double>(stop - start).count());
+        }
+        return seconds;
+    }
+
+    auto median(std::vector<double> v) -> double
+    {
+        std::sort(std::begin(v), std::end(v));
+        auto n = v.size();
+        return (n % 2u == 1u) ? v[n / 2u] : (v[n / 2u - 1u] + v[n / 2u]) / 2.;
+    }
+
+    auto report(const options& opts, const paris::detector_geometry& det_geo, const measurement& m) -> void
+    {
+        if(m.seconds.empty())
+            return;
+
+        auto min = *std::min_element(std::begin(m.seconds), std::end(m.seconds));
+        auto med = median(m.seconds);
+        auto mean = std::accumulate(std::begin(m.seconds), std::end(m.seconds), 0.) /
+                    static_cast<double>(m.seconds.size());
+        auto throughput = m.items / med;
+
+        std::cout << std::left << std::setw(14) << m.benchmark << std::right
+                  << det_geo.n_row << " x " << det_geo.n_col << " x " << opts.projections
+                  << ", " << opts.subvolumes << " subvolumes: "
+                  << std::fixed << std::setprecision(4) << med << " s (min " << min << " s), "
+                  << std::setprecision(2) << throughput << ' ' << m.unit << std::endl;
+        std::cout.unsetf(std::ios::floatfield);
+
+        if(opts.output.empty())
+            return;
+
+        auto out = std::ofstream{opts.output, std::ios::app};
+        if(!out)
+        {
+            BOOST_LOG_TRIVIAL(fatal) << "Could not open " << opts.output;
+            throw paris::stage_runtime_error{"report() failed"};
+        }
+
+        // a fresh file starts with the header
+        out.seekp(0, std::ios::end);
+        if(out.tellp() == 0)
+            out << "version,revision,backend,benchmark,phantom,n_row,n_col,projections,subvolumes,repetitions,"
+                   "min_s,median_s,mean_s,throughput,unit\n";
+
+        out << std::setprecision(6)
+            << paris::version << ',' << PARIS_REVISION << ',' << backend_name << ',' << m.benchmark << ','
+            << opts.phantom << ',' << det_geo.n_row << ',' << det_geo.n_col << ',' << opts.projections << ','
+            << opts.subvolumes << ',' << m.seconds.size() << ',' << min << ',' << med << ',' << mean << ','
+            << throughput << ',' << m.unit << '\n';
+    }
+
+    auto synchronize(const std::vector<paris::backend::projection_device_type>& p) -> void
+    {
+        for(auto&& proj : p)
+            paris::backend::synchronize(proj);
+    }
+
+    // micro-benchmarks of the single stages
+    auto run_stages(const options& opts, const paris::detector_geometry& det_geo, const std::vector<float>& data)
+        -> void
+    {
+        const auto n = opts.projections;
+        const auto size = static_cast<std::size_t>(det_geo.n_row) * det_geo.n_col;
+        const auto full = paris::row_window{0u, det_geo.n_col};
+        const auto vol_geo = paris::calculate_volume_geometry(det_geo);
+        const auto cfg = paris::filter_config{paris::filter_window::ram_lak, 1.f, ""};
+        const auto batch_size = std::min(std::max(opts.batch_size, 1u), paris::backend::max_batch_size);
+
+        paris::backend::set_pipeline_depth(opts.pipeline_depth);
+        paris::size_host_pool(det_geo.n_row, full, vol_geo, 1u, n, opts.pipeline_depth);
+
+        auto devices = paris::backend::get_devices();
+        if(devices.empty())
+        {
+            BOOST_LOG_TRIVIAL(fatal) << "No devices found";
+            throw paris::stage_construction_error{"run_stages() failed"};
+        }
+        paris::backend::set_device(devices.front());
+
+        auto host = std::vector<paris::backend::projection_host_type>{};
+        for(auto i = 0u; i < n; ++i)
+        {
+            auto h_p = paris::backend::make_projection_host(det_geo.n_row, det_geo.n_col);
+            std::copy_n(data.data() + i * size, size, h_p.buf.get());
+            h_p.idx = i;
+            host.push_back(std::move(h_p));
+        }
+
+        // decoding, the file is read from the page cache after the warm-up run
+        {
+            auto path = opts.scratch + "/paris_bench.his";
+            paris::benchmark::write_his(path, data, det_geo.n_row, det_geo.n_col, n);
+            auto s = run(opts.repetitions, []() {}, [&]()
+            {
+                paris::his::load(path, [](paris::his::image_type&) { return true; });
+            });
+            std::remove(path.c_str());
+            report(opts, det_geo, measurement{"his::load", s, static_cast<double>(n), "projections/s"});
+        }
+
+        auto device = std::vector<paris::backend::projection_device_type>{};
+        auto upload = [&]()
+        {
+            device.clear();
+            for(auto&& h_p : host)
+            {
+                device.push_back(paris::load(h_p));
+                device.back().idx = h_p.idx;
+            }
+            synchronize(device);
+        };
+
+        report(opts, det_geo, measurement{"upload", run(opts.repetitions, []() {}, upload), static_cast<double>(n),
+                                          "projections/s"});
+
+        // the weight map is built once per detector window, filter() applies it
+        {
+            auto s = run(opts.repetitions, []() {}, [&]() { paris::make_weights(det_geo, full); });
+            report(opts, det_geo, measurement{"weight", s, static_cast<double>(size) * 1e-6, "Mpixels/s"});
+        }
+
+        // the batches are filtered in place, every run starts from fresh projections
+        {
+            auto s = run(opts.repetitions, upload, [&]()
+            {
+                auto batch = std::vector<paris::backend::projection_device_type>{};
+                for(auto&& p : device)
+                {
+                    batch.push_back(std::move(p));
+                    if(batch.size() == batch_size)
+                    {
+                        paris::filter(batch, det_geo, cfg);
+                        synchronize(batch);
+                        batch.clear();
+                    }
+                }
+                paris::filter(batch, det_geo, cfg);
+                synchronize(batch);
+            });
+            report(opts, det_geo, measurement{"filter", s, static_cast<double>(n), "projections/s"});
+        }
+
+        // the first subvolume the planner would give a device
+        {
+            auto mem = paris::memory_parameters{0u, det_geo.n_col, opts.pipeline_depth, batch_size,
+                                                paris::staging_memory(det_geo.n_row, det_geo.n_col, vol_geo, 0u)};
+            auto subvol_info = paris::backend::make_subvolume_information(vol_geo, det_geo, mem);
+            auto v = paris::make_volume(subvol_info.geo, subvol_info.num == 1);
+            auto roi = paris::region_of_interest{};
+
+            upload();
+            auto s = run(opts.repetitions, []() {}, [&]()
+            {
+                auto batch = std::vector<paris::backend::projection_device_type>{};
+                for(auto first = 0u; first < n; first += batch_size)
+                {
+                    // the batches take the projections out for the duration of the pass
+                    auto last = std::min(first + batch_size, n);
+                    for(auto i = first; i < last; ++i)
+                        batch.push_back(std::move(device[i]));
+
+                    paris::backproject(batch, v, 0u, det_geo, vol_geo, false, false, roi);
+                    synchronize(batch);
+
+                    for(auto i = first; i < last; ++i)
+                        device[i] = std::move(batch[i - first]);
+                    batch.clear();
+                }
+            });
+
+            auto updates = static_cast<double>(v.dim_x) * v.dim_y * v.dim_z * n;
+            report(opts, det_geo, measurement{"backproject", s, updates * 1e-9, "GVUPS"});
+        }
+
+        // writing the whole volume in slabs of 32 slices
+        {
+            constexpr auto slab = 32u;
+            auto path = opts.scratch + "/paris_bench";
+            auto fmt = paris::ddbvf::format{};
+            fmt.level = opts.compression;
+
+            auto h_v = paris::backend::make_volume_host(vol_geo.dim_x, vol_geo.dim_y, std::min(slab, vol_geo.dim_z));
+            std::fill_n(h_v.buf.get(), static_cast<std::size_t>(h_v.dim_x) * h_v.dim_y * h_v.dim_z, 1.f);
+
+            auto h = paris::ddbvf::handle_type{};
+            auto s = run(opts.repetitions, [&]()
+            {
+                h = paris::ddbvf::create(path, vol_geo.dim_x, vol_geo.dim_y, vol_geo.dim_z, fmt);
+            }, [&]()
+            {
+                for(auto first = 0u; first < vol_geo.dim_z; first += slab)
+                {
+                    h_v.dim_z = std::min(slab, vol_geo.dim_z - first);
+                    paris::ddbvf::write(h, h_v, first);
+                }
+                paris::ddbvf::close(h);
+                h.reset();
+            });
+            std::remove((path + ".ddbvf").c_str());
+
+            auto bytes = static_cast<double>(vol_geo.dim_x) * vol_geo.dim_y * vol_geo.dim_z * sizeof(float);
+            report(opts, det_geo, measurement{"ddbvf::write", s, bytes / (1u << 20u), "MiB/s"});
+        }
+    }
+
+    // the library pipeline from projections in memory to a discarded volume
+    auto run_end_to_end(const options& opts, const paris::detector_geometry& det_geo, const std::vector<float>& data)
+        -> void
+    {
+        auto stack = paris::projection_stack{data.data(), det_geo.n_row, det_geo.n_col, opts.projections, nullptr};
+
+        auto r_opts = paris::reconstruction_options{};
+        r_opts.batch_size = opts.batch_size;
+        r_opts.pipeline_depth = opts.pipeline_depth;
+        r_opts.subvolumes = opts.subvolumes;
+
+        auto vol_geo = paris::volume_dimensions(det_geo, r_opts);
+        auto s = run(opts.repetitions, []() {}, [&]()
+        {
+            paris::reconstruct(stack, det_geo, r_opts, [](const float*, std::uint32_t, std::uint32_t) {});
+        });
+
+        auto updates = static_cast<double>(vol_geo.dim_x) * vol_geo.dim_y * vol_geo.dim_z * opts.projections;
+        report(opts, det_geo, measurement{"reconstruct", s, updates * 1e-9, "GVUPS"});
+    }
+
+    // every configuration of the sweep in a process of its own
+    auto run_sweep(const options& opts, const char* self) -> int
+    {
+        auto failed = 0;
+        for(auto&& scale : parse_list(opts.sweep_scales))
+        {
+            for(auto&& projections : parse_list(opts.sweep_projections))
+            {
+                for(auto&& subvolumes : parse_list(opts.sweep_subvolumes))
+                {
+                    auto args = std::vector<std::string>{self, "--mode", "end-to-end", "--scale", scale,
+                                                         "--projections", projections, "--subvolumes", subvolumes,
+                                                         "--repetitions", std::to_string(opts.repetitions),
+                                                         "--batch-size", std::to_string(opts.batch_size),
+                                                         "--pipeline-depth", std::to_string(opts.pipeline_depth),
+                                                         "--phantom", opts.phantom, "--scratch", opts.scratch};
+                    if(!opts.geometry_path.empty())
+                    {
+                        args.push_back("--geometry");
+                        args.push_back(opts.geometry_path);
+                    }
+                    if(!opts.output.empty())
+                    {
+                        args.push_back("--output");
+                        args.push_back(opts.output);
+                    }
+
+                    auto argv = std::vector<char*>{};
+                    for(auto&& a : args)
+                        argv.push_back(const_cast<char*>(a.c_str()));
+                    argv.push_back(nullptr);
+
+                    std::cout.flush();
+                    auto pid = ::fork();
+                    if(pid == 0)
+                    {
+                        ::execvp(self, argv.data());
+                        std::_Exit(EXIT_FAILURE);
+                    }
+
+                    auto status = 0;
+                    if(pid < 0 || ::waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+                       WEXITSTATUS(status) != EXIT_SUCCESS)
+                    {
+                        BOOST_LOG_TRIVIAL(error) << "Sweep configuration scale " << scale << ", " << projections
+                                                 << " projections, " << subvolumes << " subvolumes failed";
+                        ++failed;
+                    }
+                }
+            }
+        }
+        return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    auto make_options(int argc, char** argv) -> options
+    {
+        auto opts = options{};
+
+        boost::program_options::options_description desc{"Benchmark options"};
+        desc.add_options()
+                ("help", "produce a help message")
+                ("mode", boost::program_options::value<std::string>(&opts.mode)->default_value("stages"), "stages (micro-benchmarks of the single stages), end-to-end or sweep")
+                ("geometry", boost::program_options::value<std::string>(&opts.geometry_path), "Path to a geometry file, defaults to the detector of doc/schaum.geo (optional)")
+                ("phantom", boost::program_options::value<std::string>(&opts.phantom)->default_value("shepp-logan"), "Synthetic object: shepp-logan or cylinder (optional)")
+                ("projections", boost::program_options::value<std::uint32_t>(&opts.projections)->default_value(360), "Number of projections over a full rotation (optional)")
+                ("scale", boost::program_options::value<float>(&opts.scale)->default_value(1.f), "Scales the number of detector pixels in both directions (optional)")
+                ("subvolumes", boost::program_options::value<std::uint32_t>(&opts.subvolumes)->default_value(0), "Minimum number of subvolumes for end-to-end runs, 0 leaves it to the memory planner (optional)")
+                ("repetitions", boost::program_options::value<std::uint32_t>(&opts.repetitions)->default_value(5), "Timed runs per benchmark after one warm-up run (optional)")
+                ("batch-size", boost::program_options::value<std::uint32_t>(&opts.batch_size)->default_value(8), "Number of projections backprojected in one pass (optional)")
+                ("pipeline-depth", boost::program_options::value<std::uint32_t>(&opts.pipeline_depth)->default_value(3), "Number of projections in flight on each device (optional)")
+                ("compression", boost::program_options::value<int>(&opts.compression)->default_value(0), "zstd level for ddbvf::write (optional)")
+                ("scratch", boost::program_options::value<std::string>(&opts.scratch)->default_value("/tmp"), "Directory for the temporary HIS and volume files (optional)")
+                ("output", boost::program_options::value<std::string>(&opts.output), "Append the results to this CSV file (optional)")
+                ("sweep-scales", boost::program_options::value<std::string>(&opts.sweep_scales)->default_value("0.5,1,2"), "Detector scales of the sweep (optional)")
+                ("sweep-projections", boost::program_options::value<std::string>(&opts.sweep_projections)->default_value("180,360,720"), "Projection counts of the sweep (optional)")
+                ("sweep-subvolumes", boost::program_options::value<std::string>(&opts.sweep_subvolumes)->default_value("0,2,4"), "Subvolume counts of the sweep (optional)");
+
+        try
+        {
+            auto param_map = boost::program_options::variables_map{};
+            boost::program_options::store(boost::program_options::parse_command_line(argc, argv, desc), param_map);
+
+            if(param_map.count("help"))
+            {
+                std::cout << desc << std::endl;
+                std::exit(EXIT_SUCCESS);
+            }
+
+            boost::program_options::notify(param_map);
+        }
+        catch(const boost::program_options::error& err)
+        {
+            std::cerr << err.what() << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+
+        if(opts.mode != "stages" && opts.mode != "end-to-end" && opts.mode != "sweep")
+        {
+            std::cerr << "unknown mode '" << opts.mode << "'" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+
+        if(opts.projections == 0u || opts.repetitions == 0u || !(opts.scale > 0.f))
+        {
+            std::cerr << "the options '--projections', '--repetitions' and '--scale' must be positive" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+
+        return opts;
+    }
+}
+
+auto main(int argc, char** argv) -> int
+{
+    // the pipeline's progress messages would distort the timings
+    boost::log::core::get()->set_filter(boost::log::trivial::severity >= boost::log::trivial::warning);
+
+    auto opts = make_options(argc, argv);
+
+    try
+    {
+        if(opts.mode == "sweep")
+            return run_sweep(opts, argv[0]);
+
+        auto base = opts.geometry_path.empty() ? schaum_geometry() : read_geometry(opts.geometry_path);
+        auto det_geo = scale_detector(base, opts.scale, opts.projections);
+        auto data = paris::benchmark::make_projections(paris::benchmark::make_phantom_type(opts.phantom), det_geo,
+                                                       opts.projections);
+
+        if(opts.mode == "stages")
+            run_stages(opts, det_geo, data);
+        else
+            run_end_to_end(opts, det_geo, data);
+    }
+    catch(const paris::stage_construction_error& sce)
+    {
+        BOOST_LOG_TRIVIAL(fatal) << "main(): Benchmark construction failed: " << sce.what();
+        return EXIT_FAILURE;
+    }
+    catch(const paris::stage_runtime_error& sre)
+    {
+        BOOST_LOG_TRIVIAL(fatal) << "main(): Benchmark execution failed: " << sre.what();
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,291 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/log/trivial.hpp>
+
+#include "../exception.h"
+#include "../geometry.h"
+
+#include "phantom.h"
+
+namespace paris
+{
+    namespace benchmark
+    {
+        namespace
+        {
+            // normalized to [-1, 1] in every direction, phi rotates around z [°]
+            struct ellipsoid
+            {
+                float x0, y0, z0;
+                float a, b, c;
+                float phi;
+                float rho;
+            };
+
+            // the modified (higher contrast) 3D Shepp-Logan head
+            const ellipsoid shepp_logan[] = {
+                {  0.f,     0.f,      0.f,    0.69f,   0.92f,  0.81f,    0.f,  1.f },
+                {  0.f,    -0.0184f,  0.f,    0.6624f, 0.874f, 0.78f,    0.f, -0.8f },
+                {  0.22f,   0.f,      0.f,    0.11f,   0.31f,  0.22f,  -18.f, -0.2f },
+                { -0.22f,   0.f,      0.f,    0.16f,   0.41f,  0.28f,   18.f, -0.2f },
+                {  0.f,     0.35f,   -0.15f,  0.21f,   0.25f,  0.41f,    0.f,  0.1f },
+                {  0.f,     0.1f,     0.25f,  0.046f,  0.046f, 0.05f,    0.f,  0.1f },
+                {  0.f,    -0.1f,     0.25f,  0.046f,  0.046f, 0.05f,    0.f,  0.1f },
+                { -0.08f,  -0.605f,   0.f,    0.046f,  0.023f, 0.05f,    0.f,  0.1f },
+                {  0.f,    -0.606f,   0.f,    0.023f,  0.023f, 0.02f,    0.f,  0.1f },
+                {  0.06f,  -0.605f,   0.f,    0.023f,  0.046f, 0.02f,    0.f,  0.1f }
+            };
+
+            constexpr auto cylinder_radius = 0.8f;
+            constexpr auto cylinder_height = 0.8f;
+
+            struct vec3
+            {
+                double x, y, z;
+            };
+
+            // length of the ray S + l * d inside the ellipsoid
+            auto intersect(const ellipsoid& e, const vec3& s, const vec3& d) noexcept -> double
+            {
+                const auto phi = static_cast<double>(e.phi) * M_PI / 180.;
+                const auto c = std::cos(phi);
+                const auto sn = std::sin(phi);
+
+                // into the ellipsoid's frame, scaled to the unit sphere
+                const auto px = s.x - e.x0;
+                const auto py = s.y - e.y0;
+                const auto pz = s.z - e.z0;
+                const auto ox = (px * c + py * sn) / e.a;
+                const auto oy = (-px * sn + py * c) / e.b;
+                const auto oz = pz / e.c;
+                const auto dx = (d.x * c + d.y * sn) / e.a;
+                const auto dy = (-d.x * sn + d.y * c) / e.b;
+                const auto dz = d.z / e.c;
+
+                const auto qa = dx * dx + dy * dy + dz * dz;
+                const auto qb = ox * dx + oy * dy + oz * dz;
+                const auto qc = ox * ox + oy * oy + oz * oz - 1.;
+                const auto disc = qb * qb - qa * qc;
+                return (disc > 0.) ? 2. * std::sqrt(disc) / qa : 0.;
+            }
+
+            // length of the ray inside the cylinder of radius r and half height h around the z axis
+            auto intersect_cylinder(double r, double h, const vec3& s, const vec3& d) noexcept -> double
+            {
+                const auto qa = d.x * d.x + d.y * d.y;
+                if(qa <= 0.)
+                    return 0.;
+
+                const auto qb = s.x * d.x + s.y * d.y;
+                const auto qc = s.x * s.x + s.y * s.y - r * r;
+                const auto disc = qb * qb - qa * qc;
+                if(disc <= 0.)
+                    return 0.;
+
+                auto l1 = (-qb - std::sqrt(disc)) / qa;
+                auto l2 = (-qb + std::sqrt(disc)) / qa;
+
+                // clip against the caps
+                if(std::abs(d.z) > 1e-12)
+                {
+                    auto z1 = (-h - s.z) / d.z;
+                    auto z2 = (h - s.z) / d.z;
+                    l1 = std::max(l1, std::min(z1, z2));
+                    l2 = std::min(l2, std::max(z1, z2));
+                }
+                else if(std::abs(s.z) > h)
+                    return 0.;
+
+                return std::max(l2 - l1, 0.);
+            }
+
+            auto project(phantom_type type, const detector_geometry& det_geo, const volume_geometry& vol_geo,
+                         std::uint32_t i, float* dest) noexcept -> void
+            {
+                // the phantom fills the reconstructable volume
+                const auto r_xy = static_cast<double>(vol_geo.dim_x) * vol_geo.l_vx_x / 2.;
+                const auto r_z = static_cast<double>(vol_geo.dim_z) * vol_geo.l_vx_z / 2.;
+
+                const auto phi = static_cast<double>(i) * det_geo.delta_phi * M_PI / 180.;
+                const auto c = std::cos(phi);
+                const auto sn = std::sin(phi);
+                const auto d_so = static_cast<double>(det_geo.d_so);
+                const auto d_sd = d_so + det_geo.d_od;
+
+                // the source rotates on the negative s axis, the detector lies on the positive one
+                const auto src = vec3{-d_so * c, -d_so * sn, 0.};
+
+                const auto l_row = static_cast<double>(det_geo.l_px_row);
+                const auto l_col = static_cast<double>(det_geo.l_px_col);
+                const auto u_0 = -static_cast<double>(det_geo.n_row) * l_row / 2. - det_geo.delta_s * l_row;
+                const auto w_0 = -static_cast<double>(det_geo.n_col) * l_col / 2. - det_geo.delta_t * l_col;
+
+                // normalized phantom coordinates -> the ellipsoids are scaled once per projection
+                auto scaled = std::vector<ellipsoid>{};
+                for(auto&& e : shepp_logan)
+                {
+                    auto s = ellipsoid{};
+                    s.x0 = e.x0 * static_cast<float>(r_xy);
+                    s.y0 = e.y0 * static_cast<float>(r_xy);
+                    s.z0 = e.z0 * static_cast<float>(r_z);
+                    s.a = e.a * static_cast<float>(r_xy);
+                    s.b = e.b * static_cast<float>(r_xy);
+                    s.c = e.c * static_cast<float>(r_z);
+                    s.phi = e.phi;
+                    s.rho = e.rho;
+                    scaled.push_back(s);
+                }
+
+                for(auto y = 0u; y < det_geo.n_col; ++y)
+                {
+                    const auto w = w_0 + (static_cast<double>(y) + 0.5) * l_col;
+                    for(auto x = 0u; x < det_geo.n_row; ++x)
+                    {
+                        const auto u = u_0 + (static_cast<double>(x) + 0.5) * l_row;
+
+                        auto d = vec3{d_sd * c - u * sn, d_sd * sn + u * c, w};
+                        const auto len = std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+                        d.x /= len;
+                        d.y /= len;
+                        d.z /= len;
+
+                        auto sum = 0.;
+                        if(type == phantom_type::cylinder)
+                            sum = intersect_cylinder(cylinder_radius * r_xy, cylinder_height * r_z, src, d);
+                        else
+                        {
+                            for(auto&& e : scaled)
+                                sum += static_cast<double>(e.rho) * intersect(e, src, d);
+                        }
+
+                        dest[static_cast<std::size_t>(y) * det_geo.n_row + x] = static_cast<float>(sum);
+                    }
+                }
+            }
+
+            template <typename T>
+            auto put(std::ofstream& out, T value) -> void
+            {
+                char buf[sizeof(T)];
+                std::memcpy(buf, &value, sizeof(T));
+                out.write(buf, sizeof(T));
+            }
+        }
+
+        auto make_phantom_type(const std::string& name) -> phantom_type
+        {
+            if(name == "shepp-logan")
+                return phantom_type::shepp_logan;
+            if(name == "cylinder")
+                return phantom_type::cylinder;
+
+            BOOST_LOG_TRIVIAL(fatal) << "Unknown phantom '" << name << "', use shepp-logan or cylinder";
+            throw stage_construction_error{"make_phantom_type() failed"};
+        }
+
+        auto make_projections(phantom_type type, const detector_geometry& det_geo, std::uint32_t num)
+            -> std::vector<float>
+        {
+            const auto vol_geo = calculate_volume_geometry(det_geo);
+            const auto size = static_cast<std::size_t>(det_geo.n_row) * det_geo.n_col;
+            auto projections = std::vector<float>(size * num);
+
+            // every thread computes every n-th projection
+            auto n = std::max(std::thread::hardware_concurrency(), 1u);
+            auto threads = std::vector<std::thread>{};
+            for(auto t = 0u; t < n; ++t)
+            {
+                threads.emplace_back([&, t]()
+                {
+                    for(auto i = t; i < num; i += n)
+                        project(type, det_geo, vol_geo, i, projections.data() + i * size);
+                });
+            }
+
+            for(auto&& t : threads)
+                t.join();
+
+            return projections;
+        }
+
+        auto write_his(const std::string& path, const std::vector<float>& projections, std::uint32_t dim_x,
+                       std::uint32_t dim_y, std::uint32_t num) -> void
+        {
+            constexpr auto max_dim = std::uint32_t{std::numeric_limits<std::uint16_t>::max()};
+            if(dim_x == 0u || dim_y == 0u || dim_x > max_dim || dim_y > max_dim || num > max_dim)
+            {
+                BOOST_LOG_TRIVIAL(fatal) << "HIS files cannot hold " << num << " frames of " << dim_x << " x "
+                                         << dim_y << " pixels";
+                throw stage_construction_error{"write_his() failed"};
+            }
+
+            auto out = std::ofstream{path, std::ios::binary | std::ios::trunc};
+            if(!out)
+            {
+                BOOST_LOG_TRIVIAL(fatal) << "Could not create " << path;
+                throw stage_construction_error{"write_his() failed"};
+            }
+
+            constexpr auto header_size = std::uint16_t{68u};
+            const auto frame_size = static_cast<std::size_t>(dim_x) * dim_y * sizeof(float);
+
+            // file header, followed by image headers of size 0 and the frames
+            put(out, std::uint16_t{0x7000});
+            put(out, header_size);
+            put(out, std::uint16_t{100u});
+            put(out, static_cast<std::uint32_t>(std::min<std::size_t>(header_size + frame_size * num,
+                                                                      std::numeric_limits<std::uint32_t>::max())));
+            put(out, std::uint16_t{0u});
+            put(out, std::uint16_t{0u});
+            put(out, std::uint16_t{0u});
+            put(out, static_cast<std::uint16_t>(dim_x - 1u));
+            put(out, static_cast<std::uint16_t>(dim_y - 1u));
+            put(out, static_cast<std::uint16_t>(num));
+            put(out, std::uint16_t{0u});
+            put(out, 0.);
+            put(out, std::uint16_t{128u});
+            const char rest[34] = {};
+            out.write(rest, sizeof(rest));
+
+            out.write(reinterpret_cast<const char*>(projections.data()),
+                      static_cast<std::streamsize>(frame_size * num));
+
+            if(!out)
+            {
+                BOOST_LOG_TRIVIAL(fatal) << "Could not write " << path;
+                throw stage_construction_error{"write_his() failed"};
+            }
+        }
+    }
+}
@@ -0,0 +1,58 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#ifndef PARIS_BENCHMARK_PHANTOM_H_
+#define PARIS_BENCHMARK_PHANTOM_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../geometry.h"
+
+namespace paris
+{
+    namespace benchmark
+    {
+        enum class phantom_type
+        {
+            shepp_logan,    // the 3D Shepp-Logan head, scaled to the reconstructable volume
+            cylinder        // a homogeneous cylinder along the rotation axis
+        };
+
+        auto make_phantom_type(const std::string& name) -> phantom_type;
+
+        /*
+         * Exact line integrals of the phantom for num projections of the cone beam geometry, one after another
+         * with n_row * n_col pixels each. Projection i is taken at i * det_geo.delta_phi with the same conventions
+         * as the backprojection, so the result reconstructs to the phantom.
+         */
+        auto make_projections(phantom_type type, const detector_geometry& det_geo, std::uint32_t num)
+            -> std::vector<float>;
+
+        // writes the projections as a single HIS file of float frames
+        auto write_his(const std::string& path, const std::vector<float>& projections, std::uint32_t dim_x,
+                       std::uint32_t dim_y, std::uint32_t num) -> void;
+    }
+}
+
+#endif /* PARIS_BENCHMARK_PHANTOM_H_ */
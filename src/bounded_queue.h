@@ -0,0 +1,86 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#ifndef PARIS_BOUNDED_QUEUE_H_
+#define PARIS_BOUNDED_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace paris
+{
+    /*
+     * Lock-free ring buffer for exactly one producer and one consumer thread. One slot is kept empty to
+     * distinguish a full queue from an empty one.
+     */
+    template <class T>
+    class bounded_queue
+    {
+        public:
+            explicit bounded_queue(std::size_t capacity)
+            : buf_(capacity + 1), head_{0u}, tail_{0u}
+            {}
+
+            auto try_push(T& t) -> bool
+            {
+                const auto tail = tail_.load(std::memory_order_relaxed);
+                const auto next = increment(tail);
+                if(next == head_.load(std::memory_order_acquire))
+                    return false;
+
+                buf_[tail] = std::move(t);
+                tail_.store(next, std::memory_order_release);
+                return true;
+            }
+
+            auto try_pop(T& t) -> bool
+            {
+                const auto head = head_.load(std::memory_order_relaxed);
+                if(head == tail_.load(std::memory_order_acquire))
+                    return false;
+
+                t = std::move(buf_[head]);
+                head_.store(increment(head), std::memory_order_release);
+                return true;
+            }
+
+            auto empty() const noexcept -> bool
+            {
+                return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+            }
+
+        private:
+            auto increment(std::size_t i) const noexcept -> std::size_t
+            {
+                return (i + 1u) % buf_.size();
+            }
+
+        private:
+            std::vector<T> buf_;
+            std::atomic<std::size_t> head_;
+            std::atomic<std::size_t> tail_;
+    };
+}
+
+#endif /* PARIS_BOUNDED_QUEUE_H_ */
@@ -0,0 +1,103 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#include <cstdlib>
+
+#include <boost/log/trivial.hpp>
+
+#if defined(PARIS_ENABLE_MPI)
+// only the C interface is used, the deprecated C++ bindings would drag in libmpi_cxx
+#define OMPI_SKIP_MPICXX 1
+#define MPICH_SKIP_MPICXX 1
+#include <mpi.h>
+#endif
+
+#include "communicator.h"
+
+namespace paris
+{
+#if defined(PARIS_ENABLE_MPI)
+    communicator::communicator(int& argc, char**& argv)
+    : rank_{0}, size_{1}
+    {
+        auto provided = 0;
+        MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+        if(provided < MPI_THREAD_FUNNELED)
+            BOOST_LOG_TRIVIAL(warning) << "The MPI implementation doesn't support multithreaded processes";
+
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank_);
+        MPI_Comm_size(MPI_COMM_WORLD, &size_);
+    }
+
+    communicator::~communicator()
+    {
+        MPI_Finalize();
+    }
+
+    auto communicator::barrier() const -> void
+    {
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+
+    auto communicator::max(int value) const -> int
+    {
+        auto result = value;
+        MPI_Allreduce(&value, &result, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+        return result;
+    }
+
+    auto communicator::abort(int code) const -> void
+    {
+        if(size_ > 1)
+            MPI_Abort(MPI_COMM_WORLD, code);
+        std::exit(code);
+    }
+#else
+    communicator::communicator(int&, char**&)
+    : rank_{0}, size_{1}
+    {}
+
+    communicator::~communicator() = default;
+
+    auto communicator::barrier() const -> void {}
+
+    auto communicator::max(int value) const -> int
+    {
+        return value;
+    }
+
+    auto communicator::abort(int code) const -> void
+    {
+        std::exit(code);
+    }
+#endif
+
+    auto communicator::rank() const noexcept -> int
+    {
+        return rank_;
+    }
+
+    auto communicator::size() const noexcept -> int
+    {
+        return size_;
+    }
+}
@@ -0,0 +1,56 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#ifndef PARIS_COMMUNICATOR_H_
+#define PARIS_COMMUNICATOR_H_
+
+namespace paris
+{
+    /*
+     * The MPI environment. Only the main thread communicates. Without MPI support the process is rank 0 of 1 and
+     * all operations are no-ops.
+     */
+    class communicator
+    {
+        public:
+            communicator(int& argc, char**& argv);
+            ~communicator();
+
+            communicator(const communicator&) = delete;
+            auto operator=(const communicator&) -> communicator& = delete;
+
+            auto rank() const noexcept -> int;
+            auto size() const noexcept -> int;
+
+            auto barrier() const -> void;
+            auto max(int value) const -> int;
+
+            // terminates all ranks
+            [[noreturn]] auto abort(int code) const -> void;
+
+        private:
+            int rank_;
+            int size_;
+    };
+}
+
+#endif /* PARIS_COMMUNICATOR_H_ */
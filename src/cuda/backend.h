@@ -23,7 +23,10 @@
 #ifndef PARIS_CUDA_BACKEND_H_
 #define PARIS_CUDA_BACKEND_H_
 
+#include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <string>
 #include <vector>
 
 #include <cufft.h>
@@ -32,9 +35,11 @@
 #include <glados/cuda/memory.h>
 
 #include "../geometry.h"
+#include "../interpolation.h"
 #include "../projection.h"
 #include "../region_of_interest.h"
 #include "../subvolume_information.h"
+#include "../trajectory.h"
 #include "../volume.h"
 
 namespace paris
@@ -45,11 +50,18 @@ namespace paris
         {
             using allocator = glados::cuda::device_allocator<float, glados::memory_layout::pointer_2D>;
             using pool = glados::pool_allocator<float, glados::memory_layout::pointer_2D, allocator>;
+
+            // hands page-locked host memory back to the host pool instead of freeing it
+            struct pinned_deleter
+            {
+                std::size_t size;
+                auto operator()(float* p) noexcept -> void;
+            };
         }
 
-        using projection_host_buffer_type = glados::cuda::pinned_host_ptr<float>;
+        using projection_host_buffer_type = std::unique_ptr<float[], detail::pinned_deleter>;
         using projection_device_buffer_type = typename detail::pool::smart_pointer;
-        using volume_host_buffer_type = glados::cuda::pinned_host_ptr<float>;
+        using volume_host_buffer_type = std::unique_ptr<float[], detail::pinned_deleter>;
         using volume_device_buffer_type = glados::cuda::pitched_device_ptr<float>;
 
         struct cuda_stream
@@ -58,6 +70,10 @@ namespace paris
             ~cuda_stream();
 
             cudaStream_t stream;
+
+            // events for ordering the pipeline stages between streams
+            cudaEvent_t filtered;
+            cudaEvent_t done;
         };
         using metadata = cuda_stream*;
 
@@ -66,33 +82,133 @@ namespace paris
         using volume_host_type = volume<volume_host_buffer_type>;
         using volume_device_type = volume<volume_device_buffer_type>;
 
+        /**
+         * Host buffers are page-locked and recycled, pinning memory is far more expensive than reusing it. Up to
+         * bytes of released buffers are kept for reuse, anything beyond that is freed
+         * */
+        auto set_host_pool_size(std::size_t bytes) noexcept -> void;
+
         auto make_projection_host(std::uint32_t dim_x, std::uint32_t dim_y) -> projection_host_type;
         auto make_projection_device(std::uint32_t dim_x, std::uint32_t dim_y) -> projection_device_type;
 
         auto make_volume_host(std::uint32_t dim_x, std::uint32_t dim_y, std::uint32_t dim_z) -> volume_host_type;
         auto make_volume_device(std::uint32_t dim_x, std::uint32_t dim_y, std::uint32_t dim_z) -> volume_device_type;
 
+        // volumes live in device memory and cannot be mapped from the output file
+        constexpr auto maps_volumes = false;
+        auto map_volume(int fd, std::uint64_t pos, std::uint32_t dim_x, std::uint32_t dim_y, std::uint32_t dim_z)
+            -> volume_device_type;
+
         auto copy_h2d(const projection_host_type& h_p, projection_device_type& d_p) -> void;
         auto copy_d2h(const projection_device_type& d_p, projection_host_type& h_p) -> void;
 
+        // uploads the rows [first, first + d_p.dim_y) of h_p
+        auto copy_h2d(const projection_host_type& h_p, projection_device_type& d_p, std::uint32_t first) -> void;
+
+        // downloads the columns [first, first + h_p.dim_x) of d_p
+        auto copy_d2h(const projection_device_type& d_p, projection_host_type& h_p, std::uint32_t first) -> void;
+
         auto copy_h2d(const volume_host_type& h_v, volume_device_type& d_v) -> void;
         auto copy_d2h(const volume_device_type& d_v, volume_host_type& h_v) -> void;
+        // downloads the slices [first, first + h_v.dim_z) of d_v
+        auto copy_d2h(const volume_device_type& d_v, volume_host_type& h_v, std::uint32_t first) -> void;
+
+        // splits the volume into as few subvolumes as fit into every device's memory budget next to the pipeline
+        auto make_subvolume_information(const volume_geometry& vol_geo, const detector_geometry& det_geo,
+                                        const memory_parameters& mem) -> subvolume_info;
+
+        // the weights only depend on the geometry, they are applied while expanding the projection for filtering
+        using weight_buffer_type = glados::cuda::pitched_device_ptr<float>;
+        auto make_weights(std::uint32_t dim_x, std::uint32_t dim_y, float h_min, float v_min, float d_sd,
+                          float l_px_row, float l_px_col) -> weight_buffer_type;
+
+        // real frequency response, already includes the normalization of the inverse FFT
+        using filter_buffer_type = glados::cuda::device_ptr<float>;
+        auto make_filter(const std::vector<float>& response) -> filter_buffer_type;
+        // cuFFT plans are bound to a stream and created per stream, there is no wisdom to share
+        struct filter_plan_type {};
+        inline auto make_filter_plan(std::uint32_t, std::uint32_t, const std::string&) noexcept -> filter_plan_type
+        {
+            return filter_plan_type{};
+        }
+        auto apply_filter(projection_device_type& p, const filter_buffer_type& k, const weight_buffer_type& w,
+                          const filter_plan_type& plan, std::uint32_t filter_size, std::uint32_t n_col) -> void;
+        // filters all projections at once, small detectors keep the device busy this way
+        auto apply_filter(std::vector<projection_device_type>& p, const filter_buffer_type& k,
+                          const weight_buffer_type& w, const filter_plan_type& plan,
+                          std::uint32_t filter_size, std::uint32_t n_col) -> void;
 
-        auto make_subvolume_information(const volume_geometry& vol_geo, const detector_geometry& det_geo)
-            -> subvolume_info;
+        // number of projections which can be backprojected in one pass over the volume
+        constexpr auto max_batch_size = std::uint32_t{32u};
 
-        auto weight(projection_device_type& p, float h_min, float v_min, float d_sd, float l_px_row, float l_px_col)
+        /**
+         * Fused filtering -- detectors up to max_fused_width pixels wide are weighted and convolved with the spatial
+         * filter taps in a single kernel, the launches of the FFT path would dominate otherwise
+         * */
+        constexpr auto max_fused_width = std::uint32_t{512u};
+        /*
+         * Batched filtering -- the FFTs of up to a batch of projections share one cuFFT call if the filter is at most
+         * max_batched_filter_size long. Larger detectors keep the device busy on their own and are filtered one by one
+         */
+        constexpr auto max_batched_filter_size = std::uint32_t{2048u};
+        // taps holds the 2 * dim_x - 1 coefficients centred on dim_x - 1, all projections cover the same rows
+        auto apply_fused_filter(std::vector<projection_device_type>& p, const filter_buffer_type& taps,
+                                const weight_buffer_type& w, std::uint32_t n_col) -> void;
+        auto backproject(const std::vector<projection_device_type>& p, volume_device_type& v, std::uint32_t v_offset,
+                         const detector_geometry& det_geo, const volume_geometry& vol_geo, 
+                         bool enable_roi, const region_of_interest& roi,
+                         const std::vector<float>& sin, const std::vector<float>& cos,
+                         float delta_s, float delta_t) -> void;
+
+        // arbitrary trajectories: the projection matrix m[i] of every projection replaces the circular geometry
+        auto backproject(const std::vector<projection_device_type>& p, volume_device_type& v, std::uint32_t v_offset,
+                         const detector_geometry& det_geo, const volume_geometry& vol_geo,
+                         bool enable_roi, const region_of_interest& roi,
+                         const std::vector<projection_matrix>& m) -> void;
+
+        /**
+         * Interpolation -- the backprojections of the calling thread sample the detector with mode from now on.
+         * Every mode has its own kernels, fast_f16 keeps the projections of a batch in half precision textures
+         * */
+        auto set_interpolation(interpolation mode) noexcept -> void;
+
+        /**
+         * Iterative reconstruction -- the volume and the projections stay in device memory between iterations
+         * */
+        // adds the voxel-driven projection of v to p, the transpose of backproject() up to a constant factor
+        auto forward_project(const volume_device_type& v, std::uint32_t v_offset,
+                             std::vector<projection_device_type>& p,
+                             const detector_geometry& det_geo, const volume_geometry& vol_geo,
+                             const std::vector<float>& sin, const std::vector<float>& cos,
+                             float delta_s, float delta_t) -> void;
+        auto fill(projection_device_type& p, float value) -> void;
+        auto fill(volume_device_type& v, float value) -> void;
+        // replaces every value by its reciprocal, (almost) empty rays and voxels become 0
+        auto invert(projection_device_type& p) -> void;
+        auto invert(volume_device_type& v) -> void;
+        // ax = (b - ax) * w
+        auto residual(const projection_device_type& b, projection_device_type& ax, const projection_device_type& w)
             -> void;
+        // x += lambda * c * corr, clamped to positive values if requested, then clears corr
+        auto update(volume_device_type& x, volume_device_type& corr, const volume_device_type& c, float lambda,
+                    bool nonnegative) -> void;
 
-        using filter_buffer_type = glados::cuda::device_ptr<cufftComplex>;
-        auto make_filter(std::uint32_t size, float tau) -> filter_buffer_type;
-        auto apply_filter(projection_device_type& p, const filter_buffer_type& k, std::uint32_t filter_size,
-                          std::uint32_t n_col) -> void;
+        /**
+         * Pipelining -- up to depth projections are processed concurrently on separate streams
+         * */
+        auto set_pipeline_depth(std::uint32_t depth) noexcept -> void;
+        auto synchronize(const projection_device_type& p) -> void;
 
-        auto backproject(const projection_device_type& p, volume_device_type& v, std::uint32_t v_offset,
-                         const detector_geometry& det_geo, const volume_geometry& vol_geo, 
-                         bool enable_roi, const region_of_interest& roi,
-                         float sin, float cos, float delta_s, float delta_t) -> void;
+        /**
+         * Autotuning -- the backprojection's launch configuration is benchmarked on the first batch of every GPU
+         * model and geometry. The winners are kept in dir between runs unless it is empty
+         * */
+        auto set_tuning_dir(const std::string& dir) -> void;
+
+        /**
+         * NUMA -- device memory is placed by the driver, nothing to bind
+         * */
+        inline auto enable_numa() noexcept -> bool { return false; }
 
         /**
          * Device management
@@ -100,6 +216,26 @@ namespace paris
         using device_handle = int;
         auto get_devices() -> std::vector<device_handle>;
         auto set_device(device_handle& device) -> void;
+
+        /**
+         * Peer-to-peer -- devices which can read each other's memory hand filtered projections over directly instead
+         * of downloading them once and uploading them to every other device
+         * */
+        using projection_peer_type = projection<glados::cuda::pitched_device_ptr<float>, metadata>;
+        // true if every device can access all others, peer access is enabled between all of them then
+        auto enable_peer_access(const std::vector<device_handle>& devices) -> bool;
+        // allocated on the current device, not pooled -- the caller recycles them
+        auto make_projection_peer(std::uint32_t dim_x, std::uint32_t dim_y) -> projection_peer_type;
+        // copies the columns [first, first + p.dim_x) of d_p
+        auto copy_d2p(const projection_device_type& d_p, projection_peer_type& p, std::uint32_t first) -> void;
+        // copies the rows [first, first + d_p.dim_y) of p, which may reside on another device, to d_p
+        auto copy_p2d(const projection_peer_type& p, projection_device_type& d_p, std::uint32_t first) -> void;
+
+        /**
+         * Profiling -- named NVTX ranges around the pipeline stages, no-ops unless built with PARIS_ENABLE_NVTX
+         * */
+        auto push_range(const char* name) noexcept -> void;
+        auto pop_range() noexcept -> void;
     }
 }
 
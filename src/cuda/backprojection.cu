@@ -20,20 +20,33 @@
  * Authors: Jan Stephan <j.stephan@hzdr.de>
  */
 
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
 #include <boost/log/trivial.hpp>
 
+#include <cuda_fp16.h>
+
 #include <glados/cuda/coordinates.h>
 #include <glados/cuda/launch.h>
 #include <glados/cuda/utility.h>
 
+#include "../backprojection_constants.h"
 #include "../exception.h"
+#include "../interpolation.h"
 #include "../region_of_interest.h"
+#include "../trajectory.h"
 
 #include "backend.h"
-#include "backprojection_constants.h"
+#include "launch_config.h"
 
 namespace paris
 {
@@ -41,8 +54,15 @@ namespace paris
     {
         namespace
         {
+            // projection matrices of the projections in the current batch
+            struct backprojection_matrices
+            {
+                projection_matrix m[max_batch_size];
+            };
+
             // note that each device will automatically keep track of its own symbol
             __device__ __constant__ backprojection_constants dev_consts__{};
+            __device__ __constant__ backprojection_matrices dev_matrices__{};
             __device__ __constant__ region_of_interest dev_roi__{};
 
             inline __device__ auto vol_centered_coordinate(unsigned int coord,
@@ -53,34 +73,86 @@ namespace paris
                 return -(dim * size2) + size2 + coord * size;
             }
 
-            inline __device__ auto proj_real_coordinate(float coord, std::uint32_t dim,
-                                                        float size, float offset) -> float
+            // the mode of the calling thread's backprojections, see set_interpolation()
+            thread_local interpolation interp_mode = interpolation::fast;
+
+            /*
+             * Samples layer i of proj at (h, v), the pixel centres lie at .5. The texture unit filters with 8 bit
+             * fractional weights -- linearly for the fast modes, not at all for nearest where (h, v) lies in the
+             * closest pixel -- so these share one kernel. Precise textures are point sampled and the four
+             * neighbours are weighted in fp32.
+             */
+            template <interpolation mode>
+            inline __device__ auto sample(cudaTextureObject_t proj, float h, float v, int i) -> float
+            {
+                if(mode != interpolation::precise)
+                    return tex2DLayered<float>(proj, h, v, i);
+
+                auto x1 = floorf(h - 0.5f);
+                auto y1 = floorf(v - 0.5f);
+                auto fx = h - 0.5f - x1;
+                auto fy = v - 0.5f - y1;
+
+                // the zero border stands in for the missing neighbours
+                auto q11 = tex2DLayered<float>(proj, x1 + 0.5f, y1 + 0.5f, i);
+                auto q21 = tex2DLayered<float>(proj, x1 + 1.5f, y1 + 0.5f, i);
+                auto q12 = tex2DLayered<float>(proj, x1 + 0.5f, y1 + 1.5f, i);
+                auto q22 = tex2DLayered<float>(proj, x1 + 1.5f, y1 + 1.5f, i);
+
+                auto top = fmaf(fx, q21 - q11, q11);
+                auto bottom = fmaf(fx, q22 - q12, q12);
+                return fmaf(fy, bottom - top, top);
+            }
+
+            // the kernels of nearest are those of fast
+            constexpr auto kernel_mode(interpolation mode) noexcept -> interpolation
+            {
+                return (mode == interpolation::precise) ? interpolation::precise : interpolation::fast;
+            }
+
+            // the detector coordinate c maps to the pixel coordinate c / size + proj_offset()
+            inline auto proj_offset(std::uint32_t dim, float size, float offset) noexcept -> float
             {
                 auto size2 = size / 2.f;
-                auto min = -(dim * size2) - offset;
-                return (coord - min) / size - (1.f / 2.f);
+                auto min = -(static_cast<float>(dim) * size2) - offset;
+                return -min / size - (1.f / 2.f);
             }
 
-            template <bool enable_roi>
+            /*
+             * Specialised for the beam geometry: fan beams don't need the divide for v as every slice is seen by the
+             * same detector row, parallel beams need no divide and no distance weight at all. Every thread updates
+             * slices consecutive voxels along z which share the terms of the projection that only depend on x and y.
+             * Column kernels require matrices with a[2] = a[10] = 0 -- circular trajectories, fan and parallel beams
+             * -- where the whole perspective divide is shared by the slices of a thread. The interpolation mode is
+             * a template parameter as well, see sample().
+             */
+            template <interpolation mode, beam_geometry beam, bool enable_roi, bool column, std::uint32_t slices,
+                      std::uint32_t unroll_factor>
             __global__ void backprojection_kernel(float* __restrict__ vol, std::size_t vol_pitch,
-                                                  cudaTextureObject_t proj, float angle_sin,
-                                                  float angle_cos)
+                                                  cudaTextureObject_t proj, std::uint32_t n)
             {
                 auto k = glados::cuda::coord_x();
                 auto l = glados::cuda::coord_y();
-                auto m = glados::cuda::coord_z();
+                auto m = glados::cuda::coord_z() * slices;
 
                 if((k < dev_consts__.vol_dim_x) &&
                    (l < dev_consts__.vol_dim_y) &&
                    (m < dev_consts__.vol_dim_z))
                 {
                     auto slice_pitch = vol_pitch * dev_consts__.vol_dim_y;
-                    auto slice = reinterpret_cast<char*>(vol) + m * slice_pitch;
-                    auto row = reinterpret_cast<float*>(slice + l * vol_pitch);
+                    auto first = reinterpret_cast<char*>(vol) + m * slice_pitch + l * vol_pitch;
+
+                    // load old values from global memory while executing other instructions
+                    float old_val[slices];
+                    float sum[slices];
+                    #pragma unroll
+                    for(auto j = 0u; j < slices; ++j)
+                    {
+                        old_val[j] = (m + j < dev_consts__.vol_dim_z)
+                                     ? reinterpret_cast<float*>(first + j * slice_pitch)[k] : 0.f;
+                        sum[j] = 0.f;
+                    }
 
-                    // load old value from global memory while executing other instructions
-                    auto old_val = row[k];
-                    
                     // add ROI offset. If enable_roi == false, this will be optimized away
                     if(enable_roi)
                     {
@@ -97,85 +169,574 @@ namespace paris
                                                             dev_consts__.l_vx_x);
                     auto y_l = vol_centered_coordinate(l, dev_consts__.vol_dim_y_full,
                                                             dev_consts__.l_vx_y);
-                    auto z_m = vol_centered_coordinate(m, dev_consts__.vol_dim_z_full,
-                                                            dev_consts__.l_vx_z);
-
-                    // rotate coordinates
-                    auto s = x_k * angle_cos + y_l * angle_sin;
-                    auto t = -x_k * angle_sin + y_l * angle_cos;
-
-                    // project rotated coordinates
-                    auto factor = dev_consts__.d_sd / (s + dev_consts__.d_so);
-                    // add 0.5 to each coordinate to deal with CUDA's filtering mechanism
-                    auto h = proj_real_coordinate(t * factor, dev_consts__.proj_dim_x,
-                                                                dev_consts__.l_px_x,
-                                                                dev_consts__.delta_s) + 0.5f;
-                    auto v = proj_real_coordinate(z_m * factor, dev_consts__.proj_dim_y,
-                                                                dev_consts__.l_px_y,
-                                                                dev_consts__.delta_t) + 0.5f;
-
-                    // get projection value (note the implicit linear interpolation)
-                    auto det = tex2D<float>(proj, h, v);
-
-                    // backproject
-                    auto u = -(dev_consts__.d_so / (s + dev_consts__.d_so));
-
-                    // restore old coordinate for writing.
-                    if(enable_roi)
-                        k -= dev_roi__.x1;
 
-                    // write value
-                    row[k] = old_val + 0.5f * det * u * u;
+                    // accumulate the contributions of all projections in the batch before touching the volume
+                    #pragma unroll (unroll_factor)
+                    for(auto i = 0u; i < n; ++i)
+                    {
+                        // project the voxels, starting with the terms all slices share
+                        const auto& a = dev_matrices__.m[i].m;
+                        auto h_xy = a[0] * x_k + a[1] * y_l + a[3];
+                        auto v_xy = a[4] * x_k + a[5] * y_l + a[7];
+                        auto w_xy = a[8] * x_k + a[9] * y_l + a[11];
+
+                        if(column)
+                        {
+                            // w and h don't depend on z, only v moves by a constant step from slice to slice
+                            auto w_inv = 1.f;
+                            if(beam != beam_geometry::parallel)
+                                w_inv = 1.f / w_xy;
+
+                            // add 0.5 to each coordinate to deal with CUDA's filtering mechanism
+                            auto h = h_xy * w_inv - static_cast<float>(dev_consts__.proj_first_col) + 0.5f;
+
+                            auto z_m = vol_centered_coordinate(m, dev_consts__.vol_dim_z_full, dev_consts__.l_vx_z);
+                            auto v = 0.f;
+                            auto dv = a[6] * dev_consts__.l_vx_z;
+                            if(beam == beam_geometry::cone)
+                            {
+                                v = (v_xy + a[6] * z_m) * w_inv;
+                                dv *= w_inv;
+                            }
+                            else
+                                v = a[6] * z_m + a[7];
+                            v += -static_cast<float>(dev_consts__.proj_first_row) + 0.5f;
+
+                            auto weight = 0.5f;
+                            if(beam != beam_geometry::parallel)
+                            {
+                                auto u = dev_consts__.d_so * w_inv;
+                                weight *= u * u;
+                            }
+
+                            #pragma unroll
+                            for(auto j = 0u; j < slices; ++j)
+                                sum[j] += weight * sample<mode>(proj, h, v + static_cast<float>(j) * dv,
+                                                                static_cast<int>(i));
+                            continue;
+                        }
+
+                        #pragma unroll
+                        for(auto j = 0u; j < slices; ++j)
+                        {
+                            auto z_m = vol_centered_coordinate(m + j, dev_consts__.vol_dim_z_full,
+                                                                    dev_consts__.l_vx_z);
+
+                            auto w_inv = 1.f;
+                            if(beam != beam_geometry::parallel)
+                                w_inv = 1.f / (w_xy + a[10] * z_m);
+
+                            // add 0.5 to each coordinate to deal with CUDA's filtering mechanism
+                            auto h = (h_xy + a[2] * z_m) * w_inv
+                                     - static_cast<float>(dev_consts__.proj_first_col) + 0.5f;
+                            auto v = 0.f;
+                            if(beam == beam_geometry::cone)
+                                v = (v_xy + a[6] * z_m) * w_inv;
+                            else
+                                v = a[6] * z_m + a[7];
+                            v += -static_cast<float>(dev_consts__.proj_first_row) + 0.5f;
+
+                            // get projection value
+                            auto det = sample<mode>(proj, h, v, static_cast<int>(i));
+
+                            // backproject
+                            if(beam == beam_geometry::parallel)
+                                sum[j] += 0.5f * det;
+                            else
+                            {
+                                auto u = dev_consts__.d_so * w_inv;
+                                sum[j] += 0.5f * det * u * u;
+                            }
+                        }
+                    }
+
+                    // write values, the last thread of a column may cover slices past the subvolume
+                    m = glados::cuda::coord_z() * slices;
+                    #pragma unroll
+                    for(auto j = 0u; j < slices; ++j)
+                    {
+                        if(m + j < dev_consts__.vol_dim_z)
+                            reinterpret_cast<float*>(first + j * slice_pitch)[glados::cuda::coord_x()] =
+                                old_val[j] + sum[j];
+                    }
+                }
+            }
+
+            using backprojection_fn = void (*)(float*, std::size_t, cudaTextureObject_t, std::uint32_t);
+
+            // maps a launch configuration to its instantiation, see launch_candidates()
+            template <interpolation mode, beam_geometry beam, bool enable_roi, bool column, std::uint32_t slices>
+            auto select_kernel(std::uint32_t unroll) noexcept -> backprojection_fn
+            {
+                switch(unroll)
+                {
+                    case 4u: return backprojection_kernel<mode, beam, enable_roi, column, slices, 4u>;
+                    case 2u: return backprojection_kernel<mode, beam, enable_roi, column, slices, 2u>;
+                    default: return backprojection_kernel<mode, beam, enable_roi, column, slices, 1u>;
+                }
+            }
+
+            template <interpolation mode, beam_geometry beam, bool enable_roi, bool column>
+            auto select_kernel(const launch_config& cfg) noexcept -> backprojection_fn
+            {
+                switch(cfg.slices)
+                {
+                    case 8u: return select_kernel<mode, beam, enable_roi, column, 8u>(cfg.unroll);
+                    case 4u: return select_kernel<mode, beam, enable_roi, column, 4u>(cfg.unroll);
+                    case 2u: return select_kernel<mode, beam, enable_roi, column, 2u>(cfg.unroll);
+                    default: return select_kernel<mode, beam, enable_roi, column, 1u>(cfg.unroll);
+                }
+            }
+
+            template <interpolation mode, beam_geometry beam, bool column>
+            auto select_kernel(bool enable_roi, const launch_config& cfg) noexcept -> backprojection_fn
+            {
+                return enable_roi ? select_kernel<mode, beam, true, column>(cfg)
+                                  : select_kernel<mode, beam, false, column>(cfg);
+            }
+
+            // fan and parallel beams always have column matrices
+            template <interpolation mode>
+            auto select_kernel(beam_geometry beam, bool enable_roi, bool column, const launch_config& cfg) noexcept
+            -> backprojection_fn
+            {
+                switch(beam)
+                {
+                    case beam_geometry::fan: return select_kernel<mode, beam_geometry::fan, true>(enable_roi, cfg);
+                    case beam_geometry::parallel:
+                        return select_kernel<mode, beam_geometry::parallel, true>(enable_roi, cfg);
+                    case beam_geometry::cone:
+                        break;
+                }
+
+                return column ? select_kernel<mode, beam_geometry::cone, true>(enable_roi, cfg)
+                              : select_kernel<mode, beam_geometry::cone, false>(enable_roi, cfg);
+            }
+
+            auto select_kernel(interpolation mode, beam_geometry beam, bool enable_roi, bool column,
+                               const launch_config& cfg) noexcept -> backprojection_fn
+            {
+                if(kernel_mode(mode) == interpolation::precise)
+                    return select_kernel<interpolation::precise>(beam, enable_roi, column, cfg);
+                return select_kernel<interpolation::fast>(beam, enable_roi, column, cfg);
+            }
+
+            // stores layer of the half precision array behind dst, the texture unit can't convert while copying
+            __global__ void half_kernel(cudaSurfaceObject_t dst, int layer, const float* __restrict__ src,
+                                        std::size_t src_pitch, std::uint32_t dim_x, std::uint32_t dim_y)
+            {
+                auto x = glados::cuda::coord_x();
+                auto y = glados::cuda::coord_y();
+
+                if((x < dim_x) && (y < dim_y))
+                {
+                    auto row = reinterpret_cast<const float*>(reinterpret_cast<const char*>(src) + y * src_pitch);
+                    surf2DLayeredwrite(__half_as_ushort(__float2half(row[x])), dst,
+                                       static_cast<int>(x * sizeof(__half)), static_cast<int>(y), layer);
+                }
+            }
+
+            // true if no matrix of the batch moves the perspective divide or h along z
+            auto is_column_batch(const std::vector<projection_matrix>& m, std::size_t n) noexcept -> bool
+            {
+                for(auto i = std::size_t{0u}; i < n; ++i)
+                {
+                    if(std::fpclassify(m[i].m[2]) != FP_ZERO || std::fpclassify(m[i].m[10]) != FP_ZERO)
+                        return false;
+                }
+                return true;
+            }
+
+            auto launch_backprojection(cudaStream_t stream, backprojection_fn kernel, const launch_config& cfg,
+                                       float* vol, std::size_t vol_pitch, std::uint32_t dim_x, std::uint32_t dim_y,
+                                       std::uint32_t dim_z, cudaTextureObject_t proj, std::uint32_t n) -> void
+            {
+                auto threads_z = (dim_z + cfg.slices - 1u) / cfg.slices;
+                auto block = dim3{cfg.block_x, cfg.block_y, cfg.block_z};
+                auto grid = dim3{(dim_x + cfg.block_x - 1u) / cfg.block_x,
+                                 (dim_y + cfg.block_y - 1u) / cfg.block_y,
+                                 (threads_z + cfg.block_z - 1u) / cfg.block_z};
+
+                kernel<<<grid, block, 0u, stream>>>(vol, vol_pitch, proj, n);
+
+                auto err = cudaGetLastError();
+                if(err != cudaSuccess)
+                {
+                    BOOST_LOG_TRIVIAL(fatal) << "Could not launch backprojection: " << cudaGetErrorString(err);
+                    throw stage_runtime_error{"backproject() failed"};
+                }
+            }
+
+            /*
+             * Layered CUDA array holding the projections of one batch, bound to a texture once. The element type and
+             * filtering follow the interpolation mode, fast_f16 arrays are filled through a surface.
+             */
+            class projection_layers
+            {
+                public:
+                    projection_layers(std::uint32_t dim_x, std::uint32_t dim_y, interpolation mode)
+                    : array_{nullptr}, tex_{0}, surf_{0}, half_{mode == interpolation::fast_f16}
+                    {
+                        auto desc = half_ ? cudaCreateChannelDescHalf() : cudaCreateChannelDesc<float>();
+                        auto extent = make_cudaExtent(dim_x, dim_y, max_batch_size);
+                        auto flags = half_ ? (cudaArrayLayered | cudaArraySurfaceLoadStore) : cudaArrayLayered;
+                        auto err = cudaMalloc3DArray(&array_, &desc, extent, flags);
+                        if(err != cudaSuccess)
+                        {
+                            BOOST_LOG_TRIVIAL(fatal) << "Could not create projection array: "
+                                                     << cudaGetErrorString(err);
+                            throw stage_runtime_error{"backproject() failed"};
+                        }
+
+                        auto res_desc = cudaResourceDesc{};
+                        res_desc.resType = cudaResourceTypeArray;
+                        res_desc.res.array.array = array_;
+
+                        auto tex_desc = cudaTextureDesc{};
+                        tex_desc.addressMode[0] = cudaAddressModeBorder;
+                        tex_desc.addressMode[1] = cudaAddressModeBorder;
+                        tex_desc.filterMode = (mode == interpolation::fast || mode == interpolation::fast_f16)
+                                              ? cudaFilterModeLinear : cudaFilterModePoint;
+                        // half precision texels are promoted to float
+                        tex_desc.readMode = cudaReadModeElementType;
+                        tex_desc.normalizedCoords = 0;
+
+                        err = cudaCreateTextureObject(&tex_, &res_desc, &tex_desc, nullptr);
+                        if(err != cudaSuccess)
+                        {
+                            BOOST_LOG_TRIVIAL(fatal) << "Could not create CUDA texture: " << cudaGetErrorString(err);
+                            cudaFreeArray(array_);
+                            throw stage_runtime_error{"backproject() failed"};
+                        }
+
+                        if(half_)
+                        {
+                            err = cudaCreateSurfaceObject(&surf_, &res_desc);
+                            if(err != cudaSuccess)
+                            {
+                                BOOST_LOG_TRIVIAL(fatal) << "Could not create CUDA surface: "
+                                                         << cudaGetErrorString(err);
+                                cudaDestroyTextureObject(tex_);
+                                cudaFreeArray(array_);
+                                throw stage_runtime_error{"backproject() failed"};
+                            }
+                        }
+                    }
+
+                    ~projection_layers()
+                    {
+                        if(half_)
+                            cudaDestroySurfaceObject(surf_);
+                        cudaDestroyTextureObject(tex_);
+                        cudaFreeArray(array_);
+                    }
+
+                    projection_layers(const projection_layers&) = delete;
+                    auto operator=(const projection_layers&) -> projection_layers& = delete;
+
+                    auto copy(const projection_device_type& p, std::uint32_t layer, cudaStream_t stream) -> void
+                    {
+                        if(half_)
+                        {
+                            glados::cuda::launch_async(stream, p.dim_x, p.dim_y, half_kernel,
+                                                       surf_, static_cast<int>(layer),
+                                                       static_cast<const float*>(p.buf.get()), p.buf.pitch(),
+                                                       p.dim_x, p.dim_y);
+                            return;
+                        }
+
+                        auto parms = cudaMemcpy3DParms{};
+                        parms.srcPtr = make_cudaPitchedPtr(reinterpret_cast<void*>(p.buf.get()), p.buf.pitch(),
+                                                           p.dim_x, p.dim_y);
+                        parms.dstArray = array_;
+                        parms.dstPos = make_cudaPos(0, 0, layer);
+                        parms.extent = make_cudaExtent(p.dim_x, p.dim_y, 1);
+                        parms.kind = cudaMemcpyDeviceToDevice;
+
+                        auto err = cudaMemcpy3DAsync(&parms, stream);
+                        if(err != cudaSuccess)
+                        {
+                            BOOST_LOG_TRIVIAL(fatal) << "Could not copy projection to texture: "
+                                                     << cudaGetErrorString(err);
+                            throw stage_runtime_error{"backproject() failed"};
+                        }
+                    }
+
+                    auto texture() const noexcept -> cudaTextureObject_t { return tex_; }
+
+                private:
+                    cudaArray_t array_;
+                    cudaTextureObject_t tex_;
+                    cudaSurfaceObject_t surf_;
+                    bool half_;
+            };
+
+            /* Everything the backprojection needs on one device. All backprojections of a thread are serialised on
+             * the context's stream as they share the volume. Constants are only uploaded when they change, i.e.
+             * once per subvolume. The layers follow the detector and the interpolation mode, the launch configuration
+             * the geometry of the current reconstruction, a process may reconstruct several.
+             */
+            class backprojection_context
+            {
+                public:
+                    backprojection_context()
+                    : p_dim_x_{0u}, p_dim_y_{0u}, mode_{interpolation::fast}, consts_{}, roi_{}, consts_valid_{false},
+                      roi_valid_{false}, cfg_{}
+                    {}
+
+                    auto stream() const noexcept -> cudaStream_t { return s_.stream; }
+                    auto layers() noexcept -> projection_layers& { return *layers_; }
+
+                    // (re)allocates the layers for projections of p_dim_x * p_dim_y pixels
+                    auto resize(std::uint32_t p_dim_x, std::uint32_t p_dim_y, interpolation mode) -> void
+                    {
+                        if(layers_ != nullptr && p_dim_x == p_dim_x_ && p_dim_y == p_dim_y_ && mode == mode_)
+                            return;
+
+                        // the old layers may still be read by a backprojection
+                        glados::cuda::synchronize_stream(s_.stream);
+                        layers_.reset();
+                        layers_.reset(new projection_layers{p_dim_x, p_dim_y, mode});
+                        p_dim_x_ = p_dim_x;
+                        p_dim_y_ = p_dim_y;
+                        mode_ = mode;
+                    }
+
+                    auto tuned(const std::string& key) const noexcept -> bool { return key_ == key; }
+                    auto config() const noexcept -> const launch_config& { return cfg_; }
+                    auto set_config(const launch_config& cfg, const std::string& key) -> void
+                    {
+                        cfg_ = cfg;
+                        key_ = key;
+                    }
+
+                    auto update(const backprojection_constants& consts) -> void
+                    {
+                        if(consts_valid_ && std::memcmp(&consts_, &consts, sizeof(consts)) == 0)
+                            return;
+
+                        auto err = cudaMemcpyToSymbolAsync(dev_consts__, &consts, sizeof(consts), 0u,
+                                                           cudaMemcpyHostToDevice, s_.stream);
+                        if(err != cudaSuccess)
+                        {
+                            BOOST_LOG_TRIVIAL(fatal) << "Could not initialise device constants: "
+                                                     << cudaGetErrorString(err);
+                            throw stage_runtime_error{"backproject() failed"};
+                        }
+
+                        // remember what is on the device
+                        consts_ = consts;
+                        consts_valid_ = true;
+                    }
+
+                    auto update(const region_of_interest& roi) -> void
+                    {
+                        if(roi_valid_ && std::memcmp(&roi_, &roi, sizeof(roi)) == 0)
+                            return;
+
+                        auto err = cudaMemcpyToSymbolAsync(dev_roi__, &roi, sizeof(roi), 0u,
+                                                           cudaMemcpyHostToDevice, s_.stream);
+                        if(err != cudaSuccess)
+                        {
+                            BOOST_LOG_TRIVIAL(fatal) << "Could not initialise device ROI: " << cudaGetErrorString(err);
+                            throw stage_runtime_error{"backproject() failed"};
+                        }
+
+                        roi_ = roi;
+                        roi_valid_ = true;
+                    }
+
+                private:
+                    cuda_stream s_;
+                    std::unique_ptr<projection_layers> layers_;
+                    std::uint32_t p_dim_x_;
+                    std::uint32_t p_dim_y_;
+                    interpolation mode_;
+
+                    backprojection_constants consts_;
+                    region_of_interest roi_;
+                    bool consts_valid_;
+                    bool roi_valid_;
+
+                    launch_config cfg_;
+                    std::string key_;   // the geometry cfg_ has been tuned for
+            };
+
+            // configurations tuned by this process, devices of the same model and geometry share them
+            std::mutex tuning_mutex__;
+            std::map<std::string, launch_config> tuned_configs__;
+
+            auto describe(const launch_config& cfg) -> std::string
+            {
+                return "block " + std::to_string(cfg.block_x) + "x" + std::to_string(cfg.block_y) + "x"
+                       + std::to_string(cfg.block_z) + ", " + std::to_string(cfg.slices) + " slice(s) per thread, "
+                       + "unrolled " + std::to_string(cfg.unroll) + "x";
+            }
+
+            /*
+             * Times every candidate on a tile in the middle of the volume with the batch which already waits in the
+             * texture. The tile has its own buffer, the subvolume isn't touched. The constants are left behind on
+             * the device, the caller has to upload its own afterwards.
+             */
+            auto benchmark(backprojection_context& ctx, const backprojection_constants& consts, interpolation mode,
+                           beam_geometry beam, bool column, std::uint32_t n) -> launch_config
+            {
+                auto tile_consts = consts;
+                tile_consts.vol_dim_x = std::min(consts.vol_dim_x_full, tuning_tile_dim_xy);
+                tile_consts.vol_dim_y = std::min(consts.vol_dim_y_full, tuning_tile_dim_xy);
+                tile_consts.vol_dim_z = std::min(consts.vol_dim_z_full, tuning_tile_dim_z);
+                tile_consts.vol_offset = 0u;
+
+                auto roi = region_of_interest{};
+                roi.x1 = (consts.vol_dim_x_full - tile_consts.vol_dim_x) / 2u;
+                roi.y1 = (consts.vol_dim_y_full - tile_consts.vol_dim_y) / 2u;
+                roi.z1 = (consts.vol_dim_z_full - tile_consts.vol_dim_z) / 2u;
+
+                ctx.update(tile_consts);
+                ctx.update(roi);
+
+                auto tile = make_volume_device(tile_consts.vol_dim_x, tile_consts.vol_dim_y, tile_consts.vol_dim_z);
+
+                auto start = cudaEvent_t{};
+                auto stop = cudaEvent_t{};
+                cudaEventCreate(&start);
+                cudaEventCreate(&stop);
+
+                constexpr auto runs = 3u;
+                auto best = launch_candidates().front();
+                auto best_ms = -1.f;
+                for(auto&& cfg : launch_candidates())
+                {
+                    // heavier instantiations may not run with the larger blocks
+                    auto kernel = select_kernel(mode, beam, true, column, cfg);
+                    auto attr = cudaFuncAttributes{};
+                    if(cudaFuncGetAttributes(&attr, kernel) != cudaSuccess ||
+                       cfg.block_x * cfg.block_y * cfg.block_z > static_cast<std::uint32_t>(attr.maxThreadsPerBlock))
+                        continue;
+
+                    // warm up, then time
+                    launch_backprojection(ctx.stream(), kernel, cfg, tile.buf.get(), tile.buf.pitch(), tile.dim_x,
+                                          tile.dim_y, tile.dim_z, ctx.layers().texture(), n);
+                    cudaEventRecord(start, ctx.stream());
+                    for(auto r = 0u; r < runs; ++r)
+                        launch_backprojection(ctx.stream(), kernel, cfg, tile.buf.get(), tile.buf.pitch(),
+                                              tile.dim_x, tile.dim_y, tile.dim_z, ctx.layers().texture(), n);
+                    cudaEventRecord(stop, ctx.stream());
+
+                    auto err = cudaEventSynchronize(stop);
+                    auto ms = 0.f;
+                    if(err == cudaSuccess)
+                        err = cudaEventElapsedTime(&ms, start, stop);
+                    if(err != cudaSuccess)
+                    {
+                        BOOST_LOG_TRIVIAL(fatal) << "Could not time backprojection: " << cudaGetErrorString(err);
+                        cudaEventDestroy(stop);
+                        cudaEventDestroy(start);
+                        throw stage_runtime_error{"backproject() failed"};
+                    }
+
+                    if(best_ms < 0.f || ms < best_ms)
+                    {
+                        best = cfg;
+                        best_ms = ms;
+                    }
+                }
+
+                cudaEventDestroy(stop);
+                cudaEventDestroy(start);
+
+                BOOST_LOG_TRIVIAL(info) << "Tuned backprojection: " << describe(best) << " (" << best_ms / runs
+                                        << " ms per batch of " << n << " on " << tile.dim_x << "x" << tile.dim_y
+                                        << "x" << tile.dim_z << " voxels)";
+                return best;
+            }
+
+            // the first device of a model tunes, the others wait for its result
+            auto tune(backprojection_context& ctx, const backprojection_constants& consts, interpolation mode,
+                      beam_geometry beam, bool column, std::uint32_t n, const std::string& key) -> launch_config
+            {
+                std::lock_guard<std::mutex> lock{tuning_mutex__};
+
+                auto it = tuned_configs__.find(key);
+                if(it != std::end(tuned_configs__))
+                    return it->second;
+
+                auto cfg = launch_config{};
+                if(load_launch_config(key, cfg))
+                    BOOST_LOG_TRIVIAL(info) << "Loaded backprojection launch configuration: " << describe(cfg);
+                else
+                {
+                    cfg = benchmark(ctx, consts, mode, beam, column, n);
+                    store_launch_config(key, cfg);
                 }
+
+                tuned_configs__[key] = cfg;
+                return cfg;
             }
         }
 
-        auto backproject(const projection_device_type& p, volume_device_type& v, std::uint32_t v_offset,
+        auto set_interpolation(interpolation mode) noexcept -> void
+        {
+            interp_mode = mode;
+        }
+
+        auto backproject(const std::vector<projection_device_type>& p, volume_device_type& v, std::uint32_t v_offset,
                          const detector_geometry& det_geo, const volume_geometry& vol_geo,
                          bool enable_roi, const region_of_interest& roi,
-                         float sin, float cos, float delta_s, float delta_t)  -> void
+                         const std::vector<projection_matrix>& m) -> void
         {
-            // constants for the backprojection - these never change
-            static const auto v_dim_x_full = vol_geo.dim_x;
-            static const auto v_dim_y_full = vol_geo.dim_y;
-            static const auto v_dim_z_full = vol_geo.dim_z;
+            if(p.empty())
+                return;
 
-            static const auto l_vx_x = vol_geo.l_vx_x;
-            static const auto l_vx_y = vol_geo.l_vx_y;
-            static const auto l_vx_z = vol_geo.l_vx_z;
+            if(p.size() > max_batch_size)
+            {
+                BOOST_LOG_TRIVIAL(fatal) << "Backprojection batch exceeds " << max_batch_size << " projections";
+                throw stage_runtime_error{"backproject() failed"};
+            }
+
+            // constants for the backprojection - these only change with the geometry
+            const auto v_dim_x_full = vol_geo.dim_x;
+            const auto v_dim_y_full = vol_geo.dim_y;
+            const auto v_dim_z_full = vol_geo.dim_z;
 
-            static const auto p_dim_x = det_geo.n_row;
-            static const auto p_dim_y = det_geo.n_col;
+            const auto l_vx_x = vol_geo.l_vx_x;
+            const auto l_vx_y = vol_geo.l_vx_y;
+            const auto l_vx_z = vol_geo.l_vx_z;
 
-            static const auto l_px_x = det_geo.l_px_row;
-            static const auto l_px_y = det_geo.l_px_col;
+            const auto p_dim_x = det_geo.n_row;
+            const auto p_dim_y = det_geo.n_col;
 
-            static const auto d_s = delta_s;
-            static const auto d_t = delta_t;
+            const auto l_px_x = det_geo.l_px_row;
+            const auto l_px_y = det_geo.l_px_col;
 
-            static const auto d_so = det_geo.d_so;
-            static const auto d_sd = std::abs(det_geo.d_so) + std::abs(det_geo.d_od);
+            const auto d_s = det_geo.delta_s * det_geo.l_px_row;
+            const auto d_t = det_geo.delta_t * det_geo.l_px_col;
 
-            // variable for the backprojection - might change between subvolumes
-            thread_local static auto offset = v_offset;
+            const auto d_so = det_geo.d_so;
+            const auto d_sd = std::abs(det_geo.d_so) + std::abs(det_geo.d_od);
+            const auto beam = det_geo.beam;
 
-            // local stream
-            thread_local static auto s = cuda_stream{};
+            // created once per thread (= device)
+            thread_local static auto&& ctx = backprojection_context{};
+            const auto mode = interp_mode;
+            ctx.resize(p_dim_x, p_dim_y, mode);
 
-            // initialise device constants
-            thread_local static auto consts = backprojection_constants {
+            // the volume dimensions and offset change between subvolumes, the cropping between batches
+            const auto consts = backprojection_constants{
                 v.dim_x,
                 v_dim_x_full,
                 v.dim_y,
                 v_dim_y_full,
                 v.dim_z,
                 v_dim_z_full,
-                offset,
+                v_offset,
                 l_vx_x,
                 l_vx_y,
                 l_vx_z,
                 p_dim_x,
                 p_dim_y,
+                p.front().first_row,
+                p.front().first_col,
                 l_px_x,
                 l_px_y,
                 d_s,
@@ -183,63 +744,119 @@ namespace paris
                 d_so,
                 d_sd
             };
+            ctx.update(consts);
+
+            if(enable_roi)
+                ctx.update(roi);
+
+            auto matrices = backprojection_matrices{};
+            std::copy(std::begin(m), std::begin(m) + static_cast<std::ptrdiff_t>(p.size()), matrices.m);
 
-            auto err = cudaMemcpyToSymbolAsync(dev_consts__, &consts, sizeof(consts), 0u, cudaMemcpyHostToDevice,
-                                               s.stream);
+            // the matrices are the only constants which change with every batch
+            auto err = cudaMemcpyToSymbolAsync(dev_matrices__, &matrices, sizeof(projection_matrix) * p.size(), 0u,
+                                               cudaMemcpyHostToDevice, ctx.stream());
             if(err != cudaSuccess)
             {
-                BOOST_LOG_TRIVIAL(fatal) << "Could not initialise device constants: " << cudaGetErrorString(err);
+                BOOST_LOG_TRIVIAL(fatal) << "Could not initialise projection matrices: " << cudaGetErrorString(err);
                 throw stage_runtime_error{"backproject() failed"};
             }
 
-            // create a CUDA texture from the projection
-            auto res_desc = cudaResourceDesc{};
-            res_desc.resType = cudaResourceTypePitch2D;
-            res_desc.res.pitch2D.desc = cudaCreateChannelDesc<float>();
-            res_desc.res.pitch2D.devPtr = reinterpret_cast<void*>(p.buf.get());
-            res_desc.res.pitch2D.width = p.dim_x;
-            res_desc.res.pitch2D.height = p.dim_y;
-            res_desc.res.pitch2D.pitchInBytes = p.buf.pitch();
-
-            auto tex_desc = cudaTextureDesc{};
-            tex_desc.addressMode[0] = cudaAddressModeBorder;
-            tex_desc.addressMode[1] = cudaAddressModeBorder;
-            tex_desc.filterMode = cudaFilterModeLinear;
-            tex_desc.readMode = cudaReadModeElementType;
-            tex_desc.normalizedCoords = 0;
-
-            auto tex = cudaTextureObject_t{0};
-            err = cudaCreateTextureObject(&tex, &res_desc, &tex_desc, nullptr);
-            if(err != cudaSuccess)
+            // gather the batch in the layered texture
+            for(auto i = 0u; i < p.size(); ++i)
             {
-                BOOST_LOG_TRIVIAL(fatal) << "Could not create CUDA texture: " << cudaGetErrorString(err);
-                throw stage_runtime_error{"backproject() failed"};
+                // pipelined projections: wait until filtering on the projection's own stream has finished
+                if(p[i].meta != nullptr)
+                {
+                    err = cudaEventRecord(p[i].meta->filtered, p[i].meta->stream);
+                    if(err == cudaSuccess)
+                        err = cudaStreamWaitEvent(ctx.stream(), p[i].meta->filtered, 0u);
+                    if(err != cudaSuccess)
+                    {
+                        BOOST_LOG_TRIVIAL(fatal) << "Could not wait for filtered projection: "
+                                                 << cudaGetErrorString(err);
+                        throw stage_runtime_error{"backproject() failed"};
+                    }
+                }
+
+                ctx.layers().copy(p[i], i, ctx.stream());
             }
 
-            // apply ROI as needed and backproject
-            if(enable_roi)
+            // the first batch of every device and geometry picks the launch configuration
+            auto n = static_cast<std::uint32_t>(p.size());
+            auto column = is_column_batch(m, p.size());
+            auto key = launch_key(det_geo, vol_geo, column, mode);
+            if(!ctx.tuned(key))
+            {
+                ctx.set_config(tune(ctx, consts, mode, beam, column, n, key), key);
+
+                // tuning leaves its own constants on the device
+                ctx.update(consts);
+                if(enable_roi)
+                    ctx.update(roi);
+            }
+
+            // backproject and apply ROI as needed
+            launch_backprojection(ctx.stream(), select_kernel(mode, beam, enable_roi, column, ctx.config()),
+                                  ctx.config(), v.buf.get(), v.buf.pitch(), v.dim_x, v.dim_y, v.dim_z,
+                                  ctx.layers().texture(), n);
+
+            // the projections' streams (and thus their buffers) must not be reused before we are done
+            auto pipelined = false;
+            for(auto&& proj : p)
             {
-                err = cudaMemcpyToSymbolAsync(dev_roi__, &roi, sizeof(roi), 0u, cudaMemcpyHostToDevice, s.stream);
+                if(proj.meta == nullptr)
+                    continue;
+
+                pipelined = true;
+                err = cudaEventRecord(proj.meta->done, ctx.stream());
+                if(err == cudaSuccess)
+                    err = cudaStreamWaitEvent(proj.meta->stream, proj.meta->done, 0u);
                 if(err != cudaSuccess)
                 {
-                    BOOST_LOG_TRIVIAL(fatal) << "Could not initialise device ROI: " << cudaGetErrorString(err);
+                    BOOST_LOG_TRIVIAL(fatal) << "Could not order backprojection: " << cudaGetErrorString(err);
                     throw stage_runtime_error{"backproject() failed"};
                 }
-
-                glados::cuda::launch_async(s.stream, v.dim_x, v.dim_y, v.dim_z, backprojection_kernel<true>,
-                                           v.buf.get(), v.buf.pitch(), tex, sin, cos);
             }
-            else
-                glados::cuda::launch_async(s.stream, v.dim_x, v.dim_y, v.dim_z, backprojection_kernel<false>,
-                                           v.buf.get(), v.buf.pitch(), tex, sin, cos);
 
-            glados::cuda::synchronize_stream(s.stream);
-            err = cudaDestroyTextureObject(tex);
-            if(err != cudaSuccess)
+            if(!pipelined)
+                glados::cuda::synchronize_stream(ctx.stream());
+        }
+
+        auto backproject(const std::vector<projection_device_type>& p, volume_device_type& v, std::uint32_t v_offset,
+                         const detector_geometry& det_geo, const volume_geometry& vol_geo,
+                         bool enable_roi, const region_of_interest& roi,
+                         const std::vector<float>& sin, const std::vector<float>& cos,
+                         float delta_s, float delta_t) -> void
+        {
+            // the circular trajectory is a special case of the general one
+            const auto d_so = det_geo.d_so;
+            const auto d_sd = std::abs(det_geo.d_so) + std::abs(det_geo.d_od);
+            const auto a_h = d_sd / det_geo.l_px_row;
+            const auto a_v = d_sd / det_geo.l_px_col;
+            const auto h_c = proj_offset(det_geo.n_row, det_geo.l_px_row, delta_s);
+            const auto v_c = proj_offset(det_geo.n_col, det_geo.l_px_col, delta_t);
+
+            auto m = std::vector<projection_matrix>{};
+            m.reserve(sin.size());
+            for(auto i = 0u; i < sin.size(); ++i)
             {
-                BOOST_LOG_TRIVIAL(fatal) << "Could not destroy CUDA texture: " << cudaGetErrorString(err);
-                throw stage_runtime_error{"backproject() failed"};
+                const auto sn = sin[i];
+                const auto cs = cos[i];
+                if(det_geo.beam == beam_geometry::fan)
+                    m.push_back(projection_matrix{{-a_h * sn + h_c * cs, a_h * cs + h_c * sn, 0.f, h_c * d_so,
+                                                   0.f, 0.f, a_v / d_so, v_c,
+                                                   cs, sn, 0.f, d_so}});
+                else if(det_geo.beam == beam_geometry::parallel)
+                    m.push_back(projection_matrix{{-sn / det_geo.l_px_row, cs / det_geo.l_px_row, 0.f, h_c,
+                                                   0.f, 0.f, 1.f / det_geo.l_px_col, v_c,
+                                                   0.f, 0.f, 0.f, 1.f}});
+                else
+                    m.push_back(projection_matrix{{-a_h * sn + h_c * cs, a_h * cs + h_c * sn, 0.f, h_c * d_so,
+                                                   v_c * cs, v_c * sn, a_v, v_c * d_so,
+                                                   cs, sn, 0.f, d_so}});
             }
+
+            backproject(p, v, v_offset, det_geo, vol_geo, enable_roi, roi, m);
         }
     }
 }
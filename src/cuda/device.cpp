@@ -22,8 +22,14 @@
 
 #include <vector>
 
+#include <boost/log/trivial.hpp>
+
 #include <glados/cuda/utility.h>
 
+#if defined(PARIS_ENABLE_NVTX)
+#include <nvToolsExt.h>
+#endif
+
 #include "backend.h"
 
 namespace paris
@@ -45,5 +51,69 @@ namespace paris
 
             return vec;
         }
+
+        auto enable_peer_access(const std::vector<device_handle>& devices) -> bool
+        {
+            if(devices.size() < 2u)
+                return false;
+
+            for(auto&& a : devices)
+            {
+                for(auto&& b : devices)
+                {
+                    auto access = 0;
+                    if(a != b && (cudaDeviceCanAccessPeer(&access, a, b) != cudaSuccess || access == 0))
+                    {
+                        BOOST_LOG_TRIVIAL(info) << "Device #" << a << " cannot access device #" << b
+                                                << ", exchanging projections through the host";
+                        return false;
+                    }
+                }
+            }
+
+            for(auto&& a : devices)
+            {
+                glados::cuda::set_device(a);
+                for(auto&& b : devices)
+                {
+                    if(a == b)
+                        continue;
+
+                    // a second reconstruction in the same process finds the access already enabled
+                    auto err = cudaDeviceEnablePeerAccess(b, 0u);
+                    if(err == cudaErrorPeerAccessAlreadyEnabled)
+                        cudaGetLastError();
+                    else if(err != cudaSuccess)
+                    {
+                        BOOST_LOG_TRIVIAL(warning) << "Could not enable peer access from device #" << a
+                                                   << " to device #" << b << ": " << cudaGetErrorString(err);
+                        cudaGetLastError();
+                        return false;
+                    }
+                }
+            }
+
+            // the calling thread keeps working with the first device
+            glados::cuda::set_device(devices.front());
+            BOOST_LOG_TRIVIAL(info) << "Exchanging filtered projections between " << devices.size()
+                                    << " devices peer-to-peer";
+            return true;
+        }
+
+        auto push_range(const char* name) noexcept -> void
+        {
+#if defined(PARIS_ENABLE_NVTX)
+            nvtxRangePushA(name);
+#else
+            static_cast<void>(name);
+#endif
+        }
+
+        auto pop_range() noexcept -> void
+        {
+#if defined(PARIS_ENABLE_NVTX)
+            nvtxRangePop();
+#endif
+        }
     }
 }
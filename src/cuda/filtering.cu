@@ -21,11 +21,18 @@
  */
 
 #include <algorithm>
+#include <cstddef>
 #include <cstdint>
-#include <numeric>
+#include <functional>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <vector>
 
 #include <boost/log/trivial.hpp>
 
+#include <cuda_runtime.h>
+
 #include <glados/cuda/algorithm.h>
 #include <glados/cuda/coordinates.h>
 #include <glados/cuda/launch.h>
@@ -34,6 +41,8 @@
 #include <glados/cuda/utility.h>
 #include <glados/cufft/plan.h>
 
+#include "../exception.h"
+
 #include "backend.h"
 
 namespace paris
@@ -42,52 +51,28 @@ namespace paris
     {
         namespace
         {
-            __global__ void filter_creation_kernel(float* __restrict__ r,
-                                                   const std::int32_t* __restrict__ j,
-                                                   std::uint32_t size, float tau)
+            // weights the projection and pads it with zeroes
+            __global__ void expansion_kernel(float* __restrict__ dst, std::size_t dst_pitch, std::uint32_t dst_dim_x,
+                                             const float* __restrict__ src, std::size_t src_pitch,
+                                             std::uint32_t src_dim_x,
+                                             const float* __restrict__ w, std::size_t w_pitch,
+                                             std::uint32_t dim_y)
             {
                 auto x = glados::cuda::coord_x();
+                auto y = glados::cuda::coord_y();
 
-                /*
-                 * r(j) with j = [ -(filter_length - 2) / 2, ..., 0, ..., filter_length / 2 ]
-                 * tau = horizontal pixel distance
-                 *
-                 *          1/8 * 1/(tau^2)                     for j = 0
-                 * r(j) = { 0                                   for even j
-                 *          -(1 / (2 * j^2 * pi^2 * tau^2))     for odd j
-                 */
-                if(x < size)
+                if((x < dst_dim_x) && (y < dim_y))
                 {
-                    if(j[x] == 0) // does j = 0?
-                        r[x] = (1.f / 8.f) * (1.f / powf(tau, 2.f));
-                    else // j != 0
-                    {
-                        if(j[x] % 2 == 0) // is j even?
-                            r[x] = 0.f;
-                        else // j is odd
-                            r[x] = -(1.f / (2.f * powf(j[x], 2.f)
-                                   * powf(M_PI, 2.f)
-                                   * powf(tau, 2.f)));
-                    }
-                }
-            } 
+                    auto dst_row = reinterpret_cast<float*>(reinterpret_cast<char*>(dst) + y * dst_pitch);
+                    auto src_row = reinterpret_cast<const float*>(reinterpret_cast<const char*>(src) + y * src_pitch);
+                    auto w_row = reinterpret_cast<const float*>(reinterpret_cast<const char*>(w) + y * w_pitch);
 
-            __global__ void k_creation_kernel(cufftComplex* __restrict__ data,
-                                              std::uint32_t filter_size, float tau)
-            {
-                auto x = glados::cuda::coord_x();
-                if(x < filter_size)
-                {
-                    auto result = tau * fabsf(sqrtf(powf(data[x].x, 2.f)
-                                  + powf(data[x].y, 2.f)));
-
-                    data[x].x = result;
-                    data[x].y = result;
+                    dst_row[x] = (x < src_dim_x) ? src_row[x] * w_row[x] : 0.f;
                 }
             }
 
             __global__ void filter_application_kernel(cufftComplex* __restrict__ data,
-                                                      const cufftComplex* __restrict__ filter,
+                                                      const float* __restrict__ filter,
                                                       std::uint32_t filter_size,
                                                       std::uint32_t data_height,
                                                       std::size_t pitch)
@@ -100,164 +85,559 @@ namespace paris
                     auto row = reinterpret_cast<cufftComplex*>(
                                 reinterpret_cast<char*>(data) + y * pitch);
 
-                    row[x].x *= filter[x].x;
-                    row[x].y *= filter[x].y;
+                    row[x].x *= filter[x];
+                    row[x].y *= filter[x];
                 }
             }
 
-            __global__ void normalization_kernel(cufftReal* dst, std::size_t pitch,
-                                                 std::uint32_t width, std::uint32_t height,
-                                                 std::uint32_t filter_size)
+            auto expand(const projection_device_buffer_type& src, const weight_buffer_type& w,
+                              std::uint32_t src_dim_x,
+                              cufftReal* dst, std::size_t dst_pitch, std::uint32_t dst_dim_x,
+                              std::uint32_t dim_y, cudaStream_t& stream) -> void
             {
-                auto x = glados::cuda::coord_x();
-                auto y = glados::cuda::coord_y();
+                // weighting and zero padding in a single pass
+                glados::cuda::launch_async(stream, dst_dim_x, dim_y,
+                                           expansion_kernel,
+                                           dst, dst_pitch, dst_dim_x,
+                                           static_cast<const float*>(src.get()), src.pitch(), src_dim_x,
+                                           static_cast<const float*>(w.get()), w.pitch(), dim_y);
+            }
 
-                if((x < width) && (y < height))
+            auto shrink(const cufftReal* src, std::size_t src_pitch,
+                              projection_device_buffer_type& dst, std::uint32_t dim_x, std::uint32_t dim_y,
+                              cudaStream_t& stream) -> void
+            {
+                auto err = cudaMemcpy2DAsync(dst.get(), dst.pitch(), src, src_pitch, dim_x * sizeof(float), dim_y,
+                                             cudaMemcpyDeviceToDevice, stream);
+                if(err != cudaSuccess)
                 {
-                    auto row = reinterpret_cast<cufftReal*>(reinterpret_cast<char*>(dst) + y * pitch);
+                    BOOST_LOG_TRIVIAL(fatal) << "Could not copy filtered projection: " << cudaGetErrorString(err);
+                    throw stage_runtime_error{"apply_filter() failed"};
+                }
+            }
 
-                    row[x] /= filter_size;
+            // makes waiter wait for the work which is currently enqueued on recorder
+            auto order(cudaEvent_t event, cudaStream_t recorder, cudaStream_t waiter) -> void
+            {
+                auto err = cudaEventRecord(event, recorder);
+                if(err == cudaSuccess)
+                    err = cudaStreamWaitEvent(waiter, event, 0u);
+                if(err != cudaSuccess)
+                {
+                    BOOST_LOG_TRIVIAL(fatal) << "Could not order filter stages: " << cudaGetErrorString(err);
+                    throw stage_runtime_error{"apply_filter() failed"};
                 }
             }
 
-            auto make_filter_real(std::uint32_t filter_size, float tau)
-            -> glados::cuda::device_ptr<float>
+            // threads per detector row of the fused kernel
+            constexpr auto fused_block_size = 256u;
+
+            struct fused_batch
             {
-                /*
-                 * for a more detailed description see filter_creation_kernel
-                 */
-                /* create j on the host and fill it with values from
-                 * -(filter_size_ - 2) / 2 to filter_size / 2
-                 */
-                auto h_j = glados::cuda::make_unique_pinned_host<std::int32_t>(filter_size);
-                auto size = static_cast<std::int32_t>(filter_size);
-                auto j = -(size - 2) / 2;
-                std::iota(h_j.get(), h_j.get() + filter_size, j);
-
-                // create j on the device and copy j from the host to the device
-                auto d_j = glados::cuda::make_unique_device<std::int32_t>(filter_size);
-                glados::cuda::copy(glados::cuda::sync, d_j, h_j, filter_size);
-
-                // create r on the device
-                auto d_r  = glados::cuda::make_unique_device<float>(filter_size);
-
-                // calculate the filter values
-                glados::cuda::launch(filter_size, filter_creation_kernel,
-                                   d_r.get(),
-                                   static_cast<const std::int32_t*>(d_j.get()),
-                                   filter_size, tau);
-
-                return d_r;
+                float* ptr[max_batch_size];
+                std::size_t pitch[max_batch_size];
+            };
+
+            /*
+             * Weights one detector row and convolves it with the spatial taps of the filter in a single pass. The
+             * zero padding of the FFT path corresponds to simply leaving out the taps beyond the row's ends, so the
+             * results match. One block handles one row (blockIdx.x) of one projection (blockIdx.y).
+             */
+            __global__ void fused_filter_kernel(fused_batch batch, std::uint32_t dim_x,
+                                                const float* __restrict__ taps,
+                                                const float* __restrict__ w, std::size_t w_pitch)
+            {
+                __shared__ float row[max_fused_width];
+                __shared__ float h[2u * max_fused_width - 1u];
+
+                auto y = blockIdx.x;
+                auto line = reinterpret_cast<float*>(reinterpret_cast<char*>(batch.ptr[blockIdx.y])
+                                                     + y * batch.pitch[blockIdx.y]);
+                auto w_row = reinterpret_cast<const float*>(reinterpret_cast<const char*>(w) + y * w_pitch);
+
+                for(auto x = threadIdx.x; x < dim_x; x += blockDim.x)
+                    row[x] = line[x] * w_row[x];
+                for(auto j = threadIdx.x; j < 2u * dim_x - 1u; j += blockDim.x)
+                    h[j] = taps[j];
+                __syncthreads();
+
+                // h[dim_x - 1] is the centre tap
+                for(auto x = threadIdx.x; x < dim_x; x += blockDim.x)
+                {
+                    auto sum = 0.f;
+                    for(auto m = 0u; m < dim_x; ++m)
+                        sum += row[m] * h[x + dim_x - 1u - m];
+                    line[x] = sum;
+                }
             }
 
-            auto expand(const projection_device_buffer_type& src, std::uint32_t src_dim_x,
-                              glados::cuda::pitched_device_ptr<float>& dst, std::uint32_t dst_dim_x,
-                              std::uint32_t dim_y, cudaStream_t& stream) -> void
+            // dimensionality of the FFT - 1 in this case
+            constexpr auto rank = 1;
+
+            /*
+             * The captured sequence of one context. The expand and shrink nodes touch the projections and the filter
+             * node reads the filter, which is uploaded anew whenever the filter or the geometry changes. All three
+             * are re-pointed before every replay, the transforms work on the context's own buffer and stay as
+             * captured.
+             */
+            struct filter_graph
             {
-                // reset the expansion destination
-                glados::cuda::fill(glados::cuda::async, dst, 0, stream, dst_dim_x, dim_y);
+                filter_graph() noexcept = default;
+                ~filter_graph()
+                {
+                    if(exec != nullptr)
+                        cudaGraphExecDestroy(exec);
+                    if(graph != nullptr)
+                        cudaGraphDestroy(graph);
+                }
+
+                filter_graph(const filter_graph&) = delete;
+                auto operator=(const filter_graph&) -> filter_graph& = delete;
 
-                // copy original projection to expanded projection
-                glados::cuda::copy(glados::cuda::async, dst, src, stream, src_dim_x, dim_y);
+                cudaGraph_t graph = nullptr;
+                cudaGraphExec_t exec = nullptr;
+                std::uint32_t dim_x = 0u;
+
+                // indexed by the projection's position in the batch
+                std::vector<cudaGraphNode_t> expand;
+                std::vector<cudaKernelNodeParams> expand_params;
+                std::vector<cudaGraphNode_t> shrink;
+                std::vector<cudaMemcpy3DParms> shrink_params;
+
+                cudaGraphNode_t filter = nullptr;
+                cudaKernelNodeParams filter_params = cudaKernelNodeParams{};
+            };
+
+            /* buffer and plans for one stream -- projections which are filtered concurrently must not share them.
+             * The projection is transformed in place, a line of the buffer holds either the expanded projection or
+             * its transform. Due to cuFFT's crazy API we cannot make the constants which we need as pointers actually
+             * const - this applies to n, p_real_nembed and p_trans_nembed
+             */
+            struct filter_context
+            {
+                filter_context(std::uint32_t filter_size, std::uint32_t n_col, cudaStream_t stream)
+                : p_trans{glados::cuda::make_unique_device<cufftComplex>(filter_size / 2 + 1, n_col)}
+                , n_lines{n_col}
+                , n{static_cast<int>(filter_size)}
+                , p_real_nembed{static_cast<int>(p_trans.pitch() / sizeof(cufftReal))}
+                , p_trans_nembed{static_cast<int>(p_trans.pitch() / sizeof(cufftComplex))}
+                // distance between the first elements of two successive lines = storage dimension, stride = 1
+                , forward{rank, &n, &p_real_nembed, 1, p_real_nembed, &p_trans_nembed, 1, p_trans_nembed,
+                          static_cast<int>(n_col)}
+                , inverse{rank, &n, &p_trans_nembed, 1, p_trans_nembed, &p_real_nembed, 1, p_real_nembed,
+                          static_cast<int>(n_col)}
+                {
+                    forward.set_stream(stream);
+                    inverse.set_stream(stream);
+                }
+
+                auto real() noexcept -> cufftReal* { return reinterpret_cast<cufftReal*>(p_trans.get()); }
+
+                glados::cuda::pitched_device_ptr<cufftComplex> p_trans;
+                std::uint32_t n_lines;  // the plans transform all of them, smaller batches leave the rest unused
+
+                int n;
+                int p_real_nembed;
+                int p_trans_nembed;
+
+                glados::cufft::plan<CUFFT_R2C> forward;
+                glados::cufft::plan<CUFFT_C2R> inverse;
+
+                std::unique_ptr<filter_graph> graph;
+                bool capture = true; // false once capturing failed, the context launches every stage itself then
+            };
+
+            // finds the filter node and the expand and shrink node of each batch projection, false if one is missing
+            auto find_nodes(filter_graph& g, filter_context& ctx, std::uint32_t batch, std::uint32_t n_col) -> bool
+            {
+                auto num = std::size_t{};
+                if(cudaGraphGetNodes(g.graph, nullptr, &num) != cudaSuccess)
+                    return false;
+
+                auto nodes = std::vector<cudaGraphNode_t>(num);
+                if(cudaGraphGetNodes(g.graph, nodes.data(), &num) != cudaSuccess)
+                    return false;
+
+                g.expand.assign(batch, nullptr);
+                g.expand_params.resize(batch);
+                g.shrink.assign(batch, nullptr);
+                g.shrink_params.resize(batch);
+
+                // the projection is identified by the line of the context's buffer the node reads or writes
+                auto base = reinterpret_cast<const char*>(ctx.p_trans.get());
+                auto stride = static_cast<std::ptrdiff_t>(n_col * ctx.p_trans.pitch());
+                auto index = [&](const void* ptr) { return (reinterpret_cast<const char*>(ptr) - base) / stride; };
+
+                for(auto&& node : nodes)
+                {
+                    auto type = cudaGraphNodeType{};
+                    if(cudaGraphNodeGetType(node, &type) != cudaSuccess)
+                        return false;
+
+                    if(type == cudaGraphNodeTypeKernel)
+                    {
+                        auto params = cudaKernelNodeParams{};
+                        if(cudaGraphKernelNodeGetParams(node, &params) != cudaSuccess)
+                            return false;
+                        if(params.func == reinterpret_cast<void*>(filter_application_kernel))
+                        {
+                            g.filter = node;
+                            g.filter_params = params;
+                            continue;
+                        }
+                        if(params.func != reinterpret_cast<void*>(expansion_kernel))
+                            continue;
+
+                        auto i = index(*static_cast<float**>(params.kernelParams[0]));
+                        if(i < 0 || i >= static_cast<std::ptrdiff_t>(batch))
+                            return false;
+                        g.expand[i] = node;
+                        g.expand_params[i] = params;
+                    }
+                    else if(type == cudaGraphNodeTypeMemcpy)
+                    {
+                        auto params = cudaMemcpy3DParms{};
+                        if(cudaGraphMemcpyNodeGetParams(node, &params) != cudaSuccess)
+                            return false;
+
+                        auto i = index(params.srcPtr.ptr);
+                        if(i < 0 || i >= static_cast<std::ptrdiff_t>(batch))
+                            continue;
+                        g.shrink[i] = node;
+                        g.shrink_params[i] = params;
+                    }
+                }
+
+                return g.filter != nullptr &&
+                       std::find(std::begin(g.expand), std::end(g.expand), nullptr) == std::end(g.expand) &&
+                       std::find(std::begin(g.shrink), std::end(g.shrink), nullptr) == std::end(g.shrink);
             }
 
-            auto shrink(const glados::cuda::pitched_device_ptr<float>& src,
-                              projection_device_buffer_type& dst, std::uint32_t dim_x, std::uint32_t dim_y,
-                              cudaStream_t& stream) -> void
+            // records enqueue's work on stream into a graph, nullptr if this isn't possible (e.g. an old cuFFT)
+            auto capture(filter_context& ctx, std::uint32_t batch, std::uint32_t n_col, cudaStream_t stream,
+                         const std::function<void()>& enqueue) -> std::unique_ptr<filter_graph>
             {
-                glados::cuda::copy(glados::cuda::async, dst, src, stream, dim_x, dim_y);
+            #if CUDART_VERSION < 11040
+                // updating the nodes of instantiated graphs needs CUDA 11.4
+                static_cast<void>(ctx);
+                static_cast<void>(batch);
+                static_cast<void>(n_col);
+                static_cast<void>(stream);
+                static_cast<void>(enqueue);
+                return nullptr;
+            #else
+                auto g = std::unique_ptr<filter_graph>{new filter_graph{}};
+                if(cudaStreamBeginCapture(stream, cudaStreamCaptureModeThreadLocal) != cudaSuccess)
+                {
+                    cudaGetLastError();
+                    return nullptr;
+                }
+
+                try
+                {
+                    enqueue();
+                }
+                catch(...)
+                {
+                    cudaStreamEndCapture(stream, &g->graph);
+                    cudaGetLastError();
+                    throw;
+                }
+
+                if(cudaStreamEndCapture(stream, &g->graph) != cudaSuccess ||
+                   cudaGraphInstantiateWithFlags(&g->exec, g->graph, 0u) != cudaSuccess ||
+                   !find_nodes(*g, ctx, batch, n_col))
+                {
+                    cudaGetLastError();
+                    BOOST_LOG_TRIVIAL(warning) << "Could not capture the filter into a CUDA graph, launching its "
+                                                  "stages one by one";
+                    return nullptr;
+                }
+
+                return g;
+            #endif
             }
-        }
 
-        auto make_filter(std::uint32_t size, float tau) -> filter_buffer_type
-        {
-            auto r = make_filter_real(size, tau);
+            // points the graph's nodes to the batch projections and the current filter and launches it
+            auto replay(filter_graph& g, projection_device_type* const* p, std::uint32_t batch,
+                        const filter_buffer_type& k, const weight_buffer_type& w, std::uint32_t n_col,
+                        cudaStream_t stream) -> void
+            {
+                // the arguments of filter_application_kernel (data, filter, filter_size, data_height, pitch) -- only
+                // the filter changes
+                auto captured = g.filter_params.kernelParams;
+                auto data = *static_cast<cufftComplex**>(captured[0]);
+                auto filter = static_cast<const float*>(k.get());
+                auto filter_size = *static_cast<std::uint32_t*>(captured[2]);
+                auto data_height = *static_cast<std::uint32_t*>(captured[3]);
+                auto data_pitch = *static_cast<std::size_t*>(captured[4]);
+                void* filter_args[] = {&data, &filter, &filter_size, &data_height, &data_pitch};
+
+                auto filter_kernel = g.filter_params;
+                filter_kernel.kernelParams = filter_args;
+                filter_kernel.extra = nullptr;
+                auto err = cudaGraphExecKernelNodeSetParams(g.exec, g.filter, &filter_kernel);
+
+                for(auto i = 0u; i < batch && err == cudaSuccess; ++i)
+                {
+                    // the arguments of expansion_kernel (dst, dst_pitch, dst_dim_x, src, src_pitch, src_dim_x, w,
+                    // w_pitch, dim_y) -- only the source changes
+                    auto old = g.expand_params[i].kernelParams;
+                    auto dst = *static_cast<float**>(old[0]);
+                    auto dst_pitch = *static_cast<std::size_t*>(old[1]);
+                    auto dst_dim_x = *static_cast<std::uint32_t*>(old[2]);
+                    auto src = static_cast<const float*>(p[i]->buf.get());
+                    auto src_pitch = p[i]->buf.pitch();
+                    auto src_dim_x = p[i]->dim_x;
+                    auto w_ptr = static_cast<const float*>(w.get());
+                    auto w_pitch = w.pitch();
+                    auto dim_y = n_col;
+                    void* args[] = {&dst, &dst_pitch, &dst_dim_x, &src, &src_pitch, &src_dim_x, &w_ptr, &w_pitch,
+                                    &dim_y};
+
+                    auto kernel = g.expand_params[i];
+                    kernel.kernelParams = args;
+                    kernel.extra = nullptr;
+                    err = cudaGraphExecKernelNodeSetParams(g.exec, g.expand[i], &kernel);
+
+                    auto copy = g.shrink_params[i];
+                    copy.dstPtr = make_cudaPitchedPtr(reinterpret_cast<void*>(p[i]->buf.get()), p[i]->buf.pitch(),
+                                                      p[i]->dim_x, n_col);
+                    copy.extent = make_cudaExtent(p[i]->dim_x * sizeof(float), n_col, 1u);
+                    if(err == cudaSuccess)
+                        err = cudaGraphExecMemcpyNodeSetParams(g.exec, g.shrink[i], &copy);
+                }
 
-            auto size_trans = size / 2 + 1;
-            auto k = glados::cuda::make_unique_device<cufftComplex>(size_trans);
+                if(err == cudaSuccess)
+                    err = cudaGraphLaunch(g.exec, stream);
 
-            auto n = static_cast<int>(size);
+                if(err != cudaSuccess)
+                {
+                    BOOST_LOG_TRIVIAL(fatal) << "Could not replay the filter graph: " << cudaGetErrorString(err);
+                    throw stage_runtime_error{"apply_filter() failed"};
+                }
+            }
 
-            auto plan = glados::cufft::plan<CUFFT_R2C>{n};
-            plan.execute(r.get(), k.get());
+            /*
+             * Weights, expands, transforms, filters and shrinks the batch projections on one stream. The lines of
+             * the i-th projection start at line i * n_col of the context's buffer. The first call captures the
+             * sequence into a CUDA graph, later calls only replay it with the new projections. Batches smaller than
+             * the context are launched stage by stage, the graph holds a node per projection of a full batch.
+             */
+            auto enqueue_filter(filter_context& ctx, projection_device_type* const* p, std::uint32_t batch,
+                                const filter_buffer_type& k, const weight_buffer_type& w,
+                                std::uint32_t filter_size, std::uint32_t n_col, cudaStream_t stream) -> void
+            {
+                // the graph was captured for full batches of projections of one width
+                const auto full = batch * n_col == ctx.n_lines;
+                if(full && ctx.graph != nullptr && p[0]->dim_x == ctx.graph->dim_x)
+                    return replay(*ctx.graph, p, batch, k, w, n_col, stream);
 
-            glados::cuda::launch(size_trans, k_creation_kernel, k.get(), size_trans, tau);
+                const auto size_trans = filter_size / 2 + 1;
+                const auto lines = batch * n_col;
+                const auto pitch = ctx.p_trans.pitch();
+
+                auto line = [&](std::uint32_t i)
+                {
+                    return reinterpret_cast<cufftReal*>(reinterpret_cast<char*>(ctx.p_trans.get()) + i * n_col * pitch);
+                };
+
+                auto sequence = [&]()
+                {
+                    // weight, expand and transform the projections
+                    for(auto i = 0u; i < batch; ++i)
+                        expand(p[i]->buf, w, p[i]->dim_x, line(i), pitch, filter_size, n_col, stream);
+                    ctx.forward.execute(ctx.real(), ctx.p_trans.get());
+
+                    // apply filter to all transformed projections at once
+                    glados::cuda::launch_async(stream, size_trans, lines,
+                                               filter_application_kernel,
+                                               ctx.p_trans.get(), static_cast<const float*>(k.get()),
+                                               size_trans, lines, pitch);
+
+                    // inverse transformation
+                    ctx.inverse.execute(ctx.p_trans.get(), ctx.real());
+
+                    // shrink to original size, the filter already took care of the normalization
+                    for(auto i = 0u; i < batch; ++i)
+                        shrink(line(i), pitch, p[i]->buf, p[i]->dim_x, n_col, stream);
+                };
+
+                if(full && ctx.capture && ctx.graph == nullptr)
+                {
+                    ctx.graph = capture(ctx, batch, n_col, stream, sequence);
+                    ctx.capture = ctx.graph != nullptr;
+                    if(ctx.capture)
+                    {
+                        ctx.graph->dim_x = p[0]->dim_x;
+                        return replay(*ctx.graph, p, batch, k, w, n_col, stream);
+                    }
+                }
+
+                sequence();
+            }
+        }
+
+        auto make_filter(const std::vector<float>& response) -> filter_buffer_type
+        {
+            auto k = glados::cuda::make_unique_device<float>(response.size());
+            auto err = cudaMemcpy(k.get(), response.data(), response.size() * sizeof(float), cudaMemcpyHostToDevice);
+            if(err != cudaSuccess)
+            {
+                BOOST_LOG_TRIVIAL(fatal) << "Could not upload filter: " << cudaGetErrorString(err);
+                throw stage_construction_error{"make_filter() failed"};
+            }
 
             return k;
         }
 
-        auto apply_filter(projection_device_type& p, const filter_buffer_type& k,
-                          std::uint32_t filter_size, std::uint32_t n_col)
+        auto apply_filter(projection_device_type& p, const filter_buffer_type& k, const weight_buffer_type& w,
+                          const filter_plan_type&, std::uint32_t filter_size, std::uint32_t n_col)
             -> void
         {
-            /* due to cuFFT's crazy API we cannot make the constants which we need as pointers actually const
-             * - this applies to n, p_exp_nembed and p_trans_nembed
+            // pipelined projections bring their own stream, all others use the local one
+            thread_local static auto s = cuda_stream{};
+            auto stream = (p.meta == nullptr) ? s.stream : p.meta->stream;
+
+            /*
+             * One context (and graph) per in-flight slot. They are only kept for the current projection size, a
+             * server would otherwise collect the contexts of every job it has seen.
              */
+            using key_type = std::tuple<cudaStream_t, std::uint32_t, std::uint32_t>;
+            thread_local static auto contexts = std::map<key_type, std::unique_ptr<filter_context>>{};
+            if(!contexts.empty() && (std::get<1>(contexts.begin()->first) != filter_size ||
+                                     std::get<2>(contexts.begin()->first) != n_col))
+                contexts.clear();
+
+            auto key = std::make_tuple(stream, filter_size, n_col);
+            auto it = contexts.find(key);
+            if(it == std::end(contexts))
+            {
+                auto ctx = std::unique_ptr<filter_context>{new filter_context{filter_size, n_col, stream}};
+                it = contexts.emplace(key, std::move(ctx)).first;
+            }
 
-            // dimensionality of the FFT - 1 in this case
-            constexpr auto rank = 1;
+            auto proj = &p;
+            enqueue_filter(*(it->second), &proj, 1u, k, w, filter_size, n_col, stream);
 
-            // FFT size for each dimension
-            static auto n = static_cast<int>(filter_size);
+            if(p.meta == nullptr)
+                glados::cuda::synchronize_stream(s.stream);
+        }
+    
+        auto apply_filter(std::vector<projection_device_type>& p, const filter_buffer_type& k,
+                          const weight_buffer_type& w, const filter_plan_type& plan,
+                          std::uint32_t filter_size, std::uint32_t n_col)
+            -> void
+        {
+            if(p.empty())
+                return;
 
-            // batched FFT -> set batch size
-            static const auto batch = static_cast<int>(n_col);
+            if(p.size() == 1u || filter_size > max_batched_filter_size)
+            {
+                for(auto&& proj : p)
+                    apply_filter(proj, k, w, plan, filter_size, n_col);
+                return;
+            }
 
-            // allocate memory for expanded projection (projection width -> filter size)
-            thread_local static auto p_exp = glados::cuda::make_unique_device<float>(filter_size, n_col);
+            // the whole batch is transformed on one stream, its lines are stacked in a single buffer
+            thread_local static auto s = cuda_stream{};
+            auto batch = static_cast<std::uint32_t>(p.size());
+            auto lines = batch * n_col;
 
-            // allocate memory for transformed projection
-            static const auto size_trans = filter_size / 2 + 1;
-            thread_local static auto p_trans = glados::cuda::make_unique_device<cufftComplex>(size_trans, n_col);
+            /*
+             * A single context sized for the largest batch so far, the partial batches at the end of a task run on
+             * its first lines. It is replaced when the projections change.
+             */
+            thread_local static auto ctx = std::unique_ptr<filter_context>{};
+            thread_local static auto ctx_filter_size = std::uint32_t{0u};
+            thread_local static auto ctx_n_col = std::uint32_t{0u};
+            if(ctx == nullptr || ctx_filter_size != filter_size || ctx_n_col != n_col || ctx->n_lines < lines)
+            {
+                // the old buffers may still be in use by the stream
+                glados::cuda::synchronize_stream(s.stream);
+                ctx.reset();
+                ctx.reset(new filter_context{filter_size, lines, s.stream});
+                ctx_filter_size = filter_size;
+                ctx_n_col = n_col;
+            }
 
-            // set distance between the first elements of two successive lines
-            static const auto p_exp_dist = static_cast<int>(p_exp.pitch() / sizeof(float));
-            static const auto p_trans_dist = static_cast<int>(p_trans.pitch() / sizeof(cufftComplex));
+            // pipelined projections: wait until they have been uploaded on their own streams
+            auto projs = std::vector<projection_device_type*>{};
+            for(auto&& proj : p)
+            {
+                if(proj.meta != nullptr)
+                    order(proj.meta->filtered, proj.meta->stream, s.stream);
+                projs.push_back(&proj);
+            }
 
-            // set distance between two successive elements
-            constexpr auto p_exp_stride = 1;
-            constexpr auto p_trans_stride = 1;
+            enqueue_filter(*ctx, projs.data(), batch, k, w, filter_size, n_col, s.stream);
 
-            // set storage dimensions of data in memory
-            static auto p_exp_nembed = static_cast<int>(p_exp_dist);
-            static auto p_trans_nembed = static_cast<int>(p_trans_dist);
+            // later stages on the projections' streams must see the filtered result. The next batch reuses the
+            // buffer but is enqueued on the same stream, so it is ordered anyway
+            auto pipelined = false;
+            for(auto&& proj : p)
+            {
+                if(proj.meta == nullptr)
+                    continue;
+
+                pipelined = true;
+                order(s.done, s.stream, proj.meta->stream);
+            }
 
-            // create plans for forward and inverse FFT
-            thread_local static auto forward = glados::cufft::plan<CUFFT_R2C>{rank, &n,
-                                                                &p_exp_nembed, p_exp_stride, p_exp_dist,
-                                                                &p_trans_nembed, p_trans_stride, p_trans_dist,
-                                                                batch};
+            if(!pipelined)
+                glados::cuda::synchronize_stream(s.stream);
+        }
 
-            thread_local static auto inverse = glados::cufft::plan<CUFFT_C2R>{rank, &n,
-                                                                &p_trans_nembed, p_trans_stride, p_trans_dist,
-                                                                &p_exp_nembed, p_exp_stride, p_exp_dist,
-                                                                batch};
+        auto apply_fused_filter(std::vector<projection_device_type>& p, const filter_buffer_type& taps,
+                                const weight_buffer_type& w, std::uint32_t n_col) -> void
+        {
+            if(p.empty())
+                return;
 
-            // create stream for filtering and assign to plans
+            // the whole batch is filtered by a single launch on one stream
             thread_local static auto s = cuda_stream{};
-            forward.set_stream(s.stream);
-            inverse.set_stream(s.stream);
+            for(auto&& proj : p)
+            {
+                if(proj.meta != nullptr)
+                    order(proj.meta->filtered, proj.meta->stream, s.stream);
+            }
+
+            for(auto first = std::size_t{0u}; first < p.size(); first += max_batch_size)
+            {
+                auto n = std::min(p.size() - first, static_cast<std::size_t>(max_batch_size));
+                auto batch = fused_batch{};
+                for(auto i = std::size_t{0u}; i < n; ++i)
+                {
+                    batch.ptr[i] = p[first + i].buf.get();
+                    batch.pitch[i] = p[first + i].buf.pitch();
+                }
 
-            // expand and transform the projection
-            expand(p.buf, p.dim_x, p_exp, filter_size, n_col, s.stream);
-            forward.execute(p_exp.get(), p_trans.get());
+                // one block per row, the row and the taps have to fit into shared memory
+                auto blocks = dim3{n_col, static_cast<unsigned int>(n)};
+                fused_filter_kernel<<<blocks, fused_block_size, 0u, s.stream>>>(
+                    batch, p.front().dim_x, static_cast<const float*>(taps.get()),
+                    static_cast<const float*>(w.get()), w.pitch());
 
-            // apply filter to transformed projection
-            glados::cuda::launch_async(s.stream, size_trans, n_col,
-                                       filter_application_kernel,
-                                       p_trans.get(), static_cast<const cufftComplex*>(k.get()),
-                                       size_trans, n_col, p_trans.pitch());
+                auto err = cudaGetLastError();
+                if(err != cudaSuccess)
+                {
+                    BOOST_LOG_TRIVIAL(fatal) << "Could not launch the fused filter: " << cudaGetErrorString(err);
+                    throw stage_runtime_error{"apply_fused_filter() failed"};
+                }
+            }
 
-            // inverse transformation
-            inverse.execute(p_trans.get(), p_exp.get());
+            auto pipelined = false;
+            for(auto&& proj : p)
+            {
+                if(proj.meta == nullptr)
+                    continue;
 
-            // shrink to original size and normalize
-            shrink(p_exp, p.buf, p.dim_x, n_col, s.stream);
-            glados::cuda::launch_async(s.stream, p.dim_x, p.dim_y,
-                                       normalization_kernel,
-                                       p.buf.get(), p.buf.pitch(), p.dim_x, p.dim_y, filter_size);
+                pipelined = true;
+                order(s.done, s.stream, proj.meta->stream);
+            }
 
-            glados::cuda::synchronize_stream(s.stream);
+            if(!pipelined)
+                glados::cuda::synchronize_stream(s.stream);
         }
     }
 }
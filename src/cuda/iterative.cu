@@ -0,0 +1,340 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <boost/log/trivial.hpp>
+
+#include <glados/cuda/coordinates.h>
+#include <glados/cuda/launch.h>
+#include <glados/cuda/utility.h>
+
+#include "../backprojection_constants.h"
+#include "../exception.h"
+
+#include "backend.h"
+
+namespace paris
+{
+    namespace cuda
+    {
+        namespace
+        {
+            // reciprocals of smaller values are treated as empty rays or voxels
+            constexpr auto min_weight = 1e-6f;
+
+            // the targets of the current batch
+            struct forward_batch
+            {
+                float* ptr[max_batch_size];
+                std::size_t pitch[max_batch_size];
+                float sin[max_batch_size];
+                float cos[max_batch_size];
+            };
+
+            __device__ __constant__ backprojection_constants fp_consts__{};
+            __device__ __constant__ forward_batch fp_batch__{};
+
+            inline __device__ auto vol_centered_coordinate(unsigned int coord, std::uint32_t dim, float size)
+            -> float
+            {
+                auto size2 = size / 2.f;
+                return -(dim * size2) + size2 + coord * size;
+            }
+
+            inline __device__ auto proj_real_coordinate(float coord, std::uint32_t dim, float size, float offset)
+            -> float
+            {
+                auto size2 = size / 2.f;
+                auto min = -(dim * size2) - offset;
+                return (coord - min) / size - (1.f / 2.f);
+            }
+
+            inline __device__ auto pixel(float* p, std::size_t pitch, std::uint32_t x, std::uint32_t y) -> float*
+            {
+                return reinterpret_cast<float*>(reinterpret_cast<char*>(p) + y * pitch) + x;
+            }
+
+            inline __device__ auto pixel(const float* p, std::size_t pitch, std::uint32_t x, std::uint32_t y)
+            -> const float*
+            {
+                return reinterpret_cast<const float*>(reinterpret_cast<const char*>(p) + y * pitch) + x;
+            }
+
+            // the transpose of backprojection_kernel: every voxel is splatted onto the pixels it would be sampled from
+            __global__ void forward_projection_kernel(const float* __restrict__ vol, std::size_t vol_pitch,
+                                                      std::uint32_t n, std::uint32_t p_dim_x, std::uint32_t p_dim_y,
+                                                      float scale)
+            {
+                auto k = glados::cuda::coord_x();
+                auto l = glados::cuda::coord_y();
+                auto m = glados::cuda::coord_z();
+
+                if((k >= fp_consts__.vol_dim_x) || (l >= fp_consts__.vol_dim_y) || (m >= fp_consts__.vol_dim_z))
+                    return;
+
+                auto slice_pitch = vol_pitch * fp_consts__.vol_dim_y;
+                auto slice = reinterpret_cast<const char*>(vol) + m * slice_pitch;
+                auto val = reinterpret_cast<const float*>(slice + l * vol_pitch)[k];
+                if(!(fabsf(val) > 0.f))
+                    return;
+
+                auto x_k = vol_centered_coordinate(k, fp_consts__.vol_dim_x_full, fp_consts__.l_vx_x);
+                auto y_l = vol_centered_coordinate(l, fp_consts__.vol_dim_y_full, fp_consts__.l_vx_y);
+                auto z_m = vol_centered_coordinate(m + fp_consts__.vol_offset, fp_consts__.vol_dim_z_full,
+                                                   fp_consts__.l_vx_z);
+
+                for(auto i = 0u; i < n; ++i)
+                {
+                    auto s = x_k * fp_batch__.cos[i] + y_l * fp_batch__.sin[i];
+                    auto t = -x_k * fp_batch__.sin[i] + y_l * fp_batch__.cos[i];
+
+                    auto factor = fp_consts__.d_sd / (s + fp_consts__.d_so);
+                    auto h = proj_real_coordinate(t * factor, fp_consts__.proj_dim_x, fp_consts__.l_px_x,
+                                                  fp_consts__.delta_s)
+                             - static_cast<float>(fp_consts__.proj_first_col);
+                    auto v = proj_real_coordinate(z_m * factor, fp_consts__.proj_dim_y, fp_consts__.l_px_y,
+                                                  fp_consts__.delta_t)
+                             - static_cast<float>(fp_consts__.proj_first_row);
+
+                    auto x1 = floorf(h);
+                    auto y1 = floorf(v);
+                    auto fx = h - x1;
+                    auto fy = v - y1;
+
+                    // same footprint as the texture lookup of the backprojection (border mode)
+                    auto u = fp_consts__.d_so / (s + fp_consts__.d_so);
+                    auto w = scale * u * u * val;
+
+                    auto p = fp_batch__.ptr[i];
+                    auto pitch = fp_batch__.pitch[i];
+                    auto xi = static_cast<int>(x1);
+                    auto yi = static_cast<int>(y1);
+                    for(auto dy = 0; dy < 2; ++dy)
+                    {
+                        auto y = yi + dy;
+                        if(y < 0 || y >= static_cast<int>(p_dim_y))
+                            continue;
+
+                        auto wy = (dy == 0) ? (1.f - fy) : fy;
+                        for(auto dx = 0; dx < 2; ++dx)
+                        {
+                            auto x = xi + dx;
+                            if(x < 0 || x >= static_cast<int>(p_dim_x))
+                                continue;
+
+                            auto wx = (dx == 0) ? (1.f - fx) : fx;
+                            atomicAdd(pixel(p, pitch, static_cast<std::uint32_t>(x), static_cast<std::uint32_t>(y)),
+                                      wx * wy * w);
+                        }
+                    }
+                }
+            }
+
+            __global__ void fill_kernel(float* p, std::size_t pitch, std::uint32_t dim_x, std::uint32_t dim_y,
+                                        std::uint32_t dim_z, float value)
+            {
+                auto x = glados::cuda::coord_x();
+                auto y = glados::cuda::coord_y();
+                auto z = glados::cuda::coord_z();
+
+                if((x < dim_x) && (y < dim_y) && (z < dim_z))
+                    *pixel(p, pitch, x, z * dim_y + y) = value;
+            }
+
+            __global__ void invert_kernel(float* p, std::size_t pitch, std::uint32_t dim_x, std::uint32_t dim_y,
+                                          std::uint32_t dim_z)
+            {
+                auto x = glados::cuda::coord_x();
+                auto y = glados::cuda::coord_y();
+                auto z = glados::cuda::coord_z();
+
+                if((x < dim_x) && (y < dim_y) && (z < dim_z))
+                {
+                    auto ptr = pixel(p, pitch, x, z * dim_y + y);
+                    *ptr = (*ptr > min_weight) ? 1.f / *ptr : 0.f;
+                }
+            }
+
+            __global__ void residual_kernel(const float* b, std::size_t b_pitch, float* ax, std::size_t ax_pitch,
+                                            const float* w, std::size_t w_pitch, std::uint32_t dim_x,
+                                            std::uint32_t dim_y)
+            {
+                auto x = glados::cuda::coord_x();
+                auto y = glados::cuda::coord_y();
+
+                if((x < dim_x) && (y < dim_y))
+                {
+                    auto b_val = *pixel(b, b_pitch, x, y);
+                    auto w_val = *pixel(w, w_pitch, x, y);
+                    auto ptr = pixel(ax, ax_pitch, x, y);
+                    *ptr = (b_val - *ptr) * w_val;
+                }
+            }
+
+            __global__ void update_kernel(float* x, std::size_t x_pitch, float* corr, std::size_t corr_pitch,
+                                          const float* c, std::size_t c_pitch, std::uint32_t dim_x,
+                                          std::uint32_t dim_y, std::uint32_t dim_z, float lambda, bool nonnegative)
+            {
+                auto k = glados::cuda::coord_x();
+                auto l = glados::cuda::coord_y();
+                auto m = glados::cuda::coord_z();
+
+                if((k < dim_x) && (l < dim_y) && (m < dim_z))
+                {
+                    auto row = m * dim_y + l;
+                    auto x_ptr = pixel(x, x_pitch, k, row);
+                    auto corr_ptr = pixel(corr, corr_pitch, k, row);
+                    auto c_val = *pixel(c, c_pitch, k, row);
+
+                    auto val = *x_ptr + lambda * c_val * *corr_ptr;
+                    *x_ptr = nonnegative ? fmaxf(val, 0.f) : val;
+                    *corr_ptr = 0.f;
+                }
+            }
+
+            // all iterative kernels of a thread run on its own stream and are finished on return
+            auto stream() -> cudaStream_t
+            {
+                thread_local static auto s = cuda_stream{};
+                return s.stream;
+            }
+
+            auto check(cudaError_t err, const char* what) -> void
+            {
+                if(err != cudaSuccess)
+                {
+                    BOOST_LOG_TRIVIAL(fatal) << what << ": " << cudaGetErrorString(err);
+                    throw stage_runtime_error{"iterative reconstruction failed"};
+                }
+            }
+        }
+
+        auto forward_project(const volume_device_type& v, std::uint32_t v_offset,
+                             std::vector<projection_device_type>& p,
+                             const detector_geometry& det_geo, const volume_geometry& vol_geo,
+                             const std::vector<float>& sin, const std::vector<float>& cos,
+                             float delta_s, float delta_t) -> void
+        {
+            if(p.empty())
+                return;
+
+            const auto d_so = det_geo.d_so;
+            const auto d_sd = std::abs(det_geo.d_so) + std::abs(det_geo.d_od);
+
+            // a voxel covers (d_sd / s)^2 * l_vx^2 / l_px^2 pixels and contributes l_vx to each ray through it
+            const auto scale = vol_geo.l_vx_x * vol_geo.l_vx_y * vol_geo.l_vx_z * (d_sd / d_so) * (d_sd / d_so) /
+                               (det_geo.l_px_row * det_geo.l_px_col);
+
+            for(auto&& proj : p)
+                synchronize(proj);
+
+            auto consts = backprojection_constants{
+                v.dim_x, vol_geo.dim_x, v.dim_y, vol_geo.dim_y, v.dim_z, vol_geo.dim_z, v_offset,
+                vol_geo.l_vx_x, vol_geo.l_vx_y, vol_geo.l_vx_z,
+                det_geo.n_row, det_geo.n_col, p.front().first_row, p.front().first_col,
+                det_geo.l_px_row, det_geo.l_px_col, delta_s, delta_t, d_so, d_sd
+            };
+            check(cudaMemcpyToSymbolAsync(fp_consts__, &consts, sizeof(consts), 0u, cudaMemcpyHostToDevice,
+                                          stream()), "Could not initialise forward projection constants");
+
+            // the symbol updates are ordered behind the previous batch's kernel on the same stream
+            for(auto first = std::size_t{0u}; first < p.size(); first += max_batch_size)
+            {
+                auto n = std::min(p.size() - first, static_cast<std::size_t>(max_batch_size));
+                auto batch = forward_batch{};
+                for(auto i = std::size_t{0u}; i < n; ++i)
+                {
+                    batch.ptr[i] = p[first + i].buf.get();
+                    batch.pitch[i] = p[first + i].buf.pitch();
+                    batch.sin[i] = sin[first + i];
+                    batch.cos[i] = cos[first + i];
+                }
+
+                check(cudaMemcpyToSymbolAsync(fp_batch__, &batch, sizeof(batch), 0u, cudaMemcpyHostToDevice,
+                                              stream()), "Could not initialise forward projection batch");
+
+                glados::cuda::launch_async(stream(), v.dim_x, v.dim_y, v.dim_z, forward_projection_kernel,
+                                           static_cast<const float*>(v.buf.get()), v.buf.pitch(),
+                                           static_cast<std::uint32_t>(n), p.front().dim_x, p.front().dim_y, scale);
+            }
+
+            glados::cuda::synchronize_stream(stream());
+        }
+
+        auto fill(projection_device_type& p, float value) -> void
+        {
+            synchronize(p);
+            glados::cuda::launch_async(stream(), p.dim_x, p.dim_y, 1u, fill_kernel,
+                                       p.buf.get(), p.buf.pitch(), p.dim_x, p.dim_y, 1u, value);
+            glados::cuda::synchronize_stream(stream());
+        }
+
+        auto fill(volume_device_type& v, float value) -> void
+        {
+            glados::cuda::launch_async(stream(), v.dim_x, v.dim_y, v.dim_z, fill_kernel,
+                                       v.buf.get(), v.buf.pitch(), v.dim_x, v.dim_y, v.dim_z, value);
+            glados::cuda::synchronize_stream(stream());
+        }
+
+        auto invert(projection_device_type& p) -> void
+        {
+            synchronize(p);
+            glados::cuda::launch_async(stream(), p.dim_x, p.dim_y, 1u, invert_kernel,
+                                       p.buf.get(), p.buf.pitch(), p.dim_x, p.dim_y, 1u);
+            glados::cuda::synchronize_stream(stream());
+        }
+
+        auto invert(volume_device_type& v) -> void
+        {
+            glados::cuda::launch_async(stream(), v.dim_x, v.dim_y, v.dim_z, invert_kernel,
+                                       v.buf.get(), v.buf.pitch(), v.dim_x, v.dim_y, v.dim_z);
+            glados::cuda::synchronize_stream(stream());
+        }
+
+        auto residual(const projection_device_type& b, projection_device_type& ax, const projection_device_type& w)
+            -> void
+        {
+            synchronize(ax);
+            glados::cuda::launch_async(stream(), ax.dim_x, ax.dim_y, residual_kernel,
+                                       static_cast<const float*>(b.buf.get()), b.buf.pitch(),
+                                       ax.buf.get(), ax.buf.pitch(),
+                                       static_cast<const float*>(w.buf.get()), w.buf.pitch(),
+                                       ax.dim_x, ax.dim_y);
+            glados::cuda::synchronize_stream(stream());
+        }
+
+        auto update(volume_device_type& x, volume_device_type& corr, const volume_device_type& c, float lambda,
+                    bool nonnegative) -> void
+        {
+            glados::cuda::launch_async(stream(), x.dim_x, x.dim_y, x.dim_z, update_kernel,
+                                       x.buf.get(), x.buf.pitch(), corr.buf.get(), corr.buf.pitch(),
+                                       static_cast<const float*>(c.buf.get()), c.buf.pitch(),
+                                       x.dim_x, x.dim_y, x.dim_z, lambda, nonnegative);
+            glados::cuda::synchronize_stream(stream());
+        }
+    }
+}
@@ -0,0 +1,169 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 15 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+
+#include <cctype>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/log/trivial.hpp>
+
+#include <cuda_runtime.h>
+
+#include "../geometry.h"
+#include "../interpolation.h"
+
+#include "backend.h"
+#include "launch_config.h"
+
+namespace paris
+{
+    namespace cuda
+    {
+        namespace
+        {
+            auto tuning_dir() -> std::string&
+            {
+                static auto dir = std::string{};
+                return dir;
+            }
+
+            auto path_of(const std::string& key) -> std::string
+            {
+                return tuning_dir() + "/cuda-" + key + ".launch";
+            }
+
+            auto beam_name(beam_geometry beam) -> const char*
+            {
+                switch(beam)
+                {
+                    case beam_geometry::fan: return "fan";
+                    case beam_geometry::parallel: return "parallel";
+                    case beam_geometry::cone: break;
+                }
+                return "cone";
+            }
+        }
+
+        auto set_tuning_dir(const std::string& dir) -> void
+        {
+            tuning_dir() = dir;
+        }
+
+        auto launch_candidates() -> std::vector<launch_config>
+        {
+            // warp-wide rows keep the texture fetches of neighbouring threads close together
+            const std::uint32_t blocks[][3] = {{32u, 8u, 1u}, {32u, 4u, 1u}, {32u, 16u, 1u}, {64u, 4u, 1u},
+                                               {64u, 8u, 1u}, {128u, 2u, 1u}, {16u, 16u, 1u}, {16u, 8u, 2u},
+                                               {32u, 4u, 2u}, {8u, 8u, 4u}};
+            const std::uint32_t slices[] = {1u, 2u, 4u, 8u};
+            const std::uint32_t unrolls[] = {1u, 2u, 4u};
+
+            auto vec = std::vector<launch_config>{};
+            for(auto&& b : blocks)
+                for(auto s : slices)
+                    for(auto u : unrolls)
+                        vec.push_back(launch_config{b[0], b[1], b[2], s, u});
+
+            return vec;
+        }
+
+        auto launch_key(const detector_geometry& det_geo, const volume_geometry& vol_geo, bool column,
+                        interpolation mode) -> std::string
+        {
+            auto device = 0;
+            auto prop = cudaDeviceProp{};
+            if(cudaGetDevice(&device) != cudaSuccess || cudaGetDeviceProperties(&prop, device) != cudaSuccess)
+                return std::string{};
+
+            // the name becomes part of a file name
+            auto key = std::string{prop.name};
+            for(auto&& c : key)
+            {
+                if(!std::isalnum(static_cast<unsigned char>(c)))
+                    c = '_';
+            }
+
+            key += "-sm" + std::to_string(prop.major) + std::to_string(prop.minor);
+            key += "-" + std::to_string(vol_geo.dim_x) + "x" + std::to_string(vol_geo.dim_y) + "x"
+                 + std::to_string(vol_geo.dim_z);
+            key += "-" + std::to_string(det_geo.n_row) + "x" + std::to_string(det_geo.n_col);
+            key += std::string{"-"} + beam_name(det_geo.beam);
+            if(!column)
+                key += "-matrix";
+
+            // keys of the default mode stay as they were before the modes existed
+            switch(mode)
+            {
+                case interpolation::fast_f16: key += "-f16"; break;
+                case interpolation::precise: key += "-precise"; break;
+                case interpolation::nearest: key += "-nearest"; break;
+                default: break;
+            }
+            return key;
+        }
+
+        auto load_launch_config(const std::string& key, launch_config& cfg) -> bool
+        {
+            if(tuning_dir().empty() || key.empty())
+                return false;
+
+            auto file = std::ifstream{path_of(key)};
+            if(!file)
+                return false;
+
+            auto c = launch_config{};
+            if(!(file >> c.block_x >> c.block_y >> c.block_z >> c.slices >> c.unroll))
+            {
+                BOOST_LOG_TRIVIAL(warning) << "Ignoring malformed launch configuration in " << path_of(key);
+                return false;
+            }
+
+            // only configurations the kernels were instantiated for
+            for(auto&& candidate : launch_candidates())
+            {
+                if(candidate.block_x == c.block_x && candidate.block_y == c.block_y &&
+                   candidate.block_z == c.block_z && candidate.slices == c.slices && candidate.unroll == c.unroll)
+                {
+                    cfg = c;
+                    return true;
+                }
+            }
+
+            BOOST_LOG_TRIVIAL(warning) << "Ignoring unknown launch configuration in " << path_of(key);
+            return false;
+        }
+
+        auto store_launch_config(const std::string& key, const launch_config& cfg) -> void
+        {
+            if(tuning_dir().empty() || key.empty())
+                return;
+
+            auto file = std::ofstream{path_of(key)};
+            if(!(file << cfg.block_x << ' ' << cfg.block_y << ' ' << cfg.block_z << ' ' << cfg.slices << ' '
+                      << cfg.unroll << '\n'))
+                BOOST_LOG_TRIVIAL(warning) << "Could not store the launch configuration in " << path_of(key);
+        }
+    }
+}
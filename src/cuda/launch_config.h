@@ -0,0 +1,65 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 15 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+
+#ifndef PARIS_CUDA_LAUNCH_CONFIG_H_
+#define PARIS_CUDA_LAUNCH_CONFIG_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../geometry.h"
+#include "../interpolation.h"
+
+namespace paris
+{
+    namespace cuda
+    {
+        // how the backprojection kernel is launched, found by benchmarking the candidates on the first batch
+        struct launch_config
+        {
+            std::uint32_t block_x;
+            std::uint32_t block_y;
+            std::uint32_t block_z;
+            std::uint32_t slices;   // consecutive slices of a thread, they share the terms which only depend on x and y
+            std::uint32_t unroll;   // unroll factor of the loop over the batch
+        };
+
+        // the tuner backprojects into a tile of at most this many voxels in the middle of the volume
+        constexpr auto tuning_tile_dim_xy = std::uint32_t{256u};
+        constexpr auto tuning_tile_dim_z = std::uint32_t{32u};
+
+        // every combination the kernels are instantiated for
+        auto launch_candidates() -> std::vector<launch_config>;
+
+        // identifies the GPU model of the current device together with the geometry and the kind of kernel
+        auto launch_key(const detector_geometry& det_geo, const volume_geometry& vol_geo, bool column,
+                        interpolation mode) -> std::string;
+
+        // looks up the configuration for key in the tuning directory, false if there is none
+        auto load_launch_config(const std::string& key, launch_config& cfg) -> bool;
+        auto store_launch_config(const std::string& key, const launch_config& cfg) -> void;
+    }
+}
+
+#endif /* PARIS_CUDA_LAUNCH_CONFIG_H_ */
@@ -20,20 +20,164 @@
  * Authors: Jan Stephan <j.stephan@hzdr.de>
  */
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/log/trivial.hpp>
+
 #include <glados/cuda/algorithm.h>
 #include <glados/cuda/memory.h>
 #include <glados/cuda/sync_policy.h>
 #include <glados/cuda/utility.h>
 
+#include "../exception.h"
+
 #include "backend.h"
 
 namespace paris
 {
     namespace cuda
     {
+        namespace
+        {
+            std::atomic<std::uint32_t> pipeline_depth{1u};
+
+            // released page-locked buffers, grouped by their number of elements
+            struct host_pool
+            {
+                std::mutex mutex;
+                std::unordered_map<std::size_t, std::vector<float*>> free;
+                std::size_t cached = 0u;
+                std::size_t limit = std::size_t{1u} << 30u;
+            };
+
+            // buffers may be released during static destruction -> the pool is never destroyed
+            auto get_host_pool() -> host_pool&
+            {
+                static auto pool = new host_pool{};
+                return *pool;
+            }
+
+            auto make_pinned(std::size_t size) -> std::unique_ptr<float[], detail::pinned_deleter>
+            {
+                auto&& pool = get_host_pool();
+                {
+                    auto&& lock = std::lock_guard<std::mutex>{pool.mutex};
+                    auto it = pool.free.find(size);
+                    if(it != std::end(pool.free) && !it->second.empty())
+                    {
+                        auto ptr = it->second.back();
+                        it->second.pop_back();
+                        pool.cached -= size * sizeof(float);
+                        return std::unique_ptr<float[], detail::pinned_deleter>{ptr, detail::pinned_deleter{size}};
+                    }
+                }
+
+                auto ptr = static_cast<void*>(nullptr);
+                auto err = cudaMallocHost(&ptr, size * sizeof(float));
+                if(err != cudaSuccess)
+                {
+                    BOOST_LOG_TRIVIAL(fatal) << "Could not allocate page-locked host memory: " << cudaGetErrorString(err);
+                    throw stage_runtime_error{"make_pinned() failed"};
+                }
+                return std::unique_ptr<float[], detail::pinned_deleter>{static_cast<float*>(ptr),
+                                                                       detail::pinned_deleter{size}};
+            }
+
+            auto copy_2d(void* dst, std::size_t dst_pitch, const void* src, std::size_t src_pitch, std::size_t width,
+                         std::size_t height, cudaMemcpyKind kind, cudaStream_t stream, const char* what) -> void
+            {
+                auto err = cudaMemcpy2DAsync(dst, dst_pitch, src, src_pitch, width, height, kind, stream);
+                if(err != cudaSuccess)
+                {
+                    BOOST_LOG_TRIVIAL(fatal) << "Could not copy " << what << ": " << cudaGetErrorString(err);
+                    throw stage_runtime_error{"copy_2d() failed"};
+                }
+                glados::cuda::synchronize_stream(stream);
+            }
+
+            auto copy_3d(cudaMemcpy3DParms& parms, cudaStream_t stream, const char* what) -> void
+            {
+                auto err = cudaMemcpy3DAsync(&parms, stream);
+                if(err != cudaSuccess)
+                {
+                    BOOST_LOG_TRIVIAL(fatal) << "Could not copy " << what << ": " << cudaGetErrorString(err);
+                    throw stage_runtime_error{"copy_3d() failed"};
+                }
+                glados::cuda::synchronize_stream(stream);
+            }
+        }
+
+        namespace detail
+        {
+            auto pinned_deleter::operator()(float* p) noexcept -> void
+            {
+                auto&& pool = get_host_pool();
+                {
+                    auto&& lock = std::lock_guard<std::mutex>{pool.mutex};
+                    if(pool.cached + size * sizeof(float) <= pool.limit)
+                    {
+                        try
+                        {
+                            pool.free[size].push_back(p);
+                            pool.cached += size * sizeof(float);
+                            return;
+                        }
+                        catch(const std::bad_alloc&)
+                        {
+                            // fall through and free the buffer
+                        }
+                    }
+                }
+                cudaFreeHost(p);
+            }
+        }
+
+        auto set_host_pool_size(std::size_t bytes) noexcept -> void
+        {
+            auto&& pool = get_host_pool();
+            auto released = std::vector<float*>{};
+            {
+                auto&& lock = std::lock_guard<std::mutex>{pool.mutex};
+                pool.limit = bytes;
+
+                // drop cached buffers until the pool fits into its new size
+                for(auto&& f : pool.free)
+                {
+                    while(pool.cached > pool.limit && !f.second.empty())
+                    {
+                        released.push_back(f.second.back());
+                        f.second.pop_back();
+                        pool.cached -= f.first * sizeof(float);
+                    }
+                }
+            }
+
+            for(auto p : released)
+                cudaFreeHost(p);
+        }
+
+        auto set_pipeline_depth(std::uint32_t depth) noexcept -> void
+        {
+            pipeline_depth = std::max(depth, 1u);
+        }
+
+        auto synchronize(const projection_device_type& p) -> void
+        {
+            if(p.meta != nullptr)
+                glados::cuda::synchronize_stream(p.meta->stream);
+        }
+
         auto make_projection_host(std::uint32_t dim_x, std::uint32_t dim_y) -> projection_host_type
         {
-            auto ptr = glados::cuda::make_unique_pinned_host<float>(dim_x, dim_y);
+            auto ptr = make_pinned(static_cast<std::size_t>(dim_x) * dim_y);
             return projection_host_type{std::move(ptr), dim_x, dim_y, 0u, 0.f, metadata{}};
         }
 
@@ -41,12 +185,24 @@ namespace paris
         {
             thread_local static auto allocator = detail::pool{};
             auto ptr = allocator.allocate_smart(dim_x, dim_y);
-            return projection_device_type{std::move(ptr), dim_x, dim_y, 0u, 0.f, metadata{}};
+
+            // every projection in flight gets its own stream. A depth of 1 keeps everything synchronous
+            static const auto depth = pipeline_depth.load();
+            auto meta = metadata{nullptr};
+            if(depth > 1u)
+            {
+                thread_local static auto streams = std::unique_ptr<cuda_stream[]>{new cuda_stream[depth]};
+                thread_local static auto next = 0u;
+                meta = &streams[next];
+                next = (next + 1u) % depth;
+            }
+
+            return projection_device_type{std::move(ptr), dim_x, dim_y, 0u, 0.f, meta};
         }
 
         auto make_volume_host(std::uint32_t dim_x, std::uint32_t dim_y, std::uint32_t dim_z) -> volume_host_type
         {
-            auto ptr = glados::cuda::make_unique_pinned_host<float>(dim_x, dim_y, dim_z);
+            auto ptr = make_pinned(static_cast<std::size_t>(dim_x) * dim_y * dim_z);
             return volume_host_type{std::move(ptr), dim_x, dim_y, dim_z, 0u};
         }
 
@@ -57,48 +213,133 @@ namespace paris
             return volume_device_type{std::move(ptr), dim_x, dim_y, dim_z, 0u};
         }
 
+        auto map_volume(int, std::uint64_t, std::uint32_t, std::uint32_t, std::uint32_t) -> volume_device_type
+        {
+            BOOST_LOG_TRIVIAL(fatal) << "The CUDA backend cannot map volumes into host memory";
+            throw stage_runtime_error{"map_volume() failed"};
+        }
+
         auto copy_h2d(const projection_host_type& h_p, projection_device_type& d_p) -> void
+        {
+            // the host buffer may be released as soon as we return -> wait for the upload only
+            copy_h2d(h_p, d_p, 0u);
+        }
+
+        auto copy_h2d(const projection_host_type& h_p, projection_device_type& d_p, std::uint32_t first) -> void
         {
             thread_local static auto s = cuda_stream{};
-            if(d_p.meta == nullptr)
-            {
-                glados::cuda::copy(glados::cuda::async, d_p.buf, h_p.buf, s.stream, h_p.dim_x, h_p.dim_y);
-                glados::cuda::synchronize_stream(s.stream);
-            }
-            else
-                glados::cuda::copy(glados::cuda::async, d_p.buf, h_p.buf, d_p.meta->stream, h_p.dim_x, h_p.dim_y);
+            auto stream = (d_p.meta == nullptr) ? s.stream : d_p.meta->stream;
+
+            auto src = h_p.buf.get() + static_cast<std::size_t>(first) * h_p.dim_x;
+            copy_2d(reinterpret_cast<void*>(d_p.buf.get()), d_p.buf.pitch(), reinterpret_cast<const void*>(src),
+                    h_p.dim_x * sizeof(float), d_p.dim_x * sizeof(float), d_p.dim_y, cudaMemcpyHostToDevice, stream,
+                    "projection rows");
 
             d_p.idx = h_p.idx;
             d_p.phi = h_p.phi;
+            d_p.first_row = h_p.first_row + first;
+            d_p.first_col = h_p.first_col;
         }
 
         auto copy_d2h(const projection_device_type& d_p, projection_host_type& h_p) -> void
+        {
+            // the host is going to read the result right away
+            copy_d2h(d_p, h_p, 0u);
+        }
+
+        auto copy_d2h(const projection_device_type& d_p, projection_host_type& h_p, std::uint32_t first) -> void
         {
             thread_local static auto s = cuda_stream{};
-            if(d_p.meta == nullptr && h_p.meta == nullptr)
-            {
-                glados::cuda::copy(glados::cuda::async, h_p.buf, d_p.buf, s.stream, d_p.dim_x, d_p.dim_y);
-                glados::cuda::synchronize_stream(s.stream);
-            }
-            else
-            {
-                glados::cuda::copy(glados::cuda::async, h_p.buf, d_p.buf, d_p.meta->stream, d_p.dim_x, d_p.dim_y);
-                h_p.meta = d_p.meta;
-            }
+            auto stream = (d_p.meta == nullptr) ? s.stream : d_p.meta->stream;
+
+            auto src = d_p.buf.get() + first;
+            copy_2d(reinterpret_cast<void*>(h_p.buf.get()), h_p.dim_x * sizeof(float),
+                    reinterpret_cast<const void*>(src), d_p.buf.pitch(), h_p.dim_x * sizeof(float), h_p.dim_y,
+                    cudaMemcpyDeviceToHost, stream, "projection columns");
+
             h_p.idx = d_p.idx;
             h_p.phi = d_p.phi;
+            h_p.first_row = d_p.first_row;
+            h_p.first_col = d_p.first_col + first;
+        }
+
+        auto make_projection_peer(std::uint32_t dim_x, std::uint32_t dim_y) -> projection_peer_type
+        {
+            auto ptr = glados::cuda::make_unique_device<float>(dim_x, dim_y);
+            return projection_peer_type{std::move(ptr), dim_x, dim_y, 0u, 0.f, metadata{nullptr}};
+        }
+
+        auto copy_d2p(const projection_device_type& d_p, projection_peer_type& p, std::uint32_t first) -> void
+        {
+            thread_local static auto s = cuda_stream{};
+            auto stream = (d_p.meta == nullptr) ? s.stream : d_p.meta->stream;
+
+            // the peers read the copy as soon as it is published
+            auto src = d_p.buf.get() + first;
+            copy_2d(reinterpret_cast<void*>(p.buf.get()), p.buf.pitch(), reinterpret_cast<const void*>(src),
+                    d_p.buf.pitch(), p.dim_x * sizeof(float), p.dim_y, cudaMemcpyDeviceToDevice, stream,
+                    "projection columns for the peers");
+
+            p.idx = d_p.idx;
+            p.phi = d_p.phi;
+            p.first_row = d_p.first_row;
+            p.first_col = d_p.first_col + first;
+        }
+
+        auto copy_p2d(const projection_peer_type& p, projection_device_type& d_p, std::uint32_t first) -> void
+        {
+            thread_local static auto s = cuda_stream{};
+            auto stream = (d_p.meta == nullptr) ? s.stream : d_p.meta->stream;
+
+            // unified addressing routes the copy over the peer link
+            auto src = reinterpret_cast<const char*>(p.buf.get()) + static_cast<std::size_t>(first) * p.buf.pitch();
+            copy_2d(reinterpret_cast<void*>(d_p.buf.get()), d_p.buf.pitch(), reinterpret_cast<const void*>(src),
+                    p.buf.pitch(), d_p.dim_x * sizeof(float), d_p.dim_y, cudaMemcpyDeviceToDevice, stream,
+                    "projection rows from a peer");
+
+            d_p.idx = p.idx;
+            d_p.phi = p.phi;
+            d_p.first_row = p.first_row + first;
+            d_p.first_col = p.first_col;
         }
 
         auto copy_h2d(const volume_host_type& h_v, volume_device_type& d_v) -> void
         {
-            glados::cuda::copy(glados::cuda::sync, d_v.buf, h_v.buf, h_v.dim_x, h_v.dim_y, h_v.dim_z);
+            thread_local static auto s = cuda_stream{};
+
+            auto parms = cudaMemcpy3DParms{};
+            parms.srcPtr = make_cudaPitchedPtr(reinterpret_cast<void*>(h_v.buf.get()), h_v.dim_x * sizeof(float),
+                                               h_v.dim_x, h_v.dim_y);
+            parms.dstPtr = make_cudaPitchedPtr(reinterpret_cast<void*>(d_v.buf.get()), d_v.buf.pitch(),
+                                               d_v.dim_x, d_v.dim_y);
+            parms.extent = make_cudaExtent(h_v.dim_x * sizeof(float), h_v.dim_y, h_v.dim_z);
+            parms.kind = cudaMemcpyHostToDevice;
+
+            copy_3d(parms, s.stream, "volume");
             d_v.off = h_v.off;
         }
 
         auto copy_d2h(const volume_device_type& d_v, volume_host_type& h_v) -> void
         {
-            glados::cuda::copy(glados::cuda::sync, h_v.buf, d_v.buf, d_v.dim_x, d_v.dim_y, d_v.dim_z);
-            h_v.off = d_v.off;
+            copy_d2h(d_v, h_v, 0u);
+        }
+
+        auto copy_d2h(const volume_device_type& d_v, volume_host_type& h_v, std::uint32_t first) -> void
+        {
+            // volume downloads get their own stream so they don't queue behind the projection traffic
+            thread_local static auto s = cuda_stream{};
+
+            auto parms = cudaMemcpy3DParms{};
+            parms.srcPtr = make_cudaPitchedPtr(reinterpret_cast<void*>(d_v.buf.get()), d_v.buf.pitch(),
+                                               d_v.dim_x, d_v.dim_y);
+            parms.srcPos = make_cudaPos(0, 0, first);
+            parms.dstPtr = make_cudaPitchedPtr(reinterpret_cast<void*>(h_v.buf.get()), h_v.dim_x * sizeof(float),
+                                               h_v.dim_x, h_v.dim_y);
+            parms.extent = make_cudaExtent(d_v.dim_x * sizeof(float), d_v.dim_y, h_v.dim_z);
+            parms.kind = cudaMemcpyDeviceToHost;
+
+            copy_3d(parms, s.stream, "volume slab");
+            h_v.off = d_v.off + first;
         }
     }
 }
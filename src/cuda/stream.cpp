@@ -32,10 +32,15 @@ namespace paris
     {
         cuda_stream::cuda_stream()
         : stream{glados::cuda::create_concurrent_stream()}
-        {}
+        {
+            cudaEventCreateWithFlags(&filtered, cudaEventDisableTiming);
+            cudaEventCreateWithFlags(&done, cudaEventDisableTiming);
+        }
 
         cuda_stream::~cuda_stream()
         {
+            cudaEventDestroy(done);
+            cudaEventDestroy(filtered);
             cudaStreamDestroy(stream);
         }
     }
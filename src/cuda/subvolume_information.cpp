@@ -21,18 +21,23 @@
  */
 
 #include <algorithm>
-#include <map>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include <cuda_runtime.h>
 
 #include <boost/log/trivial.hpp>
 
 #include <glados/cuda/exception.h>
-#include <glados/cuda/memory.h>
 #include <glados/cuda/utility.h>
 
 #include "../exception.h"
+#include "../filtering.h"
 #include "../geometry.h"
 #include "../subvolume_information.h"
 #include "backend.h"
+#include "launch_config.h"
 
 namespace paris
 {
@@ -40,81 +45,168 @@ namespace paris
     {
         namespace
         {
-            struct mem_info
+            // number of subvolumes each device processes if there is more than one device
+            constexpr auto slabs_per_device = std::uint32_t{4u};
+
+            // cudaMallocPitch pads every line to the pitch alignment, the strictest one of all devices counts
+            auto pitch_alignment(int devices) -> std::size_t
             {
-                std::size_t vol;
-                std::size_t proj;
-            };
+                auto alignment = 1;
+                for(auto d = 0; d < devices; ++d)
+                {
+                    auto a = 0;
+                    auto err = cudaDeviceGetAttribute(&a, cudaDevAttrTexturePitchAlignment, d);
+                    if(err != cudaSuccess)
+                    {
+                        BOOST_LOG_TRIVIAL(fatal) << "Could not query the pitch alignment of device #" << d << ": "
+                                                 << cudaGetErrorString(err);
+                        throw stage_construction_error{"make_subvolume_information() failed"};
+                    }
+                    alignment = std::max(alignment, a);
+                }
+                return static_cast<std::size_t>(alignment);
+            }
 
-            auto memory_info(const volume_geometry& vol_geo, const detector_geometry& det_geo) noexcept -> mem_info
+            auto pitched(std::size_t width, std::size_t height, std::size_t alignment) noexcept -> std::size_t
             {
-                auto info = mem_info{};
-                // this is not entirely accurate as CUDA adds a few more bytes when allocating 2D/3D memory
-                info.vol = vol_geo.dim_x * vol_geo.dim_y * vol_geo.dim_z * sizeof(float);
-                info.proj = det_geo.n_row * det_geo.n_col * sizeof(float);
+                return (width + alignment - 1u) / alignment * alignment * height;
+            }
 
-                BOOST_LOG_TRIVIAL(info) << "The volume requires (roughly) " << info.vol << " bytes";
-                BOOST_LOG_TRIVIAL(info) << "One projection requires (roughly) " << info.proj << " bytes";
+            // see filter_context in filtering.cu: one pitched buffer and the work areas of both plans
+            auto filter_context_size(std::uint32_t filter_size, std::uint32_t lines, std::size_t alignment)
+            -> std::size_t
+            {
+                auto size_trans = filter_size / 2u + 1u;
+                auto pitch = pitched(size_trans * sizeof(cufftComplex), 1u, alignment);
+
+                auto n = static_cast<int>(filter_size);
+                auto real_nembed = static_cast<int>(pitch / sizeof(cufftReal));
+                auto trans_nembed = static_cast<int>(pitch / sizeof(cufftComplex));
+                auto batch = static_cast<int>(lines);
+
+                auto forward = std::size_t{};
+                auto inverse = std::size_t{};
+                if(cufftEstimateMany(1, &n, &real_nembed, 1, real_nembed, &trans_nembed, 1, trans_nembed,
+                                     CUFFT_R2C, batch, &forward) != CUFFT_SUCCESS ||
+                   cufftEstimateMany(1, &n, &trans_nembed, 1, trans_nembed, &real_nembed, 1, real_nembed,
+                                     CUFFT_C2R, batch, &inverse) != CUFFT_SUCCESS)
+                {
+                    BOOST_LOG_TRIVIAL(fatal) << "Could not estimate the cuFFT work area";
+                    throw stage_construction_error{"make_subvolume_information() failed"};
+                }
 
-                return info;
+                return pitch * lines + forward + inverse;
+            }
+
+            // every device buffer of the pipeline except for the volume
+            auto plan_memory(const detector_geometry& det_geo, const memory_parameters& mem, std::size_t alignment)
+            -> memory_plan
+            {
+                auto plan = memory_plan{};
+                auto batch = std::max(std::min(mem.batch_size, max_batch_size), 1u);
+                auto depth = std::max(mem.pipeline_depth, 1u);
+                auto proj = pitched(det_geo.n_row * sizeof(float), mem.rows, alignment);
+
+                // unfiltered and batched projections plus those still in flight after a backprojection pass
+                plan.projections = (3u * batch + depth + 1u) * proj;
+
+                // several devices keep up to a batch of filtered projections for their peers
+                if(glados::cuda::get_device_count() > 1)
+                    plan.projections += batch * proj;
+
+                /*
+                 * Small detectors are convolved directly. All others are transformed by a context per stream for
+                 * single projections and, for short filters, one context holding a whole batch.
+                 */
+                auto filter_size = filter_length(det_geo);
+                plan.filtering = proj + (filter_size / 2u + 1u) * sizeof(float);
+                if(det_geo.n_row > max_fused_width)
+                {
+                    plan.filtering += (depth + 1u) * filter_context_size(filter_size, mem.rows, alignment);
+                    if(batch > 1u && filter_size <= max_batched_filter_size)
+                        plan.filtering += filter_context_size(filter_size, batch * mem.rows, alignment);
+                }
+
+                // the layered array of the backprojection context covers the whole detector, the tuner's tile is
+                // only alive during the first batch
+                plan.backprojection = static_cast<std::size_t>(det_geo.n_row) * det_geo.n_col * max_batch_size
+                                    * sizeof(float)
+                                    + pitched(tuning_tile_dim_xy * sizeof(float),
+                                              tuning_tile_dim_xy * tuning_tile_dim_z, alignment);
+
+                BOOST_LOG_TRIVIAL(info) << "The projection buffers require " << plan.projections << " bytes";
+                BOOST_LOG_TRIVIAL(info) << "Filtering requires " << plan.filtering << " bytes";
+                BOOST_LOG_TRIVIAL(info) << "The backprojection requires " << plan.backprojection << " bytes";
+
+                return plan;
             }
         }
 
-        auto make_subvolume_information(const volume_geometry& vol_geo, const detector_geometry& det_geo)
-            -> subvolume_info
+        auto make_subvolume_information(const volume_geometry& vol_geo, const detector_geometry& det_geo,
+                                        const memory_parameters& mem) -> subvolume_info
         {
             auto sce = paris::stage_construction_error{"create_subvolume_information() failed"};
 
             try
             {
                 auto subvol_info = subvolume_info{};
-                auto info = memory_info(vol_geo, det_geo);
-                auto mem_needed = info.vol + 10u * info.proj;
-
                 auto devices = glados::cuda::get_device_count();
-                auto d_s = static_cast<std::size_t>(devices);
-                mem_needed /= d_s;
+                auto alignment = pitch_alignment(devices);
 
-                auto vols_needed = static_cast<std::uint32_t>(devices);
+                auto plan = plan_memory(det_geo, mem, alignment);
+                auto fixed = plan.projections + plan.filtering + plan.backprojection;
+                auto slice = pitched(vol_geo.dim_x * sizeof(float), vol_geo.dim_y, alignment);
 
+                // any device may pick up any subvolume -> the device with the least memory limits the size
+                auto max_dim_z = vol_geo.dim_z;
+                plan.budget = std::numeric_limits<std::size_t>::max();
                 for(auto d = 0; d < devices; ++d)
                 {
                     glados::cuda::set_device(d);
 
-                    auto mem_dev = mem_needed;
-
                     auto mem_free = std::size_t{};
                     auto mem_total = std::size_t{};
                     glados::cuda::get_memory_info(mem_free, mem_total);
 
-                    while(std::max(mem_dev, mem_free) == mem_dev)
-                    {
-                        mem_dev /= 2;
-                        vols_needed *= 2;
-                    }
+                    auto budget = (mem.budget != 0u) ? std::min(mem.budget, mem_free) : mem_free - mem_free / 10u;
+                    auto dev_dim_z = (budget > fixed) ? static_cast<std::uint32_t>(
+                                        std::min((budget - fixed) / slice, static_cast<std::size_t>(vol_geo.dim_z)))
+                                                      : 0u;
 
-                    // FIXME: nasty exception abuse
-                    try
-                    {
-                        glados::cuda::make_unique_device<float>(vol_geo.dim_x,
-                                                                vol_geo.dim_y,
-                                                                vol_geo.dim_z / vols_needed);
-                        BOOST_LOG_TRIVIAL(info) << "Test allocation successful.";
-                    }
-                    catch(const glados::cuda::bad_alloc& ba)
-                    {
-                        BOOST_LOG_TRIVIAL(info) << "Test allocation failed, reducing subvolume size.";
-                        mem_dev /= 2;
-                        vols_needed *= 2;
-                    }
+                    BOOST_LOG_TRIVIAL(info) << "Device #" << d << " has " << mem_free << " bytes available, "
+                                            << budget << " bytes budgeted, and fits " << dev_dim_z << " slices";
+                    max_dim_z = std::min(max_dim_z, dev_dim_z);
+                    plan.budget = std::min(plan.budget, budget);
+                }
+
+                if(max_dim_z == 0u)
+                {
+                    BOOST_LOG_TRIVIAL(fatal) << "Not a single slice fits into the device memory budget";
+                    throw sce;
                 }
 
+                // the smallest number of subvolumes which fit -- the last one also holds the remainder
+                auto vols_needed = (vol_geo.dim_z + max_dim_z - 1u) / max_dim_z;
+                while(vol_geo.dim_z / vols_needed + vol_geo.dim_z % vols_needed > max_dim_z)
+                    ++vols_needed;
+
+                // several devices: split finer so faster devices can take over more subvolumes
+                auto d_u = static_cast<std::uint32_t>(devices);
+                if(d_u > 1u)
+                    vols_needed = std::min(std::max(vols_needed, slabs_per_device * d_u), vol_geo.dim_z);
+
                 subvol_info.geo.dim_x = vol_geo.dim_x;
                 subvol_info.geo.dim_y = vol_geo.dim_y;
                 subvol_info.geo.dim_z = vol_geo.dim_z / vols_needed;
                 subvol_info.geo.remainder = vol_geo.dim_z % vols_needed;
                 subvol_info.num = static_cast<int>(vols_needed);
 
+                plan.volume = (subvol_info.geo.dim_z + subvol_info.geo.remainder) * slice;
+                subvol_info.plan = plan;
+
+                BOOST_LOG_TRIVIAL(info) << "Planned " << vols_needed << " subvolumes, each device needs "
+                                        << plan.volume + fixed << " of " << plan.budget << " bytes";
+
                 return subvol_info;
             }
             catch(const glados::cuda::bad_alloc& ba)
@@ -22,6 +22,8 @@
 
 #include <glados/cuda/coordinates.h>
 #include <glados/cuda/launch.h>
+#include <glados/cuda/memory.h>
+#include <glados/cuda/sync_policy.h>
 #include <glados/cuda/utility.h>
 
 #include "backend.h"
@@ -32,45 +34,40 @@ namespace paris
     {
         namespace
         {
-            __global__ void weighting_kernel(float* p, std::uint32_t dim_x, std::uint32_t dim_y, std::size_t pitch,
-                                             float h_min, float v_min, float d_sd, float l_px_row, float l_px_col)
+            __global__ void weight_map_kernel(float* w, std::uint32_t dim_x, std::uint32_t dim_y, std::size_t pitch,
+                                              float h_min, float v_min, float d_sd, float l_px_row, float l_px_col)
             {
                 auto s = glados::cuda::coord_x();
                 auto t = glados::cuda::coord_y();
 
                 if((s < dim_x) && (t < dim_y))
                 {
-                    auto row = reinterpret_cast<float*>(reinterpret_cast<char*>(p) + t * pitch);
-
-                    // enable parallel global memory fetch while calculating
-                    const auto val = row[s];
+                    auto row = reinterpret_cast<float*>(reinterpret_cast<char*>(w) + t * pitch);
 
                     // detector coordinates in mm
                     const auto h_s = (l_px_row / 2.f) + s * l_px_row + h_min;
                     const auto v_t = (l_px_col / 2.f) + t * l_px_col + v_min;
 
                     // calculate weight
-                    const auto w_st = d_sd * rsqrtf(powf(d_sd, 2) + powf(h_s, 2) + powf(v_t, 2));
-
-                    // write value
-                    row[s] = val * w_st;
+                    row[s] = d_sd * rsqrtf(powf(d_sd, 2) + powf(h_s, 2) + powf(v_t, 2));
                 }
             }
 
         } 
 
-        auto weight(projection_device_type& p, float h_min, float v_min, float d_sd, float l_px_row, float l_px_col)
-            -> void
+        auto make_weights(std::uint32_t dim_x, std::uint32_t dim_y, float h_min, float v_min, float d_sd,
+                          float l_px_row, float l_px_col) -> weight_buffer_type
         {
-            thread_local static auto s = cuda_stream{};
-            
-            glados::cuda::launch_async(s.stream, p.dim_x, p.dim_y,
-                                        weighting_kernel,
-                                        p.buf.get(), p.dim_x, p.dim_y, p.buf.pitch(),
-                                        h_min, v_min, d_sd, l_px_row, l_px_col);
+            auto s = cuda_stream{};
+            auto w = glados::cuda::make_unique_device<float>(dim_x, dim_y);
 
+            glados::cuda::launch_async(s.stream, dim_x, dim_y,
+                                        weight_map_kernel,
+                                        w.get(), dim_x, dim_y, w.pitch(),
+                                        h_min, v_min, d_sd, l_px_row, l_px_col);
             glados::cuda::synchronize_stream(s.stream);
+
+            return w;
         }
-        
     }
 }
@@ -20,19 +20,35 @@
  * Authors: Jan Stephan <j.stephan@hzdr.de>
  */
 
+
 #include <algorithm>
+#include <atomic>
 #include <cerrno>
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
-#include <fstream>
-#include <ios>
+#include <cstring>
+#include <future>
 #include <memory>
 #include <stdexcept>
 #include <string>
 #include <system_error>
+#include <thread>
+#include <type_traits>
 #include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
 
 #include <boost/log/trivial.hpp>
 
+#ifdef PARIS_ENABLE_ZSTD
+#include <zstd.h>
+#endif
+
 #include "ddbvf.h"
 #include "volume.h"
 
@@ -45,6 +61,13 @@ namespace paris
             constexpr auto ddbvf_id = 0xEFDDDAFA;
             constexpr auto ddbvf_version = 0x0010;
 
+            /*
+             * version 2 stores every slice as an independent, optionally compressed chunk. The chunks follow the
+             * file header in no particular order, the slice index at index_pos tells where each of them can be
+             * found and how their elements are stored.
+             */
+            constexpr auto ddbvf_version_2 = 0x0020;
+
             // as all types are the same we don't need to consider padding here
             struct header
             {
@@ -53,24 +76,301 @@ namespace paris
                 std::uint32_t dim_z;
                 std::uint32_t offset;
             };
+
+            // follows id and version in version 2 files
+            struct header_2
+            {
+                std::uint32_t dim_x;
+                std::uint32_t dim_y;
+                std::uint32_t dim_z;
+                std::uint32_t flags;
+                std::uint64_t index_pos;
+            };
+
+            // the chunks are byte-shuffled before compression
+            constexpr auto flag_shuffle = 0x1u;
+            constexpr auto flag_zstd = 0x2u;
+
+            struct index_header
+            {
+                std::uint32_t type;
+                float scale;
+                float offset;
+                std::uint32_t reserved;
+            };
+
+            struct index_entry
+            {
+                std::uint64_t pos;
+                std::uint64_t size;
+            };
             
             constexpr auto offset_pos = sizeof(ddbvf_id) + sizeof(ddbvf_version) + sizeof(header) - sizeof(header::offset);
             constexpr auto first_pos = 32;
+
+            static_assert(sizeof(ddbvf_id) + sizeof(ddbvf_version_2) + sizeof(header_2) == first_pos,
+                          "version 2 header doesn't fit");
+
+            auto write_all(int fd, const char* buf, std::size_t size, off_t pos) -> void
+            {
+                while(size > 0)
+                {
+                    auto written = ::pwrite(fd, buf, size, pos);
+                    if(written == -1)
+                    {
+                        if(errno == EINTR)
+                            continue;
+                        throw std::system_error{errno, std::generic_category()};
+                    }
+
+                    buf += written;
+                    size -= static_cast<std::size_t>(written);
+                    pos += written;
+                }
+            }
+
+            auto read_all(int fd, char* buf, std::size_t size, off_t pos) -> void
+            {
+                while(size > 0)
+                {
+                    auto bytes = ::pread(fd, buf, size, pos);
+                    if(bytes == -1)
+                    {
+                        if(errno == EINTR)
+                            continue;
+                        throw std::system_error{errno, std::generic_category()};
+                    }
+
+                    if(bytes == 0)
+                        throw std::runtime_error{"ddbvf: unexpected end of file"};
+
+                    buf += bytes;
+                    size -= static_cast<std::size_t>(bytes);
+                    pos += bytes;
+                }
+            }
+
+#ifdef PARIS_ENABLE_ZSTD
+            // groups the n-th bytes of all elements together, which makes floats far more compressible
+            auto shuffle(const char* src, char* dest, std::size_t elements, std::size_t size) noexcept -> void
+            {
+                for(auto i = std::size_t{0}; i < elements; ++i)
+                {
+                    for(auto b = std::size_t{0}; b < size; ++b)
+                        dest[b * elements + i] = src[i * size + b];
+                }
+            }
+
+            auto unshuffle(const char* src, char* dest, std::size_t elements, std::size_t size) noexcept -> void
+            {
+                for(auto i = std::size_t{0}; i < elements; ++i)
+                {
+                    for(auto b = std::size_t{0}; b < size; ++b)
+                        dest[i * size + b] = src[b * elements + i];
+                }
+            }
+#endif
+
+            auto element_size(storage_type type) noexcept -> std::size_t
+            {
+                return type == storage_type::f32 ? sizeof(float) : sizeof(std::uint16_t);
+            }
+
+            // IEEE 754 binary16 with round to nearest even
+            auto to_half(float f) noexcept -> std::uint16_t
+            {
+                auto x = std::uint32_t{};
+                std::memcpy(&x, &f, sizeof(x));
+
+                auto sign = (x >> 16u) & 0x8000u;
+                auto mag = x & 0x7fffffffu;
+
+                // infinity and NaN
+                if(mag >= 0x7f800000u)
+                    return static_cast<std::uint16_t>(sign | 0x7c00u | (mag > 0x7f800000u ? 0x200u : 0u));
+
+                // too large, rounds to infinity
+                if(mag >= 0x477ff000u)
+                    return static_cast<std::uint16_t>(sign | 0x7c00u);
+
+                // subnormal or zero
+                if(mag < 0x38800000u)
+                {
+                    if(mag < 0x33000000u)
+                        return static_cast<std::uint16_t>(sign);
+
+                    auto shift = 126u - (mag >> 23u);
+                    auto m = (mag & 0x7fffffu) | 0x800000u;
+                    auto h = m >> shift;
+                    auto rem = m & ((1u << shift) - 1u);
+                    auto half = 1u << (shift - 1u);
+                    if(rem > half || (rem == half && (h & 1u)))
+                        ++h;
+                    return static_cast<std::uint16_t>(sign | h);
+                }
+
+                // normal, a carry out of the mantissa correctly increments the exponent
+                auto h = (mag - 0x38000000u) >> 13u;
+                auto rem = mag & 0x1fffu;
+                if(rem > 0x1000u || (rem == 0x1000u && (h & 1u)))
+                    ++h;
+                return static_cast<std::uint16_t>(sign | h);
+            }
+
+            auto from_half(std::uint16_t h) noexcept -> float
+            {
+                auto sign = static_cast<std::uint32_t>(h & 0x8000u) << 16u;
+                auto e = static_cast<std::uint32_t>(h >> 10u) & 0x1fu;
+                auto m = static_cast<std::uint32_t>(h) & 0x3ffu;
+
+                auto x = sign;
+                if(e == 0u)
+                {
+                    if(m != 0u)
+                    {
+                        // normalize subnormals
+                        e = 113u;
+                        while((m & 0x400u) == 0u)
+                        {
+                            m <<= 1u;
+                            --e;
+                        }
+                        x |= (e << 23u) | ((m & 0x3ffu) << 13u);
+                    }
+                }
+                else if(e == 0x1fu)
+                    x |= 0x7f800000u | (m << 13u);
+                else
+                    x |= ((e + 112u) << 23u) | (m << 13u);
+
+                auto f = 0.f;
+                std::memcpy(&f, &x, sizeof(f));
+                return f;
+            }
+
+            auto encode(const float* src, char* dest, std::size_t elements, const index_header& ih) noexcept -> void
+            {
+                switch(static_cast<storage_type>(ih.type))
+                {
+                    case storage_type::f32:
+                        std::memcpy(dest, src, elements * sizeof(float));
+                        break;
+
+                    case storage_type::f16:
+                        for(auto i = std::size_t{0}; i < elements; ++i)
+                        {
+                            auto v = to_half(src[i]);
+                            std::memcpy(dest + i * sizeof(v), &v, sizeof(v));
+                        }
+                        break;
+
+                    case storage_type::u16:
+                        for(auto i = std::size_t{0}; i < elements; ++i)
+                        {
+                            auto q = std::round((src[i] - ih.offset) / ih.scale);
+                            auto v = static_cast<std::uint16_t>(std::min(std::max(q, 0.f), 65535.f));
+                            std::memcpy(dest + i * sizeof(v), &v, sizeof(v));
+                        }
+                        break;
+                }
+            }
+
+            auto decode(const char* src, float* dest, std::size_t elements, const index_header& ih) noexcept -> void
+            {
+                switch(static_cast<storage_type>(ih.type))
+                {
+                    case storage_type::f32:
+                        std::memcpy(dest, src, elements * sizeof(float));
+                        break;
+
+                    case storage_type::f16:
+                        for(auto i = std::size_t{0}; i < elements; ++i)
+                        {
+                            auto v = std::uint16_t{};
+                            std::memcpy(&v, src + i * sizeof(v), sizeof(v));
+                            dest[i] = from_half(v);
+                        }
+                        break;
+
+                    case storage_type::u16:
+                        for(auto i = std::size_t{0}; i < elements; ++i)
+                        {
+                            auto v = std::uint16_t{};
+                            std::memcpy(&v, src + i * sizeof(v), sizeof(v));
+                            dest[i] = static_cast<float>(v) * ih.scale + ih.offset;
+                        }
+                        break;
+                }
+            }
         }
 
         struct handle
         {
+            handle() noexcept = default;
+            handle(const handle&) = delete;
+            auto operator=(const handle&) -> handle& = delete;
+
+            ~handle()
+            {
+                if(fd != -1)
+                    ::close(fd);
+            }
+
             header head;
-            std::fstream stream;
+            int fd = -1;
+
+            // version 2 only
+            bool chunked = false;
+            bool closed = false;
+            int level = 0;
+            std::uint32_t flags = 0u;
+            index_header meta;
+            std::atomic<std::uint64_t> end{first_pos};
+            std::vector<index_entry> index;
         };
 
+        namespace
+        {
+            // the slice index goes behind the last chunk, its position completes the header
+            auto write_index(handle& h) -> void
+            {
+                auto index_pos = h.end.load();
+                write_all(h.fd, reinterpret_cast<const char*>(&h.meta), sizeof(h.meta), static_cast<off_t>(index_pos));
+                write_all(h.fd, reinterpret_cast<const char*>(h.index.data()), h.index.size() * sizeof(index_entry),
+                          static_cast<off_t>(index_pos + sizeof(h.meta)));
+
+                constexpr auto index_pos_pos = first_pos - sizeof(header_2::index_pos);
+                write_all(h.fd, reinterpret_cast<const char*>(&index_pos), sizeof(index_pos), index_pos_pos);
+                h.closed = true;
+            }
+        }
+
         auto handle_deleter::operator()(handle* h) noexcept -> void
         {
+            if(h != nullptr && h->chunked && !h->closed)
+            {
+                try
+                {
+                    write_index(*h);
+                }
+                catch(const std::exception& e)
+                {
+                    BOOST_LOG_TRIVIAL(error) << "ddbvf: failed to write the slice index: " << e.what();
+                }
+            }
             delete h;
         }
 
-        auto create(const std::string& path, std::uint32_t dim_x, std::uint32_t dim_y, std::uint32_t dim_z) -> handle_type
+        auto create(const std::string& path, std::uint32_t dim_x, std::uint32_t dim_y, std::uint32_t dim_z,
+                    const format& fmt) -> handle_type
         {
+#ifndef PARIS_ENABLE_ZSTD
+            if(fmt.level != 0)
+                throw std::runtime_error{"ddbvf::create(): compiled without support for compressed volumes"};
+#endif
+            if(fmt.type == storage_type::u16 && !(fmt.scale > 0.f))
+                throw std::runtime_error{"ddbvf::create(): Invalid quantization window"};
+
             auto full_path = path + ".ddbvf";
 
             auto h = handle_type{new handle};
@@ -79,21 +379,51 @@ namespace paris
             // the first 32 bytes are reserved for the file header
             h->head.offset = first_pos - sizeof(ddbvf_id) - sizeof(ddbvf_version) - sizeof(h->head);
 
-            h->stream.open(full_path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+            h->fd = ::open(full_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if(h->fd == -1)
+                throw std::system_error{errno, std::generic_category()};
 
-            // write file header
-            h->stream.write(reinterpret_cast<const char*>(&ddbvf_id), sizeof(ddbvf_id));
-            h->stream.write(reinterpret_cast<const char*>(&ddbvf_version), sizeof(ddbvf_version));
-            h->stream.write(reinterpret_cast<char*>(&h->head), sizeof(h->head));
-            
-            // fill remaining bytes with zeroes
-            auto buf = std::unique_ptr<char[]>{new char[h->head.offset]};
-            std::fill_n(buf.get(), h->head.offset, 0);
-            h->stream.write(buf.get(), static_cast<std::streamsize>(h->head.offset));
+            char buf[first_pos] = {};
+            auto pos = std::size_t{0};
+            std::memcpy(buf + pos, &ddbvf_id, sizeof(ddbvf_id));
+            pos += sizeof(ddbvf_id);
 
-            // check for errors
-            if(!h->stream)
-                throw std::system_error{errno, std::generic_category()};
+            if(fmt.level != 0 || fmt.type != storage_type::f32)
+            {
+                // the size of the file is unknown, the header is completed by close()
+                h->chunked = true;
+                h->level = fmt.level;
+                h->flags = fmt.level != 0 ? (flag_shuffle | flag_zstd) : 0u;
+                h->meta = index_header{static_cast<std::uint32_t>(fmt.type), fmt.scale, fmt.offset, 0u};
+                h->index.resize(dim_z, index_entry{0u, 0u});
+
+                auto head = header_2{dim_x, dim_y, dim_z, h->flags, 0u};
+                std::memcpy(buf + pos, &ddbvf_version_2, sizeof(ddbvf_version_2));
+                pos += sizeof(ddbvf_version_2);
+                std::memcpy(buf + pos, &head, sizeof(head));
+
+                write_all(h->fd, buf, sizeof(buf), 0);
+                return h;
+            }
+
+            // reserve the whole file up front so concurrent writers don't fragment it
+            auto size = static_cast<off_t>(first_pos + std::size_t{dim_x} * dim_y * dim_z * sizeof(float));
+            if(::fallocate(h->fd, 0, 0, size) == -1)
+            {
+                if(errno != EOPNOTSUPP && errno != ENOSYS)
+                    throw std::system_error{errno, std::generic_category()};
+
+                BOOST_LOG_TRIVIAL(debug) << "ddbvf::create(): file system doesn't support preallocation";
+                if(::ftruncate(h->fd, size) == -1)
+                    throw std::system_error{errno, std::generic_category()};
+            }
+
+            // write file header, the remaining bytes are zeroes
+            std::memcpy(buf + pos, &ddbvf_version, sizeof(ddbvf_version));
+            pos += sizeof(ddbvf_version);
+            std::memcpy(buf + pos, &h->head, sizeof(h->head));
+
+            write_all(h->fd, buf, sizeof(buf), 0);
 
             return h;
         }
@@ -102,26 +432,126 @@ namespace paris
         {
             auto h = handle_type{new handle};
 
-            h->stream.open(path.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+            h->fd = ::open(path.c_str(), O_RDONLY);
+            if(h->fd == -1)
+                throw std::system_error{errno, std::generic_category()};
 
             auto id = std::uint32_t{};
-            auto version = std::uint16_t{};
+            auto version = std::remove_const<decltype(ddbvf_version)>::type{};
             
             // read file header
-            h->stream.read(reinterpret_cast<char*>(&id), sizeof(id));
+            auto pos = off_t{0};
+            read_all(h->fd, reinterpret_cast<char*>(&id), sizeof(id), pos);
             if(id != ddbvf_id)
                 throw std::runtime_error{"Not a ddbvf file: " + path};
+            pos += static_cast<off_t>(sizeof(id));
 
-            h->stream.read(reinterpret_cast<char*>(&version), sizeof(version));
-            if(version != ddbvf_version)
+            read_all(h->fd, reinterpret_cast<char*>(&version), sizeof(version), pos);
+            if(version != ddbvf_version && version != ddbvf_version_2)
                 throw std::runtime_error{"Unsupported ddbvf version: " + path};
+            pos += static_cast<off_t>(sizeof(version));
+
+            if(version == ddbvf_version)
+            {
+                read_all(h->fd, reinterpret_cast<char*>(&h->head), sizeof(h->head), pos);
+                return h;
+            }
+
+            auto head = header_2{};
+            read_all(h->fd, reinterpret_cast<char*>(&head), sizeof(head), pos);
+            if(head.index_pos == 0u)
+                throw std::runtime_error{"Incomplete ddbvf file: " + path};
 
-            h->stream.read(reinterpret_cast<char*>(&h->head), sizeof(h->head));
+            h->head = {head.dim_x, head.dim_y, head.dim_z, 0u};
+            h->chunked = true;
+            h->closed = true;
+            h->flags = head.flags;
+            read_all(h->fd, reinterpret_cast<char*>(&h->meta), sizeof(h->meta), static_cast<off_t>(head.index_pos));
+            if(h->meta.type > static_cast<std::uint32_t>(storage_type::u16))
+                throw std::runtime_error{"Unsupported ddbvf storage type: " + path};
+
+            h->index.resize(head.dim_z);
+            read_all(h->fd, reinterpret_cast<char*>(h->index.data()), h->index.size() * sizeof(index_entry),
+                     static_cast<off_t>(head.index_pos + sizeof(h->meta)));
+
+            return h;
+        }
 
-            // check for errors
-            if(!h->stream)
+        namespace
+        {
+            // encodes every worker-th slice of vol, starting with slice id
+            auto encode_slices(handle& h, const volume_type& vol, std::uint32_t first, std::uint32_t id,
+                               std::uint32_t workers) -> void
+            {
+                auto elements = std::size_t{vol.dim_x} * vol.dim_y;
+                auto size = elements * element_size(static_cast<storage_type>(h.meta.type));
+
+                auto encoded = std::unique_ptr<char[]>{new char[size]};
+#ifdef PARIS_ENABLE_ZSTD
+                auto bound = ZSTD_compressBound(size);
+                auto shuffled = std::unique_ptr<char[]>{new char[size]};
+                auto out = std::unique_ptr<char[]>{new char[bound]};
+
+                auto ctx = std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)>{ZSTD_createCCtx(), &ZSTD_freeCCtx};
+                if(ctx == nullptr)
+                    throw std::bad_alloc{};
+#endif
+
+                for(auto z = id; z < vol.dim_z; z += workers)
+                {
+                    encode(vol.buf.get() + z * elements, encoded.get(), elements, h.meta);
+
+                    auto chunk = static_cast<const char*>(encoded.get());
+                    auto chunk_size = size;
+#ifdef PARIS_ENABLE_ZSTD
+                    if(h.flags & flag_zstd)
+                    {
+                        shuffle(encoded.get(), shuffled.get(), elements,
+                                element_size(static_cast<storage_type>(h.meta.type)));
+
+                        chunk_size = ZSTD_compressCCtx(ctx.get(), out.get(), bound, shuffled.get(), size, h.level);
+                        if(ZSTD_isError(chunk_size))
+                            throw std::runtime_error{std::string{"ddbvf::write(): compression failed: "}
+                                                     + ZSTD_getErrorName(chunk_size)};
+                        chunk = out.get();
+                    }
+#endif
+
+                    // chunks are appended in whatever order they are finished
+                    auto pos = h.end.fetch_add(chunk_size);
+                    write_all(h.fd, chunk, chunk_size, static_cast<off_t>(pos));
+                    h.index[first + z] = index_entry{pos, chunk_size};
+                }
+            }
+        }
+
+        auto attach(const std::string& path, std::uint32_t dim_x, std::uint32_t dim_y, std::uint32_t dim_z)
+            -> handle_type
+        {
+            auto full_path = path + ".ddbvf";
+
+            auto h = handle_type{new handle};
+            h->fd = ::open(full_path.c_str(), O_RDWR);
+            if(h->fd == -1)
                 throw std::system_error{errno, std::generic_category()};
 
+            auto id = std::uint32_t{};
+            auto version = std::remove_const<decltype(ddbvf_version)>::type{};
+
+            auto pos = off_t{0};
+            read_all(h->fd, reinterpret_cast<char*>(&id), sizeof(id), pos);
+            pos += static_cast<off_t>(sizeof(id));
+            read_all(h->fd, reinterpret_cast<char*>(&version), sizeof(version), pos);
+            pos += static_cast<off_t>(sizeof(version));
+
+            // chunks are appended at a position only the creating process knows
+            if(id != ddbvf_id || version != ddbvf_version)
+                throw std::runtime_error{"ddbvf::attach(): Not a version 1 ddbvf file: " + full_path};
+
+            read_all(h->fd, reinterpret_cast<char*>(&h->head), sizeof(h->head), pos);
+            if(h->head.dim_x != dim_x || h->head.dim_y != dim_y || h->head.dim_z != dim_z)
+                throw std::runtime_error{"ddbvf::attach(): Volume dimensions don't match: " + full_path};
+
             return h;
         }
 
@@ -134,22 +564,106 @@ namespace paris
             if(first >= h->head.dim_z)
                 throw std::runtime_error{"ddbvf::write(): Starting position out of bounds"};
 
-            if(vol.dim_x != h->head.dim_x || vol.dim_y != h->head.dim_y || vol.dim_z > h->head.dim_z)
+            if(vol.dim_x != h->head.dim_x || vol.dim_y != h->head.dim_y || vol.dim_z > h->head.dim_z - first)
                 throw std::runtime_error{"ddbvf::write(): Attempting to save volume to file with wrong dimensions"};
 
+            if(h->closed)
+                throw std::runtime_error{"ddbvf::write(): File is already closed"};
+
+            if(h->chunked)
+            {
+                auto workers = std::min(vol.dim_z, std::max(std::thread::hardware_concurrency(), 1u));
+                auto futures = std::vector<std::future<void>>{};
+                for(auto i = 1u; i < workers; ++i)
+                    futures.emplace_back(std::async(std::launch::async, encode_slices, std::ref(*h), std::cref(vol),
+                                                    first, i, workers));
+
+                encode_slices(*h, vol, first, 0u, workers);
+                for(auto&& f : futures)
+                    f.get();
+                return;
+            }
+
             // calculate size and offset for writing
             using element_type = typename decltype(volume_type::buf)::element_type;
-            auto write_size = static_cast<std::streamsize>(vol.dim_x * vol.dim_y * vol.dim_z * sizeof(element_type));
-            auto write_pos = static_cast<std::fstream::off_type>(vol.dim_x * vol.dim_y * first * sizeof(element_type));
+            auto slice_size = std::size_t{vol.dim_x} * vol.dim_y * sizeof(element_type);
+            auto write_size = slice_size * vol.dim_z;
+            auto write_pos = static_cast<off_t>(first_pos + slice_size * first);
 
-            // write data
-            h->stream.seekp(first_pos);
-            h->stream.seekp(write_pos, std::ios_base::cur);
-            h->stream.write(reinterpret_cast<char*>(vol.buf.get()), write_size);
+            // positional writes don't share a file offset, so independent subvolumes may be written concurrently
+            write_all(h->fd, reinterpret_cast<const char*>(vol.buf.get()), write_size, write_pos);
 
-            // check for errors
-            if(!h->stream)
-                throw std::system_error{errno, std::generic_category()};
+            // start writeback now and keep the page cache from filling up with volume data
+            ::sync_file_range(h->fd, write_pos, static_cast<off_t>(write_size), SYNC_FILE_RANGE_WRITE);
+            ::posix_fadvise(h->fd, write_pos, static_cast<off_t>(write_size), POSIX_FADV_DONTNEED);
+        }
+
+        auto mapping(const handle_type& h, std::uint32_t first, std::uint64_t& pos) noexcept -> int
+        {
+            if(h == nullptr || h->chunked)
+                return -1;
+
+            auto slice_size = std::uint64_t{h->head.dim_x} * h->head.dim_y * sizeof(float);
+            pos = first_pos + slice_size * first;
+            return h->fd;
+        }
+
+        auto close(handle_type& h) -> void
+        {
+            if(h == nullptr || !h->chunked || h->closed)
+                return;
+
+            write_index(*h);
+        }
+
+        auto read_slice(const handle_type& h, std::uint32_t z) -> std::vector<float>
+        {
+            if(z >= h->head.dim_z)
+                throw std::runtime_error{"ddbvf::read_slice(): Slice out of bounds"};
+
+            auto elements = std::size_t{h->head.dim_x} * h->head.dim_y;
+            auto size = elements * sizeof(float);
+            auto slice = std::vector<float>(elements, 0.f);
+
+            if(!h->chunked)
+            {
+                read_all(h->fd, reinterpret_cast<char*>(slice.data()), size, static_cast<off_t>(first_pos + z * size));
+                return slice;
+            }
+
+            // slices that have never been written are empty
+            auto&& entry = h->index[z];
+            if(entry.size == 0u)
+                return slice;
+
+            auto type = static_cast<storage_type>(h->meta.type);
+            auto encoded_size = elements * element_size(type);
+
+            auto in = std::unique_ptr<char[]>{new char[entry.size]};
+            read_all(h->fd, in.get(), entry.size, static_cast<off_t>(entry.pos));
+
+            if(h->flags & flag_zstd)
+            {
+#ifdef PARIS_ENABLE_ZSTD
+                auto shuffled = std::unique_ptr<char[]>{new char[encoded_size]};
+                auto bytes = ZSTD_decompress(shuffled.get(), encoded_size, in.get(), entry.size);
+                if(ZSTD_isError(bytes) || bytes != encoded_size)
+                    throw std::runtime_error{"ddbvf::read_slice(): Corrupt chunk"};
+
+                in = std::unique_ptr<char[]>{new char[encoded_size]};
+                if(h->flags & flag_shuffle)
+                    unshuffle(shuffled.get(), in.get(), elements, element_size(type));
+                else
+                    std::swap(in, shuffled);
+#else
+                throw std::runtime_error{"ddbvf::read_slice(): compiled without support for compressed volumes"};
+#endif
+            }
+            else if(entry.size != encoded_size)
+                throw std::runtime_error{"ddbvf::read_slice(): Corrupt chunk"};
+
+            decode(in.get(), slice.data(), elements, h->meta);
+            return slice;
         }
     }
 }
@@ -26,6 +26,7 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "backend.h"
 #include "volume.h"
@@ -40,10 +41,38 @@ namespace paris
 
         using volume_type = backend::volume_host_type;
 
+        enum class storage_type : std::uint32_t
+        {
+            f32 = 0u,
+            f16 = 1u,
+            u16 = 2u    // quantized, value = stored * scale + offset
+        };
+
+        struct format
+        {
+            int level = 0;  // zstd level, 0 disables compression
+            storage_type type = storage_type::f32;
+            float scale = 1.f;
+            float offset = 0.f;
+        };
+
         auto open(const std::string& path) -> handle_type;
-        auto create(const std::string& path, std::uint32_t dim_x, std::uint32_t dim_y, std::uint32_t dim_z)
+        // uncompressed f32 volumes are written as version 1 files, everything else needs version 2
+        auto create(const std::string& path, std::uint32_t dim_x, std::uint32_t dim_y, std::uint32_t dim_z,
+                    const format& fmt = format{}) -> handle_type;
+        // opens a version 1 file which another process has created, the slices are written independently
+        auto attach(const std::string& path, std::uint32_t dim_x, std::uint32_t dim_y, std::uint32_t dim_z)
             -> handle_type;
         auto write(handle_type& h, const volume_type& vol, std::uint32_t first) -> void;
+
+        // version 1 files may be mapped into memory: returns the descriptor and sets pos to the byte position of
+        // slice first, -1 for files which are written in chunks
+        auto mapping(const handle_type& h, std::uint32_t first, std::uint64_t& pos) noexcept -> int;
+
+        // finishes version 2 files, no writes are allowed afterwards
+        auto close(handle_type& h) -> void;
+
+        auto read_slice(const handle_type& h, std::uint32_t z) -> std::vector<float>;
     }
 }
 
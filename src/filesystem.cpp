@@ -21,6 +21,9 @@
  */
 
 #include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
 #include <iterator>
 #include <iostream>
 #include <stdexcept>
@@ -30,6 +33,10 @@
 #include <boost/log/trivial.hpp>
 #include <boost/filesystem.hpp>
 
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
 #include "filesystem.h"
 
 namespace paris
@@ -46,9 +53,11 @@ namespace paris
                     throw std::runtime_error(path + " is not a directory.");
                 else if(boost::filesystem::is_directory(p))
                 {
-                    for(auto&& it = boost::filesystem::directory_iterator(p);
+                    // resolving the directory once saves a round trip per file on network filesystems
+                    auto dir = boost::filesystem::canonical(p);
+                    for(auto&& it = boost::filesystem::directory_iterator(dir);
                             it != boost::filesystem::directory_iterator(); ++it)
-                        ret.push_back(boost::filesystem::canonical(it->path()).string());
+                        ret.push_back((dir / it->path().filename()).string());
                 }
                 else
                     throw std::runtime_error(path + " exists but is neither a regular file nor a directory.");
@@ -87,5 +96,62 @@ namespace paris
             return false;
         }
     }
-}
 
+    directory_watcher::directory_watcher(const std::string& path)
+    : path_{path}, fd_{inotify_init1(IN_CLOEXEC)}
+    {
+        if(fd_ < 0)
+            throw std::runtime_error{std::string{"Could not initialise inotify: "} + std::strerror(errno)};
+
+        // files written in place and files renamed into the directory once they are complete
+        if(inotify_add_watch(fd_, path_.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+        {
+            auto err = errno;
+            close(fd_);
+            throw std::runtime_error{"Could not watch " + path_ + ": " + std::strerror(err)};
+        }
+    }
+
+    directory_watcher::~directory_watcher()
+    {
+        close(fd_);
+    }
+
+    auto directory_watcher::poll(std::vector<std::string>& files, std::chrono::milliseconds timeout) -> void
+    {
+        auto pfd = pollfd{fd_, POLLIN, 0};
+        auto ready = ::poll(&pfd, 1, static_cast<int>(timeout.count()));
+        if(ready < 0 && errno != EINTR)
+            throw std::runtime_error{std::string{"Could not poll inotify: "} + std::strerror(errno)};
+        if(ready <= 0)
+            return;
+
+        alignas(inotify_event) char buf[4096];
+        auto len = read(fd_, buf, sizeof(buf));
+        if(len < 0)
+        {
+            if(errno == EINTR || errno == EAGAIN)
+                return;
+            throw std::runtime_error{std::string{"Could not read inotify events: "} + std::strerror(errno)};
+        }
+
+        auto first = files.size();
+        for(auto pos = 0l; pos < len;)
+        {
+            auto event = reinterpret_cast<const inotify_event*>(buf + pos);
+            pos += static_cast<long>(sizeof(inotify_event) + event->len);
+
+            if(event->len == 0u || (event->mask & IN_ISDIR) != 0u)
+                continue;
+
+            // the file may already be gone again
+            auto ec = boost::system::error_code{};
+            auto p = boost::filesystem::canonical(boost::filesystem::path{path_} / event->name, ec);
+            if(!ec)
+                files.push_back(p.string());
+        }
+
+        using difference_type = std::vector<std::string>::difference_type;
+        std::sort(std::begin(files) + static_cast<difference_type>(first), std::end(files));
+    }
+}
@@ -23,6 +23,7 @@
 #ifndef PARIS_FILESYSTEM_H_
 #define PARIS_FILESYSTEM_H_
 
+#include <chrono>
 #include <string>
 #include <vector>
 
@@ -30,6 +31,27 @@ namespace paris
 {
 	auto read_directory(const std::string&) -> std::vector<std::string>;
 	auto create_directory(const std::string&) -> bool;
+
+	/*
+	 * Reports files which have been completely written to (or moved into) a directory since the watcher was
+	 * created. Uses inotify.
+	 */
+	class directory_watcher
+	{
+		public:
+			explicit directory_watcher(const std::string& path);
+			~directory_watcher();
+
+			directory_watcher(const directory_watcher&) = delete;
+			auto operator=(const directory_watcher&) -> directory_watcher& = delete;
+
+			// waits up to timeout for new files, their sorted paths are appended to files
+			auto poll(std::vector<std::string>& files, std::chrono::milliseconds timeout) -> void;
+
+		private:
+			std::string path_;
+			int fd_;
+	};
 }
 
 #endif /* PARIS_FILESYSTEM_H_ */
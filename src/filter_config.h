@@ -0,0 +1,47 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#ifndef PARIS_FILTER_CONFIG_H_
+#define PARIS_FILTER_CONFIG_H_
+
+#include <string>
+
+namespace paris
+{
+    enum class filter_window
+    {
+        ram_lak,
+        shepp_logan,
+        cosine,
+        hamming,
+        hann
+    };
+
+    struct filter_config
+    {
+        filter_window window;
+        float cutoff; // relative to the Nyquist frequency, (0, 1]
+        std::string wisdom_dir; // FFT plans are cached here, empty disables the cache
+    };
+}
+
+#endif /* PARIS_FILTER_CONFIG_H_ */
@@ -22,25 +22,247 @@
 
 #include <cmath>
 #include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 #include "backend.h"
+#include "filter_config.h"
 #include "filtering.h"
 #include "geometry.h"
+#include "metrics.h"
+#include "weighting.h"
 
 namespace paris
 {
-    auto filter(backend::projection_device_type& p, const detector_geometry& det_geo)
-        noexcept(true && noexcept(backend::apply_filter))
+    namespace
+    {
+        // apodization window, u is the frequency relative to the cutoff
+        auto window(filter_window w, double u) noexcept -> double
+        {
+            if(u > 1.)
+                return 0.;
+
+            switch(w)
+            {
+                case filter_window::shepp_logan:
+                    return (std::fpclassify(u) == FP_ZERO) ? 1. : std::sin(M_PI * u / 2.) / (M_PI * u / 2.);
+
+                case filter_window::cosine:
+                    return std::cos(M_PI * u / 2.);
+
+                case filter_window::hamming:
+                    return 0.54 + 0.46 * std::cos(M_PI * u);
+
+                case filter_window::hann:
+                    return 0.5 + 0.5 * std::cos(M_PI * u);
+
+                case filter_window::ram_lak:
+                default:
+                    return 1.;
+            }
+        }
+
+        /*
+         * The frequency response of the discrete ramp filter
+         *
+         *          1/8 * 1/(tau^2)                     for j = 0
+         * r(j) = { 0                                   for even j
+         *          -(1 / (2 * j^2 * pi^2 * tau^2))     for odd j
+         *
+         * is real since r(j) = r(-j), so K(x) = r(0) + 2 * sum(r(j) * cos(2 * pi * j * x / size)). The
+         * magnitude is scaled by tau, multiplied by the window and divided by the size to account for the
+         * inverse FFT.
+         */
+        auto make_response(std::uint32_t size, float tau, const filter_config& cfg) -> std::vector<float>
+        {
+            const auto size_trans = size / 2 + 1;
+            const auto t = static_cast<double>(tau);
+            const auto half = static_cast<double>(size) / 2.;
+
+            auto cos_table = std::vector<double>(size);
+            for(auto i = 0u; i < size; ++i)
+                cos_table[i] = std::cos(2. * M_PI * static_cast<double>(i) / static_cast<double>(size));
+
+            auto response = std::vector<float>(size_trans);
+            for(auto x = 0u; x < size_trans; ++x)
+            {
+                auto k = 1. / (8. * t * t);
+                for(auto j = 1u; j < size / 2; j += 2)
+                {
+                    const auto idx = static_cast<std::uint64_t>(j) * x % size;
+                    k -= cos_table[idx] / (static_cast<double>(j) * static_cast<double>(j) * M_PI * M_PI * t * t);
+                }
+
+                const auto u = static_cast<double>(x) / half / static_cast<double>(cfg.cutoff);
+                response[x] = static_cast<float>(t * std::abs(k) * window(cfg.window, u) / static_cast<double>(size));
+            }
+
+            return response;
+        }
+
+        // filter bank shared by all devices -- the response only has to be uploaded by each of them
+        auto filter_response(std::uint32_t size, float tau, const filter_config& cfg) -> const std::vector<float>&
+        {
+            using key_type = std::tuple<std::uint32_t, float, filter_window, float>;
+
+            static auto&& m = std::mutex{};
+            static auto bank = std::map<key_type, std::vector<float>>{};
+
+            auto&& lock = std::lock_guard<std::mutex>{m};
+            auto key = std::make_tuple(size, tau, cfg.window, cfg.cutoff);
+            auto it = bank.find(key);
+            if(it == std::end(bank))
+                it = bank.emplace(key, make_response(size, tau, cfg)).first;
+
+            return it->second;
+        }
+
+        /*
+         * The spatial taps h(j), -n < j < n, of the same filter for rows of n pixels. Since the rows are padded to
+         * size >= 2 * n before the transform the circular convolution never wraps around, so convolving with
+         * h(j) = sum(K(x) * cos(2 * pi * j * x / size)) over all size frequencies gives the same result. The
+         * response already contains the normalization.
+         */
+        auto make_taps(std::uint32_t n, std::uint32_t size, const std::vector<float>& response) -> std::vector<float>
+        {
+            auto taps = std::vector<float>(2u * n - 1u);
+            for(auto i = 0u; i < taps.size(); ++i)
+            {
+                auto j = static_cast<double>(i) - static_cast<double>(n - 1u);
+                auto h = static_cast<double>(response.front());
+                for(auto x = 1u; x < size / 2u; ++x)
+                {
+                    auto arg = 2. * M_PI * j * static_cast<double>(x) / static_cast<double>(size);
+                    h += 2. * static_cast<double>(response[x]) * std::cos(arg);
+                }
+                h += static_cast<double>(response[size / 2u]) * std::cos(M_PI * j);
+                taps[i] = static_cast<float>(h);
+            }
+            return taps;
+        }
+
+        struct filter_resources
+        {
+            std::uint32_t filter_size;
+            std::uint32_t n_col;
+            const backend::filter_buffer_type& k;
+            const backend::filter_buffer_type& taps;
+            const backend::weight_buffer_type& w;
+            const backend::filter_plan_type& plan;
+        };
+
+        // small detectors are filtered by the backend's fused kernel
+        auto fused(const detector_geometry& det_geo) noexcept -> bool
+        {
+            return det_geo.n_row <= backend::max_fused_width;
+        }
+
+        // FFT plans only depend on the transform, all devices share them
+        auto filter_plan(std::uint32_t filter_size, std::uint32_t n_col, const std::string& wisdom_dir)
+        -> const backend::filter_plan_type&
+        {
+            using key_type = std::tuple<std::uint32_t, std::uint32_t, std::string>;
+
+            static auto&& m = std::mutex{};
+            static auto plans = std::map<key_type, backend::filter_plan_type>{};
+
+            auto&& lock = std::lock_guard<std::mutex>{m};
+            auto key = std::make_tuple(filter_size, n_col, wisdom_dir);
+            auto it = plans.find(key);
+            if(it == std::end(plans))
+                it = plans.emplace(key, backend::make_filter_plan(filter_size, n_col, wisdom_dir)).first;
+
+            return it->second;
+        }
+
+        // the uploaded filter and weights of one geometry
+        struct device_filter
+        {
+            backend::filter_buffer_type k;
+            backend::filter_buffer_type taps;
+            backend::weight_buffer_type w;
+        };
+
+        /*
+         * All freshly loaded projections of a reconstruction cover the same detector rows. A server runs many
+         * reconstructions, which usually differ in the geometry, filter or rows -- only the last one is kept.
+         */
+        auto resources(const detector_geometry& det_geo, const filter_config& cfg, const row_window& window)
+        -> filter_resources
+        {
+            const auto filter_size = filter_length(det_geo);
+            const auto n_col = window.rows;
+            const auto tau = det_geo.l_px_row;
+
+            static const auto no_plan = backend::filter_plan_type{};
+            const auto& plan = fused(det_geo) ? no_plan : filter_plan(filter_size, n_col, cfg.wisdom_dir);
+
+            // thread local -> uploaded once per thread (= device) and geometry
+            using key_type = std::tuple<std::uint32_t, std::uint32_t, float, float, float, float, float, float,
+                                        beam_geometry, std::uint32_t, std::uint32_t, filter_window, float>;
+            thread_local static auto uploaded_key = key_type{};
+            thread_local static auto uploaded = std::unique_ptr<device_filter>{};
+
+            auto key = key_type{det_geo.n_row, det_geo.n_col, det_geo.l_px_row, det_geo.l_px_col, det_geo.delta_s,
+                                det_geo.delta_t, det_geo.d_so, det_geo.d_od, det_geo.beam, window.first,
+                                window.rows, cfg.window, cfg.cutoff};
+            if(uploaded == nullptr || uploaded_key != key)
+            {
+                // the old buffers go first, device memory is planned for one set
+                uploaded.reset();
+
+                auto&& response = filter_response(filter_size, tau, cfg);
+                uploaded.reset(new device_filter{backend::make_filter(response),
+                                                 fused(det_geo) ? backend::make_filter(make_taps(det_geo.n_row,
+                                                                                                 filter_size,
+                                                                                                 response))
+                                                                : backend::filter_buffer_type{},
+                                                 make_weights(det_geo, window)});
+                uploaded_key = key;
+            }
+
+            auto&& f = *uploaded;
+            return filter_resources{filter_size, n_col, f.k, f.taps, f.w, plan};
+        }
+    }
+
+    auto filter_length(const detector_geometry& det_geo) noexcept -> std::uint32_t
+    {
+        return static_cast<std::uint32_t>(2 * std::pow(2.f, std::ceil(std::log2(det_geo.n_row))));
+    }
+
+    auto filter(backend::projection_device_type& p, const detector_geometry& det_geo, const filter_config& cfg)
         -> void
     {
-        // the following variables are static and global -> initialise once
-        static const auto filter_size = static_cast<std::uint32_t>(2 * std::pow(2.f, std::ceil(std::log2(det_geo.n_row))));
-        static const auto n_col = det_geo.n_col;
-        static const auto tau = det_geo.l_px_row;
+        auto&& t = metrics::timer{metrics::stage::filter};
+        auto r = resources(det_geo, cfg, row_window{p.first_row, p.dim_y});
+        if(fused(det_geo))
+        {
+            auto batch = std::vector<backend::projection_device_type>{};
+            batch.push_back(std::move(p));
+            backend::apply_fused_filter(batch, r.taps, r.w, r.n_col);
+            p = std::move(batch.front());
+        }
+        else
+            backend::apply_filter(p, r.k, r.w, r.plan, r.filter_size, r.n_col);
+    }
 
-        // the following variable is static and thread local -> initialise once per thread (= device)
-        thread_local static const auto k = backend::make_filter(filter_size, tau);
+    auto filter(std::vector<backend::projection_device_type>& p, const detector_geometry& det_geo,
+                const filter_config& cfg) -> void
+    {
+        if(p.empty())
+            return;
 
-        backend::apply_filter(p, k, filter_size, n_col);
+        auto&& t = metrics::timer{metrics::stage::filter, p.size()};
+        auto r = resources(det_geo, cfg, row_window{p.front().first_row, p.front().dim_y});
+        if(fused(det_geo))
+            backend::apply_fused_filter(p, r.taps, r.w, r.n_col);
+        else
+            backend::apply_filter(p, r.k, r.w, r.plan, r.filter_size, r.n_col);
     }
 }
@@ -23,15 +23,26 @@
 #ifndef PARIS_FILTERING_H_
 #define PARIS_FILTERING_H_
 
+#include <cstdint>
+#include <vector>
+
 #include "backend.h"
+#include "filter_config.h"
 #include "geometry.h"
 #include "projection.h"
 
 namespace paris
 {
-    auto filter(backend::projection_device_type& p, const detector_geometry& det_geo)
-        noexcept(true && noexcept(backend::apply_filter))
+    // length of the zero-padded detector rows which are transformed
+    auto filter_length(const detector_geometry& det_geo) noexcept -> std::uint32_t;
+
+    // weights and filters the projection
+    auto filter(backend::projection_device_type& p, const detector_geometry& det_geo, const filter_config& cfg)
         -> void;
+
+    // weights and filters all projections in a single pass
+    auto filter(std::vector<backend::projection_device_type>& p, const detector_geometry& det_geo,
+                const filter_config& cfg) -> void;
 }
 
 #endif /* PARIS_FILTERING_H_ */
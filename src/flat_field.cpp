@@ -0,0 +1,190 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 15 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include <boost/log/trivial.hpp>
+
+#include "exception.h"
+#include "filesystem.h"
+#include "flat_field.h"
+#include "geometry.h"
+#include "reader.h"
+
+namespace paris
+{
+    namespace
+    {
+        // the lowest transmission, rays through (almost) opaque material don't become infinite
+        constexpr auto min_transmission = 1e-6f;
+
+        struct reference
+        {
+            std::vector<float> mean;
+            std::uint32_t width = 0u;
+            std::uint32_t height = 0u;
+        };
+
+        auto read_reference(const std::string& path) -> reference
+        {
+            auto paths = std::vector<std::string>{path};
+            struct stat st;
+            if(::stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+            {
+                paths = read_directory(path);
+                paths.erase(std::remove_if(std::begin(paths), std::end(paths), &reader::is_sidecar),
+                            std::end(paths));
+            }
+
+            auto ref = reference{};
+            auto sum = std::vector<double>{};
+            auto frames = 0u;
+            for(auto&& p : paths)
+            {
+                reader::load(p, [&](reader::image_type& img)
+                {
+                    if(frames == 0u)
+                    {
+                        ref.width = img.dim_x;
+                        ref.height = img.dim_y;
+                        sum.assign(static_cast<std::size_t>(img.dim_x) * img.dim_y, 0.);
+                    }
+                    else if(img.dim_x != ref.width || img.dim_y != ref.height)
+                    {
+                        BOOST_LOG_TRIVIAL(fatal) << "The reference frames at " << path << " differ in size";
+                        throw stage_construction_error{"read_flat_field() failed"};
+                    }
+
+                    auto src = img.buf.get();
+                    for(auto i = std::size_t{0u}; i < sum.size(); ++i)
+                        sum[i] += src[i];
+
+                    ++frames;
+                    return true;
+                }, row_window{0u, std::numeric_limits<std::uint32_t>::max()}, 1u);
+            }
+
+            if(frames == 0u)
+            {
+                BOOST_LOG_TRIVIAL(fatal) << "Could not read any reference frame at " << path;
+                throw stage_construction_error{"read_flat_field() failed"};
+            }
+
+            ref.mean.resize(sum.size());
+            std::transform(std::begin(sum), std::end(sum), std::begin(ref.mean),
+                           [frames](double s) { return static_cast<float>(s / frames); });
+
+            BOOST_LOG_TRIVIAL(info) << "Averaged " << frames << " reference frames from " << path;
+            return ref;
+        }
+    }
+
+    flat_field::flat_field(std::vector<float> dark, std::vector<float> flat, std::uint32_t width,
+                           std::uint32_t height)
+    : width_{width}, height_{height}, dark_{std::move(dark)}, gain_(flat.size())
+    {
+        if(dark_.empty())
+            dark_.assign(flat.size(), 0.f);
+
+        for(auto i = std::size_t{0u}; i < flat.size(); ++i)
+        {
+            const auto range = flat[i] - dark_[i];
+            if(range > 0.f && std::isfinite(range))
+                gain_[i] = 1.f / range;
+            else
+                bad_.push_back(i);
+        }
+
+        if(!bad_.empty())
+            BOOST_LOG_TRIVIAL(info) << "Masking " << bad_.size() << " bad detector pixels";
+    }
+
+    auto flat_field::apply(float* px, std::uint32_t first, std::uint32_t rows) const noexcept -> void
+    {
+        const auto n = static_cast<std::size_t>(width_) * rows;
+        const auto offset = static_cast<std::size_t>(first) * width_;
+        const auto dark = dark_.data() + offset;
+        const auto gain = gain_.data() + offset;
+
+        // bad pixels have no gain, they come out as 0 and are replaced below
+        for(auto i = std::size_t{0u}; i < n; ++i)
+            px[i] = -std::log(std::max((px[i] - dark[i]) * gain[i], min_transmission)) * (gain[i] > 0.f);
+
+        const auto bad_first = std::lower_bound(std::begin(bad_), std::end(bad_), offset);
+        const auto bad_last = std::lower_bound(bad_first, std::end(bad_), offset + n);
+        for(auto it = bad_first; it != bad_last; ++it)
+        {
+            const auto i = *it - offset;
+            const auto row = i - i % width_;
+
+            // the nearest good pixels to the left and to the right inside the row
+            auto sum = 0.f;
+            auto good = 0u;
+            for(auto l = i; l > row; --l)
+            {
+                if(gain[l - 1u] > 0.f)
+                {
+                    sum += px[l - 1u];
+                    ++good;
+                    break;
+                }
+            }
+            for(auto r = i + 1u; r < row + width_; ++r)
+            {
+                if(gain[r] > 0.f)
+                {
+                    sum += px[r];
+                    ++good;
+                    break;
+                }
+            }
+
+            px[i] = (good > 0u) ? sum / static_cast<float>(good) : 0.f;
+        }
+    }
+
+    auto read_flat_field(const std::string& dark_path, const std::string& flat_path) -> flat_field_ptr
+    {
+        auto flat = read_reference(flat_path);
+        auto dark = dark_path.empty() ? reference{} : read_reference(dark_path);
+        if(!dark_path.empty() && (dark.width != flat.width || dark.height != flat.height))
+        {
+            BOOST_LOG_TRIVIAL(fatal) << "The dark frames at " << dark_path << " don't match the flat frames at "
+                                     << flat_path;
+            throw stage_construction_error{"read_flat_field() failed"};
+        }
+
+        return std::make_shared<const flat_field>(std::move(dark.mean), std::move(flat.mean), flat.width,
+                                                  flat.height);
+    }
+}
@@ -0,0 +1,71 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 15 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+
+#ifndef PARIS_FLAT_FIELD_H_
+#define PARIS_FLAT_FIELD_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace paris
+{
+    /*
+     * Dark and flat-field correction of the raw detector counts I: every pixel becomes the line integral
+     * -log((I - D) / (F - D)), where D and F are the averages of the dark and flat reference frames. Pixels whose
+     * flat isn't brighter than their dark are bad and take the mean of their nearest good neighbours in the row.
+     * The readers apply it while decoding, before binning.
+     */
+    class flat_field
+    {
+        public:
+            // dark may be empty, then D = 0. The references are given in full detector frames of width x height
+            flat_field(std::vector<float> dark, std::vector<float> flat, std::uint32_t width, std::uint32_t height);
+
+            auto width() const noexcept -> std::uint32_t { return width_; }
+            auto height() const noexcept -> std::uint32_t { return height_; }
+
+            // corrects the rows [first, first + rows) of a frame in place, they must lie inside the references
+            auto apply(float* px, std::uint32_t first, std::uint32_t rows) const noexcept -> void;
+
+        private:
+            std::uint32_t width_;
+            std::uint32_t height_;
+            std::vector<float> dark_;
+            std::vector<float> gain_;           // 1 / (F - D), 0 for bad pixels
+            std::vector<std::size_t> bad_;      // sorted
+    };
+
+    // averaged once per run and shared read-only by all readers
+    using flat_field_ptr = std::shared_ptr<const flat_field>;
+
+    /*
+     * Averages all frames of the reference files -- or of all files in the directories -- at dark_path and
+     * flat_path. dark_path may be empty.
+     */
+    auto read_flat_field(const std::string& dark_path, const std::string& flat_path) -> flat_field_ptr;
+}
+
+#endif /* PARIS_FLAT_FIELD_H_ */
@@ -23,16 +23,20 @@
 #ifndef PARIS_GENERIC_BACKEND_H_
 #define PARIS_GENERIC_BACKEND_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include <fftw3.h>
 
 #include "../geometry.h"
+#include "../interpolation.h"
 #include "../projection.h"
 #include "../region_of_interest.h"
 #include "../subvolume_information.h"
+#include "../trajectory.h"
 #include "../volume.h"
 
 namespace paris
@@ -51,34 +55,118 @@ namespace paris
         using volume_host_type = volume<volume_host_buffer_type>;
         using volume_device_type = volume<volume_device_buffer_type>;
 
+        // up to bytes of released host buffers are kept for reuse
+        auto set_host_pool_size(std::size_t bytes) noexcept -> void;
+
         auto make_projection_host(std::uint32_t dim_x, std::uint32_t dim_y) -> projection_host_type;
         auto make_projection_device(std::uint32_t dim_x, std::uint32_t dim_y) -> projection_device_type;
 
         auto make_volume_host(std::uint32_t dim_x, std::uint32_t dim_y, std::uint32_t dim_z) -> volume_host_type;
         auto make_volume_device(std::uint32_t dim_x, std::uint32_t dim_y, std::uint32_t dim_z) -> volume_device_type;
 
+        // maps dim_z slices of the file fd starting at byte pos if the volume resides in host memory
+        constexpr auto maps_volumes = false;
+        auto map_volume(int fd, std::uint64_t pos, std::uint32_t dim_x, std::uint32_t dim_y, std::uint32_t dim_z)
+            -> volume_device_type;
+
         auto copy_h2d(const projection_host_type& h_p, projection_device_type& d_p) -> void;
         auto copy_d2h(const projection_device_type& d_p, projection_host_type& h_p) -> void;
 
+        // uploads the rows [first, first + d_p.dim_y) of h_p
+        auto copy_h2d(const projection_host_type& h_p, projection_device_type& d_p, std::uint32_t first) -> void;
+
+        // downloads the columns [first, first + h_p.dim_x) of d_p
+        auto copy_d2h(const projection_device_type& d_p, projection_host_type& h_p, std::uint32_t first) -> void;
+
         auto copy_h2d(const volume_host_type& h_v, volume_device_type& d_v) -> void;
         auto copy_d2h(const volume_device_type& d_v, volume_host_type& h_v) -> void;
+        // downloads the slices [first, first + h_v.dim_z) of d_v
+        auto copy_d2h(const volume_device_type& d_v, volume_host_type& h_v, std::uint32_t first) -> void;
 
-        auto make_subvolume_information(const volume_geometry& vol_geo, const detector_geometry& det_geo)
-            -> subvolume_info;
+        // splits the volume into as few subvolumes as fit into every device's memory budget next to the pipeline
+        auto make_subvolume_information(const volume_geometry& vol_geo, const detector_geometry& det_geo,
+                                        const memory_parameters& mem) -> subvolume_info;
 
-        auto weight(projection_device_type& p, float h_min, float v_min, float d_sd, float l_px_row, float l_px_col)
-            -> void;
+        // the weights only depend on the geometry, they are applied while expanding the projection for filtering
+        using weight_buffer_type = std::unique_ptr<float[]>;
+        auto make_weights(std::uint32_t dim_x, std::uint32_t dim_y, float h_min, float v_min, float d_sd,
+                          float l_px_row, float l_px_col) -> weight_buffer_type;
 
         struct fftw_deleter { auto operator()(void* p) noexcept -> void; };
         using filter_buffer_type = std::unique_ptr<float[], fftw_deleter>;
-        auto make_filter(std::uint32_t size, float tau) -> filter_buffer_type;
-        auto apply_filter(projection_device_type& p, const filter_buffer_type& k, std::uint32_t filter_size,
-                          std::uint32_t n_col) -> void;
+        auto make_filter(const std::vector<float>& response) -> filter_buffer_type;
+        struct filter_plan_type {};
+        auto make_filter_plan(std::uint32_t filter_size, std::uint32_t n_col, const std::string& wisdom_dir)
+            -> filter_plan_type;
+        auto apply_filter(projection_device_type& p, const filter_buffer_type& k, const weight_buffer_type& w,
+                          const filter_plan_type& plan, std::uint32_t filter_size, std::uint32_t n_col) -> void;
+        // filters all projections at once, small detectors keep the device busy this way
+        auto apply_filter(std::vector<projection_device_type>& p, const filter_buffer_type& k,
+                          const weight_buffer_type& w, const filter_plan_type& plan,
+                          std::uint32_t filter_size, std::uint32_t n_col) -> void;
+
+        // number of projections which can be backprojected in one pass over the volume
+        constexpr auto max_batch_size = std::uint32_t{32u};
 
-        auto backproject(const projection_device_type& p, volume_device_type& v, std::uint32_t v_offset,
+        /**
+         * Fused filtering -- there are no launches to save, the FFT is always faster on the host
+         * */
+        constexpr auto max_fused_width = std::uint32_t{0u};
+        auto apply_fused_filter(std::vector<projection_device_type>& p, const filter_buffer_type& taps,
+                                const weight_buffer_type& w, std::uint32_t n_col) -> void;
+        auto backproject(const std::vector<projection_device_type>& p, volume_device_type& v, std::uint32_t v_offset,
                          const detector_geometry& det_geo, const volume_geometry& vol_geo, 
                          bool enable_roi, const region_of_interest& roi,
-                         float sin, float cos, float delta_s, float delta_t) -> void;
+                         const std::vector<float>& sin, const std::vector<float>& cos,
+                         float delta_s, float delta_t) -> void;
+
+        // arbitrary trajectories: the projection matrix m[i] of every projection replaces the circular geometry
+        auto backproject(const std::vector<projection_device_type>& p, volume_device_type& v, std::uint32_t v_offset,
+                         const detector_geometry& det_geo, const volume_geometry& vol_geo,
+                         bool enable_roi, const region_of_interest& roi,
+                         const std::vector<projection_matrix>& m) -> void;
+
+        /**
+         * Interpolation -- the kernels always interpolate bilinearly in fp32, nothing to choose
+         * */
+        inline auto set_interpolation(interpolation) noexcept -> void {}
+
+        /**
+         * Iterative reconstruction -- the volume and the projections stay in device memory between iterations
+         * */
+        // adds the voxel-driven projection of v to p, the transpose of backproject() up to a constant factor
+        auto forward_project(const volume_device_type& v, std::uint32_t v_offset,
+                             std::vector<projection_device_type>& p,
+                             const detector_geometry& det_geo, const volume_geometry& vol_geo,
+                             const std::vector<float>& sin, const std::vector<float>& cos,
+                             float delta_s, float delta_t) -> void;
+        auto fill(projection_device_type& p, float value) -> void;
+        auto fill(volume_device_type& v, float value) -> void;
+        // replaces every value by its reciprocal, (almost) empty rays and voxels become 0
+        auto invert(projection_device_type& p) -> void;
+        auto invert(volume_device_type& v) -> void;
+        // ax = (b - ax) * w
+        auto residual(const projection_device_type& b, projection_device_type& ax, const projection_device_type& w)
+            -> void;
+        // x += lambda * c * corr, clamped to positive values if requested, then clears corr
+        auto update(volume_device_type& x, volume_device_type& corr, const volume_device_type& c, float lambda,
+                    bool nonnegative) -> void;
+
+        /**
+         * Pipelining -- projections are processed synchronously, nothing to do here
+         * */
+        inline auto set_pipeline_depth(std::uint32_t) noexcept -> void {}
+        inline auto synchronize(const projection_device_type&) noexcept -> void {}
+
+        /**
+         * Autotuning -- the kernels have a fixed schedule, nothing to tune
+         * */
+        inline auto set_tuning_dir(const std::string&) noexcept -> void {}
+
+        /**
+         * NUMA -- device memory is placed by the driver, nothing to bind
+         * */
+        inline auto enable_numa() noexcept -> bool { return false; }
 
         /**
          * Device management
@@ -86,6 +174,30 @@ namespace paris
         using device_handle = int;
         inline auto get_devices() -> std::vector<device_handle> { return std::vector<device_handle>{0}; }
         constexpr auto set_device(device_handle&) noexcept -> int { return 0; }
+
+        /**
+         * Peer-to-peer -- there is only one device, projections are never exchanged
+         * */
+        using projection_peer_type = projection_host_type;
+        inline auto enable_peer_access(const std::vector<device_handle>&) noexcept -> bool { return false; }
+        inline auto make_projection_peer(std::uint32_t dim_x, std::uint32_t dim_y) -> projection_peer_type
+        {
+            return make_projection_host(dim_x, dim_y);
+        }
+        inline auto copy_d2p(const projection_device_type& d_p, projection_peer_type& p, std::uint32_t first) -> void
+        {
+            copy_d2h(d_p, p, first);
+        }
+        inline auto copy_p2d(const projection_peer_type& p, projection_device_type& d_p, std::uint32_t first) -> void
+        {
+            copy_h2d(p, d_p, first);
+        }
+
+        /**
+         * Profiling -- there is no timeline tool to feed
+         * */
+        inline auto push_range(const char*) noexcept -> void {}
+        inline auto pop_range() noexcept -> void {}
     }
 }
 
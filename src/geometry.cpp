@@ -20,6 +20,7 @@
  * Authors: Jan Stephan <j.stephan@hzdr.de>
  */
 
+#include <algorithm>
 #include <cstdint>
 #include <cmath>
 #include <iomanip>
@@ -46,6 +47,23 @@ namespace paris
             const auto l_px_col = det_geo.l_px_col;
             const auto delta_t = std::abs(det_geo.delta_t * l_px_col);
 
+            /* Without magnification a voxel is as large as a pixel and the volume covers the detector */
+            if(det_geo.beam == beam_geometry::parallel)
+            {
+                const auto r = ((n_row * l_px_row) / 2.f) + delta_s;
+
+                vol_geo.l_vx_x = l_px_row;
+                vol_geo.l_vx_y = vol_geo.l_vx_x;
+
+                vol_geo.dim_x = static_cast<std::uint32_t>((2.f * r) / vol_geo.l_vx_x);
+                vol_geo.dim_y = vol_geo.dim_x;
+
+                vol_geo.l_vx_z = vol_geo.l_vx_x;
+                vol_geo.dim_z = static_cast<std::uint32_t>(((n_col * l_px_col / 2.f) + delta_t) * (2.f / vol_geo.l_vx_z));
+
+                return vol_geo;
+            }
+
             const auto d_so = std::abs(det_geo.d_so);
             const auto d_sd = std::abs(det_geo.d_od) + d_so;
 
@@ -66,6 +84,53 @@ namespace paris
             return vol_geo;
         }
 
+        // distance of the voxel edge e to the rotation axis
+        auto edge_distance(std::uint32_t e, std::uint32_t dim, float size) noexcept -> float
+        {
+            return std::abs(static_cast<float>(e) * size - static_cast<float>(dim) * size / 2.f);
+        }
+
+        // every reconstructed voxel lies within this distance of the rotation axis
+        auto axis_distance(const volume_geometry& vol_geo, bool enable_roi, const region_of_interest& roi) noexcept
+        -> float
+        {
+            auto x_first = 0u;
+            auto x_last = vol_geo.dim_x;
+            auto y_first = 0u;
+            auto y_last = vol_geo.dim_y;
+            if(enable_roi)
+            {
+                // see apply_roi() for the extents
+                x_first = roi.x1;
+                x_last = std::min(roi.x2 + (roi.x1 == 0u ? 1u : 0u), vol_geo.dim_x);
+                y_first = roi.y1;
+                y_last = std::min(roi.y2 + (roi.y1 == 0u ? 1u : 0u), vol_geo.dim_y);
+            }
+
+            const auto x = std::max(edge_distance(x_first, vol_geo.dim_x, vol_geo.l_vx_x),
+                                    edge_distance(x_last, vol_geo.dim_x, vol_geo.l_vx_x));
+            const auto y = std::max(edge_distance(y_first, vol_geo.dim_y, vol_geo.l_vx_y),
+                                    edge_distance(y_last, vol_geo.dim_y, vol_geo.l_vx_y));
+            return std::sqrt(x * x + y * y);
+        }
+
+        // pixels [first, last] containing the detector interval [c_min, c_max] plus one for the interpolation
+        auto pixel_range(float c_min, float c_max, std::uint32_t dim, float size, float offset, std::uint32_t& first,
+                         std::uint32_t& num) noexcept -> bool
+        {
+            // same mapping from detector to pixel coordinates as in the backprojection
+            const auto dim_f = static_cast<float>(dim);
+            const auto off = dim_f / 2.f + offset - 0.5f;
+
+            const auto lo = std::max(std::floor(c_min / size + off) - 1.f, 0.f);
+            const auto hi = std::min(std::ceil(c_max / size + off) + 1.f, dim_f - 1.f);
+            if(hi <= lo)
+                return false;
+
+            first = static_cast<std::uint32_t>(lo);
+            num = static_cast<std::uint32_t>(hi - lo) + 1u;
+            return true;
+        }
     }
 
     auto calculate_volume_geometry(const detector_geometry& det_geo) noexcept -> volume_geometry
@@ -83,6 +148,29 @@ namespace paris
         return vol_geo;
     }
 
+    auto bin_detector(const detector_geometry& det_geo, std::uint32_t factor) noexcept -> detector_geometry
+    {
+        auto binned = det_geo;
+        if(factor <= 1u)
+            return binned;
+
+        const auto b = static_cast<float>(factor);
+        binned.n_row = det_geo.n_row / factor;
+        binned.n_col = det_geo.n_col / factor;
+        binned.l_px_row = det_geo.l_px_row * b;
+        binned.l_px_col = det_geo.l_px_col * b;
+
+        // the first pixel keeps its position, dropping pixels at the far border moves the detector's center
+        const auto crop_s = static_cast<float>(det_geo.n_row - binned.n_row * factor);
+        const auto crop_t = static_cast<float>(det_geo.n_col - binned.n_col * factor);
+        binned.delta_s = (det_geo.delta_s + crop_s / 2.f) / b;
+        binned.delta_t = (det_geo.delta_t + crop_t / 2.f) / b;
+
+        BOOST_LOG_TRIVIAL(info) << "Binned detector by " << factor << " x " << factor << ": "
+                                << binned.n_row << " x " << binned.n_col << " pixels";
+        return binned;
+    }
+
     auto apply_roi(const volume_geometry& vol_geo,
                     std::uint32_t x1, std::uint32_t x2,
                     std::uint32_t y1, std::uint32_t y2,
@@ -128,6 +216,75 @@ namespace paris
 
         return roi_geo;
     }
-}
 
+    auto calculate_row_window(const detector_geometry& det_geo, const volume_geometry& vol_geo,
+                              bool enable_roi, const region_of_interest& roi,
+                              std::uint32_t z_first, std::uint32_t z_num) noexcept -> row_window
+    {
+        auto window = row_window{0u, det_geo.n_col};
+
+        const auto d_so = std::abs(det_geo.d_so);
+        const auto d_sd = std::abs(det_geo.d_od) + d_so;
+
+        // outer borders of the first and last slice
+        const auto z_min = -(static_cast<float>(vol_geo.dim_z) * vol_geo.l_vx_z / 2.f)
+                           + static_cast<float>(z_first) * vol_geo.l_vx_z;
+        const auto z_max = z_min + static_cast<float>(z_num) * vol_geo.l_vx_z;
+
+        auto first = 0u;
+        auto rows = 0u;
+
+        // fan and parallel beams map every slice to a fixed detector row
+        if(det_geo.beam != beam_geometry::cone)
+        {
+            const auto mag = (det_geo.beam == beam_geometry::fan) ? d_sd / d_so : 1.f;
+            if(pixel_range(z_min * mag, z_max * mag, det_geo.n_col, det_geo.l_px_col, det_geo.delta_t, first, rows))
+                window = row_window{first, rows};
+            return window;
+        }
+
+        const auto r = axis_distance(vol_geo, enable_roi, roi);
+        if(r >= d_so)
+            return window;
+
+        // the magnification depends on the voxel's distance to the source
+        const auto mag_min = d_sd / (d_so + r);
+        const auto mag_max = d_sd / (d_so - r);
+
+        const auto v_min = std::min(z_min * mag_min, z_min * mag_max);
+        const auto v_max = std::max(z_max * mag_min, z_max * mag_max);
 
+        if(pixel_range(v_min, v_max, det_geo.n_col, det_geo.l_px_col, det_geo.delta_t, first, rows))
+            window = row_window{first, rows};
+        return window;
+    }
+
+    auto calculate_column_window(const detector_geometry& det_geo, const volume_geometry& vol_geo,
+                                 bool enable_roi, const region_of_interest& roi) noexcept -> column_window
+    {
+        auto window = column_window{0u, det_geo.n_row};
+
+        const auto d_so = std::abs(det_geo.d_so);
+        const auto d_sd = std::abs(det_geo.d_od) + d_so;
+
+        const auto r = axis_distance(vol_geo, enable_roi, roi);
+        if(det_geo.beam != beam_geometry::parallel && r >= d_so)
+            return window;
+
+        // at some angle the farthest voxel lies at |t| = r, as close to the source as possible
+        const auto h = (det_geo.beam == beam_geometry::parallel) ? r : r * d_sd / (d_so - r);
+
+        auto first = 0u;
+        auto cols = 0u;
+        if(pixel_range(-h, h, det_geo.n_row, det_geo.l_px_row, det_geo.delta_s, first, cols))
+            window = column_window{first, cols};
+        return window;
+    }
+
+    auto merge(const row_window& a, const row_window& b) noexcept -> row_window
+    {
+        const auto first = std::min(a.first, b.first);
+        const auto last = std::max(a.first + a.rows, b.first + b.rows);
+        return row_window{first, last - first};
+    }
+}
@@ -25,8 +25,22 @@
 
 #include <cstdint>
 
+#include "region_of_interest.h"
+
 namespace paris
 {
+    /*
+     * cone:     point source, divergent in both directions (FDK)
+     * fan:      divergent within a slice, every slice maps to the same detector row at all angles
+     * parallel: synchrotron-like, no divergence at all -- d_so and d_od are ignored
+     */
+    enum class beam_geometry : std::uint32_t
+    {
+        cone,
+        fan,
+        parallel
+    };
+
     struct detector_geometry
     {
         // Detector
@@ -43,6 +57,8 @@ namespace paris
 
         // Rotation
         float delta_phi;        // difference between two successive angles - ignored if there is an angle file
+
+        beam_geometry beam;     // value-initialised to cone
     };
 
     struct volume_geometry
@@ -68,11 +84,40 @@ namespace paris
         std::uint32_t remainder;
     };
 
+    // a band of detector rows
+    struct row_window
+    {
+        std::uint32_t first;    // first detector row
+        std::uint32_t rows;     // number of rows
+    };
+
+    // a band of detector columns
+    struct column_window
+    {
+        std::uint32_t first;    // first detector column
+        std::uint32_t cols;     // number of columns
+    };
+
     auto calculate_volume_geometry(const detector_geometry& det_geo) noexcept -> volume_geometry;
 
+    // the detector after binning factor x factor pixels, incomplete blocks at the borders are dropped
+    auto bin_detector(const detector_geometry& det_geo, std::uint32_t factor) noexcept -> detector_geometry;
+
     auto apply_roi(const volume_geometry& vol_geo, std::uint32_t roi_x1, std::uint32_t roi_x2,
                                                     std::uint32_t roi_y1, std::uint32_t roi_y2,
                                                     std::uint32_t roi_z1, std::uint32_t roi_z2) noexcept -> volume_geometry;
+
+    // the detector rows hit by the slices [z_first, z_first + z_num) of the (full) volume at any angle
+    auto calculate_row_window(const detector_geometry& det_geo, const volume_geometry& vol_geo,
+                              bool enable_roi, const region_of_interest& roi,
+                              std::uint32_t z_first, std::uint32_t z_num) noexcept -> row_window;
+
+    // the detector columns hit by the (ROI of the) volume at any angle
+    auto calculate_column_window(const detector_geometry& det_geo, const volume_geometry& vol_geo,
+                                 bool enable_roi, const region_of_interest& roi) noexcept -> column_window;
+
+    // the smallest window containing both a and b
+    auto merge(const row_window& a, const row_window& b) noexcept -> row_window;
 }
 
 #endif /* PARIS_GEOMETRY_H_ */
@@ -0,0 +1,250 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 15 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef PARIS_ENABLE_HDF5
+#include <hdf5.h>
+#endif
+
+#include <boost/log/trivial.hpp>
+
+#include "geometry.h"
+#include "hdf5_reader.h"
+#include "metrics.h"
+#include "reader.h"
+
+namespace paris
+{
+    namespace hdf5
+    {
+#ifdef PARIS_ENABLE_HDF5
+        namespace
+        {
+            // the HDF5 library is not necessarily built thread-safe and the I/O threads share it
+            std::mutex hdf5_mutex;
+
+            // closes an HDF5 identifier on destruction
+            class handle
+            {
+                public:
+                    handle(hid_t id, herr_t (*close)(hid_t)) noexcept : id_{id}, close_{close} {}
+                    ~handle() { if(id_ >= 0) close_(id_); }
+
+                    handle(const handle&) = delete;
+                    auto operator=(const handle&) -> handle& = delete;
+
+                    auto get() const noexcept -> hid_t { return id_; }
+                    auto valid() const noexcept -> bool { return id_ >= 0; }
+
+                private:
+                    hid_t id_;
+                    herr_t (*close_)(hid_t);
+            };
+
+            constexpr const char* dataset_names[] = {"/exchange/data", "/entry/data/data",
+                                                     "/entry/instrument/detector/data"};
+
+            auto find_dataset(hid_t file, const std::string& path) -> std::string
+            {
+                for(auto&& name : dataset_names)
+                {
+                    // H5Lexists fails if a parent group is missing, so walk down the path
+                    auto exists = true;
+                    auto prefix = std::string{};
+                    auto full = std::string{name};
+                    for(auto pos = full.find('/', 1u); exists; pos = full.find('/', pos + 1u))
+                    {
+                        prefix = full.substr(0u, pos);
+                        exists = H5Lexists(file, prefix.c_str(), H5P_DEFAULT) > 0;
+                        if(pos == std::string::npos)
+                            break;
+                    }
+
+                    if(exists && H5Oexists_by_name(file, name, H5P_DEFAULT) > 0)
+                        return name;
+                }
+
+                // otherwise take the first dataset that looks like an image or a stack of them
+                auto found = std::string{};
+#if H5_VERSION_GE(1, 12, 0)
+                using info_type = H5O_info2_t;
+#else
+                using info_type = H5O_info_t;
+#endif
+                auto visit = [](hid_t obj, const char* name, const info_type* info, void* data) -> herr_t
+                {
+                    if(info->type != H5O_TYPE_DATASET)
+                        return 0;
+
+                    auto&& set = handle{H5Dopen2(obj, name, H5P_DEFAULT), &H5Dclose};
+                    auto&& space = handle{H5Dget_space(set.get()), &H5Sclose};
+                    auto rank = H5Sget_simple_extent_ndims(space.get());
+                    if(rank != 2 && rank != 3)
+                        return 0;
+
+                    *static_cast<std::string*>(data) = std::string{"/"} + name;
+                    return 1;
+                };
+
+#if H5_VERSION_GE(1, 12, 0)
+                H5Ovisit3(file, H5_INDEX_NAME, H5_ITER_NATIVE, visit, &found, H5O_INFO_BASIC);
+#else
+                H5Ovisit(file, H5_INDEX_NAME, H5_ITER_NATIVE, visit, &found);
+#endif
+                if(found.empty())
+                    BOOST_LOG_TRIVIAL(warning) << "hdf5::load() found no projection dataset in " << path;
+
+                return found;
+            }
+        }
+
+        auto load(const std::string& path, const reader::consumer_type& f, const row_window& window,
+                  std::uint32_t binning, const flat_field* correction) -> std::uint32_t
+        {
+            auto lock = std::unique_lock<std::mutex>{hdf5_mutex};
+
+            // HDF5 prints its error stack on stderr, we log our own
+            H5Eset_auto2(H5E_DEFAULT, nullptr, nullptr);
+
+#if H5_VERSION_GE(1, 12, 0)
+            if(H5Fis_accessible(path.c_str(), H5P_DEFAULT) <= 0)
+#else
+            if(H5Fis_hdf5(path.c_str()) <= 0)
+#endif
+            {
+                BOOST_LOG_TRIVIAL(warning) << "hdf5::load() could not open non-HDF5 file at " << path;
+                return 0u;
+            }
+
+            auto&& file = handle{H5Fopen(path.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT), &H5Fclose};
+            if(!file.valid())
+            {
+                BOOST_LOG_TRIVIAL(warning) << "hdf5::load() could not open " << path;
+                return 0u;
+            }
+
+            auto name = find_dataset(file.get(), path);
+            if(name.empty())
+                return 0u;
+
+            auto file_size = hsize_t{0u};
+            if(H5Fget_filesize(file.get(), &file_size) >= 0)
+                metrics::count_bytes_read(static_cast<std::uint64_t>(file_size));
+
+            // find the layout first, the chunk cache is a property of the opened dataset
+            auto&& probe = handle{H5Dopen2(file.get(), name.c_str(), H5P_DEFAULT), &H5Dclose};
+            auto&& space = handle{H5Dget_space(probe.get()), &H5Sclose};
+            auto rank = H5Sget_simple_extent_ndims(space.get());
+            if(rank != 2 && rank != 3)
+            {
+                BOOST_LOG_TRIVIAL(warning) << "hdf5::load() expected a 2- or 3-dimensional dataset at " << name
+                                           << " in " << path;
+                return 0u;
+            }
+
+            hsize_t dims[3] = {1u, 1u, 1u};
+            H5Sget_simple_extent_dims(space.get(), dims + (3 - rank), nullptr);
+            const auto count = dims[0];
+            const auto height = static_cast<std::uint32_t>(dims[1]);
+            const auto width = static_cast<std::uint32_t>(dims[2]);
+
+            auto b = std::max(binning, 1u);
+            auto rows = reader::unbin(window, b, height);
+
+            auto&& dapl = handle{H5Pcreate(H5P_DATASET_ACCESS), &H5Pclose};
+            auto&& dcpl = handle{H5Dget_create_plist(probe.get()), &H5Pclose};
+            if(H5Pget_layout(dcpl.get()) == H5D_CHUNKED)
+            {
+                // keep every chunk of one band so that chunks spanning several frames are decompressed only once
+                hsize_t chunk[3] = {1u, 1u, 1u};
+                H5Pget_chunk(dcpl.get(), rank, chunk + (3 - rank));
+
+                auto&& type = handle{H5Dget_type(probe.get()), &H5Tclose};
+                const auto chunk_bytes = chunk[0] * chunk[1] * chunk[2] * H5Tget_size(type.get());
+                const auto chunks = ((rows.first + rows.rows + chunk[1] - 1u) / chunk[1] - rows.first / chunk[1]) *
+                                    ((width + chunk[2] - 1u) / chunk[2]);
+                const auto bytes = std::min<hsize_t>(chunks * chunk_bytes, hsize_t{1u} << 30);
+                H5Pset_chunk_cache(dapl.get(), static_cast<std::size_t>(std::max<hsize_t>(chunks * 101u, 521u)),
+                                   static_cast<std::size_t>(bytes), 1.);
+            }
+
+            auto&& set = handle{H5Dopen2(file.get(), name.c_str(), dapl.get()), &H5Dclose};
+            auto&& file_space = handle{H5Dget_space(set.get()), &H5Sclose};
+
+            auto scratch = std::vector<float>{};
+            auto frames = 0u;
+            for(auto i = hsize_t{0u}; i < count; ++i)
+            {
+                // HDF5 converts the stored type to float while reading, the chunk cache holds the whole band
+                auto ok = true;
+                auto img = reader::decode_frame(width, rows, b, scratch, correction,
+                                                [&](float* dest, std::uint32_t first, std::uint32_t rows_in_block)
+                {
+                    if(!ok)
+                        return;
+
+                    hsize_t start[3] = {i, rows.first + first, 0u};
+                    hsize_t block[3] = {1u, rows_in_block, width};
+                    H5Sselect_hyperslab(file_space.get(), H5S_SELECT_SET, start + (3 - rank), nullptr,
+                                        block + (3 - rank), nullptr);
+
+                    hsize_t mem_dims[1] = {static_cast<hsize_t>(width) * rows_in_block};
+                    auto&& mem_space = handle{H5Screate_simple(1, mem_dims, nullptr), &H5Sclose};
+                    ok = H5Dread(set.get(), H5T_NATIVE_FLOAT, mem_space.get(), file_space.get(), H5P_DEFAULT,
+                                 dest) >= 0;
+                });
+
+                if(!ok)
+                {
+                    BOOST_LOG_TRIVIAL(warning) << "hdf5::load() could not read frame " << i << " of " << name
+                                               << " in " << path;
+                    break;
+                }
+
+                // the consumer may block on a full queue, don't hold up the other readers meanwhile
+                lock.unlock();
+                ++frames;
+                auto more = f(img);
+                lock.lock();
+
+                if(!more)
+                    break;
+            }
+            return frames;
+        }
+#else
+        auto load(const std::string& path, const reader::consumer_type&, const row_window&, std::uint32_t,
+                  const flat_field*) -> std::uint32_t
+        {
+            BOOST_LOG_TRIVIAL(fatal) << "Cannot read " << path;
+            throw std::runtime_error{"hdf5::load(): compiled without support for HDF5 projections"};
+        }
+#endif
+    }
+}
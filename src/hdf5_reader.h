@@ -0,0 +1,49 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 15 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#ifndef PARIS_HDF5_READER_H_
+#define PARIS_HDF5_READER_H_
+
+#include <cstdint>
+#include <string>
+
+#include "flat_field.h"
+#include "geometry.h"
+#include "reader.h"
+
+namespace paris
+{
+    namespace hdf5
+    {
+        /*
+         * Reads the projections from the first dataset found at /exchange/data (Data Exchange),
+         * /entry/data/data or /entry/instrument/detector/data (NeXus), falling back to the first 2- or 3-dimensional
+         * dataset in the file. 3-dimensional datasets are indexed [frame][row][column]. Every frame is read as a
+         * hyperslab of the requested rows and converted to float by the HDF5 library; the chunk cache is sized to
+         * hold the chunks of one such band.
+         */
+        auto load(const std::string& path, const reader::consumer_type& f, const row_window& window,
+                  std::uint32_t binning, const flat_field* correction = nullptr) -> std::uint32_t;
+    }
+}
+
+#endif /* PARIS_HDF5_READER_H_ */
@@ -24,18 +24,28 @@
 #include <cerrno>
 #include <cstddef>
 #include <cstdint>
-#include <fstream>
-#include <memory>
+#include <cstring>
+#include <functional>
+#include <limits>
 #include <string>
 #include <system_error>
 #include <utility>
 #include <vector>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <boost/log/trivial.hpp>
 
 #include "backend.h"
+#include "flat_field.h"
+#include "geometry.h"
 #include "his.h"
+#include "metrics.h"
 #include "projection.h"
+#include "reader.h"
 
 namespace paris
 {
@@ -76,126 +86,249 @@ namespace paris
                 type_float              = 128
             };
 
-            template <typename U>
-            auto read_entry(std::ifstream& file, U& entry) -> void
+            // read-only mapping of a whole file, unmapped on destruction
+            class mapped_file
             {
-                using char_type = typename std::ifstream::char_type;
-                file.read(reinterpret_cast<char_type*>(&entry), sizeof(entry));
-            }
+                public:
+                    explicit mapped_file(const std::string& path)
+                    : fd_{::open(path.c_str(), O_RDONLY)}, ptr_{nullptr}, size_{0u}
+                    {
+                        if(fd_ == -1)
+                            throw std::system_error{errno, std::generic_category()};
+
+                        auto st = stat_type{};
+                        if(::fstat(fd_, &st) == -1)
+                        {
+                            auto err = errno;
+                            ::close(fd_);
+                            throw std::system_error{err, std::generic_category()};
+                        }
+                        // directories and other non-regular entries are left unmapped and rejected as too small
+                        if(!S_ISREG(st.st_mode))
+                            return;
+
+                        size_ = static_cast<std::size_t>(st.st_size);
+                        if(size_ == 0u)
+                            return;
+
+                        auto ptr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+                        if(ptr == MAP_FAILED)
+                        {
+                            auto err = errno;
+                            ::close(fd_);
+                            throw std::system_error{err, std::generic_category()};
+                        }
+                        ptr_ = static_cast<const std::uint8_t*>(ptr);
+                        ::madvise(ptr, size_, MADV_SEQUENTIAL);
+                    }
+
+                    ~mapped_file()
+                    {
+                        if(ptr_ != nullptr)
+                            ::munmap(const_cast<std::uint8_t*>(ptr_), size_);
+                        ::close(fd_);
+                    }
+
+                    mapped_file(const mapped_file&) = delete;
+                    auto operator=(const mapped_file&) -> mapped_file& = delete;
+
+                    auto data() const noexcept -> const std::uint8_t* { return ptr_; }
+                    auto size() const noexcept -> std::size_t { return size_; }
+
+                    /*
+                     * Starts reading the whole file ahead. Deferred until the header was checked so that non-HIS
+                     * files only cost the page holding their header.
+                     */
+                    auto will_need() const noexcept -> void
+                    {
+                        if(ptr_ != nullptr)
+                            ::madvise(const_cast<std::uint8_t*>(ptr_), size_, MADV_WILLNEED);
+                    }
+
+                    // tell the kernel that we don't need the pages in [0, end) anymore
+                    auto release(std::size_t end) const noexcept -> void
+                    {
+                        static const auto page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+                        auto len = (end / page_size) * page_size;
+                        if(ptr_ != nullptr && len > 0u)
+                            ::madvise(const_cast<std::uint8_t*>(ptr_), len, MADV_DONTNEED);
+                    }
+
+                private:
+                    using stat_type = struct ::stat;
+
+                    int fd_;
+                    const std::uint8_t* ptr_;
+                    std::size_t size_;
+            };
 
             template <typename U>
-            auto read_entry(std::ifstream& file, U* entry, std::streamsize size) -> void
+            auto read_entry(const std::uint8_t*& pos, U& entry) noexcept -> void
             {
-                using char_type = typename std::ifstream::char_type;
-                file.read(reinterpret_cast<char_type*>(entry), size);
+                std::memcpy(&entry, pos, sizeof(entry));
+                pos += sizeof(entry);
             }
 
-            template <typename T>
-            auto copy_to_buf(std::ifstream& file, float* dest, std::uint16_t w, std::uint16_t h) -> void
+            auto pixel_size(std::uint16_t number_type) noexcept -> std::size_t
             {
-                auto w_s = static_cast<std::size_t>(w);
-                auto h_s = static_cast<std::size_t>(h);
-                auto size = static_cast<std::streamsize>(w_s * h_s * sizeof(T));
-                auto buffer = std::unique_ptr<T[]>{new T[w_s * h_s]};
-                read_entry(file, buffer.get(), size);
-                std::copy(buffer.get(), buffer.get() + (w_s * h_s), dest);
+                using num_type = decltype(his_header::number_type);
+                switch(number_type)
+                {
+                    case static_cast<num_type>(data::type_uchar):   return sizeof(std::uint8_t);
+                    case static_cast<num_type>(data::type_ushort):  return sizeof(std::uint16_t);
+                    case static_cast<num_type>(data::type_dword):   return sizeof(std::uint32_t);
+                    case static_cast<num_type>(data::type_double):  return sizeof(double);
+                    case static_cast<num_type>(data::type_float):   return sizeof(float);
+                    default:                                        return 0u;
+                }
             }
         }
 
-        auto load(const std::string& path) -> std::vector<image_type>
+        auto load(const std::string& path, const std::function<bool(image_type&)>& f) -> std::uint32_t
         {
-            auto vec = std::vector<image_type>{};
+            return load(path, f, row_window{0u, std::numeric_limits<std::uint32_t>::max()}, 1u);
+        }
 
-            auto header = his_header{};
+        auto load(const std::string& path, const std::function<bool(image_type&)>& f, const row_window& window,
+                  std::uint32_t binning, const flat_field* correction) -> std::uint32_t
+        {
+            auto&& file = mapped_file{path};
 
-            auto&& file = std::ifstream{path.c_str(), std::ios_base::binary};
-            if(!file.is_open())
+            if(file.size() < static_cast<std::size_t>(file_header_size))
             {
-                BOOST_LOG_TRIVIAL(warning) << "his_loader::load() failed to open file at " << path;
-                throw std::system_error{errno, std::generic_category()};
+                BOOST_LOG_TRIVIAL(warning) << "his_loader::load() could not open non-HIS file at " << path;
+                return 0u;
             }
 
-            read_entry(file, header.file_type);
-            read_entry(file, header.header_size);
-            read_entry(file, header.header_version);
-            read_entry(file, header.file_size);
-            read_entry(file, header.image_header_size);
-            read_entry(file, header.ulx);
-            read_entry(file, header.uly);
-            read_entry(file, header.brx);
-            read_entry(file, header.bry);
-            read_entry(file, header.frame_number);
-            read_entry(file, header.correction);
-            read_entry(file, header.integration_time);
-            read_entry(file, header.number_type);
-            read_entry(file, header.x);
+            // parse the header in place
+            auto header = his_header{};
+            auto pos = file.data();
+            read_entry(pos, header.file_type);
+            read_entry(pos, header.header_size);
+            read_entry(pos, header.header_version);
+            read_entry(pos, header.file_size);
+            read_entry(pos, header.image_header_size);
+            read_entry(pos, header.ulx);
+            read_entry(pos, header.uly);
+            read_entry(pos, header.brx);
+            read_entry(pos, header.bry);
+            read_entry(pos, header.frame_number);
+            read_entry(pos, header.correction);
+            read_entry(pos, header.integration_time);
+            read_entry(pos, header.number_type);
+            read_entry(pos, header.x);
 
             if(header.file_type != file_id)
             {
                 BOOST_LOG_TRIVIAL(warning) << "his_loader::load() could not open non-HIS file at " << path;
-                return vec;
+                return 0u;
             }
             if(header.header_size != file_header_size)
             {
                 BOOST_LOG_TRIVIAL(warning) << "his_loader::load() encountered a file header size mismatch at " << path;
-                return vec;
+                return 0u;
             }
             if(header.number_type == static_cast<std::uint16_t>(data::type_not_implemented))
             {
                 BOOST_LOG_TRIVIAL(warning) << "his_loader::load() encountered an unsupported data type at " << path;
-                return vec;
+                return 0u;
+            }
+
+            auto px_size = pixel_size(header.number_type);
+            if(px_size == 0u)
+            {
+                BOOST_LOG_TRIVIAL(warning) << "his_loader::load() tried to load an unsupported data type.";
+                return 0u;
             }
 
+            // the acquisition software may have corrected the frames already, our references would apply twice
+            constexpr auto offset_gain = std::uint16_t{0x3u};
+            if(correction != nullptr && (header.correction & offset_gain) != 0u)
+                BOOST_LOG_TRIVIAL(warning) << "his_loader::load() applies the dark and flat frames to the already "
+                                           << "offset/gain corrected frames at " << path;
+
+            // we are going to walk through the file exactly once
+            file.will_need();
+            metrics::count_bytes_read(file.size());
+
             auto x1 = static_cast<std::uint32_t>(header.ulx);
             auto x2 = static_cast<std::uint32_t>(header.brx);
             auto y1 = static_cast<std::uint32_t>(header.uly);
             auto y2 = static_cast<std::uint32_t>(header.bry);
             auto width = x2 - x1 + 1u;
             auto height = y2 - y1 + 1u;
+
+            auto frame_size = static_cast<std::size_t>(width) * static_cast<std::size_t>(height) * px_size;
+
+            // only the requested rows are converted -- the window is given in binned rows
+            auto b = std::max(binning, 1u);
+            auto rows = reader::unbin(window, b, height);
+            auto band_offset = static_cast<std::size_t>(rows.first) * static_cast<std::size_t>(width) * px_size;
+            auto offset = static_cast<std::size_t>(file_header_size);
+
+            auto scratch = std::vector<float>{};
+            auto frames = 0u;
             for(auto i = 0u; i < header.frame_number; ++i)
             {
                 // skip image header
-                auto img_header = std::unique_ptr<std::uint8_t[]>{new std::uint8_t[header.image_header_size]};
-                read_entry(file, img_header.get(), header.image_header_size);
+                offset += header.image_header_size;
 
-                auto img = backend::make_projection_host(width, height);
+                if(offset + frame_size > file.size())
+                {
+                    BOOST_LOG_TRIVIAL(warning) << "his_loader::load() encountered a truncated frame at " << path;
+                    break;
+                }
 
-                auto w16 = static_cast<std::uint16_t>(width);
-                auto h16 = static_cast<std::uint16_t>(height);
-                using num_type = decltype(header.number_type);
-                switch(header.number_type)
+                auto src = file.data() + offset + band_offset;
+                auto img = reader::decode_frame(width, rows, b, scratch, correction,
+                                                [&header, src, width, px_size](float* dest, std::uint32_t first,
+                                                                               std::uint32_t count)
                 {
-                    case static_cast<num_type>(data::type_uchar):
-                        copy_to_buf<std::uint8_t>(file, img.buf.get(), w16, h16);
-                        break;
+                    const auto block_src = src + static_cast<std::size_t>(first) * width * px_size;
+                    const auto n = static_cast<std::size_t>(width) * count;
+                    using num_type = decltype(header.number_type);
+                    switch(header.number_type)
+                    {
+                        case static_cast<num_type>(data::type_uchar):
+                            reader::convert<std::uint8_t>(block_src, dest, n);
+                            break;
 
-                    case static_cast<num_type>(data::type_ushort):
-                        copy_to_buf<std::uint16_t>(file, img.buf.get(), w16, h16);
-                        break;
+                        case static_cast<num_type>(data::type_ushort):
+                            reader::convert<std::uint16_t>(block_src, dest, n);
+                            break;
 
-                    case static_cast<num_type>(data::type_dword):
-                        copy_to_buf<std::uint32_t>(file, img.buf.get(), w16, h16);
-                        break;
+                        case static_cast<num_type>(data::type_dword):
+                            reader::convert<std::uint32_t>(block_src, dest, n);
+                            break;
 
-                    case static_cast<num_type>(data::type_double):
-                        copy_to_buf<double>(file, img.buf.get(), w16, h16);
-                        break;
+                        case static_cast<num_type>(data::type_double):
+                            reader::convert<double>(block_src, dest, n);
+                            break;
 
-                    case static_cast<num_type>(data::type_float):
-                        copy_to_buf<float>(file, img.buf.get(), w16, h16);
-                        break;
+                        case static_cast<num_type>(data::type_float):
+                            reader::convert<float>(block_src, dest, n);
+                            break;
 
-                    default:
-                        BOOST_LOG_TRIVIAL(warning) << "his_loader::load() tried to load an unsupported data type.";
-                        return vec;
-                }
+                        default:
+                            break;
+                    }
+                });
 
-                img.dim_x = static_cast<std::uint32_t>(width);
-                img.dim_y = static_cast<std::uint32_t>(height);
-                vec.push_back(std::move(img));
+                offset += frame_size;
+                file.release(offset);
+
+                ++frames;
+                if(!f(img))
+                    break;
             }
+            return frames;
+        }
+
+        auto load(const std::string& path) -> std::vector<image_type>
+        {
+            auto vec = std::vector<image_type>{};
+            load(path, [&vec](image_type& img) { vec.push_back(std::move(img)); return true; });
             return vec;
         }
     }
 }
-
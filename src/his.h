@@ -23,11 +23,15 @@
 #ifndef PARIS_HIS_LOADER_H_
 #define PARIS_HIS_LOADER_H_
 
+#include <cstdint>
+#include <functional>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "backend.h"
+#include "flat_field.h"
+#include "geometry.h"
 #include "projection.h"
 
 namespace paris
@@ -35,6 +39,19 @@ namespace paris
     namespace his
     {
         using image_type = backend::projection_host_type;
+
+        /*
+         * Decodes the file frame by frame and hands every frame to f. Decoding stops early if f returns false.
+         * Returns the number of decoded frames -- 0 means the file is not a valid HIS file.
+         */
+        auto load(const std::string& path, const std::function<bool(image_type&)>& f) -> std::uint32_t;
+
+        /*
+         * As above, but the frames are binned by b x b pixels and only the (binned) detector rows inside window are
+         * read. A correction is applied to the raw counts before binning.
+         */
+        auto load(const std::string& path, const std::function<bool(image_type&)>& f, const row_window& window,
+                  std::uint32_t binning, const flat_field* correction = nullptr) -> std::uint32_t;
         auto load(const std::string& path) -> std::vector<image_type>;
     }
 }
@@ -0,0 +1,115 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <boost/log/trivial.hpp>
+
+#include "openmp/backend.h"
+
+#include "backend.h"
+#include "backprojection.h"
+#include "hybrid.h"
+#include "metrics.h"
+#include "projection_cache.h"
+#include "scheduler.h"
+#include "sink.h"
+#include "task.h"
+#include "trajectory.h"
+
+namespace paris
+{
+    auto reconstruct_host(scheduler& sched, std::size_t device_num,
+                          projection_cache& cache, sink& sink, std::uint32_t batch_size) -> void
+    {
+        batch_size = std::min(batch_size, openmp::max_batch_size);
+        metrics::set_worker(device_num);
+
+        auto sin = std::vector<float>{};
+        auto cos = std::vector<float>{};
+        auto m = std::vector<projection_matrix>{};
+
+        auto t = task{};
+        while(sched.next(device_num, t))
+        {
+            auto last = (t.id + 1u == t.num);
+            auto dim_z = t.subvol_geo.dim_z + (last ? t.subvol_geo.remainder : 0u);
+            auto offset = t.id * t.subvol_geo.dim_z;
+
+            auto v = openmp::make_volume_device(t.subvol_geo.dim_x, t.subvol_geo.dim_y, dim_z);
+            v.off = offset;
+            openmp::set_interpolation(t.interp);
+
+            // the device side filters with the same geometry, so the projections can be backprojected as they are
+            const auto delta_s = t.det_geo.delta_s * t.det_geo.l_px_row;
+            const auto delta_t = t.det_geo.delta_t * t.det_geo.l_px_col;
+
+            auto reader = cache.make_reader(t.id, t.window);
+            auto batch = std::vector<openmp::projection_device_type>{};
+            batch.reserve(batch_size);
+
+            auto flush = [&]()
+            {
+                auto&& bt = metrics::timer{metrics::stage::backproject, batch.size()};
+                if(t.matrices != nullptr)
+                {
+                    projection_matrices(batch, *t.matrices, m);
+                    openmp::backproject(batch, v, offset, t.det_geo, t.vol_geo, t.enable_roi, t.roi, m);
+                }
+                else
+                {
+                    projection_angles(batch, t.det_geo, t.enable_angles, sin, cos);
+                    openmp::backproject(batch, v, offset, t.det_geo, t.vol_geo, t.enable_roi, t.roi, sin, cos,
+                                        delta_s, delta_t);
+                }
+                metrics::count_voxel_updates(static_cast<std::uint64_t>(v.dim_x) * v.dim_y * v.dim_z * batch.size());
+                batch.clear();
+            };
+
+            auto copy = [&](const backend::projection_host_type& h_p)
+            {
+                auto p = openmp::make_projection_device(h_p.dim_x, h_p.dim_y);
+                std::copy_n(h_p.buf.get(), static_cast<std::size_t>(h_p.dim_x) * h_p.dim_y, p.buf.get());
+                p.idx = h_p.idx;
+                p.phi = h_p.phi;
+                p.first_row = h_p.first_row;
+                p.first_col = h_p.first_col;
+                batch.push_back(std::move(p));
+            };
+
+            while(cache.fetch_filtered(reader, copy))
+            {
+                if(batch.size() >= batch_size)
+                    flush();
+            }
+
+            if(!batch.empty())
+                flush();
+
+            sink.save(v.buf.get(), v.dim_z, v.off);
+            sched.done(device_num);
+        }
+    }
+}
@@ -0,0 +1,44 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#ifndef PARIS_HYBRID_H_
+#define PARIS_HYBRID_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "projection_cache.h"
+#include "scheduler.h"
+#include "sink.h"
+
+namespace paris
+{
+    /*
+     * Reconstructs subvolumes on the host's cores with the OpenMP backend while the devices work on the others.
+     * The host never loads or filters projections itself, it backprojects the filtered projections the devices
+     * publish in the projection cache.
+     */
+    auto reconstruct_host(scheduler& sched, std::size_t device_num,
+                          projection_cache& cache, sink& sink, std::uint32_t batch_size) -> void;
+}
+
+#endif /* PARIS_HYBRID_H_ */
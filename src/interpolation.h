@@ -0,0 +1,45 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 15 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+
+#ifndef PARIS_INTERPOLATION_H_
+#define PARIS_INTERPOLATION_H_
+
+#include <cstdint>
+
+namespace paris
+{
+    /*
+     * How the backprojection samples the detector between pixel centres. Every backend instantiates its kernels
+     * for each mode, the choice costs nothing per voxel. Backends without texture hardware treat the fast modes
+     * as precise.
+     */
+    enum class interpolation : std::uint32_t
+    {
+        fast,       // bilinear texture filtering, 8 bit fractional weights
+        fast_f16,   // the same on half precision textures, half the texture bandwidth and memory
+        precise,    // bilinear in fp32
+        nearest     // the closest pixel, for previews
+    };
+}
+
+#endif /* PARIS_INTERPOLATION_H_ */
@@ -0,0 +1,230 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <boost/log/trivial.hpp>
+
+#include "backend.h"
+#include "exception.h"
+#include "geometry.h"
+#include "iterative.h"
+#include "loader.h"
+#include "metrics.h"
+#include "region_of_interest.h"
+#include "subvolume_information.h"
+
+namespace paris
+{
+    namespace
+    {
+        // at most backend::max_batch_size projections of the same subset
+        using batch_type = std::vector<backend::projection_device_type>;
+
+        struct batch_angles
+        {
+            std::vector<float> sin;
+            std::vector<float> cos;
+        };
+
+        auto make_angles(const batch_type& b, const detector_geometry& det_geo, bool enable_angles) -> batch_angles
+        {
+            auto a = batch_angles{};
+            for(auto&& p : b)
+            {
+                auto phi = enable_angles ? p.phi : static_cast<float>(p.idx) * det_geo.delta_phi;
+                phi *= static_cast<float>(M_PI) / 180.f;
+                a.sin.push_back(std::sin(phi));
+                a.cos.push_back(std::cos(phi));
+            }
+            return a;
+        }
+
+        // the volume, its correction and the column weights next to the projections, the residuals and the row weights
+        auto check_memory(const volume_geometry& vol_geo, const detector_geometry& det_geo, std::size_t num,
+                          std::size_t budget) -> void
+        {
+            auto volumes = vol_geo;
+            volumes.dim_z *= 3u;
+
+            auto proj = static_cast<std::size_t>(det_geo.n_row) * det_geo.n_col * sizeof(float);
+            auto mem = memory_parameters{budget, det_geo.n_col, 1u, backend::max_batch_size, 3u * num * proj};
+            auto subvol_info = backend::make_subvolume_information(volumes, det_geo, mem);
+            if(subvol_info.num > 1)
+            {
+                BOOST_LOG_TRIVIAL(fatal) << "Iterative reconstruction needs the volume and all " << num
+                                         << " projections in device memory, they would need "
+                                         << subvol_info.num << " times the budget of " << subvol_info.plan.budget
+                                         << " bytes";
+                throw stage_construction_error{"reconstruct_iterative() failed"};
+            }
+        }
+
+        // waits for pipelined projections, does nothing for synchronous ones
+        auto synchronize(const batch_type& b) -> void
+        {
+            for(auto&& p : b)
+                backend::synchronize(p);
+        }
+    }
+
+    auto reconstruct_iterative(const std::vector<backend::projection_host_type>& projections,
+                               const detector_geometry& det_geo, bool enable_angles,
+                               const iterative_parameters& params) -> backend::volume_host_type
+    {
+        if(projections.empty() || params.iterations == 0u)
+        {
+            BOOST_LOG_TRIVIAL(fatal) << "Iterative reconstruction needs projections and at least one iteration";
+            throw stage_construction_error{"reconstruct_iterative() failed"};
+        }
+
+        for(auto&& p : projections)
+        {
+            if(p.dim_x != det_geo.n_row || p.dim_y != det_geo.n_col)
+            {
+                BOOST_LOG_TRIVIAL(fatal) << "Iterative reconstruction needs projections of the full detector";
+                throw stage_construction_error{"reconstruct_iterative() failed"};
+            }
+        }
+
+        const auto vol_geo = calculate_volume_geometry(det_geo);
+        const auto num = projections.size();
+        check_memory(vol_geo, det_geo, num, params.memory_budget);
+
+        auto devices = backend::get_devices();
+        backend::set_device(devices.front());
+
+        // every step needs the results of the previous one, there is nothing to overlap
+        backend::set_pipeline_depth(1u);
+
+        const auto delta_s = det_geo.delta_s * det_geo.l_px_row;
+        const auto delta_t = det_geo.delta_t * det_geo.l_px_col;
+        const auto subsets = static_cast<std::uint32_t>(std::min(std::max(params.subsets, 1u),
+                                                                 static_cast<std::uint32_t>(num)));
+
+        // interleaved subsets, every one of them covers the whole rotation
+        auto b = std::vector<std::vector<batch_type>>(subsets);
+        auto w = std::vector<std::vector<batch_type>>(subsets);
+        auto ax = std::vector<std::vector<batch_type>>(subsets);
+        for(auto i = std::size_t{0u}; i < num; ++i)
+        {
+            auto s = i % subsets;
+            if(b[s].empty() || b[s].back().size() == backend::max_batch_size)
+            {
+                b[s].emplace_back();
+                w[s].emplace_back();
+                ax[s].emplace_back();
+            }
+
+            b[s].back().push_back(load(projections[i]));
+            w[s].back().push_back(backend::make_projection_device(det_geo.n_row, det_geo.n_col));
+            ax[s].back().push_back(backend::make_projection_device(det_geo.n_row, det_geo.n_col));
+        }
+
+        auto angles = std::vector<std::vector<batch_angles>>(subsets);
+        for(auto s = 0u; s < subsets; ++s)
+        {
+            for(auto&& batch : b[s])
+                angles[s].push_back(make_angles(batch, det_geo, enable_angles));
+        }
+
+        auto x = backend::make_volume_device(vol_geo.dim_x, vol_geo.dim_y, vol_geo.dim_z);
+        auto corr = backend::make_volume_device(vol_geo.dim_x, vol_geo.dim_y, vol_geo.dim_z);
+        auto c = backend::make_volume_device(vol_geo.dim_x, vol_geo.dim_y, vol_geo.dim_z);
+        const auto roi = region_of_interest{};
+        const auto updates = static_cast<std::uint64_t>(vol_geo.dim_x) * vol_geo.dim_y * vol_geo.dim_z;
+
+        auto forward = [&](batch_type& batch, const batch_angles& a)
+        {
+            auto&& t = metrics::timer{metrics::stage::forward, batch.size()};
+            for(auto&& p : batch)
+                backend::fill(p, 0.f);
+            backend::forward_project(x, 0u, batch, det_geo, vol_geo, a.sin, a.cos, delta_s, delta_t);
+        };
+
+        auto backproject = [&](const batch_type& batch, const batch_angles& a, backend::volume_device_type& v)
+        {
+            auto&& t = metrics::timer{metrics::stage::backproject, batch.size()};
+            backend::backproject(batch, v, 0u, det_geo, vol_geo, false, roi, a.sin, a.cos, delta_s, delta_t);
+            synchronize(batch);
+            metrics::count_voxel_updates(updates * batch.size());
+        };
+
+        // row weights R = 1 / (A * 1): the length of each ray inside the volume
+        backend::fill(x, 1.f);
+        for(auto s = 0u; s < subsets; ++s)
+        {
+            for(auto j = std::size_t{0u}; j < w[s].size(); ++j)
+            {
+                std::swap(w[s][j], ax[s][j]);
+                forward(ax[s][j], angles[s][j]);
+                std::swap(w[s][j], ax[s][j]);
+                for(auto&& p : w[s][j])
+                    backend::invert(p);
+            }
+        }
+
+        // column weights C = 1 / (A^T * 1), a subset only contributes about 1 / subsets of them
+        for(auto s = 0u; s < subsets; ++s)
+        {
+            for(auto j = std::size_t{0u}; j < ax[s].size(); ++j)
+            {
+                for(auto&& p : ax[s][j])
+                    backend::fill(p, 1.f);
+                backproject(ax[s][j], angles[s][j], c);
+            }
+        }
+        backend::invert(c);
+        backend::fill(x, 0.f);
+
+        const auto lambda = params.relaxation * static_cast<float>(subsets);
+        for(auto it = 0u; it < params.iterations; ++it)
+        {
+            for(auto s = 0u; s < subsets; ++s)
+            {
+                // R * (b - A * x) for the whole subset before the volume changes
+                for(auto j = std::size_t{0u}; j < ax[s].size(); ++j)
+                {
+                    forward(ax[s][j], angles[s][j]);
+                    for(auto k = std::size_t{0u}; k < ax[s][j].size(); ++k)
+                        backend::residual(b[s][j][k], ax[s][j][k], w[s][j][k]);
+                }
+
+                for(auto j = std::size_t{0u}; j < ax[s].size(); ++j)
+                    backproject(ax[s][j], angles[s][j], corr);
+
+                backend::update(x, corr, c, lambda, params.nonnegative);
+            }
+
+            BOOST_LOG_TRIVIAL(info) << "Finished iteration " << it + 1u << " of " << params.iterations;
+        }
+
+        auto&& t = metrics::timer{metrics::stage::download};
+        auto h_v = backend::make_volume_host(vol_geo.dim_x, vol_geo.dim_y, vol_geo.dim_z);
+        backend::copy_d2h(x, h_v);
+        return h_v;
+    }
+}
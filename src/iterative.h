@@ -0,0 +1,56 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#ifndef PARIS_ITERATIVE_H_
+#define PARIS_ITERATIVE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "backend.h"
+#include "geometry.h"
+
+namespace paris
+{
+    struct iterative_parameters
+    {
+        std::uint32_t iterations;
+        std::uint32_t subsets;      // 1 is SIRT, more is OS-SART with interleaved subsets of the angles
+        float relaxation;
+        bool nonnegative;
+        std::size_t memory_budget;  // [bytes] on the device, 0 uses 90% of the free memory
+    };
+
+    /*
+     * SIRT / OS-SART on the first device: x += relaxation * C * A^T * R * (b - A * x) with the voxel-driven forward
+     * projector A, the backprojection A^T and the inverse row and column sums R and C. The volume, the projections
+     * and both weights are uploaded once and stay on the device, an iteration never touches the host.
+     *
+     * The projections are unfiltered line integrals of the full detector, ROIs are not supported.
+     */
+    auto reconstruct_iterative(const std::vector<backend::projection_host_type>& projections,
+                               const detector_geometry& det_geo, bool enable_angles,
+                               const iterative_parameters& params) -> backend::volume_host_type;
+}
+
+#endif /* PARIS_ITERATIVE_H_ */
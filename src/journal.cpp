@@ -0,0 +1,139 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 15 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <boost/log/trivial.hpp>
+
+#include "exception.h"
+#include "journal.h"
+
+namespace paris
+{
+    namespace
+    {
+        using stat_type = struct ::stat;
+    }
+
+    journal::journal(const std::string& path, bool resume)
+    {
+        if(resume)
+        {
+            // a missing journal means nothing has been written yet. Only lines ending in '\n' were written completely
+            auto in = std::ifstream{path};
+            auto line = std::string{};
+            auto complete = off_t{0};
+            while(std::getline(in, line) && !in.eof())
+            {
+                auto fields = std::istringstream{line};
+                auto first = std::uint32_t{};
+                auto count = std::uint32_t{};
+                if(!(fields >> first >> count))
+                    break;
+
+                ranges_.emplace_back(first, count);
+                complete += static_cast<off_t>(line.size() + 1u);
+            }
+
+            // later entries would be glued to a torn last line, so it has to go before appending
+            auto st = stat_type{};
+            if(::stat(path.c_str(), &st) == 0 && st.st_size > complete)
+            {
+                BOOST_LOG_TRIVIAL(warning) << "Dropping the incomplete end of " << path;
+                if(::truncate(path.c_str(), complete) == -1)
+                {
+                    BOOST_LOG_TRIVIAL(fatal) << "journal::journal() failed to truncate " << path << ": "
+                                             << std::system_error{errno, std::generic_category()}.what();
+                    throw stage_construction_error{"journal::journal() failed"};
+                }
+            }
+
+            BOOST_LOG_TRIVIAL(info) << "Resuming with " << ranges_.size() << " journal entries from " << path;
+        }
+
+        // entries are small enough to be appended atomically by concurrent writers
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | (resume ? 0 : O_TRUNC), 0644);
+        if(fd_ == -1)
+        {
+            BOOST_LOG_TRIVIAL(fatal) << "journal::journal() failed to open " << path << ": "
+                                     << std::system_error{errno, std::generic_category()}.what();
+            throw stage_construction_error{"journal::journal() failed"};
+        }
+    }
+
+    journal::~journal()
+    {
+        if(fd_ != -1)
+            ::close(fd_);
+    }
+
+    auto journal::covers(std::uint32_t first, std::uint32_t count) const -> bool
+    {
+        auto&& lock = std::lock_guard<std::mutex>{mutex_};
+
+        auto sorted = ranges_;
+        std::sort(std::begin(sorted), std::end(sorted));
+
+        // walk the entries in order and extend the covered prefix of [first, first + count)
+        auto end = first + count;
+        for(auto&& r : sorted)
+        {
+            if(first >= end || r.first > first)
+                break;
+            first = std::max(first, r.first + r.second);
+        }
+        return first >= end;
+    }
+
+    auto journal::record(std::uint32_t first, std::uint32_t count) -> void
+    {
+        if(fd_ == -1 || count == 0u)
+            return;
+
+        auto line = std::to_string(first) + ' ' + std::to_string(count) + '\n';
+
+        auto&& lock = std::lock_guard<std::mutex>{mutex_};
+        if(::write(fd_, line.data(), line.size()) != static_cast<ssize_t>(line.size()))
+        {
+            BOOST_LOG_TRIVIAL(fatal) << "journal::record() failed: "
+                                     << std::system_error{errno, std::generic_category()}.what();
+            throw stage_runtime_error{"journal::record() failed"};
+        }
+        ranges_.emplace_back(first, count);
+    }
+}
@@ -0,0 +1,65 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 15 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+
+#ifndef PARIS_JOURNAL_H_
+#define PARIS_JOURNAL_H_
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace paris
+{
+    /*
+     * Sidecar file next to the volume which records the slices that have been written completely. A run which
+     * has crashed is restarted with --resume and only reconstructs the subvolumes the journal doesn't cover yet.
+     * Every entry is a line "first count", appended as soon as the slices are on their way to the disk.
+     */
+    class journal
+    {
+        public:
+            // a journal that records nothing and covers nothing
+            journal() noexcept = default;
+
+            // with resume the entries of an earlier run are kept, otherwise the journal starts empty
+            journal(const std::string& path, bool resume);
+            ~journal();
+
+            journal(const journal&) = delete;
+            auto operator=(const journal&) -> journal& = delete;
+
+            // true if the slices [first, first + count) have been recorded, possibly by several entries
+            auto covers(std::uint32_t first, std::uint32_t count) const -> bool;
+
+            auto record(std::uint32_t first, std::uint32_t count) -> void;
+
+        private:
+            int fd_ = -1;
+            std::vector<std::pair<std::uint32_t, std::uint32_t>> ranges_;
+            mutable std::mutex mutex_;
+    };
+}
+
+#endif /* PARIS_JOURNAL_H_ */
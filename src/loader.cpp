@@ -20,15 +20,59 @@
  * Authors: Jan Stephan <j.stephan@hzdr.de>
  */
 
+#include <algorithm>
+#include <cstdint>
+
 #include "backend.h"
+#include "geometry.h"
+#include "loader.h"
+#include "metrics.h"
 #include "projection.h"
 
 namespace paris
 {
     auto load(const backend::projection_host_type& p) -> backend::projection_device_type
     {
+        auto&& t = metrics::timer{metrics::stage::upload};
         auto d_p = backend::make_projection_device(p.dim_x, p.dim_y);
         backend::copy_h2d(p, d_p);
         return d_p;
     }
+
+    auto load(const backend::projection_host_type& p, const row_window& window,
+              std::uint32_t dim_x, std::uint32_t dim_y) -> backend::projection_device_type
+    {
+        auto first = std::max(window.first, p.first_row);
+        auto last = std::min(window.first + window.rows, p.first_row + p.dim_y);
+        if(last <= first)
+            return load(p);
+
+        auto&& t = metrics::timer{metrics::stage::upload};
+
+        // device buffers are pooled -> keep the full size and only use the upper left corner
+        auto d_p = backend::make_projection_device(dim_x, dim_y);
+        d_p.dim_x = p.dim_x;
+        d_p.dim_y = last - first;
+        backend::copy_h2d(p, d_p, first - p.first_row);
+        return d_p;
+    }
+
+    auto load_peer(const backend::projection_peer_type& p, const row_window& window,
+                   std::uint32_t dim_x, std::uint32_t dim_y) -> backend::projection_device_type
+    {
+        auto first = std::max(window.first, p.first_row);
+        auto last = std::min(window.first + window.rows, p.first_row + p.dim_y);
+        if(last <= first)
+        {
+            first = p.first_row;
+            last = p.first_row + p.dim_y;
+        }
+
+        auto&& t = metrics::timer{metrics::stage::peer};
+        auto d_p = backend::make_projection_device(dim_x, dim_y);
+        d_p.dim_x = p.dim_x;
+        d_p.dim_y = last - first;
+        backend::copy_p2d(p, d_p, first - p.first_row);
+        return d_p;
+    }
 }
@@ -23,12 +23,26 @@
 #ifndef PARIS_LOADER_H_
 #define PARIS_LOADER_H_
 
+#include <cstdint>
+
 #include "backend.h"
+#include "geometry.h"
 #include "projection.h"
 
 namespace paris
 {
     auto load(const backend::projection_host_type& p) -> backend::projection_device_type;
+
+    /*
+     * Uploads only the rows of p inside window. The device buffer is allocated with dim_x * dim_y pixels so that
+     * all pooled buffers have the same size.
+     */
+    auto load(const backend::projection_host_type& p, const row_window& window,
+              std::uint32_t dim_x, std::uint32_t dim_y) -> backend::projection_device_type;
+
+    // the same for a projection which another device published
+    auto load_peer(const backend::projection_peer_type& p, const row_window& window,
+                   std::uint32_t dim_x, std::uint32_t dim_y) -> backend::projection_device_type;
 }
 
 #endif /* PARIS_LOADER_H_ */
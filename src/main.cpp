@@ -20,40 +20,48 @@
  * Authors: Jan Stephan <j.stephan@hzdr.de>
  */
 
+#include <algorithm>
 #include <chrono>
 #include <csignal>
 #include <cstdint>
 #include <cstdlib>
-#include <functional>
-#include <future>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <stdexcept>
 #include <string>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 #include <execinfo.h>
+#include <unistd.h>
 
 #include <boost/log/core.hpp>
 #include <boost/log/trivial.hpp>
 #include <boost/log/expressions.hpp>
 
-#include <glados/pipeline/task_queue.h>
-
+#include "angles.h"
 #include "backend.h"
-#include "backprojection.h"
+#include "communicator.h"
+#include "ddbvf.h"
 #include "exception.h"
-#include "filtering.h"
+#include "filesystem.h"
+#include "flat_field.h"
 #include "geometry.h"
-#include "loader.h"
-#include "make_volume.h"
+#include "iterative.h"
+#include "journal.h"
+#include "metrics.h"
 #include "program_options.h"
+#include "projection_cache.h"
+#include "reconstruction.h"
+#include "scheduler.h"
+#include "server.h"
 #include "sink.h"
 #include "source.h"
 #include "subvolume_information.h"
 #include "task.h"
 #include "version.h"
-#include "weighting.h"
 
 namespace
 {
@@ -76,50 +84,51 @@ namespace
         std::exit(EXIT_FAILURE);
     }
 
-    auto reconstruct(glados::pipeline::task_queue<paris::task>* queue,
-                     std::size_t task_num,
-                     paris::backend::device_handle& device,
-                     paris::sink& sink) -> void
+    /*
+     * The planner queries every device and test-allocates on it. A server sees the same shapes over and over, the
+     * plan of the last one is kept.
+     */
+    auto plan_subvolumes(const paris::volume_geometry& vol_geo, const paris::detector_geometry& det_geo,
+                         const paris::memory_parameters& mem, bool numa) -> paris::subvolume_info
     {
-        if(queue == nullptr)
-            return;
-
-        paris::backend::set_device(device);
+        using key_type = std::tuple<std::uint32_t, std::uint32_t, std::uint32_t, std::uint32_t, std::uint32_t,
+                                    std::size_t, std::uint32_t, std::uint32_t, std::uint32_t, std::size_t, bool>;
+        static auto last_key = key_type{};
+        static auto last = std::unique_ptr<paris::subvolume_info>{};
 
-        while(!queue->empty())
+        auto key = key_type{vol_geo.dim_x, vol_geo.dim_y, vol_geo.dim_z, det_geo.n_row, det_geo.n_col, mem.budget,
+                            mem.rows, mem.pipeline_depth, mem.batch_size, mem.reserved, numa};
+        if(last == nullptr || last_key != key)
         {
-            auto t = queue->pop();
-            auto last = (task_num - t.id) > 1 ? false : true;
-            auto source = paris::source(t.input_path, t.enable_angles, t.angle_path, t.quality);
-
-            auto v = paris::make_volume(t.subvol_geo, last);
-            auto offset = t.id * t.subvol_geo.dim_z;
-
-            while(!source.drained())
-            {
-                auto p = source.load_next();
-                auto d_p = paris::load(p);
-                paris::weight(d_p, t.det_geo);
-                paris::filter(d_p, t.det_geo);
-                paris::backproject(d_p, v, offset, t.det_geo, t.vol_geo, t.enable_angles, t.enable_roi, t.roi); 
-            }
-
-            sink.save(v);
+            last.reset(new paris::subvolume_info{paris::backend::make_subvolume_information(vol_geo, det_geo, mem)});
+            last_key = key;
         }
+        return *last;
     }
-}
 
-auto main(int argc, char** argv) -> int
-{
-    std::cout << "PARIS - version " << paris::version << std::endl;
-    std::signal(SIGSEGV, signal_handler);
-    std::signal(SIGABRT, signal_handler);
-
-    init_log();
-    auto po = paris::make_program_options(argc, argv);
+    // the devices don't change while the process runs
+    auto available_devices() -> const std::vector<paris::backend::device_handle>&
+    {
+        static const auto all = paris::backend::get_devices();
+        return all;
+    }
 
-    try
+    // a single run with the options po, the threads of pool keep the devices warm between the runs of a server
+    auto run(paris::program_options po, paris::communicator& comm, paris::worker_pool* pool) -> void
     {
+        // previews reconstruct a downsampled volume from binned projections and are written next to the full volume
+        if(po.preview > 1u)
+        {
+            po.det_geo = paris::bin_detector(po.det_geo, po.preview);
+            po.roi.x1 /= po.preview;
+            po.roi.x2 /= po.preview;
+            po.roi.y1 /= po.preview;
+            po.roi.y2 /= po.preview;
+            po.roi.z1 /= po.preview;
+            po.roi.z2 /= po.preview;
+            po.prefix += "_preview";
+        }
+
         auto vol_geo = paris::calculate_volume_geometry(po.det_geo);
 
         auto roi_geo = vol_geo;
@@ -129,44 +138,190 @@ auto main(int argc, char** argv) -> int
                                        po.roi.y1, po.roi.y2,
                                        po.roi.z1, po.roi.z2);
 
-        if(po.enable_io)
+        if(po.enable_io || po.plan_only)
         {
             auto start = std::chrono::high_resolution_clock::now();
 
-            // split the volume into subvolumes
-            auto subvol_info = paris::backend::make_subvolume_information(roi_geo, po.det_geo);
+            // split the volume into subvolumes which fit next to the pipeline's buffers
+            auto z_first = po.enable_roi ? po.roi.z1 : 0u;
+            auto rows = paris::calculate_row_window(po.det_geo, vol_geo, po.enable_roi, po.roi, z_first, roi_geo.dim_z);
+            if(po.enable_trajectory)
+                rows = paris::row_window{0u, po.det_geo.n_col};
+            auto mem = paris::memory_parameters{po.memory_budget << 20u, rows.rows, po.pipeline_depth, po.batch_size,
+                                                paris::staging_memory(po.det_geo.n_row, rows.rows, roi_geo,
+                                                                      po.prefetch_depth)};
+
+            // bound threads keep a copy of the projections per node, the planner has to know about them
+            if(po.enable_numa && !paris::backend::enable_numa())
+                BOOST_LOG_TRIVIAL(warning) << "NUMA binding isn't available for this backend or machine, ignoring";
+
+            auto subvol_info = plan_subvolumes(roi_geo, po.det_geo, mem, po.enable_numa);
+
+            // all ranks have to agree on the subvolumes, the node with the least memory decides
+            auto num = std::min(std::max(comm.max(subvol_info.num), comm.size()), static_cast<int>(roi_geo.dim_z));
+            if(num != subvol_info.num)
+            {
+                auto n = static_cast<std::uint32_t>(num);
+                subvol_info.geo.dim_z = roi_geo.dim_z / n;
+                subvol_info.geo.remainder = roi_geo.dim_z % n;
+                subvol_info.num = num;
+            }
+
+            /*
+             * written slices are journaled next to the volume, chunked files can't be continued and don't need it.
+             * Every rank keeps its own journal, a resumed run needs the same number of ranks.
+             */
+            auto volume_path = po.output_path + '/' + po.prefix;
+
+            // without the volume there is nothing to resume, a fresh file starts with an empty journal
+            auto resumed = po.resume && ::access((volume_path + ".ddbvf").c_str(), F_OK) == 0;
+            if(po.resume && !resumed)
+                BOOST_LOG_TRIVIAL(warning) << "There is no volume at " << volume_path << ".ddbvf to resume, "
+                                           << "starting over";
+
+            auto written = std::unique_ptr<paris::journal>{};
+            if(po.enable_io && po.compression == 0 && po.output_type == "f32" && (po.resume || !po.plan_only))
+            {
+                auto journal_path = volume_path + ".journal";
+                if(comm.size() > 1)
+                    journal_path += "." + std::to_string(comm.rank());
+                paris::create_directory(po.output_path);
+                written.reset(new paris::journal{journal_path, resumed});
+            }
 
-            // generate tasks
-            auto tasks = paris::make_tasks(po, vol_geo, subvol_info);
-            auto&& task_queue = glados::pipeline::task_queue<paris::task>(tasks);
+            // generate tasks, each rank reconstructs a contiguous z-slab
+            auto tasks = paris::make_tasks(po, vol_geo, subvol_info, comm.rank(), comm.size(), written.get());
             auto task_num = tasks.size();
 
-            // get devices
-            auto devices = paris::backend::get_devices();
+            if(tasks.empty())
+            {
+                BOOST_LOG_TRIVIAL(info) << "The journal covers all subvolumes of this rank, nothing to resume";
+
+                // the other ranks still synchronize around the creation of the sink and at the end, dry runs don't
+                if(!po.plan_only)
+                {
+                    comm.barrier();
+                    comm.barrier();
+                }
+                return;
+            }
+
+            // only the detector rows needed by this rank's subvolumes are loaded and filtered
+            auto window = tasks.front().window;
+            for(auto q = tasks; !q.empty(); q.pop())
+                window = paris::merge(window, q.front().window);
+            BOOST_LOG_TRIVIAL(info) << "Using detector rows " << window.first << " to " << window.first + window.rows - 1u;
+
+            if(po.plan_only)
+            {
+                BOOST_LOG_TRIVIAL(info) << "Dry run: " << subvol_info.num << " subvolumes of " << subvol_info.geo.dim_z
+                                        << " slices (the last one has " << subvol_info.geo.remainder
+                                        << " more), this rank reconstructs " << task_num;
+                return;
+            }
+
+            auto devices = available_devices();
 
-            // reconstruction futures
-            auto futures = std::vector<std::future<void>>{};
+            // the host's cores can take over subvolumes as long as the devices fill the projection cache for them
+            auto host_worker = false;
+            if(po.enable_hybrid)
+            {
+            #if defined(PARIS_ENABLE_HYBRID)
+                host_worker = task_num > 1;
+                if(!host_worker)
+                    BOOST_LOG_TRIVIAL(warning) << "Hybrid reconstruction needs more than one subvolume, ignoring";
+            #else
+                BOOST_LOG_TRIVIAL(warning) << "This build does not support hybrid reconstruction, ignoring";
+            #endif
+            }
+
+            auto&& sched = paris::scheduler{tasks, devices.size() + (host_worker ? 1u : 0u)};
+            paris::backend::set_pipeline_depth(po.pipeline_depth);
+            paris::backend::set_tuning_dir(po.tuning_dir);
+            paris::size_host_pool(po.det_geo.n_row, window, roi_geo, devices.size(), po.prefetch_depth,
+                                  po.pipeline_depth);
+
+            // number of projections per backprojection pass
+            auto batch_size = std::min(std::max(po.batch_size, 1u), paris::backend::max_batch_size);
 
             auto task_string = tasks.size() == 1 ? "task" : "tasks";
             auto device_string = devices.size() == 1 ? "device" : "devices";
             BOOST_LOG_TRIVIAL(info) << "Created " << tasks.size() << " " << task_string << " for " << devices.size() << ' ' << device_string;
+            if(comm.size() > 1)
+                BOOST_LOG_TRIVIAL(info) << "Rank " << comm.rank() << " of " << comm.size() << " reconstructs "
+                                        << tasks.size() << " of " << subvol_info.num << " subvolumes";
 
             // create sink
-            auto sink = paris::sink{po.output_path, po.prefix, roi_geo};
+            auto fmt = paris::ddbvf::format{};
+            fmt.level = po.compression;
+            if(po.output_type == "f16")
+                fmt.type = paris::ddbvf::storage_type::f16;
+            else if(po.output_type == "u16")
+            {
+                fmt.type = paris::ddbvf::storage_type::u16;
+                fmt.scale = (po.window_max - po.window_min) / 65535.f;
+                fmt.offset = po.window_min;
+            }
 
-            if(devices.size() > 1)
+            // the ranks write their slabs into the same file, this needs the fixed layout of version 1 files
+            if(comm.size() > 1 && (fmt.level != 0 || fmt.type != paris::ddbvf::storage_type::f32))
             {
-                // launch a reconstruction thread for each available device
-                for(auto&& d : devices)
-                    futures.emplace_back(std::async(std::launch::async, reconstruct, &task_queue, task_num,
-                                                                        std::ref(d), std::ref(sink)));
-
-                // wait for the end of execution
-                for(auto&& f : futures)
-                    f.get();
+                BOOST_LOG_TRIVIAL(fatal) << "Distributed reconstruction only supports uncompressed f32 volumes";
+                comm.abort(EXIT_FAILURE);
+            }
+
+            // rank 0 creates the file, the others attach to it -- as does every rank of a resumed run
+            if(comm.rank() != 0)
+                comm.barrier();
+            auto&& sink = paris::sink{po.output_path, po.prefix, roi_geo, fmt, comm.rank() != 0 || resumed,
+                                      po.map_volume, written.get()};
+            if(comm.rank() == 0)
+                comm.barrier();
+
+            // parsed once and shared by every task and device
+            auto angles = po.enable_angles ? paris::read_angles(po.angle_path) : paris::angle_table{};
+            auto correction = po.flat_path.empty() ? paris::flat_field_ptr{}
+                                                   : paris::read_flat_field(po.dark_path, po.flat_path);
+
+            if(po.iterations > 0u)
+            {
+                if(comm.size() > 1)
+                {
+                    BOOST_LOG_TRIVIAL(fatal) << "Iterative reconstruction runs on a single rank";
+                    comm.abort(EXIT_FAILURE);
+                }
+
+                // every iteration needs all projections of the full detector
+                auto&& source = paris::source{po.input_path, paris::row_window{0u, po.det_geo.n_col}, po.preview,
+                                              angles, po.quality, po.prefetch_depth,
+                                              po.stream_count, po.stream_timeout, po.io_threads, correction};
+                auto projections = std::vector<paris::backend::projection_host_type>{};
+                while(!source.drained())
+                    projections.push_back(source.load_next());
+
+                auto params = paris::iterative_parameters{po.iterations, po.subsets, po.relaxation, true,
+                                                          po.memory_budget << 20u};
+                auto v = paris::reconstruct_iterative(projections, po.det_geo, po.enable_angles, params);
+                sink.save(v.buf.get(), v.dim_z, 0u);
             }
             else
-                reconstruct(&task_queue, task_num, devices[0], sink);
+            {
+                // every projection is loaded and filtered once and then shared between all tasks
+                auto&& source = paris::source{po.input_path, window, po.preview, angles,
+                                              po.quality, po.prefetch_depth, po.stream_count, po.stream_timeout,
+                                              po.io_threads, correction};
+                auto columns = po.enable_trajectory ? paris::column_window{0u, po.det_geo.n_row}
+                                                    : paris::calculate_column_window(po.det_geo, vol_geo,
+                                                                                     po.enable_roi, po.roi);
+                auto&& cache = paris::projection_cache{source, static_cast<std::uint32_t>(task_num),
+                                                       po.det_geo.n_row, window.rows, columns};
+
+                paris::reconstruct(sched, devices, host_worker, cache, sink, po.pipeline_depth, batch_size,
+                                   pool);
+            }
+
+            sink.flush();
+            comm.barrier();
 
             auto stop = std::chrono::high_resolution_clock::now();
 
@@ -176,19 +331,65 @@ auto main(int argc, char** argv) -> int
 
             BOOST_LOG_TRIVIAL(info) << "Program terminated. Time elapsed: "
                     << minutes.count() << ":" << std::setfill('0') << std::setw(2) << seconds.count() % 60 << " minutes";
+
+            // every rank reports its own workers
+            if(!po.report_path.empty())
+            {
+                auto path = po.report_path;
+                if(comm.size() > 1)
+                    path += "." + std::to_string(comm.rank());
+                paris::metrics::write_report(path, duration);
+            }
+        }
+    }
+}
+
+auto main(int argc, char** argv) -> int
+{
+    std::cout << "PARIS - version " << paris::version << std::endl;
+    std::signal(SIGSEGV, signal_handler);
+    std::signal(SIGABRT, signal_handler);
+
+    init_log();
+    auto&& comm = paris::communicator{argc, argv};
+    auto po = paris::make_program_options(argc, argv);
+
+    try
+    {
+        if(po.serve_dir.empty())
+            run(po, comm, nullptr);
+        else
+        {
+            if(comm.size() > 1)
+            {
+                BOOST_LOG_TRIVIAL(fatal) << "The reconstruction server runs on a single rank";
+                comm.abort(EXIT_FAILURE);
+            }
+
+            // the streams are created once per device, every job runs with the server's pipeline depth
+            auto&& pool = paris::worker_pool{};
+            paris::serve(po.serve_dir, [&](paris::program_options& job)
+            {
+                job.pipeline_depth = po.pipeline_depth;
+                if(job.tuning_dir.empty())
+                    job.tuning_dir = po.tuning_dir;
+
+                paris::metrics::reset();
+                run(job, comm, &pool);
+            });
         }
     }
     catch(const paris::stage_construction_error& sce)
     {
         BOOST_LOG_TRIVIAL(fatal) << "main(): Pipeline construction failed: " << sce.what();
         BOOST_LOG_TRIVIAL(fatal) << "Aborting.";
-        std::exit(EXIT_FAILURE);
+        comm.abort(EXIT_FAILURE);
     }
     catch(const paris::stage_runtime_error& sre)
     {
         BOOST_LOG_TRIVIAL(fatal) << "main(): Pipeline execution failed: " << sre.what();
         BOOST_LOG_TRIVIAL(fatal) << "Aborting.";
-        std::exit(EXIT_FAILURE);
+        comm.abort(EXIT_FAILURE);
     }
 
     return 0;
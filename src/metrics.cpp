@@ -0,0 +1,281 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include <boost/log/trivial.hpp>
+
+#include "backend.h"
+#include "exception.h"
+#include "metrics.h"
+
+namespace paris
+{
+    namespace metrics
+    {
+        namespace
+        {
+            constexpr auto stages = static_cast<std::size_t>(stage::count);
+            constexpr const char* stage_names[stages] = {"load", "upload", "filter", "backproject", "download",
+                                                         "write", "forward", "peer"};
+
+            // worker 0 is the host, device n is worker n + 1
+            constexpr auto max_workers = std::size_t{65u};
+
+            struct counters
+            {
+                std::array<std::atomic<std::uint64_t>, stages> ns;
+                std::array<std::atomic<std::uint64_t>, stages> calls;
+                std::array<std::atomic<std::uint64_t>, stages> items;
+                std::atomic<std::uint64_t> voxel_updates;
+            };
+
+            // zero-initialised as all statics
+            counters workers[max_workers];
+            std::atomic<std::size_t> used_workers{1u};
+            std::atomic<std::uint64_t> bytes_read{0u};
+            std::atomic<std::uint64_t> bytes_written{0u};
+
+            thread_local std::size_t worker = 0u;
+
+            struct summary
+            {
+                std::string name;
+                double seconds[stages];
+                std::uint64_t calls[stages];
+                std::uint64_t items[stages];
+                double busy;
+                double utilization;
+                double gvups;
+            };
+
+            auto summarize(double elapsed) -> std::vector<summary>
+            {
+                auto result = std::vector<summary>{};
+                for(auto w = std::size_t{0u}; w < used_workers.load(); ++w)
+                {
+                    auto s = summary{};
+                    s.name = (w == 0u) ? std::string{"host"} : "device " + std::to_string(w - 1u);
+                    s.busy = 0.;
+                    for(auto i = 0u; i < stages; ++i)
+                    {
+                        s.seconds[i] = static_cast<double>(workers[w].ns[i].load()) * 1e-9;
+                        s.calls[i] = workers[w].calls[i].load();
+                        s.items[i] = workers[w].items[i].load();
+                        s.busy += s.seconds[i];
+                    }
+                    s.utilization = (elapsed > 0.) ? s.busy / elapsed : 0.;
+                    s.gvups = (elapsed > 0.) ? static_cast<double>(workers[w].voxel_updates.load()) / elapsed * 1e-9
+                                             : 0.;
+                    result.push_back(s);
+                }
+                return result;
+            }
+
+            auto total_items(const std::vector<summary>& workers_, stage s) noexcept -> std::uint64_t
+            {
+                auto n = std::uint64_t{0u};
+                for(auto&& w : workers_)
+                    n += w.items[static_cast<std::size_t>(s)];
+                return n;
+            }
+
+            auto total_gvups(const std::vector<summary>& workers_) noexcept -> double
+            {
+                auto g = 0.;
+                for(auto&& w : workers_)
+                    g += w.gvups;
+                return g;
+            }
+
+            auto ends_with(const std::string& str, const std::string& suffix) noexcept -> bool
+            {
+                return str.size() >= suffix.size() &&
+                       str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+            }
+
+            auto write_csv(std::ofstream& out, const std::vector<summary>& s, double elapsed) -> void
+            {
+                out << "scope,metric,value\n";
+                out << "run,elapsed_s," << elapsed << '\n';
+                out << "run,bytes_read," << bytes_read.load() << '\n';
+                out << "run,bytes_written," << bytes_written.load() << '\n';
+                out << "run,projections_per_s," << static_cast<double>(total_items(s, stage::load)) / elapsed << '\n';
+                out << "run,gvups," << total_gvups(s) << '\n';
+
+                for(auto&& w : s)
+                {
+                    for(auto i = 0u; i < stages; ++i)
+                    {
+                        if(w.calls[i] == 0u)
+                            continue;
+
+                        out << w.name << ',' << stage_names[i] << "_calls," << w.calls[i] << '\n';
+                        out << w.name << ',' << stage_names[i] << "_items," << w.items[i] << '\n';
+                        out << w.name << ',' << stage_names[i] << "_s," << w.seconds[i] << '\n';
+                    }
+                    out << w.name << ",busy_s," << w.busy << '\n';
+                    out << w.name << ",utilization," << w.utilization << '\n';
+                    out << w.name << ",gvups," << w.gvups << '\n';
+                }
+            }
+
+            auto write_json(std::ofstream& out, const std::vector<summary>& s, double elapsed) -> void
+            {
+                out << "{\n";
+                out << "  \"elapsed_s\": " << elapsed << ",\n";
+                out << "  \"bytes_read\": " << bytes_read.load() << ",\n";
+                out << "  \"bytes_written\": " << bytes_written.load() << ",\n";
+                out << "  \"projections_per_s\": " << static_cast<double>(total_items(s, stage::load)) / elapsed
+                    << ",\n";
+                out << "  \"gvups\": " << total_gvups(s) << ",\n";
+                out << "  \"workers\": [";
+
+                for(auto w = std::size_t{0u}; w < s.size(); ++w)
+                {
+                    out << (w == 0u ? "\n" : ",\n");
+                    out << "    {\n";
+                    out << "      \"name\": \"" << s[w].name << "\",\n";
+                    out << "      \"busy_s\": " << s[w].busy << ",\n";
+                    out << "      \"utilization\": " << s[w].utilization << ",\n";
+                    out << "      \"gvups\": " << s[w].gvups << ",\n";
+                    out << "      \"stages\": {";
+
+                    auto first = true;
+                    for(auto i = 0u; i < stages; ++i)
+                    {
+                        if(s[w].calls[i] == 0u)
+                            continue;
+
+                        out << (first ? "\n" : ",\n");
+                        first = false;
+
+                        auto rate = (s[w].seconds[i] > 0.) ? static_cast<double>(s[w].items[i]) / s[w].seconds[i]
+                                                           : 0.;
+                        out << "        \"" << stage_names[i] << "\": {\"calls\": " << s[w].calls[i]
+                            << ", \"items\": " << s[w].items[i] << ", \"seconds\": " << s[w].seconds[i]
+                            << ", \"items_per_s\": " << rate << "}";
+                    }
+                    out << (first ? "}\n" : "\n      }\n");
+                    out << "    }";
+                }
+                out << "\n  ]\n}\n";
+            }
+        }
+
+        auto set_worker(std::size_t device_num) noexcept -> void
+        {
+            worker = std::min(device_num + 1u, max_workers - 1u);
+
+            auto used = used_workers.load();
+            while(used <= worker && !used_workers.compare_exchange_weak(used, worker + 1u))
+            {
+            }
+        }
+
+        timer::timer(stage s, std::uint64_t items) noexcept
+        : stage_{s}, items_{items}, start_{std::chrono::steady_clock::now()}
+        {
+            backend::push_range(stage_names[static_cast<std::size_t>(s)]);
+        }
+
+        timer::~timer()
+        {
+            backend::pop_range();
+
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_);
+            auto i = static_cast<std::size_t>(stage_);
+            auto&& c = workers[worker];
+            c.ns[i] += static_cast<std::uint64_t>(ns.count());
+            ++c.calls[i];
+            c.items[i] += items_;
+        }
+
+        auto timer::set_items(std::uint64_t items) noexcept -> void
+        {
+            items_ = items;
+        }
+
+        auto count_voxel_updates(std::uint64_t n) noexcept -> void
+        {
+            workers[worker].voxel_updates += n;
+        }
+
+        auto count_bytes_read(std::uint64_t n) noexcept -> void
+        {
+            bytes_read += n;
+        }
+
+        auto count_bytes_written(std::uint64_t n) noexcept -> void
+        {
+            bytes_written += n;
+        }
+
+        auto write_report(const std::string& path, std::chrono::duration<double> elapsed) -> void
+        {
+            auto out = std::ofstream{path};
+            if(!out)
+            {
+                BOOST_LOG_TRIVIAL(fatal) << "Could not create the report at " << path;
+                throw stage_runtime_error{"write_report() failed"};
+            }
+
+            auto seconds = std::max(elapsed.count(), 1e-9);
+            auto s = summarize(seconds);
+            out << std::setprecision(6);
+            if(ends_with(path, ".csv"))
+                write_csv(out, s, seconds);
+            else
+                write_json(out, s, seconds);
+
+            for(auto&& w : s)
+                BOOST_LOG_TRIVIAL(info) << w.name << ": " << std::setprecision(3) << w.utilization * 100.
+                                        << "% busy, " << w.gvups << " GVUPS";
+        }
+
+        auto reset() noexcept -> void
+        {
+            for(auto&& c : workers)
+            {
+                for(auto i = 0u; i < stages; ++i)
+                {
+                    c.ns[i] = 0u;
+                    c.calls[i] = 0u;
+                    c.items[i] = 0u;
+                }
+                c.voxel_updates = 0u;
+            }
+            used_workers = 1u;
+            bytes_read = 0u;
+            bytes_written = 0u;
+        }
+    }
+}
@@ -0,0 +1,87 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#ifndef PARIS_METRICS_H_
+#define PARIS_METRICS_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace paris
+{
+    /*
+     * Run-time instrumentation. Every stage call is timed on the calling thread and attributed to the worker --
+     * the host or one of the devices -- the thread works for. Times are host wall times: asynchronous device work
+     * shows up in the stage which waits for it, use the NVTX ranges of the CUDA backend for exact timelines.
+     */
+    namespace metrics
+    {
+        enum class stage : std::uint32_t
+        {
+            load,           // decoding projection files
+            upload,         // host -> device
+            filter,         // weighting and filtering
+            backproject,
+            download,       // device -> host, projections for other subvolumes and volume slabs
+            write,          // writing volume slabs
+            forward,        // forward projection of iterative reconstructions
+            peer,           // device -> device, filtered projections shared between the devices
+            count
+        };
+
+        // the calling thread works for device device_num from now on
+        auto set_worker(std::size_t device_num) noexcept -> void;
+
+        // times the enclosing scope, items is the number of projections (or slabs) handled
+        class timer
+        {
+            public:
+                explicit timer(stage s, std::uint64_t items = 1u) noexcept;
+                ~timer();
+
+                timer(const timer&) = delete;
+                auto operator=(const timer&) -> timer& = delete;
+
+                auto set_items(std::uint64_t items) noexcept -> void;
+
+            private:
+                stage stage_;
+                std::uint64_t items_;
+                std::chrono::steady_clock::time_point start_;
+        };
+
+        auto count_voxel_updates(std::uint64_t n) noexcept -> void;
+        auto count_bytes_read(std::uint64_t n) noexcept -> void;
+        // volume bytes handed to the writer, before compression
+        auto count_bytes_written(std::uint64_t n) noexcept -> void;
+
+        // writes a CSV report if path ends with .csv, a JSON report otherwise
+        auto write_report(const std::string& path, std::chrono::duration<double> elapsed) -> void;
+
+        // clears all counters, the jobs of a server are reported one by one
+        auto reset() noexcept -> void;
+    }
+}
+
+#endif /* PARIS_METRICS_H_ */
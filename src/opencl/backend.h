@@ -0,0 +1,247 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 15 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#ifndef PARIS_OPENCL_BACKEND_H_
+#define PARIS_OPENCL_BACKEND_H_
+
+#define CL_TARGET_OPENCL_VERSION 120
+#define CL_USE_DEPRECATED_OPENCL_1_2_APIS
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <CL/cl.h>
+
+#include "../geometry.h"
+#include "../interpolation.h"
+#include "../projection.h"
+#include "../region_of_interest.h"
+#include "../subvolume_information.h"
+#include "../trajectory.h"
+#include "../volume.h"
+
+namespace paris
+{
+    namespace opencl
+    {
+        namespace detail
+        {
+            /*
+             * Device buffers are dense, a row of dim_x floats is followed by the next one. Pooled buffers go back
+             * to the pool of their context when they are released, all others are freed.
+             */
+            struct mem_deleter
+            {
+                std::size_t size; // [bytes]
+                bool pooled;
+                auto operator()(cl_mem m) noexcept -> void;
+            };
+
+            using device_ptr = std::unique_ptr<std::remove_pointer<cl_mem>::type, mem_deleter>;
+        }
+
+        using projection_host_buffer_type = std::unique_ptr<float[]>;
+        using projection_device_buffer_type = detail::device_ptr;
+        using volume_host_buffer_type = std::unique_ptr<float[]>;
+        using volume_device_buffer_type = detail::device_ptr;
+
+        // an in-order command queue on the current device, every projection in flight gets its own
+        struct cl_queue
+        {
+            cl_queue();
+            ~cl_queue();
+
+            cl_queue(const cl_queue&) = delete;
+            auto operator=(const cl_queue&) -> cl_queue& = delete;
+
+            cl_command_queue queue;
+        };
+        using metadata = cl_queue*;
+
+        using projection_host_type = projection<projection_host_buffer_type, metadata>;
+        using projection_device_type = projection<projection_device_buffer_type, metadata>;
+        using volume_host_type = volume<volume_host_buffer_type>;
+        using volume_device_type = volume<volume_device_buffer_type>;
+
+        // host memory isn't pinned, there is nothing to pool
+        inline auto set_host_pool_size(std::size_t) noexcept -> void {}
+
+        auto make_projection_host(std::uint32_t dim_x, std::uint32_t dim_y) -> projection_host_type;
+        // recycled from the device's pool of released projection buffers
+        auto make_projection_device(std::uint32_t dim_x, std::uint32_t dim_y) -> projection_device_type;
+
+        auto make_volume_host(std::uint32_t dim_x, std::uint32_t dim_y, std::uint32_t dim_z) -> volume_host_type;
+        auto make_volume_device(std::uint32_t dim_x, std::uint32_t dim_y, std::uint32_t dim_z) -> volume_device_type;
+
+        // volumes live in device memory and cannot be mapped from the output file
+        constexpr auto maps_volumes = false;
+        auto map_volume(int fd, std::uint64_t pos, std::uint32_t dim_x, std::uint32_t dim_y, std::uint32_t dim_z)
+            -> volume_device_type;
+
+        auto copy_h2d(const projection_host_type& h_p, projection_device_type& d_p) -> void;
+        auto copy_d2h(const projection_device_type& d_p, projection_host_type& h_p) -> void;
+
+        // uploads the rows [first, first + d_p.dim_y) of h_p
+        auto copy_h2d(const projection_host_type& h_p, projection_device_type& d_p, std::uint32_t first) -> void;
+
+        // downloads the columns [first, first + h_p.dim_x) of d_p
+        auto copy_d2h(const projection_device_type& d_p, projection_host_type& h_p, std::uint32_t first) -> void;
+
+        auto copy_h2d(const volume_host_type& h_v, volume_device_type& d_v) -> void;
+        auto copy_d2h(const volume_device_type& d_v, volume_host_type& h_v) -> void;
+        // downloads the slices [first, first + h_v.dim_z) of d_v
+        auto copy_d2h(const volume_device_type& d_v, volume_host_type& h_v, std::uint32_t first) -> void;
+
+        // splits the volume into as few subvolumes as fit into every device's memory budget next to the pipeline
+        auto make_subvolume_information(const volume_geometry& vol_geo, const detector_geometry& det_geo,
+                                        const memory_parameters& mem) -> subvolume_info;
+
+        // the weights only depend on the geometry, they are applied while expanding the projection for filtering
+        using weight_buffer_type = detail::device_ptr;
+        auto make_weights(std::uint32_t dim_x, std::uint32_t dim_y, float h_min, float v_min, float d_sd,
+                          float l_px_row, float l_px_col) -> weight_buffer_type;
+
+        // real frequency response, already includes the normalization of the inverse FFT
+        using filter_buffer_type = detail::device_ptr;
+        auto make_filter(const std::vector<float>& response) -> filter_buffer_type;
+        // clFFT plans are baked for a queue and created per queue, there is no wisdom to share
+        struct filter_plan_type {};
+        inline auto make_filter_plan(std::uint32_t, std::uint32_t, const std::string&) noexcept -> filter_plan_type
+        {
+            return filter_plan_type{};
+        }
+        auto apply_filter(projection_device_type& p, const filter_buffer_type& k, const weight_buffer_type& w,
+                          const filter_plan_type& plan, std::uint32_t filter_size, std::uint32_t n_col) -> void;
+        // filters all projections at once, small detectors keep the device busy this way
+        auto apply_filter(std::vector<projection_device_type>& p, const filter_buffer_type& k,
+                          const weight_buffer_type& w, const filter_plan_type& plan,
+                          std::uint32_t filter_size, std::uint32_t n_col) -> void;
+
+        // number of projections which can be backprojected in one pass over the volume
+        constexpr auto max_batch_size = std::uint32_t{32u};
+
+        /**
+         * Fused filtering -- detectors up to max_fused_width pixels wide are weighted and convolved with the spatial
+         * filter taps in a single kernel, the FFT path's enqueues would dominate otherwise
+         * */
+        constexpr auto max_fused_width = std::uint32_t{512u};
+        /*
+         * Batched filtering -- the FFTs of up to a batch of projections share one clFFT plan if the filter is at most
+         * max_batched_filter_size long. Larger detectors keep the device busy on their own and are filtered one by one
+         */
+        constexpr auto max_batched_filter_size = std::uint32_t{2048u};
+        // taps holds the 2 * dim_x - 1 coefficients centred on dim_x - 1, all projections cover the same rows
+        auto apply_fused_filter(std::vector<projection_device_type>& p, const filter_buffer_type& taps,
+                                const weight_buffer_type& w, std::uint32_t n_col) -> void;
+        auto backproject(const std::vector<projection_device_type>& p, volume_device_type& v, std::uint32_t v_offset,
+                         const detector_geometry& det_geo, const volume_geometry& vol_geo,
+                         bool enable_roi, const region_of_interest& roi,
+                         const std::vector<float>& sin, const std::vector<float>& cos,
+                         float delta_s, float delta_t) -> void;
+
+        // arbitrary trajectories: the projection matrix m[i] of every projection replaces the circular geometry
+        auto backproject(const std::vector<projection_device_type>& p, volume_device_type& v, std::uint32_t v_offset,
+                         const detector_geometry& det_geo, const volume_geometry& vol_geo,
+                         bool enable_roi, const region_of_interest& roi,
+                         const std::vector<projection_matrix>& m) -> void;
+
+        /**
+         * Interpolation -- the backprojections of the calling thread sample the detector with mode from now on.
+         * Images are filled by copies which can't convert, fast_f16 uses float images like fast
+         * */
+        auto set_interpolation(interpolation mode) noexcept -> void;
+
+        /**
+         * Iterative reconstruction -- the volume and the projections stay in device memory between iterations
+         * */
+        // adds the voxel-driven projection of v to p, the transpose of backproject() up to a constant factor
+        auto forward_project(const volume_device_type& v, std::uint32_t v_offset,
+                             std::vector<projection_device_type>& p,
+                             const detector_geometry& det_geo, const volume_geometry& vol_geo,
+                             const std::vector<float>& sin, const std::vector<float>& cos,
+                             float delta_s, float delta_t) -> void;
+        auto fill(projection_device_type& p, float value) -> void;
+        auto fill(volume_device_type& v, float value) -> void;
+        // replaces every value by its reciprocal, (almost) empty rays and voxels become 0
+        auto invert(projection_device_type& p) -> void;
+        auto invert(volume_device_type& v) -> void;
+        // ax = (b - ax) * w
+        auto residual(const projection_device_type& b, projection_device_type& ax, const projection_device_type& w)
+            -> void;
+        // x += lambda * c * corr, clamped to positive values if requested, then clears corr
+        auto update(volume_device_type& x, volume_device_type& corr, const volume_device_type& c, float lambda,
+                    bool nonnegative) -> void;
+
+        /**
+         * Pipelining -- up to depth projections are processed concurrently on separate queues
+         * */
+        auto set_pipeline_depth(std::uint32_t depth) noexcept -> void;
+        auto synchronize(const projection_device_type& p) -> void;
+
+        /**
+         * Autotuning -- work groups are sized from the limits of each kernel, nothing to tune
+         * */
+        inline auto set_tuning_dir(const std::string&) noexcept -> void {}
+
+        /**
+         * NUMA -- device memory is placed by the driver, nothing to bind
+         * */
+        inline auto enable_numa() noexcept -> bool { return false; }
+
+        /**
+         * Device management -- the GPUs and accelerators of all platforms, numbered in the order of discovery
+         * */
+        using device_handle = int;
+        auto get_devices() -> std::vector<device_handle>;
+        auto set_device(device_handle& device) -> void;
+
+        /**
+         * Peer-to-peer -- OpenCL contexts don't share memory between devices, projections go through the host
+         * */
+        using projection_peer_type = projection_host_type;
+        inline auto enable_peer_access(const std::vector<device_handle>&) noexcept -> bool { return false; }
+        inline auto make_projection_peer(std::uint32_t dim_x, std::uint32_t dim_y) -> projection_peer_type
+        {
+            return make_projection_host(dim_x, dim_y);
+        }
+        inline auto copy_d2p(const projection_device_type& d_p, projection_peer_type& p, std::uint32_t first) -> void
+        {
+            copy_d2h(d_p, p, first);
+        }
+        inline auto copy_p2d(const projection_peer_type& p, projection_device_type& d_p, std::uint32_t first) -> void
+        {
+            copy_h2d(p, d_p, first);
+        }
+
+        /**
+         * Profiling -- there is no vendor-neutral timeline tool to feed
+         * */
+        inline auto push_range(const char*) noexcept -> void {}
+        inline auto pop_range() noexcept -> void {}
+    }
+}
+
+#endif /* PARIS_OPENCL_BACKEND_H_ */
@@ -0,0 +1,308 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 15 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/log/trivial.hpp>
+
+#include "../backprojection_constants.h"
+#include "../exception.h"
+#include "../interpolation.h"
+#include "../region_of_interest.h"
+#include "../trajectory.h"
+
+#include "backend.h"
+#include "context.h"
+
+namespace paris
+{
+    namespace opencl
+    {
+        namespace
+        {
+            // the mode of the calling thread's backprojections, see set_interpolation()
+            thread_local interpolation interp_mode = interpolation::fast;
+
+            // the detector coordinate c maps to the pixel coordinate c / size + proj_offset()
+            inline auto proj_offset(std::uint32_t dim, float size, float offset) noexcept -> float
+            {
+                auto size2 = size / 2.f;
+                auto min = -(static_cast<float>(dim) * size2) - offset;
+                return -min / size - (1.f / 2.f);
+            }
+
+            /*
+             * Everything the backprojection needs on one device: the image array which holds the projections of
+             * one batch as its layers and the buffer for their matrices. All backprojections of a thread are
+             * serialised on the context's queue as they share the volume.
+             */
+            class backprojection_context
+            {
+                public:
+                    backprojection_context()
+                    : layers_{nullptr}, p_dim_x_{0u}, p_dim_y_{0u}
+                    , matrices_{detail::make_buffer(sizeof(projection_matrix) * max_batch_size, CL_MEM_READ_ONLY)}
+                    {}
+
+                    ~backprojection_context()
+                    {
+                        if(layers_ != nullptr)
+                            clReleaseMemObject(layers_);
+                    }
+
+                    backprojection_context(const backprojection_context&) = delete;
+                    auto operator=(const backprojection_context&) -> backprojection_context& = delete;
+
+                    // (re)creates the image array for projections of p_dim_x * p_dim_y pixels
+                    auto resize(std::uint32_t p_dim_x, std::uint32_t p_dim_y) -> void
+                    {
+                        if(layers_ != nullptr && p_dim_x == p_dim_x_ && p_dim_y == p_dim_y_)
+                            return;
+
+                        // the old array may still be read by a backprojection
+                        if(layers_ != nullptr)
+                        {
+                            detail::check(clFinish(q_.queue), "Could not finish backprojection");
+                            clReleaseMemObject(layers_);
+                            layers_ = nullptr;
+                        }
+
+                        auto format = cl_image_format{};
+                        format.image_channel_order = CL_R;
+                        format.image_channel_data_type = CL_FLOAT;
+
+                        auto desc = cl_image_desc{};
+                        desc.image_type = CL_MEM_OBJECT_IMAGE2D_ARRAY;
+                        desc.image_width = p_dim_x;
+                        desc.image_height = p_dim_y;
+                        desc.image_array_size = max_batch_size;
+
+                        auto err = cl_int{};
+                        layers_ = clCreateImage(detail::current().context, CL_MEM_READ_ONLY, &format, &desc, nullptr,
+                                                &err);
+                        detail::check(err, "Could not create projection image array");
+                        p_dim_x_ = p_dim_x;
+                        p_dim_y_ = p_dim_y;
+                    }
+
+                    auto queue() const noexcept -> cl_command_queue { return q_.queue; }
+                    auto layers() const noexcept -> cl_mem { return layers_; }
+                    auto matrices() const noexcept -> cl_mem { return matrices_.get(); }
+
+                    auto copy(const projection_device_type& p, std::uint32_t layer) -> void
+                    {
+                        std::size_t origin[3] = {0u, 0u, layer};
+                        std::size_t region[3] = {p.dim_x, p.dim_y, 1u};
+                        detail::check(clEnqueueCopyBufferToImage(q_.queue, p.buf.get(), layers_, 0u, origin, region,
+                                                                 0u, nullptr, nullptr),
+                                      "Could not copy projection to image array");
+                    }
+
+                private:
+                    cl_queue q_;
+                    cl_mem layers_;
+                    std::uint32_t p_dim_x_;
+                    std::uint32_t p_dim_y_;
+                    detail::device_ptr matrices_;
+            };
+
+            /*
+             * One kernel per beam geometry, ROI setting and interpolation mode, see BACKPROJECTION_KERNELS in
+             * kernels.cpp. They are created on first use, a run needs one or two of them.
+             */
+            auto kernel_for(beam_geometry beam, bool enable_roi, interpolation mode) -> detail::kernel&
+            {
+                thread_local static auto kernels = std::map<std::string, std::unique_ptr<detail::kernel>>{};
+
+                auto name = std::string{"backproject_"};
+                switch(beam)
+                {
+                    case beam_geometry::fan: name += "fan"; break;
+                    case beam_geometry::parallel: name += "parallel"; break;
+                    case beam_geometry::cone: name += "cone"; break;
+                }
+
+                if(enable_roi)
+                    name += "_roi";
+
+                if(mode == interpolation::precise)
+                    name += "_precise";
+                else if(mode == interpolation::nearest)
+                    name += "_nearest";
+
+                auto&& k = kernels[name];
+                if(k == nullptr)
+                    k.reset(new detail::kernel{name.c_str()});
+                return *k;
+            }
+        }
+
+        auto set_interpolation(interpolation mode) noexcept -> void
+        {
+            interp_mode = mode;
+        }
+
+        auto backproject(const std::vector<projection_device_type>& p, volume_device_type& v, std::uint32_t v_offset,
+                         const detector_geometry& det_geo, const volume_geometry& vol_geo,
+                         bool enable_roi, const region_of_interest& roi,
+                         const std::vector<projection_matrix>& m) -> void
+        {
+            if(p.empty())
+                return;
+
+            if(p.size() > max_batch_size)
+            {
+                BOOST_LOG_TRIVIAL(fatal) << "Backprojection batch exceeds " << max_batch_size << " projections";
+                throw stage_runtime_error{"backproject() failed"};
+            }
+
+            // constants for the backprojection - these only change with the geometry
+            const auto v_dim_x_full = vol_geo.dim_x;
+            const auto v_dim_y_full = vol_geo.dim_y;
+            const auto v_dim_z_full = vol_geo.dim_z;
+
+            const auto l_vx_x = vol_geo.l_vx_x;
+            const auto l_vx_y = vol_geo.l_vx_y;
+            const auto l_vx_z = vol_geo.l_vx_z;
+
+            const auto p_dim_x = det_geo.n_row;
+            const auto p_dim_y = det_geo.n_col;
+
+            const auto l_px_x = det_geo.l_px_row;
+            const auto l_px_y = det_geo.l_px_col;
+
+            const auto d_s = det_geo.delta_s * det_geo.l_px_row;
+            const auto d_t = det_geo.delta_t * det_geo.l_px_col;
+
+            const auto d_so = det_geo.d_so;
+            const auto d_sd = std::abs(det_geo.d_so) + std::abs(det_geo.d_od);
+            const auto beam = det_geo.beam;
+
+            // created once per thread (= device), the image array follows the detector
+            thread_local static auto&& ctx = backprojection_context{};
+            ctx.resize(p_dim_x, p_dim_y);
+
+            // the constants are passed by value, the driver keeps a copy with every launch
+            const auto consts = backprojection_constants{
+                v.dim_x,
+                v_dim_x_full,
+                v.dim_y,
+                v_dim_y_full,
+                v.dim_z,
+                v_dim_z_full,
+                v_offset,
+                l_vx_x,
+                l_vx_y,
+                l_vx_z,
+                p_dim_x,
+                p_dim_y,
+                p.front().first_row,
+                p.front().first_col,
+                l_px_x,
+                l_px_y,
+                d_s,
+                d_t,
+                d_so,
+                d_sd
+            };
+
+            // the matrices change with every batch. The write blocks so m may go away on return
+            detail::check(clEnqueueWriteBuffer(ctx.queue(), ctx.matrices(), CL_TRUE, 0u,
+                                               sizeof(projection_matrix) * p.size(), m.data(), 0u, nullptr, nullptr),
+                          "Could not upload projection matrices");
+
+            // gather the batch in the image array
+            for(auto i = 0u; i < p.size(); ++i)
+            {
+                // pipelined projections: wait until filtering on the projection's own queue has finished
+                if(p[i].meta != nullptr)
+                    detail::order(p[i].meta->queue, ctx.queue());
+
+                ctx.copy(p[i], i);
+            }
+
+            // backproject and apply ROI as needed
+            auto n = static_cast<std::uint32_t>(p.size());
+            auto&& k = kernel_for(beam, enable_roi, interp_mode);
+            k.set(v.buf.get(), ctx.layers(), ctx.matrices(), n, consts, roi);
+            detail::launch(ctx.queue(), k, v.dim_x, v.dim_y, v.dim_z);
+
+            // the projections' queues (and thus their buffers) must not be reused before we are done
+            auto pipelined = false;
+            for(auto&& proj : p)
+            {
+                if(proj.meta == nullptr)
+                    continue;
+
+                pipelined = true;
+                detail::order(ctx.queue(), proj.meta->queue);
+            }
+
+            if(!pipelined)
+                detail::check(clFinish(ctx.queue()), "Could not finish backprojection");
+        }
+
+        auto backproject(const std::vector<projection_device_type>& p, volume_device_type& v, std::uint32_t v_offset,
+                         const detector_geometry& det_geo, const volume_geometry& vol_geo,
+                         bool enable_roi, const region_of_interest& roi,
+                         const std::vector<float>& sin, const std::vector<float>& cos,
+                         float delta_s, float delta_t) -> void
+        {
+            // the circular trajectory is a special case of the general one
+            const auto d_so = det_geo.d_so;
+            const auto d_sd = std::abs(det_geo.d_so) + std::abs(det_geo.d_od);
+            const auto a_h = d_sd / det_geo.l_px_row;
+            const auto a_v = d_sd / det_geo.l_px_col;
+            const auto h_c = proj_offset(det_geo.n_row, det_geo.l_px_row, delta_s);
+            const auto v_c = proj_offset(det_geo.n_col, det_geo.l_px_col, delta_t);
+
+            auto m = std::vector<projection_matrix>{};
+            m.reserve(sin.size());
+            for(auto i = 0u; i < sin.size(); ++i)
+            {
+                const auto sn = sin[i];
+                const auto cs = cos[i];
+                if(det_geo.beam == beam_geometry::fan)
+                    m.push_back(projection_matrix{{-a_h * sn + h_c * cs, a_h * cs + h_c * sn, 0.f, h_c * d_so,
+                                                   0.f, 0.f, a_v / d_so, v_c,
+                                                   cs, sn, 0.f, d_so}});
+                else if(det_geo.beam == beam_geometry::parallel)
+                    m.push_back(projection_matrix{{-sn / det_geo.l_px_row, cs / det_geo.l_px_row, 0.f, h_c,
+                                                   0.f, 0.f, 1.f / det_geo.l_px_col, v_c,
+                                                   0.f, 0.f, 0.f, 1.f}});
+                else
+                    m.push_back(projection_matrix{{-a_h * sn + h_c * cs, a_h * cs + h_c * sn, 0.f, h_c * d_so,
+                                                   v_c * cs, v_c * sn, a_v, v_c * d_so,
+                                                   cs, sn, 0.f, d_so}});
+            }
+
+            backproject(p, v, v_offset, det_geo, vol_geo, enable_roi, roi, m);
+        }
+    }
+}
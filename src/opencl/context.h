@@ -0,0 +1,113 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 15 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+
+#ifndef PARIS_OPENCL_CONTEXT_H_
+#define PARIS_OPENCL_CONTEXT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "backend.h"
+
+namespace paris
+{
+    namespace opencl
+    {
+        namespace detail
+        {
+            // the OpenCL objects of one device, created on first use and kept until the program ends
+            struct device_context
+            {
+                cl_device_id device;
+                cl_context context;
+                cl_program program;
+
+                std::size_t global_mem;     // [bytes]
+                std::size_t max_alloc;      // [bytes] of a single buffer
+            };
+
+            auto device_count() -> int;
+            auto context_of(int device) -> device_context&;
+            // the context of the device the calling thread was bound to by set_device()
+            auto current() -> device_context&;
+
+            auto error_string(cl_int err) noexcept -> const char*;
+            // logs what together with the error and throws a stage_runtime_error unless err is CL_SUCCESS
+            auto check(cl_int err, const char* what) -> void;
+
+            // the kernels' source, built once for every device
+            extern const char* const kernel_source;
+
+            /*
+             * A kernel of the current device's program. Kernel objects keep their arguments, so every thread needs
+             * its own.
+             */
+            class kernel
+            {
+                public:
+                    explicit kernel(const char* name);
+                    ~kernel();
+
+                    kernel(const kernel&) = delete;
+                    auto operator=(const kernel&) -> kernel& = delete;
+
+                    template <typename... Args>
+                    auto set(const Args&... args) -> kernel&
+                    {
+                        set_from(0u, args...);
+                        return *this;
+                    }
+
+                    auto get() const noexcept -> cl_kernel { return kernel_; }
+
+                private:
+                    auto set_from(cl_uint) noexcept -> void {}
+
+                    template <typename T, typename... Args>
+                    auto set_from(cl_uint i, const T& arg, const Args&... args) -> void
+                    {
+                        check(clSetKernelArg(kernel_, i, sizeof(T), &arg), "Could not set kernel argument");
+                        set_from(i + 1u, args...);
+                    }
+
+                    cl_kernel kernel_;
+            };
+
+            // enqueues k over dim_x * dim_y * dim_z work items, rounded up to whole work groups
+            auto launch(cl_command_queue queue, const kernel& k, std::size_t dim_x, std::size_t dim_y = 1u,
+                        std::size_t dim_z = 1u) -> void;
+
+            // enqueues groups work groups of k, each as large as the kernel allows (up to 256 items)
+            auto launch_groups(cl_command_queue queue, const kernel& k, std::size_t groups) -> void;
+
+            // makes waiter wait for the work which is currently enqueued on recorder
+            auto order(cl_command_queue recorder, cl_command_queue waiter) -> void;
+
+            auto make_buffer(std::size_t size, cl_mem_flags flags = CL_MEM_READ_WRITE) -> device_ptr;
+            // reuses a released buffer of the same size if there is one
+            auto make_pooled_buffer(std::size_t size) -> device_ptr;
+        }
+    }
+}
+
+#endif /* PARIS_OPENCL_CONTEXT_H_ */
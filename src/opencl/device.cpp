@@ -0,0 +1,327 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 15 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/log/trivial.hpp>
+
+#include "../exception.h"
+
+#include "backend.h"
+#include "context.h"
+
+namespace paris
+{
+    namespace opencl
+    {
+        namespace
+        {
+            struct device_entry
+            {
+                cl_platform_id platform;
+                cl_device_id device;
+                std::unique_ptr<detail::device_context> ctx;
+            };
+
+            struct registry
+            {
+                std::mutex mutex;
+                std::vector<device_entry> devices;
+                bool discovered = false;
+            };
+
+            // contexts may be used during static destruction -> the registry is never destroyed
+            auto get_registry() -> registry&
+            {
+                static auto r = new registry{};
+                return *r;
+            }
+
+            thread_local auto current_device = 0;
+
+            // the GPUs and accelerators of all platforms, the CPU is served better by the OpenMP backend
+            auto discover(registry& r) -> void
+            {
+                if(r.discovered)
+                    return;
+                r.discovered = true;
+
+                auto num_platforms = cl_uint{};
+                if(clGetPlatformIDs(0u, nullptr, &num_platforms) != CL_SUCCESS || num_platforms == 0u)
+                    return;
+
+                auto platforms = std::vector<cl_platform_id>(num_platforms);
+                detail::check(clGetPlatformIDs(num_platforms, platforms.data(), nullptr),
+                              "Could not query OpenCL platforms");
+
+                for(auto&& platform : platforms)
+                {
+                    auto num_devices = cl_uint{};
+                    auto type = static_cast<cl_device_type>(CL_DEVICE_TYPE_GPU | CL_DEVICE_TYPE_ACCELERATOR);
+                    if(clGetDeviceIDs(platform, type, 0u, nullptr, &num_devices) != CL_SUCCESS || num_devices == 0u)
+                        continue;
+
+                    auto devices = std::vector<cl_device_id>(num_devices);
+                    detail::check(clGetDeviceIDs(platform, type, num_devices, devices.data(), nullptr),
+                                  "Could not query OpenCL devices");
+
+                    for(auto&& device : devices)
+                        r.devices.push_back(device_entry{platform, device, nullptr});
+                }
+            }
+
+            auto device_name(cl_device_id device) -> std::string
+            {
+                auto size = std::size_t{};
+                if(clGetDeviceInfo(device, CL_DEVICE_NAME, 0u, nullptr, &size) != CL_SUCCESS || size == 0u)
+                    return std::string{"unknown"};
+
+                auto name = std::string(size, '\0');
+                clGetDeviceInfo(device, CL_DEVICE_NAME, size, &name[0], nullptr);
+                name.resize(size - 1u);
+                return name;
+            }
+
+            auto build_log(cl_program program, cl_device_id device) -> std::string
+            {
+                auto size = std::size_t{};
+                if(clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, 0u, nullptr, &size) != CL_SUCCESS)
+                    return std::string{};
+
+                auto log = std::string(size, '\0');
+                clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, size, &log[0], nullptr);
+                return log;
+            }
+
+            auto make_context(const device_entry& e, int num) -> std::unique_ptr<detail::device_context>
+            {
+                auto ctx = std::unique_ptr<detail::device_context>{new detail::device_context{}};
+                ctx->device = e.device;
+
+                auto global_mem = cl_ulong{};
+                auto max_alloc = cl_ulong{};
+                detail::check(clGetDeviceInfo(e.device, CL_DEVICE_GLOBAL_MEM_SIZE, sizeof(global_mem), &global_mem,
+                                              nullptr), "Could not query the device memory");
+                detail::check(clGetDeviceInfo(e.device, CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(max_alloc), &max_alloc,
+                                              nullptr), "Could not query the device memory");
+                ctx->global_mem = static_cast<std::size_t>(global_mem);
+                ctx->max_alloc = static_cast<std::size_t>(max_alloc);
+
+                cl_context_properties props[] = {CL_CONTEXT_PLATFORM,
+                                                 reinterpret_cast<cl_context_properties>(e.platform), 0};
+                auto err = cl_int{};
+                ctx->context = clCreateContext(props, 1u, &e.device, nullptr, nullptr, &err);
+                detail::check(err, "Could not create OpenCL context");
+
+                auto source = detail::kernel_source;
+                ctx->program = clCreateProgramWithSource(ctx->context, 1u, &source, nullptr, &err);
+                detail::check(err, "Could not create OpenCL program");
+
+                // same floating point behaviour as the CUDA port: fused multiply-add, but precise division
+                auto options = "-cl-mad-enable -DMAX_BATCH_SIZE=" + std::to_string(max_batch_size)
+                             + " -DMAX_FUSED_WIDTH=" + std::to_string(max_fused_width);
+                err = clBuildProgram(ctx->program, 1u, &e.device, options.c_str(), nullptr, nullptr);
+                if(err != CL_SUCCESS)
+                {
+                    BOOST_LOG_TRIVIAL(fatal) << "Could not build the OpenCL kernels for device #" << num << ": "
+                                             << detail::error_string(err) << '\n' << build_log(ctx->program, e.device);
+                    throw stage_construction_error{"set_device() failed"};
+                }
+
+                BOOST_LOG_TRIVIAL(info) << "OpenCL device #" << num << " is " << device_name(e.device) << " with "
+                                        << ctx->global_mem << " bytes";
+                return ctx;
+            }
+
+            // the largest work group of up to 256 items the kernel supports, wide in x for coalesced accesses
+            auto local_size(const detail::kernel& k, std::size_t dims, std::size_t* local) -> void
+            {
+                auto max = std::size_t{256u};
+                auto supported = std::size_t{};
+                if(clGetKernelWorkGroupInfo(k.get(), detail::current().device, CL_KERNEL_WORK_GROUP_SIZE,
+                                            sizeof(supported), &supported, nullptr) == CL_SUCCESS)
+                    max = std::max(std::min(max, supported), std::size_t{1u});
+
+                local[0] = (dims == 1u) ? max : 16u;
+                local[1] = (dims == 1u) ? 1u : 16u;
+                local[2] = 1u;
+                while(local[0] * local[1] > max)
+                {
+                    if(local[1] > 1u)
+                        local[1] /= 2u;
+                    else
+                        local[0] /= 2u;
+                }
+            }
+        }
+
+        namespace detail
+        {
+            auto device_count() -> int
+            {
+                auto&& r = get_registry();
+                auto&& lock = std::lock_guard<std::mutex>{r.mutex};
+                discover(r);
+                return static_cast<int>(r.devices.size());
+            }
+
+            auto context_of(int device) -> device_context&
+            {
+                auto&& r = get_registry();
+                auto&& lock = std::lock_guard<std::mutex>{r.mutex};
+                discover(r);
+
+                if(device < 0 || static_cast<std::size_t>(device) >= r.devices.size())
+                {
+                    BOOST_LOG_TRIVIAL(fatal) << "There is no OpenCL device #" << device;
+                    throw stage_construction_error{"set_device() failed"};
+                }
+
+                auto&& e = r.devices[static_cast<std::size_t>(device)];
+                if(e.ctx == nullptr)
+                    e.ctx = make_context(e, device);
+
+                return *e.ctx;
+            }
+
+            auto current() -> device_context&
+            {
+                return context_of(current_device);
+            }
+
+            auto error_string(cl_int err) noexcept -> const char*
+            {
+                switch(err)
+                {
+                    case CL_SUCCESS: return "success";
+                    case CL_DEVICE_NOT_FOUND: return "device not found";
+                    case CL_MEM_OBJECT_ALLOCATION_FAILURE: return "memory object allocation failure";
+                    case CL_OUT_OF_RESOURCES: return "out of resources";
+                    case CL_OUT_OF_HOST_MEMORY: return "out of host memory";
+                    case CL_BUILD_PROGRAM_FAILURE: return "build program failure";
+                    case CL_INVALID_VALUE: return "invalid value";
+                    default: return "OpenCL error";
+                }
+            }
+
+            auto check(cl_int err, const char* what) -> void
+            {
+                if(err != CL_SUCCESS)
+                {
+                    BOOST_LOG_TRIVIAL(fatal) << what << ": " << error_string(err) << " (" << err << ")";
+                    throw stage_runtime_error{"OpenCL call failed"};
+                }
+            }
+
+            kernel::kernel(const char* name)
+            {
+                auto err = cl_int{};
+                kernel_ = clCreateKernel(current().program, name, &err);
+                check(err, "Could not create OpenCL kernel");
+            }
+
+            kernel::~kernel()
+            {
+                clReleaseKernel(kernel_);
+            }
+
+            auto launch(cl_command_queue queue, const kernel& k, std::size_t dim_x, std::size_t dim_y,
+                        std::size_t dim_z) -> void
+            {
+                const auto dims = (dim_z > 1u) ? std::size_t{3u} : ((dim_y > 1u) ? std::size_t{2u} : std::size_t{1u});
+
+                std::size_t local[3];
+                local_size(k, dims, local);
+
+                std::size_t global[3] = {(dim_x + local[0] - 1u) / local[0] * local[0],
+                                         (dim_y + local[1] - 1u) / local[1] * local[1],
+                                         dim_z};
+
+                check(clEnqueueNDRangeKernel(queue, k.get(), static_cast<cl_uint>(dims), nullptr, global, local, 0u,
+                                             nullptr, nullptr), "Could not launch OpenCL kernel");
+            }
+
+            auto launch_groups(cl_command_queue queue, const kernel& k, std::size_t groups) -> void
+            {
+                std::size_t local[3];
+                local_size(k, 1u, local);
+
+                std::size_t global[1] = {groups * local[0]};
+                check(clEnqueueNDRangeKernel(queue, k.get(), 1u, nullptr, global, local, 0u, nullptr, nullptr),
+                      "Could not launch OpenCL kernel");
+            }
+
+            auto order(cl_command_queue recorder, cl_command_queue waiter) -> void
+            {
+                if(recorder == waiter)
+                    return;
+
+                auto event = cl_event{};
+                check(clEnqueueMarkerWithWaitList(recorder, 0u, nullptr, &event), "Could not order queues");
+
+                auto err = clEnqueueBarrierWithWaitList(waiter, 1u, &event, nullptr);
+                clReleaseEvent(event);
+                check(err, "Could not order queues");
+            }
+        }
+
+        cl_queue::cl_queue()
+        {
+            auto&& ctx = detail::current();
+            auto err = cl_int{};
+            queue = clCreateCommandQueue(ctx.context, ctx.device, 0u, &err);
+            detail::check(err, "Could not create OpenCL command queue");
+        }
+
+        cl_queue::~cl_queue()
+        {
+            clReleaseCommandQueue(queue);
+        }
+
+        auto get_devices() -> std::vector<device_handle>
+        {
+            auto vec = std::vector<device_handle>{};
+            auto num = detail::device_count();
+
+            if(num == 0)
+                BOOST_LOG_TRIVIAL(error) << "There is no OpenCL GPU or accelerator";
+
+            for(auto i = 0; i < num; ++i)
+                vec.push_back(i);
+
+            return vec;
+        }
+
+        auto set_device(device_handle& device) -> void
+        {
+            // builds the program right away, compiler errors should show up before the pipeline starts
+            detail::context_of(device);
+            current_device = device;
+        }
+    }
+}
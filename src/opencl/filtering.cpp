@@ -0,0 +1,332 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 15 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+#include <boost/log/trivial.hpp>
+
+#include <clFFT.h>
+
+#include "../exception.h"
+
+#include "backend.h"
+#include "context.h"
+
+namespace paris
+{
+    namespace opencl
+    {
+        namespace
+        {
+            auto check_fft(clfftStatus status, const char* what) -> void
+            {
+                if(status != CLFFT_SUCCESS)
+                {
+                    BOOST_LOG_TRIVIAL(fatal) << what << ": clFFT error " << static_cast<int>(status);
+                    throw stage_runtime_error{"apply_filter() failed"};
+                }
+            }
+
+            // clFFT keeps global state which has to be initialised once. It is never torn down as the plans of
+            // other threads may still be alive at exit
+            auto setup_fft() -> void
+            {
+                static std::once_flag flag;
+                std::call_once(flag, []()
+                {
+                    auto data = clfftSetupData{};
+                    check_fft(clfftInitSetupData(&data), "Could not initialise clFFT");
+                    check_fft(clfftSetup(&data), "Could not initialise clFFT");
+                });
+            }
+
+            class fft_plan
+            {
+                public:
+                    fft_plan() noexcept = default;
+                    ~fft_plan()
+                    {
+                        if(handle_ != 0u)
+                            clfftDestroyPlan(&handle_);
+                    }
+
+                    fft_plan(const fft_plan&) = delete;
+                    auto operator=(const fft_plan&) -> fft_plan& = delete;
+
+                    auto handle() noexcept -> clfftPlanHandle& { return handle_; }
+
+                private:
+                    clfftPlanHandle handle_ = 0u;
+            };
+
+            /*
+             * Buffer and plans for one queue -- projections which are filtered concurrently must not share them.
+             * The projections are transformed in place, a line of the buffer holds either the expanded projection
+             * or its transform and is therefore 2 * (filter_size / 2 + 1) floats long.
+             */
+            struct filter_context
+            {
+                filter_context(std::uint32_t filter_size, std::uint32_t lines, cl_command_queue queue)
+                : size_trans{filter_size / 2u + 1u}
+                , stride{2u * size_trans}
+                , n_lines{lines}
+                , buf{detail::make_buffer(static_cast<std::size_t>(stride) * lines * sizeof(float))}
+                {
+                    setup_fft();
+                    make_plan(forward, filter_size, lines, CLFFT_REAL, CLFFT_HERMITIAN_INTERLEAVED, stride, size_trans,
+                              queue);
+                    make_plan(inverse, filter_size, lines, CLFFT_HERMITIAN_INTERLEAVED, CLFFT_REAL, size_trans, stride,
+                              queue);
+                }
+
+                static auto make_plan(fft_plan& plan, std::uint32_t filter_size, std::uint32_t lines,
+                                      clfftLayout in, clfftLayout out, std::size_t in_dist, std::size_t out_dist,
+                                      cl_command_queue queue) -> void
+                {
+                    auto&& ctx = detail::current();
+                    auto length = std::size_t{filter_size};
+                    auto unit = std::size_t{1u};
+
+                    check_fft(clfftCreateDefaultPlan(&plan.handle(), ctx.context, CLFFT_1D, &length),
+                              "Could not create FFT plan");
+                    check_fft(clfftSetPlanPrecision(plan.handle(), CLFFT_SINGLE), "Could not configure FFT plan");
+                    check_fft(clfftSetLayout(plan.handle(), in, out), "Could not configure FFT plan");
+                    check_fft(clfftSetResultLocation(plan.handle(), CLFFT_INPLACE), "Could not configure FFT plan");
+                    check_fft(clfftSetPlanBatchSize(plan.handle(), lines), "Could not configure FFT plan");
+                    check_fft(clfftSetPlanInStride(plan.handle(), CLFFT_1D, &unit), "Could not configure FFT plan");
+                    check_fft(clfftSetPlanOutStride(plan.handle(), CLFFT_1D, &unit), "Could not configure FFT plan");
+                    check_fft(clfftSetPlanDistance(plan.handle(), in_dist, out_dist), "Could not configure FFT plan");
+
+                    // the filter response already includes the normalization
+                    check_fft(clfftSetPlanScale(plan.handle(), CLFFT_BACKWARD, 1.f), "Could not configure FFT plan");
+                    check_fft(clfftBakePlan(plan.handle(), 1u, &queue, nullptr, nullptr), "Could not bake FFT plan");
+                }
+
+                std::uint32_t size_trans;
+                std::uint32_t stride;
+                std::uint32_t n_lines;  // the plans transform all of them, smaller batches leave the rest unused
+                detail::device_ptr buf;
+
+                fft_plan forward;
+                fft_plan inverse;
+            };
+
+            auto transform(fft_plan& plan, clfftDirection dir, cl_mem buf, cl_command_queue queue) -> void
+            {
+                check_fft(clfftEnqueueTransform(plan.handle(), dir, 1u, &queue, 0u, nullptr, nullptr, &buf, nullptr,
+                                                nullptr), "Could not enqueue FFT");
+            }
+
+            /*
+             * Weights, expands, transforms, filters and shrinks the batch projections on one queue. The lines of
+             * the i-th projection start at line i * n_col of the context's buffer.
+             */
+            auto enqueue_filter(filter_context& ctx, projection_device_type* const* p, std::uint32_t batch,
+                                const filter_buffer_type& k, const weight_buffer_type& w,
+                                std::uint32_t filter_size, std::uint32_t n_col, cl_command_queue queue) -> void
+            {
+                thread_local static auto&& expand = detail::kernel{"expand"};
+                thread_local static auto&& apply = detail::kernel{"apply_filter"};
+
+                const auto lines = batch * n_col;
+
+                // weight, expand and transform the projections
+                for(auto i = 0u; i < batch; ++i)
+                {
+                    auto offset = static_cast<std::uint64_t>(i) * n_col * ctx.stride;
+                    expand.set(ctx.buf.get(), offset, ctx.stride, filter_size, p[i]->buf.get(), p[i]->dim_x,
+                               w.get(), p[i]->dim_x, n_col);
+                    detail::launch(queue, expand, filter_size, n_col);
+                }
+                transform(ctx.forward, CLFFT_FORWARD, ctx.buf.get(), queue);
+
+                // apply filter to all transformed projections at once
+                apply.set(ctx.buf.get(), k.get(), ctx.size_trans, lines);
+                detail::launch(queue, apply, ctx.size_trans, lines);
+
+                // inverse transformation
+                transform(ctx.inverse, CLFFT_BACKWARD, ctx.buf.get(), queue);
+
+                // shrink to original size, the filter already took care of the normalization
+                for(auto i = 0u; i < batch; ++i)
+                {
+                    std::size_t src_origin[3] = {0u, static_cast<std::size_t>(i) * n_col, 0u};
+                    std::size_t dst_origin[3] = {0u, 0u, 0u};
+                    std::size_t region[3] = {p[i]->dim_x * sizeof(float), n_col, 1u};
+                    detail::check(clEnqueueCopyBufferRect(queue, ctx.buf.get(), p[i]->buf.get(), src_origin,
+                                                          dst_origin, region, ctx.stride * sizeof(float), 0u,
+                                                          p[i]->dim_x * sizeof(float), 0u, 0u, nullptr, nullptr),
+                                  "Could not copy filtered projection");
+                }
+            }
+        }
+
+        auto make_filter(const std::vector<float>& response) -> filter_buffer_type
+        {
+            auto&& q = cl_queue{};
+            auto k = detail::make_buffer(response.size() * sizeof(float));
+            detail::check(clEnqueueWriteBuffer(q.queue, k.get(), CL_TRUE, 0u, response.size() * sizeof(float),
+                                               response.data(), 0u, nullptr, nullptr),
+                          "Could not upload filter");
+            return k;
+        }
+
+        auto apply_filter(projection_device_type& p, const filter_buffer_type& k, const weight_buffer_type& w,
+                          const filter_plan_type&, std::uint32_t filter_size, std::uint32_t n_col) -> void
+        {
+            // pipelined projections bring their own queue, all others use the local one
+            thread_local static auto&& s = cl_queue{};
+            auto queue = (p.meta == nullptr) ? s.queue : p.meta->queue;
+
+            /*
+             * One context per in-flight slot. They are only kept for the current projection size, a server would
+             * otherwise collect the contexts of every job it has seen.
+             */
+            using key_type = std::tuple<cl_command_queue, std::uint32_t, std::uint32_t>;
+            thread_local static auto contexts = std::map<key_type, std::unique_ptr<filter_context>>{};
+            if(!contexts.empty() && (std::get<1>(contexts.begin()->first) != filter_size ||
+                                     std::get<2>(contexts.begin()->first) != n_col))
+                contexts.clear();
+
+            auto key = std::make_tuple(queue, filter_size, n_col);
+            auto it = contexts.find(key);
+            if(it == std::end(contexts))
+            {
+                auto ctx = std::unique_ptr<filter_context>{new filter_context{filter_size, n_col, queue}};
+                it = contexts.emplace(key, std::move(ctx)).first;
+            }
+
+            auto proj = &p;
+            enqueue_filter(*(it->second), &proj, 1u, k, w, filter_size, n_col, queue);
+
+            if(p.meta == nullptr)
+                detail::check(clFinish(s.queue), "Could not filter projection");
+        }
+
+        auto apply_filter(std::vector<projection_device_type>& p, const filter_buffer_type& k,
+                          const weight_buffer_type& w, const filter_plan_type& plan,
+                          std::uint32_t filter_size, std::uint32_t n_col) -> void
+        {
+            if(p.empty())
+                return;
+
+            if(p.size() == 1u || filter_size > max_batched_filter_size)
+            {
+                for(auto&& proj : p)
+                    apply_filter(proj, k, w, plan, filter_size, n_col);
+                return;
+            }
+
+            // the whole batch is transformed on one queue, its lines are stacked in a single buffer
+            thread_local static auto&& s = cl_queue{};
+            auto batch = static_cast<std::uint32_t>(p.size());
+            auto lines = batch * n_col;
+
+            /*
+             * A single context sized for the largest batch so far, the partial batches at the end of a task run on
+             * its first lines. It is replaced when the projections change.
+             */
+            thread_local static auto ctx = std::unique_ptr<filter_context>{};
+            thread_local static auto ctx_filter_size = std::uint32_t{0u};
+            thread_local static auto ctx_n_col = std::uint32_t{0u};
+            if(ctx == nullptr || ctx_filter_size != filter_size || ctx_n_col != n_col || ctx->n_lines < lines)
+            {
+                // the old buffer may still be in use by the queue
+                detail::check(clFinish(s.queue), "Could not filter projections");
+                ctx.reset();
+                ctx.reset(new filter_context{filter_size, lines, s.queue});
+                ctx_filter_size = filter_size;
+                ctx_n_col = n_col;
+            }
+
+            // pipelined projections: wait until they have been uploaded on their own queues
+            auto projs = std::vector<projection_device_type*>{};
+            for(auto&& proj : p)
+            {
+                if(proj.meta != nullptr)
+                    detail::order(proj.meta->queue, s.queue);
+                projs.push_back(&proj);
+            }
+
+            enqueue_filter(*ctx, projs.data(), batch, k, w, filter_size, n_col, s.queue);
+
+            // later stages on the projections' queues must see the filtered result. The next batch reuses the
+            // buffer but is enqueued on the same queue, so it is ordered anyway
+            auto pipelined = false;
+            for(auto&& proj : p)
+            {
+                if(proj.meta == nullptr)
+                    continue;
+
+                pipelined = true;
+                detail::order(s.queue, proj.meta->queue);
+            }
+
+            if(!pipelined)
+                detail::check(clFinish(s.queue), "Could not filter projections");
+        }
+
+        auto apply_fused_filter(std::vector<projection_device_type>& p, const filter_buffer_type& taps,
+                                const weight_buffer_type& w, std::uint32_t n_col) -> void
+        {
+            if(p.empty())
+                return;
+
+            // the whole batch is filtered on one queue, one work group per row
+            thread_local static auto&& s = cl_queue{};
+            thread_local static auto&& fused = detail::kernel{"fused_filter"};
+
+            for(auto&& proj : p)
+            {
+                if(proj.meta != nullptr)
+                    detail::order(proj.meta->queue, s.queue);
+            }
+
+            for(auto&& proj : p)
+            {
+                fused.set(proj.buf.get(), proj.dim_x, taps.get(), w.get(), proj.dim_x);
+                detail::launch_groups(s.queue, fused, n_col);
+            }
+
+            auto pipelined = false;
+            for(auto&& proj : p)
+            {
+                if(proj.meta == nullptr)
+                    continue;
+
+                pipelined = true;
+                detail::order(s.queue, proj.meta->queue);
+            }
+
+            if(!pipelined)
+                detail::check(clFinish(s.queue), "Could not filter projections");
+        }
+    }
+}
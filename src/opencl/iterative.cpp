@@ -0,0 +1,194 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 15 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <boost/log/trivial.hpp>
+
+#include "../backprojection_constants.h"
+#include "../exception.h"
+
+#include "backend.h"
+#include "context.h"
+
+namespace paris
+{
+    namespace opencl
+    {
+        namespace
+        {
+            // all iterative kernels of a thread run on its own queue and are finished on return
+            auto queue() -> cl_command_queue
+            {
+                thread_local static auto&& q = cl_queue{};
+                return q.queue;
+            }
+
+            auto elements(std::uint32_t x, std::uint32_t y, std::uint32_t z = 1u) noexcept -> std::size_t
+            {
+                return static_cast<std::size_t>(x) * y * z;
+            }
+
+            auto fill_buffer(cl_mem buf, std::size_t n, float value) -> void
+            {
+                detail::check(clEnqueueFillBuffer(queue(), buf, &value, sizeof(value), 0u, n * sizeof(float), 0u,
+                                                  nullptr, nullptr), "Could not fill buffer");
+                detail::check(clFinish(queue()), "Could not fill buffer");
+            }
+
+            auto invert_buffer(cl_mem buf, std::size_t n) -> void
+            {
+                thread_local static auto&& k = detail::kernel{"invert"};
+                k.set(buf, static_cast<std::uint64_t>(n));
+                detail::launch(queue(), k, n);
+                detail::check(clFinish(queue()), "Could not invert buffer");
+            }
+        }
+
+        auto forward_project(const volume_device_type& v, std::uint32_t v_offset,
+                             std::vector<projection_device_type>& p,
+                             const detector_geometry& det_geo, const volume_geometry& vol_geo,
+                             const std::vector<float>& sin, const std::vector<float>& cos,
+                             float delta_s, float delta_t) -> void
+        {
+            if(p.empty())
+                return;
+
+            const auto d_so = det_geo.d_so;
+            const auto d_sd = std::abs(det_geo.d_so) + std::abs(det_geo.d_od);
+
+            // a voxel covers (d_sd / s)^2 * l_vx^2 / l_px^2 pixels and contributes l_vx to each ray through it
+            const auto scale = vol_geo.l_vx_x * vol_geo.l_vx_y * vol_geo.l_vx_z * (d_sd / d_so) * (d_sd / d_so) /
+                               (det_geo.l_px_row * det_geo.l_px_col);
+
+            for(auto&& proj : p)
+                synchronize(proj);
+
+            const auto consts = backprojection_constants{
+                v.dim_x, vol_geo.dim_x, v.dim_y, vol_geo.dim_y, v.dim_z, vol_geo.dim_z, v_offset,
+                vol_geo.l_vx_x, vol_geo.l_vx_y, vol_geo.l_vx_z,
+                det_geo.n_row, det_geo.n_col, p.front().first_row, p.front().first_col,
+                det_geo.l_px_row, det_geo.l_px_col, delta_s, delta_t, d_so, d_sd
+            };
+
+            // the kernel splats into a stack of max_batch_size projections, they are gathered and scattered around it
+            const auto dim_x = p.front().dim_x;
+            const auto dim_y = p.front().dim_y;
+            const auto proj_size = elements(dim_x, dim_y) * sizeof(float);
+
+            thread_local static auto stack_size = std::size_t{0u};
+            thread_local static auto stack = detail::device_ptr{nullptr, detail::mem_deleter{0u, false}};
+            if(stack_size < proj_size * max_batch_size)
+            {
+                stack = detail::make_buffer(proj_size * max_batch_size);
+                stack_size = proj_size * max_batch_size;
+            }
+
+            thread_local static auto&& sincos = detail::make_buffer(2u * max_batch_size * sizeof(float),
+                                                                    CL_MEM_READ_ONLY);
+            thread_local static auto&& k = detail::kernel{"forward_projection"};
+
+            for(auto first = std::size_t{0u}; first < p.size(); first += max_batch_size)
+            {
+                auto n = std::min(p.size() - first, static_cast<std::size_t>(max_batch_size));
+
+                auto sc = std::vector<float>(2u * n);
+                for(auto i = std::size_t{0u}; i < n; ++i)
+                {
+                    sc[2u * i] = sin[first + i];
+                    sc[2u * i + 1u] = cos[first + i];
+                }
+
+                // blocking, sc goes away with the next batch
+                detail::check(clEnqueueWriteBuffer(queue(), sincos.get(), CL_TRUE, 0u, sc.size() * sizeof(float),
+                                                   sc.data(), 0u, nullptr, nullptr),
+                              "Could not initialise forward projection batch");
+
+                for(auto i = std::size_t{0u}; i < n; ++i)
+                    detail::check(clEnqueueCopyBuffer(queue(), p[first + i].buf.get(), stack.get(), 0u,
+                                                      i * proj_size, proj_size, 0u, nullptr, nullptr),
+                                  "Could not gather forward projection batch");
+
+                k.set(v.buf.get(), stack.get(), sincos.get(), static_cast<std::uint32_t>(n), dim_x, dim_y, scale,
+                      consts);
+                detail::launch(queue(), k, v.dim_x, v.dim_y, v.dim_z);
+
+                for(auto i = std::size_t{0u}; i < n; ++i)
+                    detail::check(clEnqueueCopyBuffer(queue(), stack.get(), p[first + i].buf.get(), i * proj_size,
+                                                      0u, proj_size, 0u, nullptr, nullptr),
+                                  "Could not scatter forward projection batch");
+            }
+
+            detail::check(clFinish(queue()), "Could not finish forward projection");
+        }
+
+        auto fill(projection_device_type& p, float value) -> void
+        {
+            synchronize(p);
+            fill_buffer(p.buf.get(), elements(p.dim_x, p.dim_y), value);
+        }
+
+        auto fill(volume_device_type& v, float value) -> void
+        {
+            fill_buffer(v.buf.get(), elements(v.dim_x, v.dim_y, v.dim_z), value);
+        }
+
+        auto invert(projection_device_type& p) -> void
+        {
+            synchronize(p);
+            invert_buffer(p.buf.get(), elements(p.dim_x, p.dim_y));
+        }
+
+        auto invert(volume_device_type& v) -> void
+        {
+            invert_buffer(v.buf.get(), elements(v.dim_x, v.dim_y, v.dim_z));
+        }
+
+        auto residual(const projection_device_type& b, projection_device_type& ax, const projection_device_type& w)
+            -> void
+        {
+            synchronize(ax);
+
+            thread_local static auto&& k = detail::kernel{"residual"};
+            auto n = elements(ax.dim_x, ax.dim_y);
+            k.set(b.buf.get(), ax.buf.get(), w.buf.get(), static_cast<std::uint64_t>(n));
+            detail::launch(queue(), k, n);
+            detail::check(clFinish(queue()), "Could not compute residual");
+        }
+
+        auto update(volume_device_type& x, volume_device_type& corr, const volume_device_type& c, float lambda,
+                    bool nonnegative) -> void
+        {
+            thread_local static auto&& k = detail::kernel{"update"};
+            auto n = elements(x.dim_x, x.dim_y, x.dim_z);
+            k.set(x.buf.get(), corr.buf.get(), c.buf.get(), static_cast<std::uint64_t>(n), lambda,
+                  static_cast<std::int32_t>(nonnegative));
+            detail::launch(queue(), k, n);
+            detail::check(clFinish(queue()), "Could not update volume");
+        }
+    }
+}
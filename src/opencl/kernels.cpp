@@ -0,0 +1,396 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 15 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+
+#include "context.h"
+
+namespace paris
+{
+    namespace opencl
+    {
+        namespace detail
+        {
+            /*
+             * OpenCL C 1.2. The constants mirror backprojection_constants and region_of_interest on the host,
+             * MAX_BATCH_SIZE and MAX_FUSED_WIDTH are defined by the build options.
+             */
+            const char* const kernel_source = R"CLC(
+typedef struct
+{
+    uint vol_dim_x;
+    uint vol_dim_x_full;
+    uint vol_dim_y;
+    uint vol_dim_y_full;
+    uint vol_dim_z;
+    uint vol_dim_z_full;
+    uint vol_offset;
+
+    float l_vx_x;
+    float l_vx_y;
+    float l_vx_z;
+
+    uint proj_dim_x;
+    uint proj_dim_y;
+    uint proj_first_row;
+    uint proj_first_col;
+
+    float l_px_x;
+    float l_px_y;
+
+    float delta_s;
+    float delta_t;
+
+    float d_so;
+    float d_sd;
+} backprojection_constants;
+
+typedef struct
+{
+    uint x1;
+    uint x2;
+    uint y1;
+    uint y2;
+    uint z1;
+    uint z2;
+} region_of_interest;
+
+// beam_geometry
+#define BEAM_CONE 0
+#define BEAM_FAN 1
+#define BEAM_PARALLEL 2
+
+// interpolation, fast_f16 images hold floats as well
+#define INTERP_FAST 0
+#define INTERP_PRECISE 2
+#define INTERP_NEAREST 3
+
+// reciprocals of smaller values are treated as empty rays or voxels
+#define MIN_WEIGHT 1e-6f
+
+inline float vol_centered_coordinate(uint coord, uint dim, float size)
+{
+    const float size2 = size / 2.f;
+    return -(dim * size2) + size2 + coord * size;
+}
+
+inline float proj_real_coordinate(float coord, uint dim, float size, float offset)
+{
+    const float size2 = size / 2.f;
+    const float first = -(dim * size2) - offset;
+    return (coord - first) / size - (1.f / 2.f);
+}
+
+/*
+ * Weighting
+ */
+__kernel void weight_map(__global float* w, uint dim_x, uint dim_y, float h_min, float v_min, float d_sd,
+                         float l_px_row, float l_px_col)
+{
+    const uint s = get_global_id(0);
+    const uint t = get_global_id(1);
+
+    if((s < dim_x) && (t < dim_y))
+    {
+        // detector coordinates in mm
+        const float h_s = (l_px_row / 2.f) + s * l_px_row + h_min;
+        const float v_t = (l_px_col / 2.f) + t * l_px_col + v_min;
+
+        w[(size_t) t * dim_x + s] = d_sd * rsqrt(d_sd * d_sd + h_s * h_s + v_t * v_t);
+    }
+}
+
+/*
+ * Filtering
+ */
+// weights the projection and pads it with zeroes, the lines of dst are stride floats apart
+__kernel void expand(__global float* dst, ulong dst_offset, uint stride, uint dst_dim_x,
+                     __global const float* src, uint src_dim_x, __global const float* w, uint w_dim_x, uint dim_y)
+{
+    const uint x = get_global_id(0);
+    const uint y = get_global_id(1);
+
+    if((x < dst_dim_x) && (y < dim_y))
+    {
+        const float val = (x < src_dim_x) ? src[(size_t) y * src_dim_x + x] * w[(size_t) y * w_dim_x + x] : 0.f;
+        dst[dst_offset + (size_t) y * stride + x] = val;
+    }
+}
+
+__kernel void apply_filter(__global float2* data, __global const float* filter, uint size_trans, uint lines)
+{
+    const uint x = get_global_id(0);
+    const uint y = get_global_id(1);
+
+    if((x < size_trans) && (y < lines))
+        data[(size_t) y * size_trans + x] *= filter[x];
+}
+
+/*
+ * Weights one detector row and convolves it with the spatial taps of the filter in a single pass. The zero padding
+ * of the FFT path corresponds to simply leaving out the taps beyond the row's ends, so the results match. One work
+ * group handles one row.
+ */
+__kernel void fused_filter(__global float* p, uint dim_x, __global const float* taps, __global const float* w,
+                           uint w_dim_x)
+{
+    __local float row[MAX_FUSED_WIDTH];
+    __local float h[2 * MAX_FUSED_WIDTH - 1];
+
+    const uint y = get_group_id(0);
+    const uint lid = get_local_id(0);
+    const uint lsize = get_local_size(0);
+
+    __global float* line = p + (size_t) y * dim_x;
+    __global const float* w_row = w + (size_t) y * w_dim_x;
+
+    for(uint x = lid; x < dim_x; x += lsize)
+        row[x] = line[x] * w_row[x];
+    for(uint j = lid; j < 2u * dim_x - 1u; j += lsize)
+        h[j] = taps[j];
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // h[dim_x - 1] is the centre tap
+    for(uint x = lid; x < dim_x; x += lsize)
+    {
+        float sum = 0.f;
+        for(uint m = 0u; m < dim_x; ++m)
+            sum += row[m] * h[x + dim_x - 1u - m];
+        line[x] = sum;
+    }
+}
+
+/*
+ * Backprojection -- the projections of a batch are the layers of an image array with a zero border like the CUDA
+ * port's layered texture. beam, enable_roi and interp are compile-time constants of the kernels below, the
+ * compiler removes the branches which don't apply.
+ */
+const sampler_t linear_sampler = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP | CLK_FILTER_LINEAR;
+const sampler_t point_sampler = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP | CLK_FILTER_NEAREST;
+
+// samples layer i at (h, v), the pixel centres lie at .5. Precise weights the four neighbours in fp32
+inline float sample(__read_only image2d_array_t proj, float h, float v, float i, const int interp)
+{
+    if(interp == INTERP_FAST)
+        return read_imagef(proj, linear_sampler, (float4)(h, v, i, 0.f)).x;
+    if(interp == INTERP_NEAREST)
+        return read_imagef(proj, point_sampler, (float4)(h, v, i, 0.f)).x;
+
+    const float x1 = floor(h - 0.5f);
+    const float y1 = floor(v - 0.5f);
+    const float fx = h - 0.5f - x1;
+    const float fy = v - 0.5f - y1;
+
+    const float q11 = read_imagef(proj, point_sampler, (float4)(x1 + 0.5f, y1 + 0.5f, i, 0.f)).x;
+    const float q21 = read_imagef(proj, point_sampler, (float4)(x1 + 1.5f, y1 + 0.5f, i, 0.f)).x;
+    const float q12 = read_imagef(proj, point_sampler, (float4)(x1 + 0.5f, y1 + 1.5f, i, 0.f)).x;
+    const float q22 = read_imagef(proj, point_sampler, (float4)(x1 + 1.5f, y1 + 1.5f, i, 0.f)).x;
+
+    const float top = fma(fx, q21 - q11, q11);
+    const float bottom = fma(fx, q22 - q12, q12);
+    return fma(fy, bottom - top, top);
+}
+
+inline void backproject(__global float* vol, __read_only image2d_array_t proj, __constant float* mats, uint n,
+                        backprojection_constants c, region_of_interest roi, const int beam, const int enable_roi,
+                        const int interp)
+{
+    uint k = get_global_id(0);
+    uint l = get_global_id(1);
+    uint m = get_global_id(2);
+
+    if((k >= c.vol_dim_x) || (l >= c.vol_dim_y) || (m >= c.vol_dim_z))
+        return;
+
+    const size_t idx = ((size_t) m * c.vol_dim_y + l) * c.vol_dim_x + k;
+
+    if(enable_roi)
+    {
+        k += roi.x1;
+        l += roi.y1;
+        m += roi.z1;
+    }
+
+    // add offset for the current subvolume
+    m += c.vol_offset;
+
+    // get centered coordinates -- volume center at (0, 0, 0)
+    const float x_k = vol_centered_coordinate(k, c.vol_dim_x_full, c.l_vx_x);
+    const float y_l = vol_centered_coordinate(l, c.vol_dim_y_full, c.l_vx_y);
+    const float z_m = vol_centered_coordinate(m, c.vol_dim_z_full, c.l_vx_z);
+
+    // accumulate the contributions of all projections in the batch before touching the volume
+    float sum = 0.f;
+    for(uint i = 0u; i < n; ++i)
+    {
+        __constant float* a = mats + 12u * i;
+
+        float w_inv = 1.f;
+        if(beam != BEAM_PARALLEL)
+            w_inv = 1.f / (a[8] * x_k + a[9] * y_l + a[10] * z_m + a[11]);
+
+        // add 0.5 to each coordinate to sample the pixel centres
+        const float h = (a[0] * x_k + a[1] * y_l + a[2] * z_m + a[3]) * w_inv - (float) c.proj_first_col + 0.5f;
+        float v = (beam == BEAM_CONE) ? (a[4] * x_k + a[5] * y_l + a[6] * z_m + a[7]) * w_inv
+                                      : a[6] * z_m + a[7];
+        v += -(float) c.proj_first_row + 0.5f;
+
+        const float det = sample(proj, h, v, (float) i, interp);
+
+        if(beam == BEAM_PARALLEL)
+            sum += 0.5f * det;
+        else
+        {
+            const float u = c.d_so * w_inv;
+            sum += 0.5f * det * u * u;
+        }
+    }
+
+    vol[idx] += sum;
+}
+
+#define BACKPROJECTION_KERNEL(name, beam, enable_roi, interp) \
+__kernel void name(__global float* vol, __read_only image2d_array_t proj, __constant float* mats, uint n, \
+                   backprojection_constants c, region_of_interest roi) \
+{ \
+    backproject(vol, proj, mats, n, c, roi, beam, enable_roi, interp); \
+}
+
+#define BACKPROJECTION_KERNELS(suffix, interp) \
+BACKPROJECTION_KERNEL(backproject_cone##suffix, BEAM_CONE, 0, interp) \
+BACKPROJECTION_KERNEL(backproject_cone_roi##suffix, BEAM_CONE, 1, interp) \
+BACKPROJECTION_KERNEL(backproject_fan##suffix, BEAM_FAN, 0, interp) \
+BACKPROJECTION_KERNEL(backproject_fan_roi##suffix, BEAM_FAN, 1, interp) \
+BACKPROJECTION_KERNEL(backproject_parallel##suffix, BEAM_PARALLEL, 0, interp) \
+BACKPROJECTION_KERNEL(backproject_parallel_roi##suffix, BEAM_PARALLEL, 1, interp)
+
+BACKPROJECTION_KERNELS(, INTERP_FAST)
+BACKPROJECTION_KERNELS(_precise, INTERP_PRECISE)
+BACKPROJECTION_KERNELS(_nearest, INTERP_NEAREST)
+
+/*
+ * Iterative reconstruction
+ */
+// OpenCL 1.2 has no floating point atomics
+inline void atomic_add_float(volatile __global float* p, float val)
+{
+    union { uint u; float f; } old_val, new_val;
+    do
+    {
+        old_val.f = *p;
+        new_val.f = old_val.f + val;
+    } while(atomic_cmpxchg((volatile __global uint*) p, old_val.u, new_val.u) != old_val.u);
+}
+
+// the transpose of backproject: every voxel is splatted onto the pixels it would be sampled from. The projections
+// of the batch are stacked in p, sincos holds sin and cos of each of them
+__kernel void forward_projection(__global const float* vol, __global float* p, __constant float* sincos, uint n,
+                                 uint p_dim_x, uint p_dim_y, float scale, backprojection_constants c)
+{
+    const uint k = get_global_id(0);
+    const uint l = get_global_id(1);
+    const uint m = get_global_id(2);
+
+    if((k >= c.vol_dim_x) || (l >= c.vol_dim_y) || (m >= c.vol_dim_z))
+        return;
+
+    const float val = vol[((size_t) m * c.vol_dim_y + l) * c.vol_dim_x + k];
+    if(!(fabs(val) > 0.f))
+        return;
+
+    const float x_k = vol_centered_coordinate(k, c.vol_dim_x_full, c.l_vx_x);
+    const float y_l = vol_centered_coordinate(l, c.vol_dim_y_full, c.l_vx_y);
+    const float z_m = vol_centered_coordinate(m + c.vol_offset, c.vol_dim_z_full, c.l_vx_z);
+
+    for(uint i = 0u; i < n; ++i)
+    {
+        const float sn = sincos[2u * i];
+        const float cs = sincos[2u * i + 1u];
+        const float s = x_k * cs + y_l * sn;
+        const float t = -x_k * sn + y_l * cs;
+
+        const float factor = c.d_sd / (s + c.d_so);
+        const float h = proj_real_coordinate(t * factor, c.proj_dim_x, c.l_px_x, c.delta_s)
+                      - (float) c.proj_first_col;
+        const float v = proj_real_coordinate(z_m * factor, c.proj_dim_y, c.l_px_y, c.delta_t)
+                      - (float) c.proj_first_row;
+
+        const float x1 = floor(h);
+        const float y1 = floor(v);
+        const float fx = h - x1;
+        const float fy = v - y1;
+
+        // same footprint as the image lookup of the backprojection (zero border)
+        const float u = c.d_so / (s + c.d_so);
+        const float w = scale * u * u * val;
+
+        __global float* proj = p + (size_t) i * p_dim_x * p_dim_y;
+        const int xi = (int) x1;
+        const int yi = (int) y1;
+        for(int dy = 0; dy < 2; ++dy)
+        {
+            const int y = yi + dy;
+            if(y < 0 || y >= (int) p_dim_y)
+                continue;
+
+            const float wy = (dy == 0) ? (1.f - fy) : fy;
+            for(int dx = 0; dx < 2; ++dx)
+            {
+                const int x = xi + dx;
+                if(x < 0 || x >= (int) p_dim_x)
+                    continue;
+
+                const float wx = (dx == 0) ? (1.f - fx) : fx;
+                atomic_add_float(proj + (size_t) y * p_dim_x + x, wx * wy * w);
+            }
+        }
+    }
+}
+
+__kernel void invert(__global float* p, ulong n)
+{
+    const size_t i = get_global_id(0);
+    if(i < n)
+        p[i] = (p[i] > MIN_WEIGHT) ? 1.f / p[i] : 0.f;
+}
+
+__kernel void residual(__global const float* b, __global float* ax, __global const float* w, ulong n)
+{
+    const size_t i = get_global_id(0);
+    if(i < n)
+        ax[i] = (b[i] - ax[i]) * w[i];
+}
+
+__kernel void update(__global float* x, __global float* corr, __global const float* c, ulong n, float lambda,
+                     int nonnegative)
+{
+    const size_t i = get_global_id(0);
+    if(i < n)
+    {
+        const float val = x[i] + lambda * c[i] * corr[i];
+        x[i] = nonnegative ? fmax(val, 0.f) : val;
+        corr[i] = 0.f;
+    }
+}
+)CLC";
+        }
+    }
+}
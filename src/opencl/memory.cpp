@@ -0,0 +1,276 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 15 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include <boost/log/trivial.hpp>
+
+#include "../exception.h"
+
+#include "backend.h"
+#include "context.h"
+
+namespace paris
+{
+    namespace opencl
+    {
+        namespace
+        {
+            std::atomic<std::uint32_t> pipeline_depth{1u};
+
+            // released device buffers, grouped by their context and size
+            struct device_pool
+            {
+                std::mutex mutex;
+                std::map<std::pair<cl_context, std::size_t>, std::vector<cl_mem>> free;
+            };
+
+            // buffers may be released during static destruction -> the pool is never destroyed
+            auto get_device_pool() -> device_pool&
+            {
+                static auto pool = new device_pool{};
+                return *pool;
+            }
+
+            // transfers of the calling thread which don't belong to a pipelined projection
+            auto local_queue() -> cl_command_queue
+            {
+                thread_local static auto&& q = cl_queue{};
+                return q.queue;
+            }
+
+            auto queue_of(const projection_device_type& p) -> cl_command_queue
+            {
+                return (p.meta == nullptr) ? local_queue() : p.meta->queue;
+            }
+
+            constexpr auto elements(std::uint32_t x, std::uint32_t y, std::uint32_t z = 1u) noexcept -> std::size_t
+            {
+                return static_cast<std::size_t>(x) * y * z;
+            }
+        }
+
+        namespace detail
+        {
+            auto mem_deleter::operator()(cl_mem m) noexcept -> void
+            {
+                if(pooled)
+                {
+                    auto ctx = cl_context{};
+                    if(clGetMemObjectInfo(m, CL_MEM_CONTEXT, sizeof(ctx), &ctx, nullptr) == CL_SUCCESS)
+                    {
+                        auto&& pool = get_device_pool();
+                        auto&& lock = std::lock_guard<std::mutex>{pool.mutex};
+                        try
+                        {
+                            pool.free[std::make_pair(ctx, size)].push_back(m);
+                            return;
+                        }
+                        catch(const std::bad_alloc&)
+                        {
+                            // fall through and free the buffer
+                        }
+                    }
+                }
+                clReleaseMemObject(m);
+            }
+
+            auto make_buffer(std::size_t size, cl_mem_flags flags) -> device_ptr
+            {
+                auto&& ctx = current();
+                if(size > ctx.max_alloc)
+                {
+                    BOOST_LOG_TRIVIAL(fatal) << "Could not allocate " << size << " bytes of device memory, the device "
+                                             << "supports buffers of up to " << ctx.max_alloc << " bytes";
+                    throw stage_runtime_error{"make_buffer() failed"};
+                }
+
+                // OpenCL rejects empty buffers
+                auto err = cl_int{};
+                auto m = clCreateBuffer(ctx.context, flags, std::max(size, sizeof(float)), nullptr, &err);
+                check(err, "Could not allocate device memory");
+                return device_ptr{m, mem_deleter{size, false}};
+            }
+
+            auto make_pooled_buffer(std::size_t size) -> device_ptr
+            {
+                auto&& ctx = current();
+                {
+                    auto&& pool = get_device_pool();
+                    auto&& lock = std::lock_guard<std::mutex>{pool.mutex};
+                    auto it = pool.free.find(std::make_pair(ctx.context, size));
+                    if(it != std::end(pool.free) && !it->second.empty())
+                    {
+                        auto m = it->second.back();
+                        it->second.pop_back();
+                        return device_ptr{m, mem_deleter{size, true}};
+                    }
+                }
+
+                auto ptr = make_buffer(size);
+                ptr.get_deleter().pooled = true;
+                return ptr;
+            }
+        }
+
+        auto set_pipeline_depth(std::uint32_t depth) noexcept -> void
+        {
+            pipeline_depth = std::max(depth, 1u);
+        }
+
+        auto synchronize(const projection_device_type& p) -> void
+        {
+            if(p.meta != nullptr)
+                detail::check(clFinish(p.meta->queue), "Could not synchronize projection queue");
+        }
+
+        auto make_projection_host(std::uint32_t dim_x, std::uint32_t dim_y) -> projection_host_type
+        {
+            auto ptr = std::unique_ptr<float[]>{new float[elements(dim_x, dim_y)]};
+            return projection_host_type{std::move(ptr), dim_x, dim_y, 0u, 0.f, metadata{nullptr}};
+        }
+
+        auto make_projection_device(std::uint32_t dim_x, std::uint32_t dim_y) -> projection_device_type
+        {
+            auto ptr = detail::make_pooled_buffer(elements(dim_x, dim_y) * sizeof(float));
+
+            // every projection in flight gets its own queue. A depth of 1 keeps everything synchronous
+            static const auto depth = pipeline_depth.load();
+            auto meta = metadata{nullptr};
+            if(depth > 1u)
+            {
+                thread_local static auto queues = std::unique_ptr<cl_queue[]>{new cl_queue[depth]};
+                thread_local static auto next = 0u;
+                meta = &queues[next];
+                next = (next + 1u) % depth;
+            }
+
+            return projection_device_type{std::move(ptr), dim_x, dim_y, 0u, 0.f, meta};
+        }
+
+        auto make_volume_host(std::uint32_t dim_x, std::uint32_t dim_y, std::uint32_t dim_z) -> volume_host_type
+        {
+            auto ptr = std::unique_ptr<float[]>{new float[elements(dim_x, dim_y, dim_z)]};
+            return volume_host_type{std::move(ptr), dim_x, dim_y, dim_z, 0u};
+        }
+
+        auto make_volume_device(std::uint32_t dim_x, std::uint32_t dim_y, std::uint32_t dim_z) -> volume_device_type
+        {
+            auto size = elements(dim_x, dim_y, dim_z) * sizeof(float);
+            auto ptr = detail::make_buffer(size);
+
+            const auto zero = 0.f;
+            auto q = local_queue();
+            detail::check(clEnqueueFillBuffer(q, ptr.get(), &zero, sizeof(zero), 0u, size, 0u, nullptr, nullptr),
+                          "Could not clear volume");
+            detail::check(clFinish(q), "Could not clear volume");
+
+            return volume_device_type{std::move(ptr), dim_x, dim_y, dim_z, 0u};
+        }
+
+        auto map_volume(int, std::uint64_t, std::uint32_t, std::uint32_t, std::uint32_t) -> volume_device_type
+        {
+            BOOST_LOG_TRIVIAL(fatal) << "The OpenCL backend cannot map volumes into host memory";
+            throw stage_runtime_error{"map_volume() failed"};
+        }
+
+        auto copy_h2d(const projection_host_type& h_p, projection_device_type& d_p) -> void
+        {
+            copy_h2d(h_p, d_p, 0u);
+        }
+
+        auto copy_h2d(const projection_host_type& h_p, projection_device_type& d_p, std::uint32_t first) -> void
+        {
+            // the host buffer may be released as soon as we return -> blocking write
+            std::size_t buffer_origin[3] = {0u, 0u, 0u};
+            std::size_t host_origin[3] = {0u, first, 0u};
+            std::size_t region[3] = {d_p.dim_x * sizeof(float), d_p.dim_y, 1u};
+            detail::check(clEnqueueWriteBufferRect(queue_of(d_p), d_p.buf.get(), CL_TRUE, buffer_origin, host_origin,
+                                                   region, d_p.dim_x * sizeof(float), 0u, h_p.dim_x * sizeof(float),
+                                                   0u, h_p.buf.get(), 0u, nullptr, nullptr),
+                          "Could not copy projection rows");
+
+            d_p.idx = h_p.idx;
+            d_p.phi = h_p.phi;
+            d_p.first_row = h_p.first_row + first;
+            d_p.first_col = h_p.first_col;
+        }
+
+        auto copy_d2h(const projection_device_type& d_p, projection_host_type& h_p) -> void
+        {
+            copy_d2h(d_p, h_p, 0u);
+        }
+
+        auto copy_d2h(const projection_device_type& d_p, projection_host_type& h_p, std::uint32_t first) -> void
+        {
+            // the host is going to read the result right away
+            std::size_t buffer_origin[3] = {first * sizeof(float), 0u, 0u};
+            std::size_t host_origin[3] = {0u, 0u, 0u};
+            std::size_t region[3] = {h_p.dim_x * sizeof(float), h_p.dim_y, 1u};
+            detail::check(clEnqueueReadBufferRect(queue_of(d_p), d_p.buf.get(), CL_TRUE, buffer_origin, host_origin,
+                                                  region, d_p.dim_x * sizeof(float), 0u, h_p.dim_x * sizeof(float),
+                                                  0u, h_p.buf.get(), 0u, nullptr, nullptr),
+                          "Could not copy projection columns");
+
+            h_p.idx = d_p.idx;
+            h_p.phi = d_p.phi;
+            h_p.first_row = d_p.first_row;
+            h_p.first_col = d_p.first_col + first;
+        }
+
+        auto copy_h2d(const volume_host_type& h_v, volume_device_type& d_v) -> void
+        {
+            detail::check(clEnqueueWriteBuffer(local_queue(), d_v.buf.get(), CL_TRUE, 0u,
+                                               elements(h_v.dim_x, h_v.dim_y, h_v.dim_z) * sizeof(float),
+                                               h_v.buf.get(), 0u, nullptr, nullptr),
+                          "Could not copy volume");
+            d_v.off = h_v.off;
+        }
+
+        auto copy_d2h(const volume_device_type& d_v, volume_host_type& h_v) -> void
+        {
+            copy_d2h(d_v, h_v, 0u);
+        }
+
+        auto copy_d2h(const volume_device_type& d_v, volume_host_type& h_v, std::uint32_t first) -> void
+        {
+            // volume downloads get their own queue so they don't queue behind the projection traffic
+            thread_local static auto&& q = cl_queue{};
+
+            auto slice = elements(d_v.dim_x, d_v.dim_y) * sizeof(float);
+            detail::check(clEnqueueReadBuffer(q.queue, d_v.buf.get(), CL_TRUE, first * slice, h_v.dim_z * slice,
+                                              h_v.buf.get(), 0u, nullptr, nullptr),
+                          "Could not copy volume slab");
+            h_v.off = d_v.off + first;
+        }
+    }
+}
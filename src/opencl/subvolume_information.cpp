@@ -0,0 +1,164 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 15 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include <boost/log/trivial.hpp>
+
+#include "../exception.h"
+#include "../filtering.h"
+#include "../geometry.h"
+#include "../subvolume_information.h"
+
+#include "backend.h"
+#include "context.h"
+
+namespace paris
+{
+    namespace opencl
+    {
+        namespace
+        {
+            // number of subvolumes each device processes if there is more than one device
+            constexpr auto slabs_per_device = std::uint32_t{4u};
+
+            /*
+             * See filter_context in filtering.cpp: one buffer with lines of 2 * (filter_size / 2 + 1) floats. clFFT
+             * doesn't report its temporary buffers before baking, they are assumed to be as large as the data.
+             */
+            auto filter_context_size(std::uint32_t filter_size, std::uint32_t lines) noexcept -> std::size_t
+            {
+                auto data = 2u * (filter_size / 2u + 1u) * sizeof(float) * lines;
+                return 2u * data;
+            }
+
+            // every device buffer of the pipeline except for the volume
+            auto plan_memory(const detector_geometry& det_geo, const memory_parameters& mem) -> memory_plan
+            {
+                auto plan = memory_plan{};
+                auto batch = std::max(std::min(mem.batch_size, max_batch_size), 1u);
+                auto depth = std::max(mem.pipeline_depth, 1u);
+                auto proj = static_cast<std::size_t>(det_geo.n_row) * mem.rows * sizeof(float);
+
+                // unfiltered and batched projections plus those still in flight after a backprojection pass
+                plan.projections = (3u * batch + depth + 1u) * proj;
+
+                /*
+                 * Small detectors are convolved directly. All others are transformed by a context per queue for
+                 * single projections and, for short filters, one context holding a whole batch.
+                 */
+                auto filter_size = filter_length(det_geo);
+                plan.filtering = proj + (filter_size / 2u + 1u) * sizeof(float);
+                if(det_geo.n_row > max_fused_width)
+                {
+                    plan.filtering += (depth + 1u) * filter_context_size(filter_size, mem.rows);
+                    if(batch > 1u && filter_size <= max_batched_filter_size)
+                        plan.filtering += filter_context_size(filter_size, batch * mem.rows);
+                }
+
+                // the image array of the backprojection context covers the whole detector
+                plan.backprojection = static_cast<std::size_t>(det_geo.n_row) * det_geo.n_col * max_batch_size
+                                    * sizeof(float);
+
+                BOOST_LOG_TRIVIAL(info) << "The projection buffers require " << plan.projections << " bytes";
+                BOOST_LOG_TRIVIAL(info) << "Filtering requires " << plan.filtering << " bytes";
+                BOOST_LOG_TRIVIAL(info) << "The backprojection requires " << plan.backprojection << " bytes";
+
+                return plan;
+            }
+        }
+
+        auto make_subvolume_information(const volume_geometry& vol_geo, const detector_geometry& det_geo,
+                                        const memory_parameters& mem) -> subvolume_info
+        {
+            auto subvol_info = subvolume_info{};
+            auto plan = plan_memory(det_geo, mem);
+            auto fixed = plan.projections + plan.filtering + plan.backprojection;
+            auto slice = static_cast<std::size_t>(vol_geo.dim_x) * vol_geo.dim_y * sizeof(float);
+
+            auto devices = detail::device_count();
+            if(devices == 0)
+            {
+                BOOST_LOG_TRIVIAL(fatal) << "No OpenCL device found";
+                throw stage_construction_error{"create_subvolume_information() failed"};
+            }
+
+            // any device may pick up any subvolume -> the device with the least memory limits the size
+            auto max_dim_z = vol_geo.dim_z;
+            plan.budget = std::numeric_limits<std::size_t>::max();
+            for(auto d = 0; d < devices; ++d)
+            {
+                auto&& ctx = detail::context_of(d);
+
+                // OpenCL can't tell how much memory is free, the whole device is assumed to be ours
+                auto mem_total = ctx.global_mem;
+                auto budget = (mem.budget != 0u) ? std::min(mem.budget, mem_total) : mem_total - mem_total / 10u;
+                auto dev_dim_z = (budget > fixed) ? static_cast<std::uint32_t>(
+                                    std::min((budget - fixed) / slice, static_cast<std::size_t>(vol_geo.dim_z)))
+                                                  : 0u;
+
+                // the subvolume is a single buffer
+                dev_dim_z = std::min(dev_dim_z, static_cast<std::uint32_t>(
+                                        std::min(ctx.max_alloc / slice, static_cast<std::size_t>(vol_geo.dim_z))));
+
+                BOOST_LOG_TRIVIAL(info) << "Device #" << d << " has " << mem_total << " bytes, "
+                                        << budget << " bytes budgeted, and fits " << dev_dim_z << " slices";
+                max_dim_z = std::min(max_dim_z, dev_dim_z);
+                plan.budget = std::min(plan.budget, budget);
+            }
+
+            if(max_dim_z == 0u)
+            {
+                BOOST_LOG_TRIVIAL(fatal) << "Not a single slice fits into the device memory budget";
+                throw stage_construction_error{"create_subvolume_information() failed"};
+            }
+
+            // the smallest number of subvolumes which fit -- the last one also holds the remainder
+            auto vols_needed = (vol_geo.dim_z + max_dim_z - 1u) / max_dim_z;
+            while(vol_geo.dim_z / vols_needed + vol_geo.dim_z % vols_needed > max_dim_z)
+                ++vols_needed;
+
+            // several devices: split finer so faster devices can take over more subvolumes
+            auto d_u = static_cast<std::uint32_t>(devices);
+            if(d_u > 1u)
+                vols_needed = std::min(std::max(vols_needed, slabs_per_device * d_u), vol_geo.dim_z);
+
+            subvol_info.geo.dim_x = vol_geo.dim_x;
+            subvol_info.geo.dim_y = vol_geo.dim_y;
+            subvol_info.geo.dim_z = vol_geo.dim_z / vols_needed;
+            subvol_info.geo.remainder = vol_geo.dim_z % vols_needed;
+            subvol_info.num = static_cast<int>(vols_needed);
+
+            plan.volume = (subvol_info.geo.dim_z + subvol_info.geo.remainder) * slice;
+            subvol_info.plan = plan;
+
+            BOOST_LOG_TRIVIAL(info) << "Planned " << vols_needed << " subvolumes, each device needs "
+                                    << plan.volume + fixed << " of " << plan.budget << " bytes";
+
+            return subvol_info;
+        }
+    }
+}
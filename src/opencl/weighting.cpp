@@ -0,0 +1,48 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 15 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include "backend.h"
+#include "context.h"
+
+namespace paris
+{
+    namespace opencl
+    {
+        auto make_weights(std::uint32_t dim_x, std::uint32_t dim_y, float h_min, float v_min, float d_sd,
+                          float l_px_row, float l_px_col) -> weight_buffer_type
+        {
+            auto&& q = cl_queue{};
+            auto w = detail::make_buffer(static_cast<std::size_t>(dim_x) * dim_y * sizeof(float));
+
+            auto&& k = detail::kernel{"weight_map"};
+            k.set(w.get(), dim_x, dim_y, h_min, v_min, d_sd, l_px_row, l_px_col);
+            detail::launch(q.queue, k, dim_x, dim_y);
+            detail::check(clFinish(q.queue), "Could not compute the weights");
+
+            return w;
+        }
+    }
+}
@@ -20,15 +20,25 @@
  * Authors: Jan Stephan <j.stephan@hzdr.de>
  */
 
+#include <algorithm>
 #include <cmath>
+#include <cstddef>
 #include <cstdint>
 #include <type_traits>
+#include <vector>
 
 #include <boost/log/trivial.hpp>
 
+#include "../interpolation.h"
 #include "../region_of_interest.h"
 
 #include "backend.h"
+#include "cpu.h"
+#include "numa.h"
+
+#if PARIS_OPENMP_X86
+#include <immintrin.h>
+#endif
 
 namespace paris
 {
@@ -36,166 +46,1074 @@ namespace paris
     {
         namespace
         {
+            // per-core share of L2 available for the detector footprint of one z-slab
+            constexpr auto l2_budget = std::size_t{256u} << 10u;
+
+            /*
+             * The mode of the calling thread's backprojections, see set_interpolation(). The kernels are instantiated
+             * for precise -- which the fast modes map to -- and nearest. Nearest samples reach half a pixel further
+             * out than bilinear ones, the hit ranges get this as a margin.
+             */
+            thread_local interpolation interp_mode = interpolation::fast;
+
+            constexpr auto margin(interpolation mode) noexcept -> float
+            {
+                return (mode == interpolation::nearest) ? 0.5f : 0.f;
+            }
+
             inline auto vol_centered_coordinate(std::uint32_t coord, std::uint32_t dim, float size) noexcept -> float
             {
                 auto size2 = size / 2.f;
                 return -(static_cast<float>(dim) * size2) + size2 + static_cast<float>(coord) * size;
             }
 
-            inline auto proj_real_coordinate(float coord, std::uint32_t dim, float size, float offset) noexcept -> float
+            // the detector coordinate c maps to the pixel coordinate c / size + proj_offset()
+            inline auto proj_offset(std::uint32_t dim, float size, float offset) noexcept -> float
             {
                 auto size2 = size / 2.f;
                 auto min = -(static_cast<float>(dim) * size2) - offset;
-                return (coord - min) / size - (1.f / 2.f);
+                return -min / size - (1.f / 2.f);
+            }
+
+            /*
+             * Everything needed to backproject one projection onto one row of voxels along x. Along the row the
+             * rows of the projection matrix change linearly: w = s0 + k * ds, h * w = h0 + k * dh and
+             * v * w = v0 + k * dv.
+             */
+            struct row_params
+            {
+                const float* p;
+                std::uint32_t p_dim_x;
+                std::uint32_t p_dim_y;
+
+                float s0;   // includes d_so
+                float ds;
+                float h0;
+                float dh;
+                float v0;
+                float dv;
+
+                float h_off; // the first column and row held by the buffer
+                float v_off;
+                float d_so;
+            };
+
+            // the projection matrix of a circular trajectory at the given angle
+            auto circular_matrix(float sin, float cos, float a_h, float a_v, float h_c, float v_c, float d_so) noexcept
+            -> projection_matrix
+            {
+                return projection_matrix{{-a_h * sin + h_c * cos, a_h * cos + h_c * sin, 0.f, h_c * d_so,
+                                          v_c * cos, v_c * sin, a_v, v_c * d_so,
+                                          cos, sin, 0.f, d_so}};
+            }
+
+            /*
+             * The same for fan and parallel beams. Their second row is affine -- v = a[6] * z + a[7] -- as every
+             * slice is seen by the same detector row, and a parallel beam also has a constant third row w = 1.
+             */
+            auto separable_matrix(beam_geometry beam, float sin, float cos, float a_h, float a_v, float h_c, float v_c,
+                                  float d_so) noexcept -> projection_matrix
+            {
+                if(beam == beam_geometry::fan)
+                    return projection_matrix{{-a_h * sin + h_c * cos, a_h * cos + h_c * sin, 0.f, h_c * d_so,
+                                              0.f, 0.f, a_v / d_so, v_c,
+                                              cos, sin, 0.f, d_so}};
+
+                return projection_matrix{{-a_h * sin, a_h * cos, 0.f, h_c,
+                                          0.f, 0.f, a_v, v_c,
+                                          0.f, 0.f, 0.f, 1.f}};
+            }
+
+            /*
+             * Branch-free bilinear interpolation, samples without all four neighbours contribute nothing. Nearest
+             * takes the closest pixel instead.
+             */
+            template <interpolation mode>
+            PARIS_OPENMP_MULTIVERSION
+            auto backproject_row_generic(float* sum, std::uint32_t first, std::uint32_t n_x,
+                                                const row_params& rp) noexcept -> void
+            {
+                const auto max_x = static_cast<float>(rp.p_dim_x) - 1.f;
+                const auto max_y = static_cast<float>(rp.p_dim_y) - 1.f;
+                const auto stride = static_cast<std::int32_t>(rp.p_dim_x);
+
+                if(mode == interpolation::nearest)
+                {
+                    #pragma omp simd
+                    for(auto k = first; k < n_x; ++k)
+                    {
+                        const auto kf = static_cast<float>(k);
+                        const auto w = 1.f / (rp.s0 + kf * rp.ds);
+                        const auto x = std::floor((rp.h0 + kf * rp.dh) * w + rp.h_off + 0.5f);
+                        const auto y = std::floor((rp.v0 + kf * rp.dv) * w + rp.v_off + 0.5f);
+
+                        const auto valid = (x >= 0.f) & (x <= max_x) & (y >= 0.f) & (y <= max_y);
+                        const auto idx = static_cast<std::int32_t>(valid ? x : 0.f)
+                                       + static_cast<std::int32_t>(valid ? y : 0.f) * stride;
+
+                        const auto u = rp.d_so * w;
+                        sum[k] += valid ? 0.5f * rp.p[idx] * u * u : 0.f;
+                    }
+                    return;
+                }
+
+                #pragma omp simd
+                for(auto k = first; k < n_x; ++k)
+                {
+                    const auto kf = static_cast<float>(k);
+                    const auto w = 1.f / (rp.s0 + kf * rp.ds);
+                    const auto h = (rp.h0 + kf * rp.dh) * w + rp.h_off;
+                    const auto v = (rp.v0 + kf * rp.dv) * w + rp.v_off;
+
+                    const auto x1 = std::floor(h);
+                    const auto y1 = std::floor(v);
+                    const auto fx = h - x1;
+                    const auto fy = v - y1;
+
+                    const auto valid = (x1 >= 0.f) & (x1 < max_x) & (y1 >= 0.f) & (y1 < max_y);
+                    const auto idx = static_cast<std::int32_t>(valid ? x1 : 0.f)
+                                   + static_cast<std::int32_t>(valid ? y1 : 0.f) * stride;
+
+                    const auto q11 = rp.p[idx];
+                    const auto q21 = rp.p[idx + 1];
+                    const auto q12 = rp.p[idx + stride];
+                    const auto q22 = rp.p[idx + stride + 1];
+
+                    const auto top = q11 + fx * (q21 - q11);
+                    const auto bottom = q12 + fx * (q22 - q12);
+                    const auto det = top + fy * (bottom - top);
+
+                    const auto u = rp.d_so * w;
+                    sum[k] += valid ? 0.5f * det * u * u : 0.f;
+                }
+            }
+
+#if PARIS_OPENMP_X86
+            PARIS_OPENMP_TARGET("avx2,fma")
+            auto backproject_row_avx2(float* sum, std::uint32_t n_x, const row_params& rp) noexcept -> void
+            {
+                const auto lane = _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f);
+                const auto zero = _mm256_setzero_ps();
+                const auto one = _mm256_set1_ps(1.f);
+                const auto half = _mm256_set1_ps(0.5f);
+                const auto max_x = _mm256_set1_ps(static_cast<float>(rp.p_dim_x) - 1.f);
+                const auto max_y = _mm256_set1_ps(static_cast<float>(rp.p_dim_y) - 1.f);
+                const auto stride = _mm256_set1_epi32(static_cast<int>(rp.p_dim_x));
+
+                const auto s0 = _mm256_set1_ps(rp.s0);
+                const auto ds = _mm256_set1_ps(rp.ds);
+                const auto h0 = _mm256_set1_ps(rp.h0);
+                const auto dh = _mm256_set1_ps(rp.dh);
+                const auto v0 = _mm256_set1_ps(rp.v0);
+                const auto dv = _mm256_set1_ps(rp.dv);
+                const auto h_off = _mm256_set1_ps(rp.h_off);
+                const auto v_off = _mm256_set1_ps(rp.v_off);
+                const auto d_so = _mm256_set1_ps(rp.d_so);
+
+                const auto p11 = rp.p;
+                const auto p21 = rp.p + 1;
+                const auto p12 = rp.p + rp.p_dim_x;
+                const auto p22 = rp.p + rp.p_dim_x + 1;
+
+                auto k = 0u;
+                for(; k + 8u <= n_x; k += 8u)
+                {
+                    const auto kf = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(k)), lane);
+                    const auto w = _mm256_div_ps(one, _mm256_fmadd_ps(kf, ds, s0));
+                    const auto h = _mm256_fmadd_ps(_mm256_fmadd_ps(kf, dh, h0), w, h_off);
+                    const auto v = _mm256_fmadd_ps(_mm256_fmadd_ps(kf, dv, v0), w, v_off);
+
+                    const auto x1 = _mm256_floor_ps(h);
+                    const auto y1 = _mm256_floor_ps(v);
+                    const auto fx = _mm256_sub_ps(h, x1);
+                    const auto fy = _mm256_sub_ps(v, y1);
+
+                    const auto valid = _mm256_and_ps(
+                                        _mm256_and_ps(_mm256_cmp_ps(x1, zero, _CMP_GE_OQ),
+                                                      _mm256_cmp_ps(x1, max_x, _CMP_LT_OQ)),
+                                        _mm256_and_ps(_mm256_cmp_ps(y1, zero, _CMP_GE_OQ),
+                                                      _mm256_cmp_ps(y1, max_y, _CMP_LT_OQ)));
+
+                    // invalid lanes are neither converted nor loaded
+                    const auto xi = _mm256_cvttps_epi32(_mm256_and_ps(x1, valid));
+                    const auto yi = _mm256_cvttps_epi32(_mm256_and_ps(y1, valid));
+                    const auto idx = _mm256_add_epi32(xi, _mm256_mullo_epi32(yi, stride));
+
+                    const auto q11 = _mm256_mask_i32gather_ps(zero, p11, idx, valid, 4);
+                    const auto q21 = _mm256_mask_i32gather_ps(zero, p21, idx, valid, 4);
+                    const auto q12 = _mm256_mask_i32gather_ps(zero, p12, idx, valid, 4);
+                    const auto q22 = _mm256_mask_i32gather_ps(zero, p22, idx, valid, 4);
+
+                    const auto top = _mm256_fmadd_ps(fx, _mm256_sub_ps(q21, q11), q11);
+                    const auto bottom = _mm256_fmadd_ps(fx, _mm256_sub_ps(q22, q12), q12);
+                    const auto det = _mm256_fmadd_ps(fy, _mm256_sub_ps(bottom, top), top);
+
+                    const auto u = _mm256_mul_ps(d_so, w);
+                    const auto weight = _mm256_mul_ps(half, _mm256_mul_ps(u, u));
+                    _mm256_storeu_ps(sum + k, _mm256_fmadd_ps(det, weight, _mm256_loadu_ps(sum + k)));
+                }
+
+                backproject_row_generic<interpolation::precise>(sum, k, n_x, rp);
+            }
+
+/*
+ * without optimization GCC implements some AVX-512 intrinsics as macros which trigger conversion warnings, and
+ * _mm512_roundscale_ps() starts from an undefined vector which -Wmaybe-uninitialized reports
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#if !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+            PARIS_OPENMP_TARGET("avx512f")
+            auto backproject_row_avx512(float* sum, std::uint32_t n_x, const row_params& rp) noexcept -> void
+            {
+                const auto lane = _mm512_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f,
+                                                 8.f, 9.f, 10.f, 11.f, 12.f, 13.f, 14.f, 15.f);
+                const auto zero = _mm512_setzero_ps();
+                const auto one = _mm512_set1_ps(1.f);
+                const auto half = _mm512_set1_ps(0.5f);
+                const auto max_x = _mm512_set1_ps(static_cast<float>(rp.p_dim_x) - 1.f);
+                const auto max_y = _mm512_set1_ps(static_cast<float>(rp.p_dim_y) - 1.f);
+                const auto stride = _mm512_set1_epi32(static_cast<int>(rp.p_dim_x));
+
+                const auto s0 = _mm512_set1_ps(rp.s0);
+                const auto ds = _mm512_set1_ps(rp.ds);
+                const auto h0 = _mm512_set1_ps(rp.h0);
+                const auto dh = _mm512_set1_ps(rp.dh);
+                const auto v0 = _mm512_set1_ps(rp.v0);
+                const auto dv = _mm512_set1_ps(rp.dv);
+                const auto h_off = _mm512_set1_ps(rp.h_off);
+                const auto v_off = _mm512_set1_ps(rp.v_off);
+                const auto d_so = _mm512_set1_ps(rp.d_so);
+
+                const auto p11 = rp.p;
+                const auto p21 = rp.p + 1;
+                const auto p12 = rp.p + rp.p_dim_x;
+                const auto p22 = rp.p + rp.p_dim_x + 1;
+
+                auto k = 0u;
+                for(; k + 16u <= n_x; k += 16u)
+                {
+                    const auto kf = _mm512_add_ps(_mm512_set1_ps(static_cast<float>(k)), lane);
+                    const auto w = _mm512_div_ps(one, _mm512_fmadd_ps(kf, ds, s0));
+                    const auto h = _mm512_fmadd_ps(_mm512_fmadd_ps(kf, dh, h0), w, h_off);
+                    const auto v = _mm512_fmadd_ps(_mm512_fmadd_ps(kf, dv, v0), w, v_off);
+
+                    const auto x1 = _mm512_roundscale_ps(h, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+                    const auto y1 = _mm512_roundscale_ps(v, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+                    const auto fx = _mm512_sub_ps(h, x1);
+                    const auto fy = _mm512_sub_ps(v, y1);
+
+                    const auto valid = static_cast<__mmask16>(_mm512_cmp_ps_mask(x1, zero, _CMP_GE_OQ)
+                                                            & _mm512_cmp_ps_mask(x1, max_x, _CMP_LT_OQ)
+                                                            & _mm512_cmp_ps_mask(y1, zero, _CMP_GE_OQ)
+                                                            & _mm512_cmp_ps_mask(y1, max_y, _CMP_LT_OQ));
+
+                    // invalid lanes are neither converted nor loaded
+                    const auto xi = _mm512_maskz_cvttps_epi32(valid, x1);
+                    const auto yi = _mm512_maskz_cvttps_epi32(valid, y1);
+                    const auto idx = _mm512_add_epi32(xi, _mm512_mullo_epi32(yi, stride));
+
+                    const auto q11 = _mm512_mask_i32gather_ps(zero, valid, idx, p11, 4);
+                    const auto q21 = _mm512_mask_i32gather_ps(zero, valid, idx, p21, 4);
+                    const auto q12 = _mm512_mask_i32gather_ps(zero, valid, idx, p12, 4);
+                    const auto q22 = _mm512_mask_i32gather_ps(zero, valid, idx, p22, 4);
+
+                    const auto top = _mm512_fmadd_ps(fx, _mm512_sub_ps(q21, q11), q11);
+                    const auto bottom = _mm512_fmadd_ps(fx, _mm512_sub_ps(q22, q12), q12);
+                    const auto det = _mm512_fmadd_ps(fy, _mm512_sub_ps(bottom, top), top);
+
+                    const auto u = _mm512_mul_ps(d_so, w);
+                    const auto weight = _mm512_mul_ps(half, _mm512_mul_ps(u, u));
+                    _mm512_storeu_ps(sum + k, _mm512_fmadd_ps(det, weight, _mm512_loadu_ps(sum + k)));
+                }
+
+                backproject_row_generic<interpolation::precise>(sum, k, n_x, rp);
+            }
+#pragma GCC diagnostic pop
+#endif
+
+            /*
+             * Fan and parallel beams: the projection row of a slice was already interpolated into line, only a 1D
+             * interpolation along it is left. A parallel beam needs neither the divide nor the distance weight.
+             */
+            struct line_params
+            {
+                const float* line;
+                std::uint32_t p_dim_x;
+
+                float s0;   // w = s0 + k * ds, constant 1 for parallel beams
+                float ds;
+                float h0;   // h * w = h0 + k * dh
+                float dh;
+
+                float h_off;
+                float d_so;
+            };
+
+            template <interpolation mode, beam_geometry beam>
+            inline auto backproject_line(float* sum, std::uint32_t n_x, const line_params& lp) noexcept -> void
+            {
+                const auto max_x = static_cast<float>(lp.p_dim_x) - 1.f;
+
+                if(mode == interpolation::nearest)
+                {
+                    #pragma omp simd
+                    for(auto k = 0u; k < n_x; ++k)
+                    {
+                        const auto kf = static_cast<float>(k);
+                        const auto w = (beam == beam_geometry::fan) ? 1.f / (lp.s0 + kf * lp.ds) : 1.f;
+                        const auto x = std::floor((lp.h0 + kf * lp.dh) * w + lp.h_off + 0.5f);
+                        const auto valid = (x >= 0.f) & (x <= max_x);
+                        const auto det = lp.line[static_cast<std::int32_t>(valid ? x : 0.f)];
+
+                        const auto u = lp.d_so * w;
+                        const auto weight = (beam == beam_geometry::fan) ? 0.5f * u * u : 0.5f;
+                        sum[k] += valid ? det * weight : 0.f;
+                    }
+                    return;
+                }
+
+                #pragma omp simd
+                for(auto k = 0u; k < n_x; ++k)
+                {
+                    const auto kf = static_cast<float>(k);
+                    const auto w = (beam == beam_geometry::fan) ? 1.f / (lp.s0 + kf * lp.ds) : 1.f;
+                    const auto h = (lp.h0 + kf * lp.dh) * w + lp.h_off;
+
+                    const auto x1 = std::floor(h);
+                    const auto fx = h - x1;
+                    const auto valid = (x1 >= 0.f) & (x1 < max_x);
+                    const auto idx = static_cast<std::int32_t>(valid ? x1 : 0.f);
+
+                    const auto q1 = lp.line[idx];
+                    const auto q2 = lp.line[idx + 1];
+                    const auto det = q1 + fx * (q2 - q1);
+
+                    const auto u = lp.d_so * w;
+                    const auto weight = (beam == beam_geometry::fan) ? 0.5f * u * u : 0.5f;
+                    sum[k] += valid ? det * weight : 0.f;
+                }
+            }
+
+            template <interpolation mode>
+            PARIS_OPENMP_MULTIVERSION
+            auto backproject_line_fan(float* sum, std::uint32_t n_x, const line_params& lp) noexcept -> void
+            {
+                backproject_line<mode, beam_geometry::fan>(sum, n_x, lp);
+            }
+
+            template <interpolation mode>
+            PARIS_OPENMP_MULTIVERSION
+            auto backproject_line_parallel(float* sum, std::uint32_t n_x, const line_params& lp) noexcept -> void
+            {
+                backproject_line<mode, beam_geometry::parallel>(sum, n_x, lp);
+            }
+
+            auto backproject_row_default(float* sum, std::uint32_t n_x, const row_params& rp) noexcept -> void
+            {
+                backproject_row_generic<interpolation::precise>(sum, 0u, n_x, rp);
+            }
+
+            // previews don't need hand-written kernels
+            auto backproject_row_nearest(float* sum, std::uint32_t n_x, const row_params& rp) noexcept -> void
+            {
+                backproject_row_generic<interpolation::nearest>(sum, 0u, n_x, rp);
+            }
+
+            using row_kernel = void (*)(float*, std::uint32_t, const row_params&);
+
+            auto select_row_kernel() noexcept -> row_kernel
+            {
+                switch(detect_isa())
+                {
+#if PARIS_OPENMP_X86
+                    case isa::avx512:
+                        BOOST_LOG_TRIVIAL(info) << "Using the AVX-512 backprojection kernel";
+                        return &backproject_row_avx512;
+
+                    case isa::avx2:
+                        BOOST_LOG_TRIVIAL(info) << "Using the AVX2 backprojection kernel";
+                        return &backproject_row_avx2;
+#else
+                    case isa::avx512:
+                    case isa::avx2:
+#endif
+                    case isa::generic:
+                        break;
+                }
+
+                BOOST_LOG_TRIVIAL(info) << "Using the generic backprojection kernel";
+                return &backproject_row_default;
+            }
+
+            // chosen once for the executing CPU
+            auto row_kernel_for_cpu() noexcept -> row_kernel
+            {
+                static const auto kernel = select_row_kernel();
+                return kernel;
+            }
+
+            // number of slices per slab so that the detector band of a slab stays in L2 for the whole batch
+            auto slab_size(std::uint32_t v_dim_z, std::uint32_t p_dim_x, std::uint32_t n, float l_vx_z, float l_px_y,
+                           float d_so, float d_sd) noexcept -> std::uint32_t
+            {
+                const auto magnification = d_sd / std::abs(d_so);
+                const auto rows = std::max(std::ceil(magnification * l_vx_z / l_px_y), 1.f) + 1.f;
+                const auto band = static_cast<std::size_t>(rows) * p_dim_x * sizeof(float) * n;
+                const auto slab = std::max(l2_budget / band, std::size_t{1u});
+                return static_cast<std::uint32_t>(std::min(slab, static_cast<std::size_t>(v_dim_z)));
             }
 
-            auto interpolate(const float* p, float x, float y, std::uint32_t dim_x, std::uint32_t dim_y) noexcept
-                -> float
+            /*
+             * Along a row of voxels the projected coordinates have the form (a + b * k) / (c + d * k) which is
+             * monotonic in k. Narrows [first, last) to the voxels whose coordinate lies within [lo, hi), with one
+             * voxel of margin -- the kernels still check every sample.
+             */
+            auto narrow(float a, float b, float c, float d, float lo, float hi,
+                        std::uint32_t& first, std::uint32_t& last) noexcept -> void
             {
-                auto x1 = std::floor(x);
-                auto x2 = x1 + 1.f;
-                auto y1 = std::floor(y);
-                auto y2 = y1 + 1.f;
+                if(first >= last)
+                    return;
 
-                auto x1u = static_cast<std::uint32_t>(x1);
-                auto x2u = static_cast<std::uint32_t>(x2);
-                auto y1u = static_cast<std::uint32_t>(y1);
-                auto y2u = static_cast<std::uint32_t>(y2);
+                auto coord = [&](float k) { return (a + b * k) / (c + d * k); };
+                auto cross = [&](float y) { return (y * c - a) / (b - y * d); };
 
-                auto x1_valid = x1 >= 0.f;
-                auto x2_valid = x2 < static_cast<float>(dim_x);
-                auto y1_valid = y1 >= 0.f;
-                auto y2_valid = y2 < static_cast<float>(dim_y);
+                const auto k0 = static_cast<float>(first);
+                const auto k1 = static_cast<float>(last - 1u);
+                const auto f0 = coord(k0);
+                const auto f1 = coord(k1);
 
-                auto interp = 0.f;
-                if(x1_valid && x2_valid && y1_valid && y2_valid)
+                auto from = k0;
+                auto to = k1;
+                if(f0 <= f1)
                 {
-                    auto q11 = p[x1u + y1u * dim_x];
-                    auto q12 = p[x1u + y2u * dim_x];
-                    auto q21 = p[x2u + y1u * dim_x];
-                    auto q22 = p[x2u + y2u * dim_x];
-                    auto interp_y1 = (x2 - x) / (x2 - x1) * q11 + (x - x1) / (x2 - x1) * q21;
-                    auto interp_y2 = (x2 - x) / (x2 - x1) * q12 + (x - x1) / (x2 - x1) * q22;
+                    if(f1 < lo || f0 >= hi)
+                    {
+                        last = first;
+                        return;
+                    }
+                    if(f0 < lo)
+                        from = std::floor(cross(lo)) - 1.f;
+                    if(f1 >= hi)
+                        to = std::ceil(cross(hi)) + 1.f;
+                }
+                else
+                {
+                    if(f0 < lo || f1 >= hi)
+                    {
+                        last = first;
+                        return;
+                    }
+                    if(f0 >= hi)
+                        from = std::floor(cross(hi)) - 1.f;
+                    if(f1 < lo)
+                        to = std::ceil(cross(lo)) + 1.f;
+                }
 
-                    interp = (y2 - y) / (y2 - y1) * interp_y1 + (y - y1) / (y2 - y1) * interp_y2;
+                from = std::isfinite(from) ? std::max(from, k0) : k0;
+                to = std::isfinite(to) ? std::min(to, k1) : k1;
+                if(to < from)
+                {
+                    last = first;
+                    return;
                 }
 
-                return interp;
+                first = static_cast<std::uint32_t>(from);
+                last = static_cast<std::uint32_t>(to) + 1u;
             }
 
-            template <bool enable_roi>
+            // the part [first, last) of a row of n_x voxels which reaches the projection at all
+            auto hit_range(const row_params& rp, std::uint32_t n_x, float margin, std::uint32_t& first,
+                           std::uint32_t& last) noexcept -> void
+            {
+                first = 0u;
+                last = n_x;
+
+                const auto max_x = static_cast<float>(rp.p_dim_x) - 1.f + margin;
+                const auto max_y = static_cast<float>(rp.p_dim_y) - 1.f + margin;
+
+                narrow(rp.h0 + rp.h_off * rp.s0, rp.dh + rp.h_off * rp.ds, rp.s0, rp.ds, -margin, max_x, first,
+                       last);
+                narrow(rp.v0 + rp.v_off * rp.s0, rp.dv + rp.v_off * rp.ds, rp.s0, rp.ds, -margin, max_y, first,
+                       last);
+            }
+
+            /*
+             * Matrices with a[2] = a[10] = 0 -- all circular trajectories -- project a column of voxels onto a
+             * vertical line of the detector: w, h and the distance weight only depend on x and y, v changes linearly
+             * along z. The terms of a row of columns are computed once per projection and block of slices, after
+             * that every voxel costs one FMA for v and the vertical interpolation.
+             */
+            constexpr auto column_slices = 16u;
+
+            struct column_terms
+            {
+                std::vector<std::int32_t> x;    // left pixel of the interpolation, -1 if the ray misses the detector
+                std::vector<float> fx;
+                std::vector<float> weight;      // 0.5 * u^2
+                std::vector<float> v_base;      // v = v_base + z * v_step
+                std::vector<float> v_step;
+            };
+
+            auto is_column_batch(const projection_matrix* mats, std::uint32_t n) noexcept -> bool
+            {
+                for(auto i = 0u; i < n; ++i)
+                {
+                    if(std::fpclassify(mats[i].m[2]) != FP_ZERO || std::fpclassify(mats[i].m[10]) != FP_ZERO)
+                        return false;
+                }
+                return true;
+            }
+
+            // rp as for backproject_row_generic() at z = 0, a6 is the z coefficient of the matrix' second row
+            template <interpolation mode>
+            PARIS_OPENMP_MULTIVERSION
+            auto prepare_columns(column_terms& ct, std::uint32_t first, std::uint32_t n_x, const row_params& rp,
+                                 float a6) noexcept -> void
+            {
+                const auto max_x = static_cast<float>(rp.p_dim_x) - 1.f;
+                auto x = ct.x.data();
+                auto fx = ct.fx.data();
+                auto weight = ct.weight.data();
+                auto v_base = ct.v_base.data();
+                auto v_step = ct.v_step.data();
+
+                #pragma omp simd
+                for(auto k = first; k < n_x; ++k)
+                {
+                    const auto kf = static_cast<float>(k - first);
+                    const auto w = 1.f / (rp.s0 + kf * rp.ds);
+                    const auto h = (rp.h0 + kf * rp.dh) * w + rp.h_off + margin(mode);
+
+                    // nearest: the closest column, fx is never read
+                    const auto x1 = std::floor(h);
+                    const auto valid = (x1 >= 0.f) & ((mode == interpolation::nearest) ? (x1 <= max_x) : (x1 < max_x));
+                    x[k] = valid ? static_cast<std::int32_t>(x1) : -1;
+                    fx[k] = h - x1;
+
+                    const auto u = rp.d_so * w;
+                    weight[k] = 0.5f * u * u;
+                    v_base[k] = (rp.v0 + kf * rp.dv) * w + rp.v_off;
+                    v_step[k] = a6 * w;
+                }
+            }
+
+            template <interpolation mode>
+            PARIS_OPENMP_MULTIVERSION
+            auto backproject_columns(float* sum, std::uint32_t first, std::uint32_t n_x, const column_terms& ct,
+                                     const float* p, std::uint32_t p_dim_x, std::uint32_t p_dim_y, float z) noexcept
+            -> void
+            {
+                const auto max_y = static_cast<float>(p_dim_y) - 1.f;
+                const auto stride = static_cast<std::int32_t>(p_dim_x);
+                const auto x = ct.x.data();
+                const auto fx = ct.fx.data();
+                const auto weight = ct.weight.data();
+                const auto v_base = ct.v_base.data();
+                const auto v_step = ct.v_step.data();
+
+                if(mode == interpolation::nearest)
+                {
+                    #pragma omp simd
+                    for(auto k = first; k < n_x; ++k)
+                    {
+                        const auto y = std::floor(v_base[k] + z * v_step[k] + 0.5f);
+                        const auto valid = (x[k] >= 0) & (y >= 0.f) & (y <= max_y);
+                        const auto idx = (valid ? x[k] : 0) + static_cast<std::int32_t>(valid ? y : 0.f) * stride;
+                        sum[k] += valid ? weight[k] * p[idx] : 0.f;
+                    }
+                    return;
+                }
+
+                #pragma omp simd
+                for(auto k = first; k < n_x; ++k)
+                {
+                    const auto v = v_base[k] + z * v_step[k];
+                    const auto y1 = std::floor(v);
+                    const auto fy = v - y1;
+
+                    const auto valid = (x[k] >= 0) & (y1 >= 0.f) & (y1 < max_y);
+                    const auto idx = (valid ? x[k] : 0) + static_cast<std::int32_t>(valid ? y1 : 0.f) * stride;
+
+                    const auto q11 = p[idx];
+                    const auto q21 = p[idx + 1];
+                    const auto q12 = p[idx + stride];
+                    const auto q22 = p[idx + stride + 1];
+
+                    const auto top = q11 + fx[k] * (q21 - q11);
+                    const auto bottom = q12 + fx[k] * (q22 - q12);
+                    const auto det = top + fy * (bottom - top);
+
+                    sum[k] += valid ? weight[k] * det : 0.f;
+                }
+            }
+
+            template <interpolation mode, bool enable_roi>
             auto do_backprojection(float* vol_ptr, std::uint32_t v_dim_x, std::uint32_t v_dim_y, std::uint32_t v_dim_z,
-                                   const float* p_ptr, std::uint32_t p_dim_x, std::uint32_t p_dim_y,
+                                   const float* const* p_ptrs, std::uint32_t p_dim_x, std::uint32_t p_dim_y,
+                                   std::uint32_t p_first_col, std::uint32_t p_first_row,
+                                   const projection_matrix* mats, std::uint32_t n,
                                    std::uint32_t offset,
                                    std::uint32_t v_dim_x_full, std::uint32_t v_dim_y_full, std::uint32_t v_dim_z_full,
                                    float l_vx_x, float l_vx_y, float l_vx_z,
-                                   float l_px_x, float l_px_y, float d_so, float d_sd, float delta_s, float delta_t,
-                                   float sin, float cos, const region_of_interest& roi) noexcept -> void
+                                   float l_px_y, float d_so, float d_sd,
+                                   const region_of_interest& roi) noexcept -> void
             {
-                #pragma omp parallel for collapse(3)
-                for(auto m = 0u; m < v_dim_z; ++m)
+                const auto backproject_row = (mode == interpolation::nearest) ? &backproject_row_nearest
+                                                                              : row_kernel_for_cpu();
+
+                const auto slab = slab_size(v_dim_z, p_dim_x, n, l_vx_z, l_px_y, d_so, d_sd);
+                const auto n_slabs = (v_dim_z + slab - 1u) / slab;
+
+                // add ROI offset -- this should get optimized away for enable_roi == false
+                const auto x_0 = vol_centered_coordinate(enable_roi ? roi.x1 : 0u, v_dim_x_full, l_vx_x);
+
+                // the buffers only hold the detector pixels starting at p_first_col and p_first_row
+                const auto h_off = -static_cast<float>(p_first_col);
+                const auto v_off = -static_cast<float>(p_first_row);
+
+                const auto columns = is_column_batch(mats, n);
+
+                // the slices [z_first, z_last) of row l, column_slices at a time
+                auto column_block = [&](std::uint32_t z_first, std::uint32_t z_last, std::uint32_t l,
+                                        const float* const* ptrs, std::vector<float>& sum, column_terms& ct)
                 {
-                    for(auto l = 0u; l < v_dim_y; ++l)
+                    const auto l_f = enable_roi ? l + roi.y1 : l;
+                    const auto y_l = vol_centered_coordinate(l_f, v_dim_y_full, l_vx_y);
+                    const auto max_x = static_cast<float>(p_dim_x) - 1.f;
+
+                    for(auto m_first = z_first; m_first < z_last; m_first += column_slices)
                     {
-                        for(auto k = 0u; k < v_dim_x; ++k)
+                        const auto m_last = std::min(m_first + column_slices, z_last);
+                        std::fill(std::begin(sum), std::begin(sum) + (m_last - m_first) * v_dim_x, 0.f);
+
+                        for(auto i = 0u; i < n; ++i)
                         {
-                            const auto coord = k + l * v_dim_x + m * v_dim_x * v_dim_y;
+                            const auto& a = mats[i].m;
+                            auto rp = row_params{ptrs[i], p_dim_x, p_dim_y,
+                                                 a[8] * x_0 + a[9] * y_l + a[11], a[8] * l_vx_x,
+                                                 a[0] * x_0 + a[1] * y_l + a[3], a[0] * l_vx_x,
+                                                 a[4] * x_0 + a[5] * y_l + a[7], a[4] * l_vx_x,
+                                                 h_off, v_off, d_so};
 
-                            // add ROI offset -- this should get optimized away for enable_roi == false
-                            if(enable_roi)
+                            // skip the columns whose rays miss the (cropped) projection horizontally
+                            auto first = 0u;
+                            auto last = v_dim_x;
+                            narrow(rp.h0 + rp.h_off * rp.s0, rp.dh + rp.h_off * rp.ds, rp.s0, rp.ds, -margin(mode),
+                                   max_x + margin(mode), first, last);
+                            if(first >= last)
+                                continue;
+
+                            const auto k0 = static_cast<float>(first);
+                            rp.s0 += k0 * rp.ds;
+                            rp.h0 += k0 * rp.dh;
+                            rp.v0 += k0 * rp.dv;
+                            prepare_columns<mode>(ct, first, last, rp, a[6]);
+
+                            for(auto m = m_first; m < m_last; ++m)
                             {
-                                k += roi.x1;
-                                l += roi.y1;
-                                m += roi.z1;
+                                // add offset for the current subvolume
+                                const auto m_f = (enable_roi ? m + roi.z1 : m) + offset;
+                                const auto z_m = vol_centered_coordinate(m_f, v_dim_z_full, l_vx_z);
+                                backproject_columns<mode>(sum.data() + (m - m_first) * v_dim_x, first, last, ct,
+                                                          ptrs[i], p_dim_x, p_dim_y, z_m);
                             }
+                        }
+
+                        for(auto m = m_first; m < m_last; ++m)
+                        {
+                            auto row = vol_ptr + (static_cast<std::size_t>(m) * v_dim_y + l) * v_dim_x;
+                            auto contrib = sum.data() + (m - m_first) * v_dim_x;
+                            #pragma omp simd
+                            for(auto k = 0u; k < v_dim_x; ++k)
+                                row[k] += contrib[k];
+                        }
+                    }
+                };
+
+                // the slices [z_first, z_last) of row l, projected from the batch in ptrs
+                auto row_block = [&](std::uint32_t z_first, std::uint32_t z_last, std::uint32_t l,
+                                     const float* const* ptrs, std::vector<float>& sum, column_terms& ct)
+                {
+                    if(columns)
+                        return column_block(z_first, z_last, l, ptrs, sum, ct);
+
+                    const auto l_f = enable_roi ? l + roi.y1 : l;
+                    const auto y_l = vol_centered_coordinate(l_f, v_dim_y_full, l_vx_y);
+
+                    for(auto m = z_first; m < z_last; ++m)
+                    {
+                        // add offset for the current subvolume
+                        const auto m_f = (enable_roi ? m + roi.z1 : m) + offset;
+                        const auto z_m = vol_centered_coordinate(m_f, v_dim_z_full, l_vx_z);
 
+                        std::fill(std::begin(sum), std::end(sum), 0.f);
+                        for(auto i = 0u; i < n; ++i)
+                        {
+                            const auto& a = mats[i].m;
+                            auto rp = row_params{ptrs[i], p_dim_x, p_dim_y,
+                                                 a[8] * x_0 + a[9] * y_l + a[10] * z_m + a[11], a[8] * l_vx_x,
+                                                 a[0] * x_0 + a[1] * y_l + a[2] * z_m + a[3], a[0] * l_vx_x,
+                                                 a[4] * x_0 + a[5] * y_l + a[6] * z_m + a[7], a[4] * l_vx_x,
+                                                 h_off, v_off, d_so};
+
+                            // skip the voxels whose rays miss the (cropped) projection
+                            auto first = 0u;
+                            auto last = 0u;
+                            hit_range(rp, v_dim_x, margin(mode), first, last);
+                            if(first >= last)
+                                continue;
+
+                            const auto k0 = static_cast<float>(first);
+                            rp.s0 += k0 * rp.ds;
+                            rp.h0 += k0 * rp.dh;
+                            rp.v0 += k0 * rp.dv;
+                            backproject_row(sum.data() + first, last - first, rp);
+                        }
+
+                        auto row = vol_ptr + (static_cast<std::size_t>(m) * v_dim_y + l) * v_dim_x;
+                        #pragma omp simd
+                        for(auto k = 0u; k < v_dim_x; ++k)
+                            row[k] += sum[k];
+                    }
+                };
+
+                // bound threads: every node backprojects its own z-slab from its own copy of the projections
+                const auto p_size = static_cast<std::size_t>(p_dim_x) * p_dim_y;
+                static const auto no_replicas = std::vector<float*>{};
+                const auto& replicas = numa::bound() ? numa::replicas(p_size * n) : no_replicas;
+
+                #pragma omp parallel
+                {
+                    // contributions of the whole batch to the current row -- or block of rows for columns
+                    auto sum = std::vector<float>(columns ? column_slices * v_dim_x : v_dim_x);
+                    auto ct = column_terms{};
+                    if(columns)
+                    {
+                        ct.x.resize(v_dim_x);
+                        ct.fx.resize(v_dim_x);
+                        ct.weight.resize(v_dim_x);
+                        ct.v_base.resize(v_dim_x);
+                        ct.v_step.resize(v_dim_x);
+                    }
+
+                    auto place = numa::place{};
+                    if(numa::current_place(place))
+                    {
+                        // each thread copies its share of the batch, the pages stay on its node
+                        auto copy_first = std::size_t{};
+                        auto copy_last = std::size_t{};
+                        numa::share(p_size * n, place.rank, place.size, copy_first, copy_last);
+                        auto replica = replicas[place.node];
+                        for(auto i = copy_first / p_size; i < n && i * p_size < copy_last; ++i)
+                        {
+                            auto from = std::max(copy_first, i * p_size);
+                            auto to = std::min(copy_last, (i + 1u) * p_size);
+                            std::copy(p_ptrs[i] + (from - i * p_size), p_ptrs[i] + (to - i * p_size),
+                                      replica + from);
+                        }
+
+                        auto ptrs = std::vector<const float*>(n);
+                        for(auto i = 0u; i < n; ++i)
+                            ptrs[i] = replica + i * p_size;
+
+                        #pragma omp barrier
+
+                        // the same z-slab as the first touch in make_volume_host(), split into the usual blocks
+                        auto z_first = std::size_t{};
+                        auto z_last = std::size_t{};
+                        numa::share(v_dim_z, place.node, place.nodes, z_first, z_last);
+                        const auto node_slabs = (z_last - z_first + slab - 1u) / slab;
+
+                        auto it_first = std::size_t{};
+                        auto it_last = std::size_t{};
+                        numa::share(node_slabs * v_dim_y, place.rank, place.size, it_first, it_last);
+                        for(auto it = it_first; it < it_last; ++it)
+                        {
+                            const auto b = it / v_dim_y;
+                            const auto l = static_cast<std::uint32_t>(it % v_dim_y);
+                            const auto m_first = z_first + b * slab;
+                            const auto m_last = std::min(m_first + slab, z_last);
+                            row_block(static_cast<std::uint32_t>(m_first), static_cast<std::uint32_t>(m_last), l,
+                                      ptrs.data(), sum, ct);
+                        }
+                    }
+                    else
+                    {
+                        #pragma omp for collapse(2) schedule(static)
+                        for(auto b = 0u; b < n_slabs; ++b)
+                        {
+                            for(auto l = 0u; l < v_dim_y; ++l)
+                                row_block(b * slab, std::min((b + 1u) * slab, v_dim_z), l, p_ptrs, sum, ct);
+                        }
+                    }
+                }
+            }
+
+            /*
+             * Fan and parallel beams: all voxels of a slice hit the same detector row of a projection. Each slice
+             * therefore interpolates that row once per projection and then backprojects its voxels with 1D
+             * interpolations only. The slices are split into blocks of rows so that the work stays balanced for thin
+             * subvolumes.
+             */
+            template <interpolation mode, beam_geometry beam, bool enable_roi>
+            auto do_separable_backprojection(float* vol_ptr,
+                                             std::uint32_t v_dim_x, std::uint32_t v_dim_y, std::uint32_t v_dim_z,
+                                             const float* const* p_ptrs, std::uint32_t p_dim_x, std::uint32_t p_dim_y,
+                                             std::uint32_t p_first_col, std::uint32_t p_first_row,
+                                             const projection_matrix* mats, std::uint32_t n,
+                                             std::uint32_t offset,
+                                             std::uint32_t v_dim_x_full, std::uint32_t v_dim_y_full,
+                                             std::uint32_t v_dim_z_full,
+                                             float l_vx_x, float l_vx_y, float l_vx_z, float d_so,
+                                             const region_of_interest& roi) noexcept -> void
+            {
+                constexpr auto block_rows = 16u;
+                const auto n_blocks = (v_dim_y + block_rows - 1u) / block_rows;
+
+                const auto backproject_line = (beam == beam_geometry::fan) ? &backproject_line_fan<mode>
+                                                                           : &backproject_line_parallel<mode>;
+
+                const auto x_0 = vol_centered_coordinate(enable_roi ? roi.x1 : 0u, v_dim_x_full, l_vx_x);
+                const auto h_off = -static_cast<float>(p_first_col);
+                const auto v_off = -static_cast<float>(p_first_row);
+                const auto max_x = static_cast<float>(p_dim_x) - 1.f;
+                const auto max_y = static_cast<float>(p_dim_y) - 1.f;
+
+                #pragma omp parallel
+                {
+                    auto sum = std::vector<float>(v_dim_x);
+                    auto lines = std::vector<float>(static_cast<std::size_t>(p_dim_x) * n);
+                    auto hits = std::vector<char>(n);
+
+                    #pragma omp for collapse(2) schedule(static)
+                    for(auto m = 0u; m < v_dim_z; ++m)
+                    {
+                        for(auto b = 0u; b < n_blocks; ++b)
+                        {
                             // add offset for the current subvolume
-                            m += offset;
-
-                            // get centered coordinates -- volume center is at (0, 0, 0)
-                            const auto x_k = vol_centered_coordinate(k, v_dim_x_full, l_vx_x);
-                            const auto y_l = vol_centered_coordinate(l, v_dim_y_full, l_vx_y);
-                            const auto z_m = vol_centered_coordinate(m, v_dim_z_full, l_vx_z);
-
-                            // rotate coordinates
-                            const auto s = x_k * cos + y_l * sin;
-                            const auto t = -x_k * sin + y_l * cos;
-
-                            // project rotated coordinates
-                            const auto factor = d_sd / (s + d_so);
-                            const auto h = proj_real_coordinate(t * factor,
-                                                                p_dim_x,
-                                                                l_px_x,
-                                                                delta_s);
-                            const auto v = proj_real_coordinate(z_m * factor,
-                                                                p_dim_y,
-                                                                l_px_y,
-                                                                delta_t);
-                            
-                            // get projection value through interpolation
-                            const auto det = interpolate(p_ptr, h, v, p_dim_x, p_dim_y);
-                            
-                            // backproject
-                            const auto u = -(d_so / (s + d_so));
-                            vol_ptr[coord] += 0.5f * det * u * u;
-
-                            // restore old coordinates
-                            m -= offset;
-                            if(enable_roi)
+                            const auto m_f = (enable_roi ? m + roi.z1 : m) + offset;
+                            const auto z_m = vol_centered_coordinate(m_f, v_dim_z_full, l_vx_z);
+
+                            // the detector row seen by this slice, interpolated once per projection
+                            for(auto i = 0u; i < n; ++i)
                             {
-                                k -= roi.x1;
-                                l -= roi.y1;
-                                m -= roi.z1;
+                                const auto& a = mats[i].m;
+                                const auto v = a[6] * z_m + a[7] + v_off + margin(mode);
+                                const auto y1 = std::floor(v);
+                                hits[i] = (y1 >= 0.f) && ((mode == interpolation::nearest) ? (y1 <= max_y)
+                                                                                           : (y1 < max_y));
+                                if(!hits[i])
+                                    continue;
+
+                                const auto top = p_ptrs[i] + static_cast<std::size_t>(y1) * p_dim_x;
+                                auto line = lines.data() + static_cast<std::size_t>(i) * p_dim_x;
+                                if(mode == interpolation::nearest)
+                                {
+                                    std::copy(top, top + p_dim_x, line);
+                                    continue;
+                                }
+
+                                const auto fy = v - y1;
+                                const auto bottom = top + p_dim_x;
+
+                                #pragma omp simd
+                                for(auto s = 0u; s < p_dim_x; ++s)
+                                    line[s] = top[s] + fy * (bottom[s] - top[s]);
+                            }
+
+                            const auto l_last = std::min((b + 1u) * block_rows, v_dim_y);
+                            for(auto l = b * block_rows; l < l_last; ++l)
+                            {
+                                const auto l_f = enable_roi ? l + roi.y1 : l;
+                                const auto y_l = vol_centered_coordinate(l_f, v_dim_y_full, l_vx_y);
+
+                                std::fill(std::begin(sum), std::end(sum), 0.f);
+                                for(auto i = 0u; i < n; ++i)
+                                {
+                                    if(!hits[i])
+                                        continue;
+
+                                    const auto& a = mats[i].m;
+                                    auto lp = line_params{lines.data() + static_cast<std::size_t>(i) * p_dim_x,
+                                                          p_dim_x,
+                                                          a[8] * x_0 + a[9] * y_l + a[11], a[8] * l_vx_x,
+                                                          a[0] * x_0 + a[1] * y_l + a[3], a[0] * l_vx_x,
+                                                          h_off, d_so};
+
+                                    // skip the voxels whose rays miss the (cropped) projection
+                                    auto first = 0u;
+                                    auto last = v_dim_x;
+                                    narrow(lp.h0 + h_off * lp.s0, lp.dh + h_off * lp.ds, lp.s0, lp.ds, -margin(mode),
+                                           max_x + margin(mode), first, last);
+                                    if(first >= last)
+                                        continue;
+
+                                    const auto k0 = static_cast<float>(first);
+                                    lp.s0 += k0 * lp.ds;
+                                    lp.h0 += k0 * lp.dh;
+                                    backproject_line(sum.data() + first, last - first, lp);
+                                }
+
+                                auto row = vol_ptr + (static_cast<std::size_t>(m) * v_dim_y + l) * v_dim_x;
+                                #pragma omp simd
+                                for(auto k = 0u; k < v_dim_x; ++k)
+                                    row[k] += sum[k];
                             }
                         }
                     }
                 }
             }
+
+            // dispatches to the kernel specialised for beam and enable_roi
+            template <interpolation mode, beam_geometry beam>
+            auto separable_backprojection(bool enable_roi, float* vol_ptr,
+                                          std::uint32_t v_dim_x, std::uint32_t v_dim_y, std::uint32_t v_dim_z,
+                                          const float* const* p_ptrs, std::uint32_t p_dim_x, std::uint32_t p_dim_y,
+                                          std::uint32_t p_first_col, std::uint32_t p_first_row,
+                                          const projection_matrix* mats, std::uint32_t n,
+                                          std::uint32_t offset,
+                                          std::uint32_t v_dim_x_full, std::uint32_t v_dim_y_full,
+                                          std::uint32_t v_dim_z_full,
+                                          float l_vx_x, float l_vx_y, float l_vx_z, float d_so,
+                                          const region_of_interest& roi) noexcept -> void
+            {
+                if(enable_roi)
+                    do_separable_backprojection<mode, beam, true>(vol_ptr, v_dim_x, v_dim_y, v_dim_z,
+                                                                  p_ptrs, p_dim_x, p_dim_y, p_first_col, p_first_row,
+                                                                  mats, n, offset,
+                                                                  v_dim_x_full, v_dim_y_full, v_dim_z_full,
+                                                                  l_vx_x, l_vx_y, l_vx_z, d_so, roi);
+                else
+                    do_separable_backprojection<mode, beam, false>(vol_ptr, v_dim_x, v_dim_y, v_dim_z,
+                                                                   p_ptrs, p_dim_x, p_dim_y, p_first_col, p_first_row,
+                                                                   mats, n, offset,
+                                                                   v_dim_x_full, v_dim_y_full, v_dim_z_full,
+                                                                   l_vx_x, l_vx_y, l_vx_z, d_so, roi);
+            }
         }
 
-        auto backproject(const projection_device_type& p, volume_device_type& v, std::uint32_t v_offset,
+        namespace
+        {
+            template <interpolation mode>
+            auto backproject_batch(const std::vector<projection_device_type>& p, volume_device_type& v,
+                                   std::uint32_t v_offset, const detector_geometry& det_geo,
+                                   const volume_geometry& vol_geo, bool enable_roi, const region_of_interest& roi,
+                                   const std::vector<projection_matrix>& m) noexcept -> void
+            {
+                if(p.empty())
+                    return;
+
+                // constants for the backprojection - these only change with the geometry
+                const auto v_dim_x_full = vol_geo.dim_x;
+                const auto v_dim_y_full = vol_geo.dim_y;
+                const auto v_dim_z_full = vol_geo.dim_z;
+
+                const auto l_vx_x = vol_geo.l_vx_x;
+                const auto l_vx_y = vol_geo.l_vx_y;
+                const auto l_vx_z = vol_geo.l_vx_z;
+
+                const auto l_px_y = det_geo.l_px_col;
+
+                const auto d_so = det_geo.d_so;
+                const auto d_sd = std::abs(det_geo.d_so) + std::abs(det_geo.d_od);
+                const auto beam = det_geo.beam;
+
+                // the projection stack of this batch
+                auto p_ptrs = std::vector<const float*>{};
+                p_ptrs.reserve(p.size());
+                for(auto&& proj : p)
+                    p_ptrs.push_back(proj.buf.get());
+
+                const auto n = static_cast<std::uint32_t>(p.size());
+                const auto p_dim_x = p.front().dim_x;
+                const auto p_dim_y = p.front().dim_y;
+                const auto p_first_col = p.front().first_col;
+                const auto p_first_row = p.front().first_row;
+
+                // fan and parallel beams are separable per slice
+                if(beam == beam_geometry::fan)
+                    separable_backprojection<mode, beam_geometry::fan>(enable_roi, v.buf.get(),
+                                                                       v.dim_x, v.dim_y, v.dim_z,
+                                                                       p_ptrs.data(), p_dim_x, p_dim_y, p_first_col,
+                                                                       p_first_row, m.data(), n, v_offset,
+                                                                       v_dim_x_full, v_dim_y_full, v_dim_z_full,
+                                                                       l_vx_x, l_vx_y, l_vx_z, d_so, roi);
+                else if(beam == beam_geometry::parallel)
+                    separable_backprojection<mode, beam_geometry::parallel>(enable_roi, v.buf.get(),
+                                                                            v.dim_x, v.dim_y, v.dim_z,
+                                                                            p_ptrs.data(), p_dim_x, p_dim_y,
+                                                                            p_first_col, p_first_row,
+                                                                            m.data(), n, v_offset,
+                                                                            v_dim_x_full, v_dim_y_full, v_dim_z_full,
+                                                                            l_vx_x, l_vx_y, l_vx_z, d_so, roi);
+                // backproject and apply ROI as needed
+                else if(enable_roi)
+                    do_backprojection<mode, true>(v.buf.get(), v.dim_x, v.dim_y, v.dim_z,
+                                                  p_ptrs.data(), p_dim_x, p_dim_y, p_first_col, p_first_row,
+                                                  m.data(), n,
+                                                  v_offset,
+                                                  v_dim_x_full, v_dim_y_full, v_dim_z_full,
+                                                  l_vx_x, l_vx_y, l_vx_z,
+                                                  l_px_y, d_so, d_sd,
+                                                  roi);
+                else
+                    do_backprojection<mode, false>(v.buf.get(), v.dim_x, v.dim_y, v.dim_z,
+                                                   p_ptrs.data(), p_dim_x, p_dim_y, p_first_col, p_first_row,
+                                                   m.data(), n,
+                                                   v_offset,
+                                                   v_dim_x_full, v_dim_y_full, v_dim_z_full,
+                                                   l_vx_x, l_vx_y, l_vx_z,
+                                                   l_px_y, d_so, d_sd,
+                                                   roi);
+            }
+        }
+
+        auto backproject(const std::vector<projection_device_type>& p, volume_device_type& v, std::uint32_t v_offset,
                          const detector_geometry& det_geo, const volume_geometry& vol_geo,
-                         bool enable_roi, const region_of_interest& roi, float sin, float cos,
-                         float delta_s, float delta_t) noexcept -> void
+                         bool enable_roi, const region_of_interest& roi,
+                         const std::vector<projection_matrix>& m) noexcept -> void
         {
-            // constants for the backprojection - these never change
-            static const auto v_dim_x_full = vol_geo.dim_x;
-            static const auto v_dim_y_full = vol_geo.dim_y;
-            static const auto v_dim_z_full = vol_geo.dim_z;
-
-            static const auto l_vx_x = vol_geo.l_vx_x;
-            static const auto l_vx_y = vol_geo.l_vx_y;
-            static const auto l_vx_z = vol_geo.l_vx_z;
-
-            static const auto l_px_x = det_geo.l_px_row;
-            static const auto l_px_y = det_geo.l_px_col;
-
-            static const auto d_s = delta_s;
-            static const auto d_t = delta_t;
-
-            static const auto d_so = det_geo.d_so;
-            static const auto d_sd = std::abs(det_geo.d_so) + std::abs(det_geo.d_od);
-
-            // variable for the backprojection - this might change between subvolumes
-            thread_local static auto offset = v_offset;
-
-            // backproject and apply ROI as needed
-            if(enable_roi)
-                do_backprojection<true>(v.buf.get(), v.dim_x, v.dim_y, v.dim_z,
-                                        p.buf.get(), p.dim_x, p.dim_y,
-                                        offset,
-                                        v_dim_x_full, v_dim_y_full, v_dim_z_full,
-                                        l_vx_x, l_vx_y, l_vx_z,
-                                        l_px_x, l_px_y, d_so, d_sd, d_s, d_t,
-                                        sin, cos, roi);
+            // the fast modes have no hardware filtering to trade precision for on the CPU
+            if(interp_mode == interpolation::nearest)
+                backproject_batch<interpolation::nearest>(p, v, v_offset, det_geo, vol_geo, enable_roi, roi, m);
             else
-                do_backprojection<false>(v.buf.get(), v.dim_x, v.dim_y, v.dim_z,
-                                         p.buf.get(), p.dim_x, p.dim_y,
-                                         offset,
-                                         v_dim_x_full, v_dim_y_full, v_dim_z_full,
-                                         l_vx_x, l_vx_y, l_vx_z,
-                                         l_px_x, l_px_y, d_so, d_sd, d_s, d_t,
-                                         sin, cos, roi);
+                backproject_batch<interpolation::precise>(p, v, v_offset, det_geo, vol_geo, enable_roi, roi, m);
+        }
+
+        auto backproject(const std::vector<projection_device_type>& p, volume_device_type& v, std::uint32_t v_offset,
+                         const detector_geometry& det_geo, const volume_geometry& vol_geo,
+                         bool enable_roi, const region_of_interest& roi,
+                         const std::vector<float>& sin, const std::vector<float>& cos,
+                         float delta_s, float delta_t) noexcept -> void
+        {
+            // the circular trajectory is a special case of the general one
+            const auto a_h = (std::abs(det_geo.d_so) + std::abs(det_geo.d_od)) / det_geo.l_px_row;
+            const auto a_v = (std::abs(det_geo.d_so) + std::abs(det_geo.d_od)) / det_geo.l_px_col;
+            const auto h_c = proj_offset(det_geo.n_row, det_geo.l_px_row, delta_s);
+            const auto v_c = proj_offset(det_geo.n_col, det_geo.l_px_col, delta_t);
+
+            auto m = std::vector<projection_matrix>{};
+            m.reserve(sin.size());
+            for(auto i = 0u; i < sin.size(); ++i)
+            {
+                if(det_geo.beam == beam_geometry::cone)
+                    m.push_back(circular_matrix(sin[i], cos[i], a_h, a_v, h_c, v_c, det_geo.d_so));
+                else if(det_geo.beam == beam_geometry::fan)
+                    m.push_back(separable_matrix(det_geo.beam, sin[i], cos[i], a_h, a_v, h_c, v_c, det_geo.d_so));
+                else
+                    m.push_back(separable_matrix(det_geo.beam, sin[i], cos[i], 1.f / det_geo.l_px_row,
+                                                 1.f / det_geo.l_px_col, h_c, v_c, det_geo.d_so));
+            }
+
+            backproject(p, v, v_offset, det_geo, vol_geo, enable_roi, roi, m);
+        }
+
+        auto set_interpolation(interpolation mode) noexcept -> void
+        {
+            interp_mode = mode;
         }
     }
 }
@@ -0,0 +1,67 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#ifndef PARIS_OPENMP_CPU_H_
+#define PARIS_OPENMP_CPU_H_
+
+/*
+ * A single paris.openmp binary runs on all nodes of a cluster. Hot kernels are therefore compiled for several ISA
+ * levels and the fitting version is chosen on the executing machine.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(__INTEL_COMPILER)
+#define PARIS_OPENMP_X86 1
+// the dynamic loader picks the best clone, the kernel must not contain OpenMP parallel regions
+#define PARIS_OPENMP_MULTIVERSION __attribute__((target_clones("avx512f", "avx2", "sse4.2", "default")))
+#define PARIS_OPENMP_TARGET(isa) __attribute__((target(isa)))
+#else
+#define PARIS_OPENMP_X86 0
+#define PARIS_OPENMP_MULTIVERSION
+#define PARIS_OPENMP_TARGET(isa)
+#endif
+
+namespace paris
+{
+    namespace openmp
+    {
+        enum class isa
+        {
+            generic,
+            avx2,   // including FMA
+            avx512
+        };
+
+        // the instruction set used by the hand-written kernels
+        inline auto detect_isa() noexcept -> isa
+        {
+#if PARIS_OPENMP_X86
+            __builtin_cpu_init();
+            if(__builtin_cpu_supports("avx512f"))
+                return isa::avx512;
+            if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+                return isa::avx2;
+#endif
+            return isa::generic;
+        }
+    }
+}
+
+#endif /* PARIS_OPENMP_CPU_H_ */
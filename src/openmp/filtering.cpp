@@ -20,14 +20,20 @@
  * Authors: Jan Stephan <j.stephan@hzdr.de>
  */
 
-#include <cmath>
+#include <algorithm>
 #include <cstdint>
 #include <memory>
-#include <numeric>
+#include <string>
+#include <vector>
+
+#include <boost/log/trivial.hpp>
 
 #include <fftw3.h>
 
+#include "../exception.h"
+
 #include "backend.h"
+#include "cpu.h"
 
 namespace paris
 {
@@ -49,59 +55,44 @@ namespace paris
                 return std::unique_ptr<T[], fftw_deleter>{p};
             }
 
-            auto make_filter_real(float* r, std::uint32_t size, float tau) -> void
+            // weights one row and pads it with zeroes
+            PARIS_OPENMP_MULTIVERSION
+            auto expand_row(const float* src, const float* w, std::uint32_t src_dim_x,
+                            float* dst, std::uint32_t dst_dim_x) noexcept -> void
             {
-                auto js = std::make_unique<std::int32_t[]>(size);
-                auto j = -(static_cast<std::int32_t>(size) - 2) / 2;
-                std::iota(js.get(), js.get() + size, j);
+                #pragma omp simd
+                for(auto x = 0u; x < src_dim_x; ++x)
+                    dst[x] = src[x] * w[x];
 
-                auto pi_f = static_cast<float>(M_PI);
-
-                #pragma omp parallel for
-                for(auto x = 0u; x < size; ++x)
-                {
-                    if(js[x] == 0)
-                        r[x] = (1.f / 8.f) * (1.f / std::pow(tau, 2.f));
-                    else
-                    {
-                        if(js[x] % 2 == 0)
-                            r[x] = 0.f;
-                        else
-                            r[x] = -(1.f / (2.f * static_cast<float>(js[x] * js[x]) * (pi_f * pi_f) * (tau * tau)));
-                    }
-                }
-            }   
+                std::fill(dst + src_dim_x, dst + dst_dim_x, 0.f);
+            }
 
-            auto expand(const float* src, std::uint32_t src_dim_x,
+            auto expand(const float* src, const float* w, std::uint32_t src_dim_x,
                               float* dst, std::uint32_t dst_dim_x, std::uint32_t dim_y) noexcept -> void
             {
-                // copy original projection to expanded projection
-                #pragma omp parallel for collapse(2)
+                // copy weighted projection to expanded projection
+                #pragma omp parallel for
                 for(auto y = 0u; y < dim_y; ++y)
+                    expand_row(src + y * src_dim_x, w + y * src_dim_x, src_dim_x, dst + y * dst_dim_x, dst_dim_x);
+            }
+
+            PARIS_OPENMP_MULTIVERSION
+            auto filter_row(fftwf_complex* in, const float* filter, std::uint32_t dim_x) noexcept -> void
+            {
+                #pragma omp simd
+                for(auto x = 0u; x < dim_x; ++x)
                 {
-                    for(auto x = 0u; x < dst_dim_x; ++x)
-                    {
-                        if(x < src_dim_x)
-                            dst[x + y * dst_dim_x] = src[x + y * src_dim_x];
-                        else
-                            dst[x + y * dst_dim_x] = 0.f;
-                    }
+                    in[x][0] *= filter[x];
+                    in[x][1] *= filter[x];
                 }
             }
 
-            auto do_filtering(fftwf_complex* in, const fftwf_complex* filter,
+            auto do_filtering(fftwf_complex* in, const float* filter,
                               std::uint32_t dim_x, std::uint32_t dim_y) noexcept -> void
             {
-                #pragma omp parallel for collapse(2)
+                #pragma omp parallel for
                 for(auto y = 0u; y < dim_y; ++y)
-                {
-                    for(auto x = 0u; x < dim_x; ++x)
-                    {
-                        auto coord = x + y * dim_x;
-                        in[coord][0] *= filter[x][0];
-                        in[coord][1] *= filter[x][1];
-                    }
-                }
+                    filter_row(in + y * dim_x, filter, dim_x);
             }
 
             auto shrink(const float* src, std::uint32_t src_dim_x,
@@ -116,19 +107,6 @@ namespace paris
                     }
                 }
             }
-
-            auto normalize(float* src, std::uint32_t dim_x, std::uint32_t dim_y, std::uint32_t filter_size) noexcept
-                -> void
-            {
-                #pragma omp parallel for collapse(2)
-                for(auto y = 0u; y < dim_y; ++y)
-                {
-                    for(auto x = 0u; x < dim_x; ++x)
-                    {
-                        src[x + y * dim_x] /= static_cast<float>(filter_size);
-                    }
-                }
-            }
         }
 
         auto fftw_deleter::operator()(void* p) noexcept -> void
@@ -136,87 +114,134 @@ namespace paris
             fftwf_free(p);
         }
 
-        auto make_filter(std::uint32_t size, float tau) -> filter_buffer_type
+        auto make_filter(const std::vector<float>& response) -> filter_buffer_type
         {
-            // Note some FFTW quirks: Input initialization has to be done AFTER plan creation,
-            // otherwise it will be overwritten
-            const auto size_trans = size / 2 + 1;
-            const auto n = static_cast<int>(size);
-
-            auto r = make_ptr<float>(size);
-            auto k = make_ptr<fftwf_complex>(size_trans);
-
-            auto plan = fftwf_plan_dft_r2c_1d(n, r.get(), k.get(), FFTW_MEASURE | FFTW_PRESERVE_INPUT);
-
-            make_filter_real(r.get(), size, tau);
-
-            fftwf_execute(plan);
-            
-            #pragma omp parallel for
-            for(auto x = 0u; x < size_trans; ++x)
-            {
-                auto result = tau * std::abs(std::sqrt(std::pow(k[x][0], 2.f) + std::pow(k[x][1], 2.f)));
-
-                k[x][0] = result;
-                k[x][1] = result;
-            }
+            auto k = make_ptr<float>(static_cast<std::uint32_t>(response.size()));
+            std::copy(std::begin(response), std::end(response), k.get());
 
             return k;
         }
 
-        auto apply_filter(projection_device_type& p, const filter_buffer_type& k, std::uint32_t filter_size,
-                          std::uint32_t n_col) -> void
+        auto filter_plan_deleter::operator()(filter_plan* p) noexcept -> void
+        {
+            if(p->forward != nullptr)
+                fftwf_destroy_plan(p->forward);
+            if(p->inverse != nullptr)
+                fftwf_destroy_plan(p->inverse);
+            delete p;
+        }
+
+        auto make_filter_plan(std::uint32_t filter_size, std::uint32_t n_col, const std::string& wisdom_dir)
+            -> filter_plan_type
         {
             // dimensionality of the FFT - 1 in this case
             constexpr auto rank = 1;
 
             // FFT size for each dimension
-            static const auto n = static_cast<int>(filter_size);
+            const auto n = static_cast<int>(filter_size);
 
             // batched FFT -> set batch size
-            static const auto batch = static_cast<int>(n_col);
+            const auto batch = static_cast<int>(n_col);
 
-            // allocate memory for expanded projection (projection width -> filter size)
-            thread_local static auto p_exp = make_ptr<float>(filter_size, n_col);
-
-            // allocate memory for transformed projection
-            static const auto size_trans = filter_size / 2 + 1;
-            thread_local static auto p_trans = make_ptr<fftwf_complex>(size_trans, n_col);
+            // the projection is transformed in place: each line holds size_trans complex or 2 * size_trans real values
+            const auto size_trans = filter_size / 2 + 1;
 
             // set distance between the first elements of two successive lines
-            static const auto p_exp_dist = static_cast<int>(filter_size);
-            static const auto p_trans_dist = static_cast<int>(size_trans);
+            const auto p_real_dist = static_cast<int>(2 * size_trans);
+            const auto p_trans_dist = static_cast<int>(size_trans);
 
             // set distance between two successive elements
-            constexpr auto p_exp_stride = 1;
+            constexpr auto p_real_stride = 1;
             constexpr auto p_trans_stride = 1;
 
             // set storage dimensions of data in memory
-            static const auto p_exp_nembed = static_cast<int>(p_exp_dist);
-            static const auto p_trans_nembed = static_cast<int>(p_trans_dist);
+            const auto p_real_nembed = p_real_dist;
+            const auto p_trans_nembed = p_trans_dist;
+
+            // the wisdom depends on the transform, keep one file per detector geometry
+            auto wisdom_path = std::string{};
+            if(!wisdom_dir.empty())
+            {
+                wisdom_path = wisdom_dir + "/fftw-" + std::to_string(filter_size) + "x" + std::to_string(n_col)
+                            + ".wisdom";
+                if(fftwf_import_wisdom_from_filename(wisdom_path.c_str()) != 0)
+                    BOOST_LOG_TRIVIAL(info) << "Imported FFTW wisdom from " << wisdom_path;
+            }
+
+            // FFTW_MEASURE overwrites the arrays, plan on a scratch buffer. fftwf_malloc guarantees the
+            // alignment the buffers of all threads will share, this is required for the new-array execution
+            auto scratch = make_ptr<fftwf_complex>(size_trans, n_col);
+            auto p_trans = scratch.get();
+            auto p_real = reinterpret_cast<float*>(p_trans);
+
+            auto plan = filter_plan_type{new filter_plan{nullptr, nullptr}};
+            plan->forward = fftwf_plan_many_dft_r2c(rank, &n, batch,
+                                                    p_real, &p_real_nembed, p_real_stride, p_real_dist,
+                                                    p_trans, &p_trans_nembed, p_trans_stride, p_trans_dist,
+                                                    FFTW_MEASURE);
 
-            // create plans for forward and inverse FFT
-            thread_local static auto forward = fftwf_plan_many_dft_r2c(rank, &n, batch, p_exp.get(), &p_exp_nembed, p_exp_stride, p_exp_dist, p_trans.get(), &p_trans_nembed, p_trans_stride, p_trans_dist, FFTW_MEASURE | FFTW_PRESERVE_INPUT);
+            plan->inverse = fftwf_plan_many_dft_c2r(rank, &n, batch,
+                                                    p_trans, &p_trans_nembed, p_trans_stride, p_trans_dist,
+                                                    p_real, &p_real_nembed, p_real_stride, p_real_dist,
+                                                    FFTW_MEASURE | FFTW_DESTROY_INPUT);
 
-            thread_local static auto inverse = fftwf_plan_many_dft_c2r(rank, &n, batch,
-                                                          p_trans.get(), &p_trans_nembed, p_trans_stride, p_trans_dist,
-                                                          p_exp.get(), &p_exp_nembed, p_exp_stride, p_exp_dist,
-                                                          FFTW_MEASURE | FFTW_DESTROY_INPUT);
+            if(plan->forward == nullptr || plan->inverse == nullptr)
+            {
+                BOOST_LOG_TRIVIAL(fatal) << "Could not create FFTW plans for " << n_col << " lines of size "
+                                         << filter_size;
+                throw stage_construction_error{"make_filter_plan() failed"};
+            }
+
+            if(!wisdom_path.empty() && fftwf_export_wisdom_to_filename(wisdom_path.c_str()) == 0)
+                BOOST_LOG_TRIVIAL(warning) << "Could not export FFTW wisdom to " << wisdom_path;
+
+            return plan;
+        }
+
+        auto apply_filter(projection_device_type& p, const filter_buffer_type& k, const weight_buffer_type& w,
+                          const filter_plan_type& plan, std::uint32_t filter_size, std::uint32_t n_col) -> void
+        {
+            // the projection is transformed in place: each line holds size_trans complex or 2 * size_trans real values
+            const auto size_trans = filter_size / 2 + 1;
+
+            // grows with the largest geometry this thread has filtered
+            thread_local static auto p_trans = std::unique_ptr<fftwf_complex[], fftw_deleter>{};
+            thread_local static auto capacity = std::size_t{0u};
+            if(capacity < static_cast<std::size_t>(size_trans) * n_col)
+            {
+                p_trans = make_ptr<fftwf_complex>(size_trans, n_col);
+                capacity = static_cast<std::size_t>(size_trans) * n_col;
+            }
+            auto p_real = reinterpret_cast<float*>(p_trans.get());
 
-            // expand and transform the projection
-            expand(p.buf.get(), p.dim_x, p_exp.get(), filter_size, n_col);
-            fftwf_execute(forward);
+            // weight, expand and transform the projection
+            expand(p.buf.get(), w.get(), p.dim_x, p_real, 2 * size_trans, n_col);
+            fftwf_execute_dft_r2c(plan->forward, p_real, p_trans.get());
 
             // apply filter to transformed projection
             do_filtering(p_trans.get(), k.get(), size_trans, n_col);
 
             // inverse transformation
-            fftwf_execute(inverse);
+            fftwf_execute_dft_c2r(plan->inverse, p_trans.get(), p_real);
+
+            // shrink to original size, the filter already took care of the normalization
+            shrink(p_real, 2 * size_trans, p.buf.get(), p.dim_x, n_col);
+        }
+    
+        auto apply_filter(std::vector<projection_device_type>& p, const filter_buffer_type& k,
+                          const weight_buffer_type& w, const filter_plan_type& plan,
+                          std::uint32_t filter_size, std::uint32_t n_col) -> void
+        {
+            // every transform is already spread over all cores
+            for(auto&& proj : p)
+                apply_filter(proj, k, w, plan, filter_size, n_col);
+        }
 
-            // shrink to original size and normalize
-            shrink(p_exp.get(), filter_size, p.buf.get(), p.dim_x, n_col);
-            normalize(p.buf.get(), p.dim_x, p.dim_y, filter_size);
+        auto apply_fused_filter(std::vector<projection_device_type>&, const filter_buffer_type&,
+                                const weight_buffer_type&, std::uint32_t) -> void
+        {
+            BOOST_LOG_TRIVIAL(fatal) << "The OpenMP backend has no fused filter";
+            throw stage_runtime_error{"apply_fused_filter() failed"};
         }
     }
 }
-
@@ -0,0 +1,286 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <vector>
+
+#include <omp.h>
+
+#include "../geometry.h"
+
+#include "backend.h"
+
+namespace paris
+{
+    namespace openmp
+    {
+        namespace
+        {
+            // reciprocals of smaller values are treated as empty rays or voxels
+            constexpr auto min_weight = 1e-6f;
+
+            inline auto vol_centered_coordinate(std::uint32_t coord, std::uint32_t dim, float size) noexcept -> float
+            {
+                auto size2 = size / 2.f;
+                return -(static_cast<float>(dim) * size2) + size2 + static_cast<float>(coord) * size;
+            }
+
+            // the detector coordinate c maps to the pixel coordinate c / size + proj_offset()
+            inline auto proj_offset(std::uint32_t dim, float size, float offset) noexcept -> float
+            {
+                auto size2 = size / 2.f;
+                auto min = -(static_cast<float>(dim) * size2) - offset;
+                return -min / size - (1.f / 2.f);
+            }
+
+            /*
+             * Distributes w over the four pixels around (h, v) with the backprojection's bilinear weights. p holds the
+             * rows [first, last) of the projection, last never exceeds its height.
+             */
+            inline auto splat(float* p, std::uint32_t dim_x, std::uint32_t first, std::uint32_t last, float h, float v,
+                              float w) noexcept -> void
+            {
+                const auto x1 = std::floor(h);
+                const auto y1 = std::floor(v);
+                const auto fx = h - x1;
+                const auto fy = v - y1;
+
+                // the backprojection only samples where all four neighbours exist
+                if(x1 < 0.f || y1 < static_cast<float>(first) || x1 >= static_cast<float>(dim_x) - 1.f ||
+                   y1 >= static_cast<float>(last) - 1.f)
+                    return;
+
+                const auto idx = (static_cast<std::size_t>(y1) - first) * dim_x + static_cast<std::size_t>(x1);
+                p[idx] += (1.f - fx) * (1.f - fy) * w;
+                p[idx + 1u] += fx * (1.f - fy) * w;
+                p[idx + dim_x] += (1.f - fx) * fy * w;
+                p[idx + dim_x + 1u] += fx * fy * w;
+            }
+
+            template <typename F>
+            auto for_each(float* ptr, std::size_t n, F&& f) noexcept -> void
+            {
+                #pragma omp parallel for simd schedule(static)
+                for(auto i = std::size_t{0u}; i < n; ++i)
+                    f(ptr[i], i);
+            }
+
+            auto size(const projection_device_type& p) noexcept -> std::size_t
+            {
+                return static_cast<std::size_t>(p.dim_x) * p.dim_y;
+            }
+
+            auto size(const volume_device_type& v) noexcept -> std::size_t
+            {
+                return static_cast<std::size_t>(v.dim_x) * v.dim_y * v.dim_z;
+            }
+
+            // detector rows [first, last) held by a thread's accumulation buffer
+            struct row_band
+            {
+                const float* buf;
+                std::uint32_t first;
+                std::uint32_t last;
+            };
+        }
+
+        auto forward_project(const volume_device_type& v, std::uint32_t v_offset,
+                             std::vector<projection_device_type>& p,
+                             const detector_geometry& det_geo, const volume_geometry& vol_geo,
+                             const std::vector<float>& sin, const std::vector<float>& cos,
+                             float delta_s, float delta_t) noexcept -> void
+        {
+            const auto d_so = det_geo.d_so;
+            const auto d_sd = std::abs(det_geo.d_so) + std::abs(det_geo.d_od);
+
+            // a voxel covers (d_sd / s)^2 * l_vx^2 / l_px^2 pixels and contributes l_vx to each ray through it
+            const auto scale = vol_geo.l_vx_x * vol_geo.l_vx_y * vol_geo.l_vx_z * (d_sd / d_so) * (d_sd / d_so) /
+                               (det_geo.l_px_row * det_geo.l_px_col);
+
+            const auto n = p.size();
+            const auto x_first = vol_centered_coordinate(0u, vol_geo.dim_x, vol_geo.l_vx_x);
+            const auto x_last = vol_centered_coordinate(v.dim_x - 1u, vol_geo.dim_x, vol_geo.l_vx_x);
+            const auto y_first = vol_centered_coordinate(0u, vol_geo.dim_y, vol_geo.l_vx_y);
+            const auto y_last = vol_centered_coordinate(v.dim_y - 1u, vol_geo.dim_y, vol_geo.l_vx_y);
+
+            /*
+             * A batch holds far fewer projections than there are cores. Every thread splats its own z-slab of the
+             * volume into a buffer for the detector rows the slab projects to, the threads then add up the buffers
+             * row by row.
+             */
+            auto bands = std::vector<row_band>(static_cast<std::size_t>(omp_get_max_threads()));
+            #pragma omp parallel
+            {
+                const auto t = static_cast<std::uint32_t>(omp_get_thread_num());
+                const auto threads = static_cast<std::uint32_t>(omp_get_num_threads());
+                const auto m_first = static_cast<std::uint32_t>(std::size_t{v.dim_z} * t / threads);
+                const auto m_last = static_cast<std::uint32_t>(std::size_t{v.dim_z} * (t + 1u) / threads);
+                auto local = std::vector<float>{};
+
+                for(auto i = std::size_t{0u}; i < n; ++i)
+                {
+                    auto&& proj = p[i];
+                    const auto h_off = proj_offset(det_geo.n_row, det_geo.l_px_row, delta_s)
+                                       - static_cast<float>(proj.first_col);
+                    const auto v_off = proj_offset(det_geo.n_col, det_geo.l_px_col, delta_t)
+                                       - static_cast<float>(proj.first_row);
+
+                    // s is linear in x and y -> its extremes lie in the corners of the slices
+                    auto s_min = d_so;
+                    auto s_max = d_so;
+                    for(auto x : {x_first, x_last})
+                    {
+                        for(auto y : {y_first, y_last})
+                        {
+                            const auto s = x * cos[i] + y * sin[i] + d_so;
+                            s_min = std::min(s_min, s);
+                            s_max = std::max(s_max, s);
+                        }
+                    }
+
+                    // the rows the slab projects to, plus a margin for rounding -- all rows if the source is inside
+                    auto first = 0u;
+                    auto last = (m_first < m_last) ? proj.dim_y : 0u;
+                    if(m_first < m_last && s_min > 0.f)
+                    {
+                        const auto z_lo = vol_centered_coordinate(m_first + v_offset, vol_geo.dim_z, vol_geo.l_vx_z);
+                        const auto z_hi = vol_centered_coordinate(m_last - 1u + v_offset, vol_geo.dim_z,
+                                                                  vol_geo.l_vx_z);
+                        auto v_min = std::numeric_limits<float>::max();
+                        auto v_max = std::numeric_limits<float>::lowest();
+                        for(auto z : {z_lo, z_hi})
+                        {
+                            for(auto factor : {d_sd / s_min, d_sd / s_max})
+                            {
+                                const auto vv = z * factor / det_geo.l_px_col + v_off;
+                                v_min = std::min(v_min, vv);
+                                v_max = std::max(v_max, vv);
+                            }
+                        }
+
+                        const auto dim_y = static_cast<float>(proj.dim_y);
+                        first = static_cast<std::uint32_t>(std::min(std::max(std::floor(v_min) - 1.f, 0.f), dim_y));
+                        last = static_cast<std::uint32_t>(std::min(std::max(std::floor(v_max) + 3.f, 0.f), dim_y));
+                        last = std::max(first, last);
+                    }
+
+                    local.assign(static_cast<std::size_t>(last - first) * proj.dim_x, 0.f);
+                    for(auto m = m_first; m < m_last; ++m)
+                    {
+                        const auto z_m = vol_centered_coordinate(m + v_offset, vol_geo.dim_z, vol_geo.l_vx_z);
+                        for(auto l = 0u; l < v.dim_y; ++l)
+                        {
+                            const auto y_l = vol_centered_coordinate(l, vol_geo.dim_y, vol_geo.l_vx_y);
+                            const auto row = v.buf.get() + (static_cast<std::size_t>(m) * v.dim_y + l) * v.dim_x;
+                            for(auto k = 0u; k < v.dim_x; ++k)
+                            {
+                                if(!(std::abs(row[k]) > 0.f))
+                                    continue;
+
+                                const auto x_k = vol_centered_coordinate(k, vol_geo.dim_x, vol_geo.l_vx_x);
+                                const auto s = x_k * cos[i] + y_l * sin[i] + d_so;
+                                const auto tt = -x_k * sin[i] + y_l * cos[i];
+
+                                const auto factor = d_sd / s;
+                                const auto h = tt * factor / det_geo.l_px_row + h_off;
+                                const auto vv = z_m * factor / det_geo.l_px_col + v_off;
+
+                                const auto u = d_so / s;
+                                splat(local.data(), proj.dim_x, first, last, h, vv, scale * u * u * row[k]);
+                            }
+                        }
+                    }
+                    bands[t] = row_band{local.data(), first, last};
+
+                    // every buffer is complete before any row is summed, and summed before it is cleared again
+                    #pragma omp barrier
+                    #pragma omp for schedule(static)
+                    for(auto y = 0u; y < proj.dim_y; ++y)
+                    {
+                        auto dst = proj.buf.get() + static_cast<std::size_t>(y) * proj.dim_x;
+                        for(auto b = 0u; b < threads; ++b)
+                        {
+                            const auto& band = bands[b];
+                            if(y < band.first || y >= band.last)
+                                continue;
+
+                            const auto src = band.buf + static_cast<std::size_t>(y - band.first) * proj.dim_x;
+                            #pragma omp simd
+                            for(auto k = 0u; k < proj.dim_x; ++k)
+                                dst[k] += src[k];
+                        }
+                    }
+                }
+            }
+        }
+
+        auto fill(projection_device_type& p, float value) noexcept -> void
+        {
+            for_each(p.buf.get(), size(p), [value](float& x, std::size_t) { x = value; });
+        }
+
+        auto fill(volume_device_type& v, float value) noexcept -> void
+        {
+            for_each(v.buf.get(), size(v), [value](float& x, std::size_t) { x = value; });
+        }
+
+        auto invert(projection_device_type& p) noexcept -> void
+        {
+            for_each(p.buf.get(), size(p), [](float& x, std::size_t) { x = (x > min_weight) ? 1.f / x : 0.f; });
+        }
+
+        auto invert(volume_device_type& v) noexcept -> void
+        {
+            for_each(v.buf.get(), size(v), [](float& x, std::size_t) { x = (x > min_weight) ? 1.f / x : 0.f; });
+        }
+
+        auto residual(const projection_device_type& b, projection_device_type& ax,
+                      const projection_device_type& w) noexcept -> void
+        {
+            const auto b_ptr = b.buf.get();
+            const auto w_ptr = w.buf.get();
+            for_each(ax.buf.get(), size(ax), [b_ptr, w_ptr](float& x, std::size_t i)
+            {
+                x = (b_ptr[i] - x) * w_ptr[i];
+            });
+        }
+
+        auto update(volume_device_type& x, volume_device_type& corr, const volume_device_type& c, float lambda,
+                    bool nonnegative) noexcept -> void
+        {
+            const auto corr_ptr = corr.buf.get();
+            const auto c_ptr = c.buf.get();
+            for_each(x.buf.get(), size(x), [=](float& val, std::size_t i)
+            {
+                val += lambda * c_ptr[i] * corr_ptr[i];
+                if(nonnegative)
+                    val = std::max(val, 0.f);
+                corr_ptr[i] = 0.f;
+            });
+        }
+    }
+}
@@ -21,10 +21,21 @@
  */
 
 #include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <memory>
 
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <boost/log/trivial.hpp>
+
 #include "backend.h"
+#include "../exception.h"
 #include "../projection.h"
+#include "numa.h"
 
 namespace paris
 {
@@ -41,12 +52,73 @@ namespace paris
             return make_projection_host(dim_x, dim_y);
         }
 
+        auto volume_deleter::operator()(float* p) noexcept -> void
+        {
+            if(length == 0u)
+            {
+                delete[] p;
+                return;
+            }
+
+            // start writing back the dirty pages, the mapping itself goes away right now
+            auto base = reinterpret_cast<char*>(p) - offset;
+            ::msync(base, length, MS_ASYNC);
+            ::munmap(base, length);
+        }
+
         auto make_volume_host(std::uint32_t dim_x, std::uint32_t dim_y, std::uint32_t dim_z) -> volume_host_type
         {
-            auto ptr = std::make_unique<float[]>(dim_x * dim_y * dim_z);
-            // fill with 0
-            std::fill_n(ptr.get(), dim_x * dim_y * dim_z, 0.f);
-            return volume<volume_host_buffer_type>{std::move(ptr), dim_x, dim_y, dim_z, 0}; 
+            auto slice = static_cast<std::size_t>(dim_x) * dim_y;
+            auto ptr = volume_host_buffer_type{new float[slice * dim_z], volume_deleter{0u, 0u}};
+
+            // first touch: the pages end up next to the cores which backproject into them
+            auto dst = ptr.get();
+            numa::bound();  // binds the team of this thread if it is the first to get here
+            #pragma omp parallel
+            {
+                auto place = numa::place{};
+                if(numa::current_place(place))
+                {
+                    // the node's z-slab, see do_backprojection()
+                    auto z_first = std::size_t{};
+                    auto z_last = std::size_t{};
+                    numa::share(dim_z, place.node, place.nodes, z_first, z_last);
+
+                    auto first = std::size_t{};
+                    auto last = std::size_t{};
+                    numa::share((z_last - z_first) * slice, place.rank, place.size, first, last);
+                    std::fill(dst + z_first * slice + first, dst + z_first * slice + last, 0.f);
+                }
+                else
+                {
+                    #pragma omp for schedule(static)
+                    for(auto z = 0u; z < dim_z; ++z)
+                        std::fill_n(dst + z * slice, slice, 0.f);
+                }
+            }
+
+            return volume<volume_host_buffer_type>{std::move(ptr), dim_x, dim_y, dim_z, 0};
+        }
+
+        auto map_volume(int fd, std::uint64_t pos, std::uint32_t dim_x, std::uint32_t dim_y, std::uint32_t dim_z)
+            -> volume_device_type
+        {
+            // mappings have to start at a page boundary
+            static const auto page = static_cast<std::uint64_t>(::sysconf(_SC_PAGESIZE));
+            auto base = pos / page * page;
+            auto offset = static_cast<std::size_t>(pos - base);
+            auto length = offset + static_cast<std::size_t>(dim_x) * dim_y * dim_z * sizeof(float);
+
+            auto addr = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, static_cast<off_t>(base));
+            if(addr == MAP_FAILED)
+            {
+                BOOST_LOG_TRIVIAL(fatal) << "Could not map volume slab: " << std::strerror(errno);
+                throw stage_runtime_error{"map_volume() failed"};
+            }
+
+            auto ptr = volume_device_buffer_type{reinterpret_cast<float*>(static_cast<char*>(addr) + offset),
+                                                 volume_deleter{offset, length}};
+            return volume_device_type{std::move(ptr), dim_x, dim_y, dim_z, 0};
         }
 
         auto make_volume_device(std::uint32_t dim_x, std::uint32_t dim_y, std::uint32_t dim_z) -> volume_device_type
@@ -59,6 +131,19 @@ namespace paris
             std::copy_n(h_p.buf.get(), h_p.dim_x * h_p.dim_y, d_p.buf.get());
             d_p.idx = h_p.idx;
             d_p.phi = h_p.phi;
+            d_p.first_row = h_p.first_row;
+            d_p.first_col = h_p.first_col;
+            d_p.meta = h_p.meta;
+        }
+
+        auto copy_h2d(const projection_host_type& h_p, projection_device_type& d_p, std::uint32_t first) noexcept -> void
+        {
+            auto row = static_cast<std::size_t>(h_p.dim_x);
+            std::copy_n(h_p.buf.get() + first * row, d_p.dim_y * row, d_p.buf.get());
+            d_p.idx = h_p.idx;
+            d_p.phi = h_p.phi;
+            d_p.first_row = h_p.first_row + first;
+            d_p.first_col = h_p.first_col;
             d_p.meta = h_p.meta;
         }
 
@@ -67,6 +152,18 @@ namespace paris
             copy_h2d(d_p, h_p);
         }
 
+        auto copy_d2h(const projection_device_type& d_p, projection_host_type& h_p, std::uint32_t first) noexcept -> void
+        {
+            for(auto y = 0u; y < h_p.dim_y; ++y)
+                std::copy_n(d_p.buf.get() + static_cast<std::size_t>(y) * d_p.dim_x + first, h_p.dim_x,
+                            h_p.buf.get() + static_cast<std::size_t>(y) * h_p.dim_x);
+            h_p.idx = d_p.idx;
+            h_p.phi = d_p.phi;
+            h_p.first_row = d_p.first_row;
+            h_p.first_col = d_p.first_col + first;
+            h_p.meta = d_p.meta;
+        }
+
         auto copy_h2d(const volume_host_type& h_v, volume_device_type& d_v) noexcept -> void
         {
             std::copy_n(h_v.buf.get(), h_v.dim_x * h_v.dim_y * h_v.dim_z, d_v.buf.get());
@@ -77,5 +174,12 @@ namespace paris
         {
             copy_h2d(d_v, h_v);
         }
+
+        auto copy_d2h(const volume_device_type& d_v, volume_host_type& h_v, std::uint32_t first) noexcept -> void
+        {
+            auto slice = static_cast<std::size_t>(d_v.dim_x) * d_v.dim_y;
+            std::copy_n(d_v.buf.get() + first * slice, h_v.dim_z * slice, h_v.buf.get());
+            h_v.off = d_v.off + first;
+        }
     }
 }
@@ -0,0 +1,252 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <omp.h>
+
+#include <boost/log/trivial.hpp>
+
+#include "backend.h"
+#include "numa.h"
+
+namespace paris
+{
+    namespace openmp
+    {
+        namespace numa
+        {
+            namespace
+            {
+                struct binding
+                {
+                    bool enabled = false;
+                    std::uint32_t nodes = 1u;
+                    std::vector<cpu_set_t> sets;         // CPUs of every node
+                    std::vector<std::uint32_t> node_of;  // of every thread
+                    std::vector<std::uint32_t> first;    // thread of every node
+                    std::vector<std::uint32_t> count;    // threads of every node
+                };
+
+                auto get_binding() -> binding&
+                {
+                    static auto b = binding{};
+                    return b;
+                }
+
+                /*
+                 * Every thread which starts parallel regions -- the main thread, the device workers and the threads
+                 * of a server's pool -- has a team of its own, each team is bound the first time it is needed.
+                 */
+                enum class team_state { unbound, bound, failed };
+                thread_local auto team = team_state::unbound;
+
+                // set by the members of a bound team
+                thread_local auto bound_here = false;
+
+                // binds the team of the calling thread, must be called outside of parallel regions
+                auto bind_team() -> bool
+                {
+                    auto&& b = get_binding();
+                    auto threads = static_cast<std::uint32_t>(b.node_of.size());
+                    auto&& ok = std::atomic<bool>{true};
+                    #pragma omp parallel num_threads(threads)
+                    {
+                        auto t = static_cast<std::uint32_t>(omp_get_thread_num());
+                        auto&& set = b.sets[b.node_of[t]];
+                        if(pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+                            ok = false;
+                        else
+                            bound_here = true;
+                    }
+
+                    team = ok ? team_state::bound : team_state::failed;
+                    if(!ok)
+                        BOOST_LOG_TRIVIAL(warning) << "Could not bind the OpenMP threads to their NUMA nodes";
+                    return ok;
+                }
+
+                // lists like "0-3,8-11"
+                auto parse_list(const std::string& list) -> std::vector<int>
+                {
+                    auto result = std::vector<int>{};
+                    auto ss = std::istringstream{list};
+                    auto item = std::string{};
+                    while(std::getline(ss, item, ','))
+                    {
+                        if(item.empty())
+                            continue;
+
+                        auto dash = item.find('-');
+                        auto from = std::stoi(item.substr(0u, dash));
+                        auto to = (dash == std::string::npos) ? from : std::stoi(item.substr(dash + 1u));
+                        for(auto i = from; i <= to; ++i)
+                            result.push_back(i);
+                    }
+                    return result;
+                }
+
+                auto read_list(const std::string& path) -> std::vector<int>
+                {
+                    auto file = std::ifstream{path};
+                    auto line = std::string{};
+                    if(!std::getline(file, line))
+                        return std::vector<int>{};
+                    return parse_list(line);
+                }
+            }
+
+            auto bind_threads() -> bool
+            {
+                auto&& b = get_binding();
+                if(b.enabled)
+                    return team != team_state::failed;
+
+                auto allowed = cpu_set_t{};
+                CPU_ZERO(&allowed);
+                if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+                    return false;
+
+                // the CPUs of every node this process may run on
+                auto sets = std::vector<cpu_set_t>{};
+                try
+                {
+                    for(auto node : read_list("/sys/devices/system/node/online"))
+                    {
+                        auto set = cpu_set_t{};
+                        CPU_ZERO(&set);
+                        auto path = "/sys/devices/system/node/node" + std::to_string(node) + "/cpulist";
+                        for(auto cpu : read_list(path))
+                        {
+                            if(cpu < 0 || cpu >= CPU_SETSIZE)
+                                continue;
+
+                            auto c = static_cast<std::size_t>(cpu);
+                            if(CPU_ISSET(c, &allowed))
+                                CPU_SET(c, &set);
+                        }
+
+                        if(CPU_COUNT(&set) > 0)
+                            sets.push_back(set);
+                    }
+                }
+                catch(const std::exception& e)
+                {
+                    BOOST_LOG_TRIVIAL(warning) << "Could not read the NUMA topology: " << e.what();
+                    return false;
+                }
+
+                auto nodes = static_cast<std::uint32_t>(sets.size());
+                auto threads = static_cast<std::uint32_t>(omp_get_max_threads());
+                if(nodes < 2u || threads < nodes)
+                    return false;
+
+                // contiguous blocks of threads per node, like the static schedule hands out iterations
+                b.sets = sets;
+                b.node_of.resize(threads);
+                b.first.assign(nodes, threads);
+                b.count.assign(nodes, 0u);
+                for(auto t = 0u; t < threads; ++t)
+                {
+                    auto node = static_cast<std::uint32_t>(std::size_t{t} * nodes / threads);
+                    b.node_of[t] = node;
+                    b.first[node] = std::min(b.first[node], t);
+                    ++b.count[node];
+                }
+
+                if(!bind_team())
+                    return false;
+
+                b.nodes = nodes;
+                b.enabled = true;
+                BOOST_LOG_TRIVIAL(info) << "Bound " << threads << " threads to " << nodes << " NUMA nodes";
+                return true;
+            }
+
+            auto bound() -> bool
+            {
+                if(!get_binding().enabled || team == team_state::failed)
+                    return false;
+
+                return team == team_state::bound || bind_team();
+            }
+
+            auto nodes() noexcept -> std::uint32_t
+            {
+                auto&& b = get_binding();
+                return b.enabled ? b.nodes : 1u;
+            }
+
+            auto current_place(place& p) noexcept -> bool
+            {
+                auto&& b = get_binding();
+                if(!bound_here || static_cast<std::size_t>(omp_get_num_threads()) != b.node_of.size())
+                    return false;
+
+                auto t = static_cast<std::uint32_t>(omp_get_thread_num());
+                p.node = b.node_of[t];
+                p.nodes = b.nodes;
+                p.rank = t - b.first[p.node];
+                p.size = b.count[p.node];
+                return true;
+            }
+
+            auto replicas(std::size_t size) -> const std::vector<float*>&
+            {
+                thread_local static auto owned = std::vector<std::unique_ptr<float[]>>{};
+                thread_local static auto ptrs = std::vector<float*>{};
+                thread_local static auto capacity = std::size_t{0u};
+
+                auto nodes = get_binding().nodes;
+                if(size > capacity || owned.size() != nodes)
+                {
+                    owned.clear();
+                    ptrs.clear();
+                    for(auto i = 0u; i < nodes; ++i)
+                    {
+                        // left uninitialised, the first touch happens on the node
+                        owned.emplace_back(new float[size]);
+                        ptrs.push_back(owned.back().get());
+                    }
+                    capacity = size;
+                }
+                return ptrs;
+            }
+        }
+
+        auto enable_numa() -> bool
+        {
+            return numa::bind_threads();
+        }
+    }
+}
@@ -0,0 +1,79 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#ifndef PARIS_OPENMP_NUMA_H_
+#define PARIS_OPENMP_NUMA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * NUMA placement for the OpenMP backend. The threads are bound to the nodes in contiguous blocks, every node then
+ * owns a z-slab of the volume and its own copy of the projections. Without binding -- or on machines with a single
+ * node -- all of this falls back to plain static scheduling.
+ */
+namespace paris
+{
+    namespace openmp
+    {
+        namespace numa
+        {
+            // the calling OpenMP thread: node it is bound to, its rank among the threads of that node
+            struct place
+            {
+                std::uint32_t node;
+                std::uint32_t nodes;
+                std::uint32_t rank;
+                std::uint32_t size;
+            };
+
+            // binds the OpenMP threads to the nodes, returns false if there is nothing to bind to
+            auto bind_threads() -> bool;
+
+            // binds the team of the calling thread on first use, call it outside of parallel regions
+            auto bound() -> bool;
+
+            // the nodes the threads are spread over, 1 without binding
+            auto nodes() noexcept -> std::uint32_t;
+
+            // false unless the calling thread is bound and its team is as large as the one which was bound
+            auto current_place(place& p) noexcept -> bool;
+
+            // the part [first, last) of [0, num) handled by index i out of n
+            inline auto share(std::size_t num, std::uint32_t i, std::uint32_t n,
+                              std::size_t& first, std::size_t& last) noexcept -> void
+            {
+                first = num * i / n;
+                last = num * (i + 1u) / n;
+            }
+
+            /*
+             * One buffer per node with room for size floats. The buffers are reused by later calls on the same
+             * thread and only grow, their pages are placed by whichever thread touches them first.
+             */
+            auto replicas(std::size_t size) -> const std::vector<float*>&;
+        }
+    }
+}
+
+#endif /* PARIS_OPENMP_NUMA_H_ */
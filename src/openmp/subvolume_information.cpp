@@ -20,24 +20,115 @@
  * Authors: Jan Stephan <j.stephan@hzdr.de>
  */
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include <unistd.h>
+
+#include <boost/log/trivial.hpp>
+
+#include "../exception.h"
+#include "../filtering.h"
 #include "../geometry.h"
 #include "../subvolume_information.h"
 #include "backend.h"
+#include "numa.h"
 
 namespace paris
 {
     namespace openmp
     {
-        auto make_subvolume_information(const volume_geometry& vol_geo, const detector_geometry& /* det_geo */) noexcept
-            -> subvolume_info
+        namespace
+        {
+            // memory the kernel could hand out without swapping [bytes]
+            auto available_memory() -> std::size_t
+            {
+                auto meminfo = std::ifstream{"/proc/meminfo"};
+                auto key = std::string{};
+                auto value = std::size_t{};
+                auto unit = std::string{};
+                while(meminfo >> key >> value >> unit)
+                {
+                    if(key == "MemAvailable:")
+                        return value << 10u;
+                }
+
+                auto pages = ::sysconf(_SC_AVPHYS_PAGES);
+                auto page = ::sysconf(_SC_PAGESIZE);
+                return (pages > 0 && page > 0) ? static_cast<std::size_t>(pages) * static_cast<std::size_t>(page)
+                                               : 0u;
+            }
+
+            // every buffer of the pipeline except for the volume
+            auto plan_memory(const detector_geometry& det_geo, const memory_parameters& mem) -> memory_plan
+            {
+                auto plan = memory_plan{};
+                auto batch = std::max(std::min(mem.batch_size, max_batch_size), 1u);
+                auto depth = std::max(mem.pipeline_depth, 1u);
+                auto proj = static_cast<std::size_t>(det_geo.n_row) * mem.rows * sizeof(float);
+
+                // unfiltered and batched projections plus those still in flight after a backprojection pass
+                plan.projections = (3u * batch + depth + 1u) * proj;
+
+                // weights, filter and the transform buffer of the worker thread and of the planner
+                auto size_trans = std::size_t{filter_length(det_geo) / 2u + 1u};
+                plan.filtering = proj + size_trans * sizeof(float) + 2u * size_trans * mem.rows * sizeof(fftwf_complex);
+
+                // the backprojection reads the projections in place -- bound threads copy each batch to every node
+                auto nodes = numa::nodes();
+                plan.backprojection = (nodes > 1u) ? batch * proj * nodes : 0u;
+
+                return plan;
+            }
+        }
+
+        auto make_subvolume_information(const volume_geometry& vol_geo, const detector_geometry& det_geo,
+                                        const memory_parameters& mem) -> subvolume_info
         {
             auto subvol_info = subvolume_info{};
+            auto plan = plan_memory(det_geo, mem);
+            auto fixed = plan.projections + plan.filtering + plan.backprojection + mem.reserved;
+            auto slice = static_cast<std::size_t>(vol_geo.dim_x) * vol_geo.dim_y * sizeof(float);
+
+            auto mem_free = available_memory();
+            plan.budget = (mem.budget != 0u) ? mem.budget : mem_free - mem_free / 10u;
+            if(mem.budget == 0u && mem_free == 0u)
+            {
+                BOOST_LOG_TRIVIAL(warning) << "Could not determine the available memory, not splitting the volume";
+                plan.budget = fixed + vol_geo.dim_z * slice;
+            }
+
+            auto max_dim_z = (plan.budget > fixed) ? static_cast<std::uint32_t>(
+                                std::min((plan.budget - fixed) / slice, static_cast<std::size_t>(vol_geo.dim_z)))
+                                                   : 0u;
+
+            BOOST_LOG_TRIVIAL(info) << "The host has " << mem_free << " bytes available, " << plan.budget
+                                    << " bytes budgeted, and fits " << max_dim_z << " slices";
+            if(max_dim_z == 0u)
+            {
+                BOOST_LOG_TRIVIAL(fatal) << "Not a single slice fits into the host memory budget";
+                throw stage_construction_error{"make_subvolume_information() failed"};
+            }
+
+            // the smallest number of z-slabs which fit -- the last one also holds the remainder
+            auto vols_needed = (vol_geo.dim_z + max_dim_z - 1u) / max_dim_z;
+            while(vol_geo.dim_z / vols_needed + vol_geo.dim_z % vols_needed > max_dim_z)
+                ++vols_needed;
 
             subvol_info.geo.dim_x = vol_geo.dim_x;
             subvol_info.geo.dim_y = vol_geo.dim_y;
-            subvol_info.geo.dim_z = vol_geo.dim_z;
-            subvol_info.geo.remainder = 0u;
-            subvol_info.num = 1;
+            subvol_info.geo.dim_z = vol_geo.dim_z / vols_needed;
+            subvol_info.geo.remainder = vol_geo.dim_z % vols_needed;
+            subvol_info.num = static_cast<int>(vols_needed);
+
+            plan.volume = (subvol_info.geo.dim_z + subvol_info.geo.remainder) * slice;
+            subvol_info.plan = plan;
+
+            BOOST_LOG_TRIVIAL(info) << "Planned " << vols_needed << " subvolumes, the host needs "
+                                    << plan.volume + fixed << " of " << plan.budget << " bytes";
 
             return subvol_info;
         }
@@ -22,6 +22,7 @@
 
 #include <cmath>
 #include <cstdint>
+#include <memory>
 
 #include "backend.h"
 
@@ -29,17 +30,16 @@ namespace paris
 {
     namespace openmp
     {
-        auto weight(projection_device_type& p, float h_min, float v_min, float d_sd, float l_px_row, float l_px_col)
-            noexcept
-            -> void
+        auto make_weights(std::uint32_t dim_x, std::uint32_t dim_y, float h_min, float v_min, float d_sd,
+                          float l_px_row, float l_px_col) -> weight_buffer_type
         {
+            auto w = std::make_unique<float[]>(dim_x * dim_y);
+
             #pragma omp parallel for collapse(2)
-            for(auto t = 0u; t < p.dim_y; ++t)
+            for(auto t = 0u; t < dim_y; ++t)
             {
-                for(auto s = 0u; s < p.dim_x; ++s)
+                for(auto s = 0u; s < dim_x; ++s)
                 {
-                    const auto coord = s + t * p.dim_x;
-
                     // prevent conversion warnings
                     const auto s_f = static_cast<float>(s);
                     const auto t_f = static_cast<float>(t);
@@ -48,12 +48,11 @@ namespace paris
                     const auto h_s = (l_px_row / 2) + s_f * l_px_row + h_min;
                     const auto v_t = (l_px_col / 2) + t_f * l_px_col + v_min;
 
-                    // calculate weight
-                    const auto w_st = d_sd / std::sqrt(d_sd * d_sd + h_s * h_s + v_t * v_t);
-
-                    p.buf[coord] *= w_st;
+                    w[s + t * dim_x] = d_sd / std::sqrt(d_sd * d_sd + h_s * h_s + v_t * v_t);
                 }
             }
+
+            return w;
         }
     }
 }
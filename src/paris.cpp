@@ -0,0 +1,188 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <queue>
+
+#include <boost/log/trivial.hpp>
+
+#include "backend.h"
+#include "exception.h"
+#include "geometry.h"
+#include "iterative.h"
+#include "paris.h"
+#include "program_options.h"
+#include "projection_cache.h"
+#include "reconstruction.h"
+#include "scheduler.h"
+#include "sink.h"
+#include "source.h"
+#include "subvolume_information.h"
+#include "task.h"
+
+namespace paris
+{
+    namespace
+    {
+        // the tasks only know the program options of the command line interface
+        auto make_options(const projection_stack& projections, const detector_geometry& det_geo,
+                          const reconstruction_options& opts) -> program_options
+        {
+            auto po = program_options{};
+            po.det_geo = det_geo;
+            po.enable_io = true;
+            po.prefetch_depth = opts.prefetch_depth;
+            po.enable_roi = opts.enable_roi;
+            po.roi = opts.roi;
+            po.enable_angles = projections.angles != nullptr;
+            po.filter = opts.filter;
+            po.quality = std::max(opts.quality, std::uint16_t{1u});
+            po.interp = opts.interp;
+            po.pipeline_depth = opts.pipeline_depth;
+            po.batch_size = opts.batch_size;
+            po.enable_hybrid = false;
+            po.preview = 1u;
+            return po;
+        }
+
+        auto make_volume_geometry(const program_options& po) -> volume_geometry
+        {
+            auto vol_geo = calculate_volume_geometry(po.det_geo);
+            if(po.enable_roi)
+                return apply_roi(vol_geo, po.roi.x1, po.roi.x2, po.roi.y1, po.roi.y2, po.roi.z1, po.roi.z2);
+            return vol_geo;
+        }
+    }
+
+    auto volume_dimensions(const detector_geometry& det_geo, const reconstruction_options& opts) -> volume_geometry
+    {
+        return make_volume_geometry(make_options(projection_stack{}, det_geo, opts));
+    }
+
+    auto reconstruct(const projection_stack& projections, const detector_geometry& det_geo,
+                     const reconstruction_options& opts, const volume_consumer& consume) -> void
+    {
+        if(projections.data == nullptr || projections.num == 0u)
+            throw stage_construction_error{"reconstruct() called without projections"};
+
+        if(projections.dim_x != det_geo.n_row || projections.dim_y != det_geo.n_col)
+        {
+            BOOST_LOG_TRIVIAL(fatal) << "Projections of " << projections.dim_x << " x " << projections.dim_y
+                                     << " pixels don't match the detector of " << det_geo.n_row << " x "
+                                     << det_geo.n_col << " pixels";
+            throw stage_construction_error{"reconstruct() failed"};
+        }
+
+        auto po = make_options(projections, det_geo, opts);
+        auto vol_geo = calculate_volume_geometry(po.det_geo);
+        auto roi_geo = make_volume_geometry(po);
+
+        auto z_first = po.enable_roi ? po.roi.z1 : 0u;
+        auto rows = calculate_row_window(po.det_geo, vol_geo, po.enable_roi, po.roi, z_first, roi_geo.dim_z);
+        auto mem = memory_parameters{opts.memory_budget, rows.rows, po.pipeline_depth, po.batch_size,
+                                     staging_memory(po.det_geo.n_row, rows.rows, roi_geo, po.prefetch_depth)};
+        auto subvol_info = backend::make_subvolume_information(roi_geo, po.det_geo, mem);
+
+        // more subvolumes than the memory needs, e.g. to spread a small volume over several devices
+        auto num = std::min(opts.subvolumes, roi_geo.dim_z);
+        if(num > static_cast<std::uint32_t>(subvol_info.num))
+        {
+            subvol_info.geo.dim_z = roi_geo.dim_z / num;
+            subvol_info.geo.remainder = roi_geo.dim_z % num;
+            subvol_info.num = static_cast<int>(num);
+        }
+
+        auto tasks = make_tasks(po, vol_geo, subvol_info);
+        auto task_num = static_cast<std::uint32_t>(tasks.size());
+
+        // only the detector rows needed by the subvolumes are copied into the pipeline
+        auto window = tasks.front().window;
+        for(auto q = tasks; !q.empty(); q.pop())
+            window = merge(window, q.front().window);
+
+        auto devices = backend::get_devices();
+        auto&& sched = scheduler{tasks, devices.size()};
+        backend::set_pipeline_depth(po.pipeline_depth);
+        backend::set_tuning_dir(opts.tuning_dir);
+        size_host_pool(po.det_geo.n_row, window, roi_geo, devices.size(), po.prefetch_depth, po.pipeline_depth);
+        auto batch_size = std::min(std::max(po.batch_size, 1u), backend::max_batch_size);
+
+        auto&& sink = paris::sink{roi_geo, consume};
+        auto&& source = paris::source{projections.data, projections.dim_x, projections.dim_y, projections.num,
+                                      projections.angles, window, po.quality, po.prefetch_depth};
+        auto columns = calculate_column_window(po.det_geo, vol_geo, po.enable_roi, po.roi);
+        auto&& cache = projection_cache{source, task_num, po.det_geo.n_row, window.rows, columns};
+
+        reconstruct(sched, devices, false, cache, sink, po.pipeline_depth, batch_size);
+        sink.flush();
+    }
+
+    auto reconstruct(const projection_stack& projections, const detector_geometry& det_geo,
+                     const reconstruction_options& opts, float* volume) -> void
+    {
+        auto vol_geo = volume_dimensions(det_geo, opts);
+        auto slice = static_cast<std::size_t>(vol_geo.dim_x) * vol_geo.dim_y;
+
+        // the slabs are disjoint, the writers don't need to synchronise
+        reconstruct(projections, det_geo, opts, [volume, slice](const float* slices, std::uint32_t dim_z,
+                                                                std::uint32_t first)
+        {
+            std::copy_n(slices, dim_z * slice, volume + first * slice);
+        });
+    }
+
+    auto reconstruct_iterative(const projection_stack& projections, const detector_geometry& det_geo,
+                               const iterative_options& opts, float* volume) -> void
+    {
+        if(projections.data == nullptr || projections.num == 0u)
+            throw stage_construction_error{"reconstruct_iterative() called without projections"};
+
+        if(projections.dim_x != det_geo.n_row || projections.dim_y != det_geo.n_col)
+        {
+            BOOST_LOG_TRIVIAL(fatal) << "Projections of " << projections.dim_x << " x " << projections.dim_y
+                                     << " pixels don't match the detector of " << det_geo.n_row << " x "
+                                     << det_geo.n_col << " pixels";
+            throw stage_construction_error{"reconstruct_iterative() failed"};
+        }
+
+        if(det_geo.beam != beam_geometry::cone)
+        {
+            BOOST_LOG_TRIVIAL(fatal) << "Iterative reconstructions only support cone beams";
+            throw stage_construction_error{"reconstruct_iterative() failed"};
+        }
+
+        // all projections are needed at once, the source only converts them
+        auto&& source = paris::source{projections.data, projections.dim_x, projections.dim_y, projections.num,
+                                      projections.angles, row_window{0u, det_geo.n_col}, 1u, 8u};
+        auto p = std::vector<backend::projection_host_type>{};
+        p.reserve(projections.num);
+        while(!source.drained())
+            p.push_back(source.load_next());
+
+        auto params = iterative_parameters{opts.iterations, opts.subsets, opts.relaxation, opts.nonnegative,
+                                           opts.memory_budget};
+        auto h_v = paris::reconstruct_iterative(p, det_geo, projections.angles != nullptr, params);
+        std::copy_n(h_v.buf.get(), static_cast<std::size_t>(h_v.dim_x) * h_v.dim_y * h_v.dim_z, volume);
+    }
+}
@@ -0,0 +1,103 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#ifndef PARIS_PARIS_H_
+#define PARIS_PARIS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "filter_config.h"
+#include "geometry.h"
+#include "interpolation.h"
+#include "region_of_interest.h"
+
+/*
+ * Entry point for embedding PARIS into other programs. The projections are taken from the caller's memory and the
+ * volume is handed back without touching the file system.
+ *
+ * The geometry dependent parts of the pipeline (filter, weights, FFT plans) are cached per detector geometry and
+ * filter options, reconstructions of a process may use different geometries.
+ */
+namespace paris
+{
+    // a stack of projections in caller-owned memory
+    struct projection_stack
+    {
+        const float* data;      // num projections of dim_x * dim_y pixels, one after another
+        std::uint32_t dim_x;    // has to match det_geo.n_row
+        std::uint32_t dim_y;    // has to match det_geo.n_col
+        std::uint32_t num;
+        const float* angles;    // num angles [°], nullptr uses det_geo.delta_phi
+    };
+
+    struct reconstruction_options
+    {
+        filter_config filter = filter_config{filter_window::ram_lak, 1.f, ""};
+
+        bool enable_roi = false;
+        region_of_interest roi = region_of_interest{0u, 0u, 0u, 0u, 0u, 0u};
+
+        std::uint16_t quality = 1;          // use every quality-th projection
+        interpolation interp = interpolation::fast;
+        std::uint32_t pipeline_depth = 3;
+        std::uint32_t batch_size = 8;
+        std::size_t prefetch_depth = 8;
+        std::size_t memory_budget = 0;      // [bytes] of device memory per device, 0 uses 90% of the free memory
+        std::uint32_t subvolumes = 0;       // at least this many subvolumes, 0 leaves the split to the memory budget
+        std::string tuning_dir;             // tuned launch configurations are cached here, empty tunes in every run
+    };
+
+    /*
+     * Receives dim_z slices starting at slice first (relative to the ROI if one is set). May be called from several
+     * threads at once for different slabs; the memory is only valid during the call.
+     */
+    using volume_consumer = std::function<void(const float* slices, std::uint32_t dim_z, std::uint32_t first)>;
+
+    // the dimensions of the volume reconstruct() is going to produce
+    auto volume_dimensions(const detector_geometry& det_geo, const reconstruction_options& opts) -> volume_geometry;
+
+    auto reconstruct(const projection_stack& projections, const detector_geometry& det_geo,
+                     const reconstruction_options& opts, const volume_consumer& consume) -> void;
+
+    // volume has to hold volume_dimensions() voxels, x varies fastest
+    auto reconstruct(const projection_stack& projections, const detector_geometry& det_geo,
+                     const reconstruction_options& opts, float* volume) -> void;
+
+    // SIRT (subsets = 1) or OS-SART on the first device, the projections are unfiltered line integrals
+    struct iterative_options
+    {
+        std::uint32_t iterations = 20;
+        std::uint32_t subsets = 1;
+        float relaxation = 1.f;
+        bool nonnegative = true;            // clamp the volume to positive values after every update
+        std::size_t memory_budget = 0;      // [bytes] of device memory, the whole problem has to fit
+    };
+
+    // volume has to hold volume_dimensions() voxels without a ROI, x varies fastest
+    auto reconstruct_iterative(const projection_stack& projections, const detector_geometry& det_geo,
+                               const iterative_options& opts, float* volume) -> void;
+}
+
+#endif /* PARIS_PARIS_H_ */
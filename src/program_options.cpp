@@ -20,11 +20,14 @@
  * Authors: Jan Stephan <j.stephan@hzdr.de>
  */
 
+#include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 #include <boost/program_options.hpp>
 
@@ -34,121 +37,295 @@
 
 namespace paris
 {
-    auto make_program_options(int argc, char** argv) -> program_options
+    namespace
     {
-        auto po = program_options{};
+        // malformed options throw std::invalid_argument, only interactive runs may print the help and exit
+        auto parse(int argc, const char* const* argv, bool interactive) -> program_options
+        {
+            auto po = program_options{};
 
-        auto geometry_path = std::string{""};
+            auto geometry_path = std::string{""};
+            auto filter_name = std::string{""};
+            auto beam_name = std::string{""};
+            auto interp_name = std::string{""};
 
-        try
-        {
-            // General options
-            boost::program_options::options_description general{"General options"};
-            general.add_options()
-                    ("help", "produce a help message")
-                    ("geometry-format", "Display geometry file format");
-
-            // Geometry options
-            boost::program_options::options_description geo_opts{"Geometry options"};
-            geo_opts.add_options()
-                    ("geometry", boost::program_options::value<std::string>(&geometry_path)->required(), "Path to geometry file")
-                    ("roi", "Region of interest switch (optional)");
-
-            // Region of interest options
-            boost::program_options::options_description roi_opts{"Region of Interest options"};
-            roi_opts.add_options()
-                    ("roi-x1", boost::program_options::value<std::uint32_t>(&po.roi.x1), "leftmost coordinate")
-                    ("roi-x2", boost::program_options::value<std::uint32_t>(&po.roi.x2), "rightmost coordinate")
-                    ("roi-y1", boost::program_options::value<std::uint32_t>(&po.roi.y1), "uppermost coordinate")
-                    ("roi-y2", boost::program_options::value<std::uint32_t>(&po.roi.y2), "lowest coordinate")
-                    ("roi-z1", boost::program_options::value<std::uint32_t>(&po.roi.z1), "uppermost slice")
-                    ("roi-z2", boost::program_options::value<std::uint32_t>(&po.roi.z2), "lowest slice");
-
-            // I/O options
-            boost::program_options::options_description io{"Input/output options"};
-            io.add_options()
-                    ("input", boost::program_options::value<std::string>(&po.input_path), "Path to projections (optional)")
-                    ("output", boost::program_options::value<std::string>(&po.output_path), "Output directory for the reconstructed volume (optional)")
-                    ("name", boost::program_options::value<std::string>(&po.prefix)->default_value("vol"), "Name of the reconstructed volume (optional)");
-
-            // Reconstruction options
-            boost::program_options::options_description recon{"Reconstruction options"};
-            recon.add_options()
-                    ("angles", boost::program_options::value<std::string>(&po.angle_path), "Path to projection angles (optional)")
-                    ("quality", boost::program_options::value<std::uint16_t>(&po.quality)->default_value(1), "Quality setting (optional)");
-
-            // Geometry file
-            boost::program_options::options_description geom{"Geometry file"};
-            geom.add_options()
-                    ("n_row", boost::program_options::value<std::uint32_t>(&po.det_geo.n_row)->required(), "[integer] number of pixels per detector row (= projection width)")
-                    ("n_col", boost::program_options::value<std::uint32_t>(&po.det_geo.n_col)->required(), "[integer] number of pixels per detector column (= projection height)")
-                    ("l_px_row", boost::program_options::value<float>(&po.det_geo.l_px_row)->required(), "[float] horizontal pixel size (= distance between pixel centers) in mm")
-                    ("l_px_col", boost::program_options::value<float>(&po.det_geo.l_px_col)->required(), "[float] vertical pixel size (= distance between pixel centers) in mm")
-                    ("delta_s", boost::program_options::value<float>(&po.det_geo.delta_s)->required(), "[float] horizontal detector offset in pixels")
-                    ("delta_t", boost::program_options::value<float>(&po.det_geo.delta_t)->required(), "[float] vertical detector offset in pixels")
-                    ("d_so", boost::program_options::value<float>(&po.det_geo.d_so)->required(), "[float] distance between object (= center of rotation) and source in mm")
-                    ("d_od", boost::program_options::value<float>(&po.det_geo.d_od)->required(), "[float] distance between object (= center of rotation) and detector in mm")
-                    ("delta_phi", boost::program_options::value<float>(&po.det_geo.delta_phi)->required(), "[float] angle step between two successive projections in °");
-
-            // combine
-            boost::program_options::options_description params;
-            params.add(general).add(geo_opts).add(io).add(recon).add(roi_opts);
-
-            boost::program_options::variables_map param_map, geom_map;
-            boost::program_options::store(boost::program_options::parse_command_line(argc, argv, params), param_map);
-
-            if(param_map.count("help"))
+            try
             {
-                std::cout << params << std::endl;
-                std::exit(EXIT_SUCCESS);
-            }
-            else if(param_map.count("geometry-format"))
-            {
-                std::cout << geom << std::endl;
-                std::exit(EXIT_SUCCESS);
-            }
+                // General options
+                boost::program_options::options_description general{"General options"};
+                general.add_options()
+                        ("help", "produce a help message")
+                        ("geometry-format", "Display geometry file format");
 
-            auto print_missing = [](const char* str)
-            {
-                std::cerr << "the option '--" << str << "' is required but missing" << std::endl;
-                std::exit(EXIT_FAILURE);
-            };
+                // Geometry options
+                boost::program_options::options_description geo_opts{"Geometry options"};
+                geo_opts.add_options()
+                        ("geometry", boost::program_options::value<std::string>(&geometry_path), "Path to geometry file, required unless serving")
+                        ("roi", "Region of interest switch (optional)");
 
-            if(param_map.count("input") || param_map.count("output"))
-            {
-                po.enable_io = true;
-                if(param_map.count("input") == 0) print_missing("input");
-                if(param_map.count("output") == 0) print_missing("output");
-            }
+                // Region of interest options
+                boost::program_options::options_description roi_opts{"Region of Interest options"};
+                roi_opts.add_options()
+                        ("roi-x1", boost::program_options::value<std::uint32_t>(&po.roi.x1), "leftmost coordinate")
+                        ("roi-x2", boost::program_options::value<std::uint32_t>(&po.roi.x2), "rightmost coordinate")
+                        ("roi-y1", boost::program_options::value<std::uint32_t>(&po.roi.y1), "uppermost coordinate")
+                        ("roi-y2", boost::program_options::value<std::uint32_t>(&po.roi.y2), "lowest coordinate")
+                        ("roi-z1", boost::program_options::value<std::uint32_t>(&po.roi.z1), "uppermost slice")
+                        ("roi-z2", boost::program_options::value<std::uint32_t>(&po.roi.z2), "lowest slice");
+
+                // I/O options
+                boost::program_options::options_description io{"Input/output options"};
+                io.add_options()
+                        ("input", boost::program_options::value<std::string>(&po.input_path), "Path to projections (optional)")
+                        ("output", boost::program_options::value<std::string>(&po.output_path), "Output directory for the reconstructed volume (optional)")
+                        ("name", boost::program_options::value<std::string>(&po.prefix)->default_value("vol"), "Name of the reconstructed volume (optional)")
+                        ("prefetch", boost::program_options::value<std::size_t>(&po.prefetch_depth)->default_value(8), "Number of projections loaded ahead of the reconstruction (optional)")
+                        ("stream", boost::program_options::value<std::uint32_t>(&po.stream_count)->default_value(0), "Reconstruct while the scanner writes to the input directory until this many projections arrived (optional)")
+                        ("stream-timeout", boost::program_options::value<std::uint32_t>(&po.stream_timeout)->default_value(600), "Seconds without new projections after which streaming fails (optional)")
+                        ("io-threads", boost::program_options::value<std::uint32_t>(&po.io_threads)->default_value(4), "Number of projection files read and decoded at once, raise it for many small files on network filesystems (optional)")
+                        ("dark", boost::program_options::value<std::string>(&po.dark_path), "File or directory of dark frames, averaged and subtracted from the projections and the flat frames (optional)")
+                        ("flat", boost::program_options::value<std::string>(&po.flat_path), "File or directory of flat frames, the projections are converted to -log((I - dark) / (flat - dark)) while loading (optional)")
+                        ("compression", boost::program_options::value<int>(&po.compression)->default_value(0), "zstd compression level of the reconstructed volume, 0 disables compression (optional)")
+                        ("output-type", boost::program_options::value<std::string>(&po.output_type)->default_value("f32"), "Storage type of the reconstructed volume: f32, f16 or u16 (optional)")
+                        ("map-volume", "Reconstruct straight into a memory mapping of the output file, needs the OpenMP backend and an uncompressed f32 volume (optional)")
+                        ("resume", "Continue a crashed run: subvolumes recorded in the journal next to the volume are skipped, needs an uncompressed f32 volume (optional)")
+                        ("window-min", boost::program_options::value<float>(&po.window_min), "Value mapped to 0 in u16 volumes")
+                        ("window-max", boost::program_options::value<float>(&po.window_max), "Value mapped to 65535 in u16 volumes");
+
+                // Reconstruction options
+                boost::program_options::options_description recon{"Reconstruction options"};
+                recon.add_options()
+                        ("angles", boost::program_options::value<std::string>(&po.angle_path), "Path to projection angles (optional)")
+                        ("matrices", boost::program_options::value<std::string>(&po.trajectory_path), "Path to one 3x4 projection matrix per projection for helical or misaligned trajectories, replaces the circular geometry and --angles in the backprojection (optional)")
+                        ("filter", boost::program_options::value<std::string>(&filter_name)->default_value("ram-lak"), "Reconstruction filter: ram-lak, shepp-logan, cosine, hamming or hann (optional)")
+                        ("filter-cutoff", boost::program_options::value<float>(&po.filter.cutoff)->default_value(1.f), "Filter cutoff relative to the Nyquist frequency, (0, 1] (optional)")
+                        ("fft-wisdom", boost::program_options::value<std::string>(&po.filter.wisdom_dir), "Directory in which FFT plans are cached between runs (optional)")
+                        ("quality", boost::program_options::value<std::uint16_t>(&po.quality)->default_value(1), "Quality setting (optional)")
+                        ("interpolation", boost::program_options::value<std::string>(&interp_name)->default_value("fast"), "Detector interpolation of the backprojection: fast (texture filtering), fast-f16 (the same on half precision textures), precise (bilinear in fp32) or nearest (optional)")
+                        ("preview", boost::program_options::value<std::uint32_t>(&po.preview)->default_value(1), "Bin the detector by 2 or 4 for a quick low-resolution reconstruction, combine with --quality to skip angles (optional)")
+                        ("pipeline-depth", boost::program_options::value<std::uint32_t>(&po.pipeline_depth)->default_value(3), "Number of projections in flight on each device (optional)")
+                        ("tuning-dir", boost::program_options::value<std::string>(&po.tuning_dir), "Directory in which the backprojection's tuned launch configuration is cached between runs, CUDA only (optional)")
+                        ("hybrid", "Reconstruct some subvolumes on the host's cores next to the GPUs (optional)")
+                        ("numa", "Bind the OpenMP threads to the NUMA nodes and give every node its own z-slab and copy of the projections (optional)")
+                        ("batch-size", boost::program_options::value<std::uint32_t>(&po.batch_size)->default_value(8), "Number of projections backprojected in one pass over the volume (optional)")
+                        ("memory-budget", boost::program_options::value<std::size_t>(&po.memory_budget)->default_value(0), "Memory in MiB each device -- or the host with the OpenMP backend -- may use, 0 uses 90% of the free memory (optional)")
+                        ("iterations", boost::program_options::value<std::uint32_t>(&po.iterations)->default_value(0), "Reconstruct iteratively with SIRT or OS-SART instead of FDK, the volume and all projections have to fit onto the first device (optional)")
+                        ("subsets", boost::program_options::value<std::uint32_t>(&po.subsets)->default_value(1), "Number of OS-SART subsets, 1 is SIRT (optional)")
+                        ("relaxation", boost::program_options::value<float>(&po.relaxation)->default_value(1.f), "Relaxation factor of the iterative update, (0, 2) (optional)")
+                        ("serve", boost::program_options::value<std::string>(&po.serve_dir), "Keep the devices, plans and memory pools warm and reconstruct the jobs dropped into this directory as <name>.job files, each holding the options of a run (optional)")
+                        ("plan", "Print how the volume is split into subvolumes and exit (optional)")
+                        ("report", boost::program_options::value<std::string>(&po.report_path), "Write per-stage timings, throughput and utilization to this file, CSV if it ends with .csv and JSON otherwise (optional)");
+
+                // Geometry file
+                boost::program_options::options_description geom{"Geometry file"};
+                geom.add_options()
+                        ("n_row", boost::program_options::value<std::uint32_t>(&po.det_geo.n_row)->required(), "[integer] number of pixels per detector row (= projection width)")
+                        ("n_col", boost::program_options::value<std::uint32_t>(&po.det_geo.n_col)->required(), "[integer] number of pixels per detector column (= projection height)")
+                        ("l_px_row", boost::program_options::value<float>(&po.det_geo.l_px_row)->required(), "[float] horizontal pixel size (= distance between pixel centers) in mm")
+                        ("l_px_col", boost::program_options::value<float>(&po.det_geo.l_px_col)->required(), "[float] vertical pixel size (= distance between pixel centers) in mm")
+                        ("delta_s", boost::program_options::value<float>(&po.det_geo.delta_s)->required(), "[float] horizontal detector offset in pixels")
+                        ("delta_t", boost::program_options::value<float>(&po.det_geo.delta_t)->required(), "[float] vertical detector offset in pixels")
+                        ("d_so", boost::program_options::value<float>(&po.det_geo.d_so)->required(), "[float] distance between object (= center of rotation) and source in mm")
+                        ("d_od", boost::program_options::value<float>(&po.det_geo.d_od)->required(), "[float] distance between object (= center of rotation) and detector in mm")
+                        ("delta_phi", boost::program_options::value<float>(&po.det_geo.delta_phi)->required(), "[float] angle step between two successive projections in °")
+                        ("beam", boost::program_options::value<std::string>(&beam_name)->default_value("cone"), "[string] beam geometry: cone, fan (one detector row per slice) or parallel (optional)");
+
+                // combine
+                boost::program_options::options_description params;
+                params.add(general).add(geo_opts).add(io).add(recon).add(roi_opts);
+
+                boost::program_options::variables_map param_map, geom_map;
+                boost::program_options::store(boost::program_options::parse_command_line(argc, argv, params), param_map);
+
+                if((param_map.count("help") || param_map.count("geometry-format")) && !interactive)
+                    throw std::invalid_argument{"the options '--help' and '--geometry-format' are only available on the "
+                                                "command line"};
+
+                if(param_map.count("help"))
+                {
+                    std::cout << params << std::endl;
+                    std::exit(EXIT_SUCCESS);
+                }
+                else if(param_map.count("geometry-format"))
+                {
+                    std::cout << geom << std::endl;
+                    std::exit(EXIT_SUCCESS);
+                }
+
+                auto missing = [](const char* str)
+                {
+                    throw std::invalid_argument{std::string{"the option '--"} + str + "' is required but missing"};
+                };
+
+                // a server has no geometry of its own, every job brings one
+                if(param_map.count("serve") && !interactive)
+                    throw std::invalid_argument{"jobs can't start another server"};
+                if(param_map.count("geometry") == 0 && param_map.count("serve") == 0)
+                    missing("geometry");
+
+                if(param_map.count("input") || param_map.count("output"))
+                {
+                    po.enable_io = true;
+                    if(param_map.count("input") == 0) missing("input");
+                    if(param_map.count("output") == 0) missing("output");
+                }
+
+                if(param_map.count("roi"))
+                {
+                    po.enable_roi = true;
+                    if(param_map.count("roi-x1") == 0) missing("roi-x1");
+                    if(param_map.count("roi-x2") == 0) missing("roi-x2");
+                    if(param_map.count("roi-y1") == 0) missing("roi-y1");
+                    if(param_map.count("roi-y2") == 0) missing("roi-y2");
+                    if(param_map.count("roi-z1") == 0) missing("roi-z1");
+                    if(param_map.count("roi-z2") == 0) missing("roi-z2");
+                }
+
+                if(param_map.count("angles"))
+                    po.enable_angles = true;
+
+                if(param_map.count("matrices"))
+                    po.enable_trajectory = true;
+
+                if(param_map.count("hybrid"))
+                    po.enable_hybrid = true;
+
+                if(param_map.count("numa"))
+                    po.enable_numa = true;
+
+                if(param_map.count("map-volume"))
+                    po.map_volume = true;
+
+                if(param_map.count("plan"))
+                    po.plan_only = true;
 
-            if(param_map.count("roi"))
+                if(param_map.count("resume"))
+                    po.resume = true;
+
+                boost::program_options::notify(param_map);
+
+                if(po.output_type != "f32" && po.output_type != "f16" && po.output_type != "u16")
+                    throw std::invalid_argument{std::string{"unknown output type '"} + po.output_type + "'"};
+
+                // only the fixed layout of version 1 files can be continued, chunked files lose their index in a crash
+                if(po.resume && (po.compression != 0 || po.output_type != "f32"))
+                    throw std::invalid_argument{"the option '--resume' needs an uncompressed f32 volume"};
+
+                if(po.output_type == "u16")
+                {
+                    if(param_map.count("window-min") == 0) missing("window-min");
+                    if(param_map.count("window-max") == 0) missing("window-max");
+                    if(!(po.window_max > po.window_min))
+                    {
+                        throw std::invalid_argument{"the option '--window-max' must be greater than '--window-min'"};
+                    }
+                }
+
+                if(filter_name == "ram-lak")
+                    po.filter.window = filter_window::ram_lak;
+                else if(filter_name == "shepp-logan")
+                    po.filter.window = filter_window::shepp_logan;
+                else if(filter_name == "cosine")
+                    po.filter.window = filter_window::cosine;
+                else if(filter_name == "hamming")
+                    po.filter.window = filter_window::hamming;
+                else if(filter_name == "hann")
+                    po.filter.window = filter_window::hann;
+                else
+                    throw std::invalid_argument{std::string{"unknown filter '"} + filter_name + "'"};
+
+                if(interp_name == "fast")
+                    po.interp = interpolation::fast;
+                else if(interp_name == "fast-f16")
+                    po.interp = interpolation::fast_f16;
+                else if(interp_name == "precise")
+                    po.interp = interpolation::precise;
+                else if(interp_name == "nearest")
+                    po.interp = interpolation::nearest;
+                else
+                    throw std::invalid_argument{std::string{"unknown interpolation '"} + interp_name + "'"};
+
+                if(!(po.filter.cutoff > 0.f && po.filter.cutoff <= 1.f))
+                    throw std::invalid_argument{"the option '--filter-cutoff' must be in (0, 1]"};
+
+                if(!po.dark_path.empty() && po.flat_path.empty())
+                    throw std::invalid_argument{"the option '--dark' needs '--flat'"};
+
+                if(po.preview != 1u && po.preview != 2u && po.preview != 4u)
+                    throw std::invalid_argument{"the option '--preview' must be 1, 2 or 4"};
+
+                if(po.iterations > 0u && !(po.relaxation > 0.f && po.relaxation < 2.f))
+                    throw std::invalid_argument{"the option '--relaxation' must be in (0, 2)"};
+
+                if(po.iterations > 0u && po.enable_trajectory)
+                {
+                    std::cerr << "iterative reconstructions don't support projection matrices, ignoring them" << std::endl;
+                    po.enable_trajectory = false;
+                }
+
+                if(po.iterations > 0u && po.enable_roi)
+                {
+                    std::cerr << "iterative reconstructions don't support a region of interest, ignoring it" << std::endl;
+                    po.enable_roi = false;
+                }
+
+                if(!geometry_path.empty())
+                {
+                    auto&& file = std::ifstream{geometry_path.c_str()};
+                    if(file)
+                        boost::program_options::store(boost::program_options::parse_config_file(file, geom), geom_map);
+                    boost::program_options::notify(geom_map);
+                }
+
+                if(beam_name == "cone")
+                    po.det_geo.beam = beam_geometry::cone;
+                else if(beam_name == "fan")
+                    po.det_geo.beam = beam_geometry::fan;
+                else if(beam_name == "parallel")
+                    po.det_geo.beam = beam_geometry::parallel;
+                else
+                    throw std::invalid_argument{std::string{"unknown beam geometry '"} + beam_name + "'"};
+
+                if(po.det_geo.beam != beam_geometry::cone && po.iterations > 0u)
+                    throw std::invalid_argument{"iterative reconstructions only support cone beams"};
+
+                if(po.det_geo.beam != beam_geometry::cone && po.enable_trajectory)
+                {
+                    std::cerr << "projection matrices describe cone beams, ignoring them" << std::endl;
+                    po.enable_trajectory = false;
+                }
+            }
+            catch(const boost::program_options::error& err)
             {
-                po.enable_roi = true;
-                if(param_map.count("roi-x1") == 0) print_missing("roi-x1");
-                if(param_map.count("roi-x2") == 0) print_missing("roi-x2");
-                if(param_map.count("roi-y1") == 0) print_missing("roi-y1");
-                if(param_map.count("roi-y2") == 0) print_missing("roi-y2");
-                if(param_map.count("roi-z1") == 0) print_missing("roi-z1");
-                if(param_map.count("roi-z2") == 0) print_missing("roi-z2");
+                throw std::invalid_argument{err.what()};
             }
 
-            if(param_map.count("angles"))
-                po.enable_angles = true;
-
-            boost::program_options::notify(param_map);
+            return po;
+        }
+    }
 
-            auto&& file = std::ifstream{geometry_path.c_str()};
-            if(file)
-                boost::program_options::store(boost::program_options::parse_config_file(file, geom), geom_map);
-            boost::program_options::notify(geom_map);
+    auto make_program_options(int argc, char** argv) -> program_options
+    {
+        try
+        {
+            return parse(argc, argv, true);
         }
-        catch(const boost::program_options::error& err)
+        catch(const std::invalid_argument& err)
         {
             std::cerr << err.what() << std::endl;
             std::exit(EXIT_FAILURE);
         }
+    }
+
+    auto make_job_options(const std::string& args) -> program_options
+    {
+        // the words are split like a shell would, quotes keep paths with blanks together
+        auto words = boost::program_options::split_unix(args, " \t\r\n");
+        auto argv = std::vector<const char*>{"paris"};
+        for(auto&& w : words)
+            argv.push_back(w.c_str());
 
-        return po;
+        return parse(static_cast<int>(argv.size()), argv.data(), false);
     }
 }
 
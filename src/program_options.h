@@ -23,10 +23,13 @@
 #ifndef PARIS_PROGRAM_OPTIONS_H_
 #define PARIS_PROGRAM_OPTIONS_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 
+#include "filter_config.h"
 #include "geometry.h"
+#include "interpolation.h"
 #include "region_of_interest.h"
 
 namespace paris
@@ -39,6 +42,18 @@ namespace paris
         std::string input_path;
         std::string output_path;
         std::string prefix;
+        std::size_t prefetch_depth;
+        std::uint32_t stream_count;     // projections expected while watching the input, 0 disables streaming
+        std::uint32_t stream_timeout;   // [s]
+        std::uint32_t io_threads;       // projection files decoded at once
+        std::string dark_path;          // dark and flat reference frames, an empty flat_path reads the counts as is
+        std::string flat_path;
+        int compression;
+        std::string output_type;
+        bool map_volume;    // accumulate into a mapping of the output file, host backends only
+        bool resume;        // only reconstruct the subvolumes which the journal of an earlier run doesn't cover
+        float window_min;
+        float window_max;
 
         bool enable_roi;
         region_of_interest roi;
@@ -46,10 +61,37 @@ namespace paris
         bool enable_angles;
         std::string angle_path;
 
+        bool enable_trajectory;         // backproject along per-projection matrices instead of the circular geometry
+        std::string trajectory_path;
+
+        filter_config filter;
+
         std::uint16_t quality;
+        interpolation interp;
+        std::uint32_t preview;  // detector binning for quick previews, 1 reconstructs at full resolution
+        std::uint32_t pipeline_depth;
+        std::uint32_t batch_size;
+        std::string tuning_dir;     // tuned launch configurations are cached here, empty tunes in every run
+        bool enable_hybrid;
+        bool enable_numa;   // bind the OpenMP threads to the NUMA nodes
+
+        std::size_t memory_budget;  // [MiB] per device (host for OpenMP), 0 uses 90% of the free memory
+        bool plan_only;             // print the memory plan and exit
+
+        std::uint32_t iterations;   // SIRT / OS-SART iterations, 0 reconstructs with FDK
+        std::uint32_t subsets;      // OS-SART subsets, 1 is SIRT
+        float relaxation;
+
+        std::string report_path;    // per-stage timings as JSON (or CSV), empty disables the report
+
+        std::string serve_dir;      // reconstruct the jobs dropped into this directory, empty runs once
     };
 
+    // prints the problem and exits if the command line is malformed
     auto make_program_options(int argc, char** argv) -> program_options;
+
+    // the options of a job, given as a command line without the program name. Throws std::invalid_argument
+    auto make_job_options(const std::string& args) -> program_options;
 }
 
 #endif /* PARIS_PROGRAM_OPTIONS_H_ */
@@ -40,6 +40,8 @@ namespace paris
         BufferType buf = BufferType{};
         std::uint32_t dim_x = 0;
         std::uint32_t dim_y = 0;
+        std::uint32_t first_row = 0; // detector row stored in the buffer's first row
+        std::uint32_t first_col = 0; // detector column stored in the buffer's first column
         std::uint32_t idx = 0;
         float phi = 0.f;
         Metadata meta = Metadata{};
@@ -0,0 +1,458 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <boost/log/trivial.hpp>
+
+#include "backend.h"
+#include "exception.h"
+#include "geometry.h"
+#include "loader.h"
+#include "metrics.h"
+#include "projection.h"
+#include "projection_cache.h"
+#include "source.h"
+
+namespace paris
+{
+    namespace
+    {
+        auto physical_memory() noexcept -> std::size_t
+        {
+            auto pages = ::sysconf(_SC_PHYS_PAGES);
+            auto page = ::sysconf(_SC_PAGESIZE);
+            return (pages > 0 && page > 0) ? static_cast<std::size_t>(pages) * static_cast<std::size_t>(page) : 0u;
+        }
+
+        // unlinked right away, the file disappears with its descriptor
+        auto make_spill_file() noexcept -> int
+        {
+            auto dir = std::getenv("TMPDIR");
+            auto path = std::string{(dir != nullptr && *dir != '\0') ? dir : "/tmp"} + "/paris-spill-XXXXXX";
+            auto fd = ::mkstemp(&path[0]);
+            if(fd != -1)
+                ::unlink(path.c_str());
+            return fd;
+        }
+
+        auto write_all(int fd, const char* buf, std::size_t size, off_t pos) -> void
+        {
+            while(size > 0u)
+            {
+                auto written = ::pwrite(fd, buf, size, pos);
+                if(written == -1)
+                {
+                    auto err = errno;
+                    if(err == EINTR)
+                        continue;
+
+                    BOOST_LOG_TRIVIAL(fatal) << "Could not spill a projection: " << std::strerror(err);
+                    throw stage_runtime_error{"projection_cache::spill() failed"};
+                }
+
+                buf += written;
+                size -= static_cast<std::size_t>(written);
+                pos += written;
+            }
+        }
+
+        auto read_all(int fd, char* buf, std::size_t size, off_t pos) -> void
+        {
+            while(size > 0u)
+            {
+                auto bytes = ::pread(fd, buf, size, pos);
+                auto err = errno;
+                if(bytes == -1 && err == EINTR)
+                    continue;
+
+                if(bytes <= 0)
+                {
+                    BOOST_LOG_TRIVIAL(fatal) << "Could not read back a spilled projection: "
+                                             << ((bytes == 0) ? "unexpected end of file" : std::strerror(err));
+                    throw stage_runtime_error{"projection_cache::read_back() failed"};
+                }
+
+                buf += bytes;
+                size -= static_cast<std::size_t>(bytes);
+                pos += bytes;
+            }
+        }
+    }
+
+    projection_cache::projection_cache(source& src, std::uint32_t consumers, std::uint32_t dim_x, std::uint32_t dim_y,
+                                       const column_window& columns)
+    : src_(src), src_drained_{false}, consumers_{consumers}, dim_x_{dim_x}, dim_y_{dim_y}, columns_(columns),
+      pending_{0u}, failed_{false}, peer_capacity_{0u}, host_limit_{physical_memory() / 2u}, host_bytes_{0u},
+      spill_fd_{-1}, slot_size_{0u}, spill_slots_{0u}
+    {
+        if(host_limit_ == 0u)
+            host_limit_ = std::numeric_limits<std::size_t>::max();
+
+        if(consumers_ > 1u)
+            BOOST_LOG_TRIVIAL(info) << "Sharing filtered projections between " << consumers_ << " subvolumes";
+        if(consumers_ > 1u && columns_.cols < dim_x_)
+            BOOST_LOG_TRIVIAL(info) << "Keeping detector columns " << columns_.first << " to "
+                                    << columns_.first + columns_.cols - 1u << " of the filtered projections";
+    }
+
+    projection_cache::~projection_cache()
+    {
+        if(spill_fd_ != -1)
+            ::close(spill_fd_);
+    }
+
+    auto projection_cache::make_reader(std::uint32_t task_id, const row_window& window,
+                                       std::uint32_t device) const noexcept -> reader
+    {
+        return reader{task_id, 0u, 0u, window, device};
+    }
+
+    auto projection_cache::enable_peer_copies(std::size_t devices, std::uint32_t capacity) -> void
+    {
+        // nobody reads the projections a second time
+        if(consumers_ < 2u)
+            return;
+
+        peer_capacity_ = capacity;
+        peer_copies_.assign(devices, 0u);
+        peer_free_.resize(devices);
+    }
+
+    auto projection_cache::limit_host_memory(std::size_t bytes) noexcept -> void
+    {
+        auto&& lock = std::lock_guard<std::mutex>{mutex_};
+        host_limit_ = bytes;
+    }
+
+    auto projection_cache::release(entry& e) -> void
+    {
+        // the device memory of peer copies is kept, freeing it would synchronise the device
+        if(e.on_peer)
+        {
+            peer_free_[e.device].push_back(std::move(e.peer));
+            --peer_copies_[e.device];
+        }
+        else if(e.spilled)
+            spill_free_.push_back(e.slot);
+        else
+        {
+            host_bytes_ -= static_cast<std::size_t>(e.proj.dim_x) * e.proj.dim_y * sizeof(float);
+            e.proj = backend::projection_host_type{};
+        }
+    }
+
+    auto projection_cache::spill(backend::projection_host_type& h_p, std::size_t slot) -> void
+    {
+        write_all(spill_fd_, reinterpret_cast<const char*>(h_p.buf.get()), slot_size_,
+                  static_cast<off_t>(slot * slot_size_));
+
+        // only the metadata stays, the buffer goes back to the pool
+        h_p.buf = decltype(h_p.buf){};
+    }
+
+    auto projection_cache::read_back(const entry& e) const -> backend::projection_host_type
+    {
+        auto h_p = backend::make_projection_host(e.proj.dim_x, e.proj.dim_y);
+        read_all(spill_fd_, reinterpret_cast<char*>(h_p.buf.get()), slot_size_,
+                 static_cast<off_t>(e.slot * slot_size_));
+
+        h_p.first_row = e.proj.first_row;
+        h_p.first_col = e.proj.first_col;
+        h_p.idx = e.proj.idx;
+        h_p.phi = e.proj.phi;
+        h_p.meta = e.proj.meta;
+        return h_p;
+    }
+
+    auto projection_cache::fetch(reader& r, backend::projection_device_type& p, bool& filtered) -> bool
+    {
+        auto&& lock = std::unique_lock<std::mutex>{mutex_};
+        while(true)
+        {
+            if(failed_)
+            {
+                BOOST_LOG_TRIVIAL(fatal) << "Giving up on the shared projections, another task failed";
+                throw stage_runtime_error{"projection_cache::fetch() failed"};
+            }
+
+            // look for a filtered projection this reader hasn't seen yet
+            while(r.pos < entries_.size())
+            {
+                auto e = entries_[r.pos].get();
+                ++r.pos;
+
+                if(e->origin == r.id)
+                    continue;
+
+                // the entry stays alive until this reader releases it below
+                lock.unlock();
+                if(e->on_peer)
+                    p = load_peer(e->peer, r.window, dim_x_, dim_y_);
+                else if(e->spilled)
+                    p = load(read_back(*e), r.window, dim_x_, dim_y_);
+                else
+                    p = load(e->proj, r.window, dim_x_, dim_y_);
+                filtered = true;
+                lock.lock();
+
+                --e->remaining;
+                if(e->remaining == 0u)
+                    release(*e);
+
+                return true;
+            }
+
+            // nothing cached -> load a new projection from the source
+            if(!src_drained_)
+            {
+                ++pending_;
+                lock.unlock();
+
+                // a projection which couldn't be loaded will never be published
+                struct pending_guard
+                {
+                    projection_cache& c;
+                    bool armed;
+                    ~pending_guard()
+                    {
+                        if(!armed)
+                            return;
+
+                        {
+                            auto&& lock = std::lock_guard<std::mutex>{c.mutex_};
+                            --c.pending_;
+                            c.failed_ = true;
+                        }
+                        c.cv_.notify_all();
+                    }
+                } guard{*this, true};
+
+                auto&& src_lock = std::unique_lock<std::mutex>{src_mutex_};
+                if(src_.drained())
+                {
+                    guard.armed = false;
+                    src_lock.unlock();
+                    lock.lock();
+                    --pending_;
+                    src_drained_ = true;
+                    cv_.notify_all();
+                    continue;
+                }
+
+                auto h_p = src_.load_next();
+                auto drained = src_.drained();
+                src_lock.unlock();
+
+                p = load(h_p);
+                filtered = false;
+                ++r.unpublished;
+                guard.armed = false;
+
+                if(drained)
+                {
+                    lock.lock();
+                    src_drained_ = true;
+                }
+                return true;
+            }
+
+            // other readers are still filtering projections which this reader needs
+            if(pending_ > 0u)
+            {
+                if(r.unpublished > 0u)
+                    return false;
+
+                cv_.wait(lock);
+                continue;
+            }
+
+            return false;
+        }
+    }
+
+    auto projection_cache::publish(reader& r, const backend::projection_device_type& p) -> void
+    {
+        // the projection is only needed again if there is more than one subvolume
+        auto e = std::unique_ptr<entry>{};
+        if(consumers_ > 1u)
+        {
+            // the other subvolumes only need the columns the ROI projects to
+            auto first = std::min(columns_.first, p.dim_x - 1u);
+            auto cols = std::min(columns_.cols, p.dim_x - first);
+
+            // a free slot on this device keeps the projection away from the host
+            auto peer = backend::projection_peer_type{};
+            auto on_peer = false;
+            if(peer_capacity_ > 0u)
+            {
+                auto&& lock = std::lock_guard<std::mutex>{mutex_};
+                if(peer_copies_[r.device] < peer_capacity_)
+                {
+                    ++peer_copies_[r.device];
+                    on_peer = true;
+
+                    auto&& free = peer_free_[r.device];
+                    if(!free.empty())
+                    {
+                        peer = std::move(free.back());
+                        free.pop_back();
+                    }
+                }
+            }
+
+            if(on_peer)
+            {
+                auto&& t = metrics::timer{metrics::stage::peer};
+                if(peer.dim_x != cols || peer.dim_y != p.dim_y)
+                    peer = backend::make_projection_peer(cols, p.dim_y);
+                backend::copy_d2p(p, peer, first);
+                e = std::unique_ptr<entry>{new entry{backend::projection_host_type{}, std::move(peer), true, r.device,
+                                                     r.id, consumers_ - 1u, false, 0u}};
+            }
+            else
+            {
+                // the host keeps what fits into its limit, the rest goes to the spill file
+                auto bytes = static_cast<std::size_t>(cols) * p.dim_y * sizeof(float);
+                auto spilled = false;
+                auto slot = std::size_t{0u};
+                {
+                    auto&& lock = std::lock_guard<std::mutex>{mutex_};
+                    if(host_bytes_ + bytes > host_limit_ && spill_fd_ == -1)
+                    {
+                        spill_fd_ = make_spill_file();
+                        auto err = errno;
+                        slot_size_ = bytes;
+                        if(spill_fd_ == -1)
+                        {
+                            BOOST_LOG_TRIVIAL(warning) << "Could not create a spill file, keeping all filtered "
+                                                       << "projections in host memory: " << std::strerror(err);
+                            host_limit_ = std::numeric_limits<std::size_t>::max();
+                        }
+                        else
+                            BOOST_LOG_TRIVIAL(info) << "The filtered projections exceed " << host_limit_
+                                                    << " bytes of host memory, spilling the rest to disk";
+                    }
+
+                    if(host_bytes_ + bytes > host_limit_ && bytes == slot_size_)
+                    {
+                        spilled = true;
+                        if(spill_free_.empty())
+                            slot = spill_slots_++;
+                        else
+                        {
+                            slot = spill_free_.back();
+                            spill_free_.pop_back();
+                        }
+                    }
+                    else
+                        host_bytes_ += bytes;
+                }
+
+                auto&& t = metrics::timer{metrics::stage::download};
+                auto h_p = backend::make_projection_host(cols, p.dim_y);
+                backend::copy_d2h(p, h_p, first);
+                if(spilled)
+                    spill(h_p, slot);
+                e = std::unique_ptr<entry>{new entry{std::move(h_p), backend::projection_peer_type{}, false, r.device,
+                                                     r.id, consumers_ - 1u, spilled, slot}};
+            }
+        }
+
+        auto&& lock = std::lock_guard<std::mutex>{mutex_};
+        if(e != nullptr)
+            entries_.push_back(std::move(e));
+        --pending_;
+        --r.unpublished;
+        cv_.notify_all();
+    }
+
+    auto projection_cache::abort(reader& r) -> void
+    {
+        {
+            auto&& lock = std::lock_guard<std::mutex>{mutex_};
+            pending_ -= r.unpublished;
+            r.unpublished = 0u;
+            failed_ = true;
+        }
+        cv_.notify_all();
+    }
+
+    auto projection_cache::fetch_filtered(reader& r,
+                                          const std::function<void(const backend::projection_host_type&)>& consume)
+        -> bool
+    {
+        auto&& lock = std::unique_lock<std::mutex>{mutex_};
+        while(true)
+        {
+            if(failed_)
+            {
+                BOOST_LOG_TRIVIAL(fatal) << "Giving up on the shared projections, another task failed";
+                throw stage_runtime_error{"projection_cache::fetch_filtered() failed"};
+            }
+
+            while(r.pos < entries_.size())
+            {
+                auto e = entries_[r.pos].get();
+                ++r.pos;
+
+                if(e->origin == r.id)
+                    continue;
+
+                // the entry stays alive until this reader releases it below
+                lock.unlock();
+                if(e->spilled)
+                    consume(read_back(*e));
+                else
+                    consume(e->proj);
+                lock.lock();
+
+                --e->remaining;
+                if(e->remaining == 0u)
+                    release(*e);
+
+                return true;
+            }
+
+            if(src_drained_ && pending_ == 0u)
+                return false;
+
+            cv_.wait(lock);
+        }
+    }
+}
@@ -0,0 +1,154 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#ifndef PARIS_PROJECTION_CACHE_H_
+#define PARIS_PROJECTION_CACHE_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "backend.h"
+#include "geometry.h"
+#include "projection.h"
+#include "source.h"
+
+namespace paris
+{
+    /*
+     * Shared projection stage. Every projection is loaded, weighted and filtered exactly once by whichever task
+     * gets to it first. The filtered result is then kept on the host until all other tasks have uploaded it. Only
+     * the detector columns inside the given window are kept, the projections of the source have dim_x * dim_y
+     * pixels. Devices which can access each other's memory may keep them in the publishing device's memory instead.
+     * Tasks which are still queued need every projection, so the cache can't wait for them. Projections beyond the
+     * host limit are spilled to an unlinked temporary file instead and read back by the tasks which need them.
+     */
+    class projection_cache
+    {
+        public:
+            struct reader
+            {
+                std::uint32_t id;   // task id
+                std::size_t pos;    // number of entries already handled by this task
+                std::uint32_t unpublished; // projections fetched for filtering but not published yet
+                row_window window;  // detector rows needed by this task
+                std::uint32_t device; // device the task runs on
+            };
+
+            projection_cache(source& src, std::uint32_t consumers, std::uint32_t dim_x, std::uint32_t dim_y,
+                             const column_window& columns);
+            ~projection_cache();
+
+            projection_cache(const projection_cache&) = delete;
+            auto operator=(const projection_cache&) -> projection_cache& = delete;
+
+            auto make_reader(std::uint32_t task_id, const row_window& window, std::uint32_t device = 0u) const noexcept
+                -> reader;
+
+            /*
+             * Keeps up to capacity filtered projections per device in the memory of the device which published them,
+             * the readers on the other devices copy them peer-to-peer. Projections beyond that go through the host
+             * as before. Requires peer access between all devices and no reader calling fetch_filtered().
+             */
+            auto enable_peer_copies(std::size_t devices, std::uint32_t capacity) -> void;
+
+            // keeps up to bytes of filtered projections in host memory, the default is half of the physical memory
+            auto limit_host_memory(std::size_t bytes) noexcept -> void;
+
+            /*
+             * Fetches the next projection the reader hasn't seen yet and uploads it to the current device. Filtered
+             * projections are cropped to the reader's window, fresh ones keep the rows loaded by the source. If
+             * filtered is false the projection was freshly loaded from the source and the caller has to weight,
+             * filter and publish it. Returns false once the reader has seen every projection. A reader which still
+             * holds unpublished projections is never blocked -- other readers might be waiting for them -- so false
+             * is also returned if it would have to wait. It has to publish them before fetching again.
+             */
+            auto fetch(reader& r, backend::projection_device_type& p, bool& filtered) -> bool;
+            auto publish(reader& r, const backend::projection_device_type& p) -> void;
+
+            /*
+             * Withdraws the projections the reader fetched for filtering but won't publish any more because its task
+             * failed. Nobody can wait for them now, so the cache fails as a whole: the other readers are woken up and
+             * fetch() and fetch_filtered() throw from then on.
+             */
+            auto abort(reader& r) -> void;
+
+            /*
+             * Hands the next filtered projection the reader hasn't seen yet to consume without uploading it. Such a
+             * reader never loads projections from the source but waits until the other readers have published
+             * them. Returns false once the reader has seen every projection.
+             */
+            auto fetch_filtered(reader& r, const std::function<void(const backend::projection_host_type&)>& consume)
+                -> bool;
+
+        private:
+            struct entry
+            {
+                backend::projection_host_type proj;
+                backend::projection_peer_type peer;
+                bool on_peer;           // peer holds the projection, proj is empty
+                std::uint32_t device;   // the device peer resides on
+                std::uint32_t origin;
+                std::uint32_t remaining;
+                bool spilled;           // the spill file holds the data, proj only keeps the metadata
+                std::size_t slot;       // position in the spill file in units of slot_size_
+            };
+
+            auto release(entry& e) -> void;
+            auto spill(backend::projection_host_type& h_p, std::size_t slot) -> void;
+            auto read_back(const entry& e) const -> backend::projection_host_type;
+
+            source& src_;
+            std::mutex src_mutex_;
+            bool src_drained_;
+
+            std::uint32_t consumers_;
+            std::uint32_t dim_x_;
+            std::uint32_t dim_y_;
+            column_window columns_;
+            std::vector<std::unique_ptr<entry>> entries_;
+            std::uint32_t pending_;
+            bool failed_;
+
+            // peer copies in use and released ones for reuse, for each device
+            std::uint32_t peer_capacity_;
+            std::vector<std::uint32_t> peer_copies_;
+            std::vector<std::vector<backend::projection_peer_type>> peer_free_;
+
+            // host memory taken by the cached projections and the spill file for those beyond its limit
+            std::size_t host_limit_;
+            std::size_t host_bytes_;
+            int spill_fd_;
+            std::size_t slot_size_;
+            std::size_t spill_slots_;
+            std::vector<std::size_t> spill_free_;
+
+            std::mutex mutex_;
+            std::condition_variable cv_;
+    };
+}
+
+#endif /* PARIS_PROJECTION_CACHE_H_ */
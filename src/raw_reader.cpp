@@ -0,0 +1,227 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 15 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <locale>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/log/trivial.hpp>
+
+#include "geometry.h"
+#include "metrics.h"
+#include "raw_reader.h"
+#include "reader.h"
+
+namespace paris
+{
+    namespace raw
+    {
+        namespace
+        {
+            using convert_type = void (*)(const std::uint8_t*, float*, std::size_t);
+            using stat_type = struct ::stat;
+
+            struct raw_header
+            {
+                std::uint32_t width = 0u;
+                std::uint32_t height = 0u;
+                std::string type = "u16";
+                std::uint64_t offset = 0u;
+                std::uint64_t frame_header = 0u;
+                std::uint64_t frames = 0u;
+            };
+
+            auto pixel_type(const std::string& type, std::size_t& size) noexcept -> convert_type
+            {
+                if(type == "u8")    { size = sizeof(std::uint8_t);  return &reader::convert<std::uint8_t>; }
+                if(type == "u16")   { size = sizeof(std::uint16_t); return &reader::convert<std::uint16_t>; }
+                if(type == "u32")   { size = sizeof(std::uint32_t); return &reader::convert<std::uint32_t>; }
+                if(type == "i16")   { size = sizeof(std::int16_t);  return &reader::convert<std::int16_t>; }
+                if(type == "i32")   { size = sizeof(std::int32_t);  return &reader::convert<std::int32_t>; }
+                if(type == "f32")   { size = sizeof(float);         return &reader::convert<float>; }
+                if(type == "f64")   { size = sizeof(double);        return &reader::convert<double>; }
+                return nullptr;
+            }
+
+            auto read_header(const std::string& path, raw_header& header) -> bool
+            {
+                auto&& file = std::ifstream{(path + "." + header_extension).c_str()};
+                if(!file.is_open())
+                {
+                    auto slash = path.find_last_of('/');
+                    auto dir = (slash == std::string::npos) ? std::string{} : path.substr(0u, slash + 1u);
+                    file.open((dir + "raw." + header_extension).c_str());
+                    if(!file.is_open())
+                        return false;
+                }
+
+                auto line = std::string{};
+                while(std::getline(file, line))
+                {
+                    if(line.empty() || line.front() == '#')
+                        continue;
+
+                    std::replace(std::begin(line), std::end(line), '=', ' ');
+                    auto&& stream = std::istringstream{line};
+                    stream.imbue(std::locale::classic());
+
+                    auto key = std::string{};
+                    stream >> key;
+                    if(key == "width")              stream >> header.width;
+                    else if(key == "height")        stream >> header.height;
+                    else if(key == "type")          stream >> header.type;
+                    else if(key == "offset")        stream >> header.offset;
+                    else if(key == "frame_header")  stream >> header.frame_header;
+                    else if(key == "frames")        stream >> header.frames;
+
+                    if(stream.fail())
+                    {
+                        BOOST_LOG_TRIVIAL(warning) << "raw::load() could not parse \"" << line << "\" in the header of "
+                                                   << path;
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            // reads exactly size bytes at offset
+            auto read_at(int fd, void* buf, std::size_t size, std::uint64_t offset) -> bool
+            {
+                auto dest = static_cast<char*>(buf);
+                while(size > 0u)
+                {
+                    auto n = ::pread(fd, dest, size, static_cast<off_t>(offset));
+                    if(n < 0 && errno == EINTR)
+                        continue;
+                    if(n <= 0)
+                        return false;
+
+                    dest += n;
+                    size -= static_cast<std::size_t>(n);
+                    offset += static_cast<std::uint64_t>(n);
+                }
+                return true;
+            }
+
+            struct fd_closer
+            {
+                int fd;
+                ~fd_closer() { ::close(fd); }
+            };
+        }
+
+        auto load(const std::string& path, const reader::consumer_type& f, const row_window& window,
+                  std::uint32_t binning, const flat_field* correction) -> std::uint32_t
+        {
+            auto header = raw_header{};
+            if(!read_header(path, header))
+            {
+                BOOST_LOG_TRIVIAL(warning) << "raw::load() found no usable header for " << path;
+                return 0u;
+            }
+
+            auto px_size = std::size_t{0u};
+            auto convert = pixel_type(header.type, px_size);
+            if(header.width == 0u || header.height == 0u || convert == nullptr)
+            {
+                BOOST_LOG_TRIVIAL(warning) << "raw::load() found an incomplete or unsupported header for " << path;
+                return 0u;
+            }
+
+            auto fd = ::open(path.c_str(), O_RDONLY);
+            if(fd == -1)
+                throw std::system_error{errno, std::generic_category()};
+            auto&& closer = fd_closer{fd};
+
+            auto st = stat_type{};
+            if(::fstat(fd, &st) == -1)
+                throw std::system_error{errno, std::generic_category()};
+
+            const auto frame_size = static_cast<std::uint64_t>(header.width) * header.height * px_size;
+            const auto stride = header.frame_header + frame_size;
+            const auto file_size = static_cast<std::uint64_t>(st.st_size);
+            metrics::count_bytes_read(file_size);
+            auto available = (file_size > header.offset) ? (file_size - header.offset) / stride : 0u;
+            auto count = (header.frames > 0u) ? std::min(header.frames, available) : available;
+            if(count < header.frames)
+                BOOST_LOG_TRIVIAL(warning) << "raw::load() found only " << count << " of " << header.frames
+                                           << " frames in " << path;
+
+            auto b = std::max(binning, 1u);
+            auto rows = reader::unbin(window, b, header.height);
+            const auto row_size = static_cast<std::size_t>(header.width) * px_size;
+            const auto band_offset = static_cast<std::uint64_t>(rows.first) * header.width * px_size;
+
+            // float frames are read straight into the projection, everything else is converted on the way
+            const auto direct = header.type == "f32";
+            auto bytes = std::vector<std::uint8_t>{};
+            auto scratch = std::vector<float>{};
+            auto frames = 0u;
+            for(auto i = std::uint64_t{0u}; i < count; ++i)
+            {
+                const auto pos = header.offset + i * stride + header.frame_header + band_offset;
+                auto ok = true;
+                auto img = reader::decode_frame(header.width, rows, b, scratch, correction,
+                                                [&](float* dest, std::uint32_t first, std::uint32_t rows_in_block)
+                {
+                    if(!ok)
+                        return;
+
+                    const auto block_pos = pos + first * row_size;
+                    if(direct)
+                    {
+                        ok = read_at(fd, dest, rows_in_block * row_size, block_pos);
+                        return;
+                    }
+
+                    bytes.resize(rows_in_block * row_size);
+                    ok = read_at(fd, bytes.data(), bytes.size(), block_pos);
+                    if(ok)
+                        convert(bytes.data(), dest, static_cast<std::size_t>(header.width) * rows_in_block);
+                });
+
+                if(!ok)
+                {
+                    BOOST_LOG_TRIVIAL(warning) << "raw::load() could not read frame " << i << " of " << path;
+                    break;
+                }
+
+                ++frames;
+                if(!f(img))
+                    break;
+            }
+            return frames;
+        }
+    }
+}
@@ -0,0 +1,57 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 15 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#ifndef PARIS_RAW_READER_H_
+#define PARIS_RAW_READER_H_
+
+#include <cstdint>
+#include <string>
+
+#include "flat_field.h"
+#include "geometry.h"
+#include "reader.h"
+
+namespace paris
+{
+    namespace raw
+    {
+        // the extension of the sidecars
+        constexpr auto header_extension = "hdr";
+
+        /*
+         * Headerless frames in host byte order, described by the text sidecar <path>.hdr or, for directories of
+         * raw files, a shared raw.hdr next to them. The sidecar holds "key = value" lines:
+         *
+         *  width, height   frame size in pixels (required)
+         *  type            u8, u16 (default), u32, i16, i32, f32 or f64
+         *  offset          bytes before the first frame (default 0)
+         *  frame_header    bytes before every frame (default 0)
+         *  frames          number of frames (default: as many as the file holds)
+         *
+         * Only the requested rows are read from the file.
+         */
+        auto load(const std::string& path, const reader::consumer_type& f, const row_window& window,
+                  std::uint32_t binning, const flat_field* correction = nullptr) -> std::uint32_t;
+    }
+}
+
+#endif /* PARIS_RAW_READER_H_ */
@@ -0,0 +1,125 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 15 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <string>
+
+#include <boost/log/trivial.hpp>
+
+#include "exception.h"
+#include "flat_field.h"
+#include "geometry.h"
+#include "hdf5_reader.h"
+#include "his.h"
+#include "raw_reader.h"
+#include "reader.h"
+#include "tiff_reader.h"
+
+namespace paris
+{
+    namespace reader
+    {
+        namespace
+        {
+            auto extension(const std::string& path) -> std::string
+            {
+                auto slash = path.find_last_of('/');
+                auto dot = path.find_last_of('.');
+                if(dot == std::string::npos || (slash != std::string::npos && dot < slash))
+                    return std::string{};
+
+                auto ext = path.substr(dot + 1u);
+                std::transform(std::begin(ext), std::end(ext), std::begin(ext),
+                               [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+                return ext;
+            }
+        }
+
+        auto load(const std::string& path, const consumer_type& f, const row_window& window, std::uint32_t binning,
+                  const flat_field* correction) -> std::uint32_t
+        {
+            auto ext = extension(path);
+            if(ext == "tif" || ext == "tiff")
+                return tiff::load(path, f, window, binning, correction);
+            if(ext == "raw")
+                return raw::load(path, f, window, binning, correction);
+            if(ext == "h5" || ext == "hdf5" || ext == "nxs")
+                return hdf5::load(path, f, window, binning, correction);
+
+            // HIS files come with all sorts of names, the loader rejects everything else by its header
+            return his::load(path, f, window, binning, correction);
+        }
+
+        auto is_sidecar(const std::string& path) -> bool
+        {
+            return extension(path) == raw::header_extension;
+        }
+
+        auto check_correction(const flat_field& correction, std::uint32_t width, const band& rows) -> void
+        {
+            if(correction.width() == width && rows.first + rows.rows <= correction.height())
+                return;
+
+            BOOST_LOG_TRIVIAL(fatal) << "The dark and flat frames of " << correction.width() << " x "
+                                     << correction.height() << " pixels don't cover the projections of width "
+                                     << width;
+            throw stage_runtime_error{"reader::load() failed"};
+        }
+
+        auto unbin(const row_window& window, std::uint32_t binning, std::uint32_t height) noexcept -> band
+        {
+            auto b = std::max(binning, 1u);
+            auto clamp = [b](std::uint32_t v, std::uint32_t max)
+            {
+                return static_cast<std::uint32_t>(std::min(std::uint64_t{v} * b, std::uint64_t{max}));
+            };
+
+            auto first = clamp(window.first, height - 1u);
+            return band{first, clamp(window.rows, height - first)};
+        }
+
+        auto bin(const float* src, std::uint32_t w, std::uint32_t h, std::uint32_t b, float* dest) noexcept -> void
+        {
+            const auto w_b = w / b;
+            const auto h_b = h / b;
+            const auto norm = 1.f / static_cast<float>(b * b);
+
+            for(auto y = 0u; y < h_b; ++y)
+            {
+                auto row = dest + static_cast<std::size_t>(y) * w_b;
+                std::fill(row, row + w_b, 0.f);
+                for(auto j = 0u; j < b; ++j)
+                {
+                    auto line = src + (static_cast<std::size_t>(y) * b + j) * w;
+                    for(auto x = 0u; x < w_b; ++x)
+                        for(auto i = 0u; i < b; ++i)
+                            row[x] += line[x * b + i];
+                }
+
+                for(auto x = 0u; x < w_b; ++x)
+                    row[x] *= norm;
+            }
+        }
+    }
+}
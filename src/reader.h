@@ -0,0 +1,133 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 15 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#ifndef PARIS_READER_H_
+#define PARIS_READER_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "backend.h"
+#include "flat_field.h"
+#include "geometry.h"
+#include "projection.h"
+
+namespace paris
+{
+    /*
+     * Projection file readers. Every reader decodes a file frame by frame straight into backend projection buffers,
+     * binned by b x b pixels and restricted to the (binned) detector rows inside window, hands every frame to f and
+     * stops early if f returns false. They return the number of decoded frames -- 0 means the file is not one of
+     * theirs. A correction, if any, turns the raw counts into line integrals right after decoding.
+     */
+    namespace reader
+    {
+        using image_type = backend::projection_host_type;
+        using consumer_type = std::function<bool(image_type&)>;
+
+        // picks the reader by the file extension: .tif/.tiff, .raw, .h5/.hdf5/.nxs and HIS for everything else
+        auto load(const std::string& path, const consumer_type& f, const row_window& window, std::uint32_t binning,
+                  const flat_field* correction = nullptr) -> std::uint32_t;
+
+        // files that describe the projections next to them, e.g. the headers of raw files
+        auto is_sidecar(const std::string& path) -> bool;
+
+        // the unbinned rows [first, first + rows) of a frame with height rows which make up the binned window
+        struct band
+        {
+            std::uint32_t first;
+            std::uint32_t rows;
+        };
+
+        auto unbin(const row_window& window, std::uint32_t binning, std::uint32_t height) noexcept -> band;
+
+        // throws if the references of correction don't cover the rows of a frame with the given width
+        auto check_correction(const flat_field& correction, std::uint32_t width, const band& rows) -> void;
+
+        // averages b x b pixels, incomplete blocks at the right and lower border are dropped
+        auto bin(const float* src, std::uint32_t w, std::uint32_t h, std::uint32_t b, float* dest) noexcept -> void;
+
+        // the source pixels are not necessarily aligned for T -> memcpy each element into place
+        template <typename T>
+        auto convert(const std::uint8_t* src, float* dest, std::size_t n) noexcept -> void
+        {
+            for(auto i = std::size_t{0u}; i < n; ++i)
+            {
+                auto val = T{};
+                std::memcpy(&val, src + i * sizeof(T), sizeof(T));
+                dest[i] = static_cast<float>(val);
+            }
+        }
+
+        // unbinned pixels decoded and corrected in one go, small enough to stay in L2
+        constexpr auto decode_block_size = std::size_t{256u} << 10u;
+
+        /*
+         * Allocates the projection for the rows of a frame with the given width and lets decode(dest, first, count)
+         * write the width * count unbinned pixels of rows [first, first + count) of the band to dest. They go
+         * straight into the projection unless the frame is binned. The band is decoded in blocks of rows and the
+         * correction runs on each block right after it was decoded, while its pixels are still in the cache.
+         */
+        template <typename Decode>
+        auto decode_frame(std::uint32_t width, const band& rows, std::uint32_t binning, std::vector<float>& scratch,
+                          const flat_field* correction, Decode&& decode) -> image_type
+        {
+            if(correction != nullptr)
+                check_correction(*correction, width, rows);
+
+            auto img = backend::make_projection_host(width / binning, rows.rows / binning);
+
+            auto dest = img.buf.get();
+            if(binning > 1u)
+            {
+                scratch.resize(static_cast<std::size_t>(width) * rows.rows);
+                dest = scratch.data();
+            }
+
+            const auto block = static_cast<std::uint32_t>(
+                std::max(decode_block_size / (std::max(width, 1u) * sizeof(float)), std::size_t{1u}));
+            for(auto first = 0u; first < rows.rows; first += block)
+            {
+                const auto count = std::min(block, rows.rows - first);
+                const auto block_dest = dest + static_cast<std::size_t>(first) * width;
+                decode(block_dest, first, count);
+                if(correction != nullptr)
+                    correction->apply(block_dest, rows.first + first, count);
+            }
+
+            if(binning > 1u)
+                bin(scratch.data(), width, rows.rows, binning, img.buf.get());
+
+            img.dim_x = width / binning;
+            img.dim_y = rows.rows / binning;
+            img.first_row = rows.first / binning;
+            return img;
+        }
+    }
+}
+
+#endif /* PARIS_READER_H_ */
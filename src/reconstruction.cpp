@@ -0,0 +1,327 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "backend.h"
+#include "backprojection.h"
+#include "filtering.h"
+#if defined(PARIS_ENABLE_HYBRID)
+#include "hybrid.h"
+#endif
+#include "make_volume.h"
+#include "metrics.h"
+#include "projection_cache.h"
+#include "reconstruction.h"
+#include "scheduler.h"
+#include "sink.h"
+#include "task.h"
+
+namespace paris
+{
+    namespace
+    {
+        auto reconstruct_device(scheduler* sched,
+                                std::size_t device_num,
+                                backend::device_handle& device,
+                                projection_cache& cache,
+                                sink& sink,
+                                std::uint32_t pipeline_depth,
+                                std::uint32_t batch_size) -> void
+        {
+            if(sched == nullptr)
+                return;
+
+            backend::set_device(device);
+            metrics::set_worker(device_num);
+
+            auto t = task{};
+            while(sched->next(device_num, t))
+            {
+                auto last = (t.id + 1u == t.num);
+
+                auto offset = t.id * t.subvol_geo.dim_z;
+                auto dim_z = t.subvol_geo.dim_z + (last ? t.subvol_geo.remainder : 0u);
+
+                // mapped volumes accumulate straight into the output file
+                auto v = sink.mapped() ? sink.make_volume(offset, dim_z) : make_volume(t.subvol_geo, last);
+                v.off = offset;
+                backend::set_interpolation(t.interp);
+
+                auto reader = cache.make_reader(t.id, t.window, static_cast<std::uint32_t>(device_num));
+
+                // the other tasks would wait forever for the projections this one fails to publish
+                struct reader_guard
+                {
+                    projection_cache& c;
+                    projection_cache::reader& r;
+                    bool armed;
+                    ~reader_guard()
+                    {
+                        if(armed)
+                            c.abort(r);
+                    }
+                } guard{cache, reader, true};
+
+                auto d_p = backend::projection_device_type{};
+                auto filtered = false;
+
+                // projections which are still being processed asynchronously by the backend
+                auto in_flight = std::queue<backend::projection_device_type>{};
+
+                // filtered projections waiting for the next backprojection pass
+                auto batch = std::vector<backend::projection_device_type>{};
+                batch.reserve(batch_size);
+
+                // freshly loaded projections, these are filtered together once there are enough for a whole batch
+                auto unfiltered = std::vector<backend::projection_device_type>{};
+                unfiltered.reserve(batch_size);
+
+                auto flush = [&]()
+                {
+                    backproject(batch, v, offset, t.det_geo, t.vol_geo, t.enable_angles, t.enable_roi, t.roi,
+                                t.matrices.get());
+                    for(auto&& p : batch)
+                        in_flight.push(std::move(p));
+                    batch.clear();
+                };
+
+                // a batch has to cover the same detector pixels -- fresh projections hold more than cached ones
+                auto add = [&](backend::projection_device_type& p)
+                {
+                    if(!batch.empty() && (batch.front().first_row != p.first_row || batch.front().dim_y != p.dim_y ||
+                                          batch.front().first_col != p.first_col || batch.front().dim_x != p.dim_x))
+                        flush();
+
+                    batch.push_back(std::move(p));
+                    if(batch.size() >= batch_size)
+                        flush();
+                };
+
+                auto filter = [&]()
+                {
+                    paris::filter(unfiltered, t.det_geo, t.filter);
+                    for(auto&& p : unfiltered)
+                    {
+                        cache.publish(reader, p);
+                        add(p);
+                    }
+                    unfiltered.clear();
+                };
+
+                while(true)
+                {
+                    if(!in_flight.empty() && in_flight.size() >= pipeline_depth)
+                    {
+                        backend::synchronize(in_flight.front());
+                        in_flight.pop();
+                    }
+
+                    if(!cache.fetch(reader, d_p, filtered))
+                    {
+                        // the cache may only be done with us once everything we loaded is published
+                        if(unfiltered.empty())
+                            break;
+
+                        filter();
+                        continue;
+                    }
+
+                    // projections which haven't been seen by any other task yet need to be weighted and filtered first
+                    if(!filtered)
+                    {
+                        unfiltered.push_back(std::move(d_p));
+                        if(unfiltered.size() >= batch_size)
+                            filter();
+                    }
+                    else
+                        add(d_p);
+                }
+                guard.armed = false;
+
+                if(!batch.empty())
+                    flush();
+
+                // the volume is complete once the pipeline is empty
+                while(!in_flight.empty())
+                {
+                    backend::synchronize(in_flight.front());
+                    in_flight.pop();
+                }
+
+                sink.save(v);
+                sched->done(device_num);
+            }
+        }
+    }
+
+    struct worker_pool::worker
+    {
+        std::mutex m;
+        std::condition_variable cv;
+        std::queue<std::packaged_task<void()>> jobs;
+        bool stop = false;
+        std::thread t;
+
+        auto loop() -> void
+        {
+            while(true)
+            {
+                auto job = std::packaged_task<void()>{};
+                {
+                    auto&& lock = std::unique_lock<std::mutex>{m};
+                    cv.wait(lock, [this]() { return stop || !jobs.empty(); });
+                    if(jobs.empty())
+                        return;
+
+                    job = std::move(jobs.front());
+                    jobs.pop();
+                }
+
+                // exceptions end up in the job's future
+                job();
+            }
+        }
+    };
+
+    worker_pool::worker_pool() = default;
+
+    worker_pool::~worker_pool()
+    {
+        for(auto&& w : workers_)
+        {
+            {
+                auto&& lock = std::lock_guard<std::mutex>{w->m};
+                w->stop = true;
+            }
+            w->cv.notify_one();
+            w->t.join();
+        }
+    }
+
+    auto worker_pool::run(std::size_t n, const std::function<void(std::size_t)>& f) -> void
+    {
+        while(workers_.size() < n)
+        {
+            auto w = std::unique_ptr<worker>{new worker};
+            w->t = std::thread{&worker::loop, w.get()};
+            workers_.push_back(std::move(w));
+        }
+
+        auto futures = std::vector<std::future<void>>{};
+        for(auto i = std::size_t{0u}; i < n; ++i)
+        {
+            auto job = std::packaged_task<void()>{[&f, i]() { f(i); }};
+            futures.push_back(job.get_future());
+            {
+                auto&& lock = std::lock_guard<std::mutex>{workers_[i]->m};
+                workers_[i]->jobs.push(std::move(job));
+            }
+            workers_[i]->cv.notify_one();
+        }
+
+        // f has to outlive every job, so all of them are waited for before anything is rethrown
+        auto error = std::exception_ptr{};
+        for(auto&& fut : futures)
+        {
+            try
+            {
+                fut.get();
+            }
+            catch(...)
+            {
+                if(error == nullptr)
+                    error = std::current_exception();
+            }
+        }
+
+        if(error != nullptr)
+            std::rethrow_exception(error);
+    }
+
+    auto reconstruct(scheduler& sched, std::vector<backend::device_handle>& devices, bool host_worker,
+                     projection_cache& cache, sink& sink, std::uint32_t pipeline_depth, std::uint32_t batch_size,
+                     worker_pool* pool)
+    -> void
+    {
+        if(devices.size() == 1 && !host_worker && pool == nullptr)
+        {
+            reconstruct_device(&sched, 0u, devices[0], cache, sink, pipeline_depth, batch_size);
+            return;
+        }
+
+        // the devices hand their filtered projections to each other, the host worker needs them in host memory
+        if(devices.size() > 1 && !host_worker && backend::enable_peer_access(devices))
+            cache.enable_peer_copies(devices.size(), batch_size);
+
+        // the host is scheduled like an additional device
+        auto workers = devices.size() + (host_worker ? 1u : 0u);
+        auto work = [&](std::size_t i)
+        {
+            if(i < devices.size())
+                reconstruct_device(&sched, i, devices[i], cache, sink, pipeline_depth, batch_size);
+    #if defined(PARIS_ENABLE_HYBRID)
+            else
+                reconstruct_host(sched, devices.size(), cache, sink, batch_size);
+    #endif
+        };
+
+        if(pool != nullptr)
+            return pool->run(workers, work);
+
+        // launch a reconstruction thread for each available device
+        auto futures = std::vector<std::future<void>>{};
+        for(auto i = std::size_t{0u}; i < workers; ++i)
+            futures.emplace_back(std::async(std::launch::async, work, i));
+
+        // wait for the end of execution
+        for(auto&& f : futures)
+            f.get();
+    }
+
+    auto staging_memory(std::uint32_t dim_x, std::uint32_t rows, const volume_geometry& vol_geo,
+                        std::size_t prefetch_depth) noexcept -> std::size_t
+    {
+        auto projection_size = static_cast<std::size_t>(dim_x) * rows * sizeof(float);
+        return prefetch_depth * projection_size + sink::staging_size(vol_geo);
+    }
+
+    auto size_host_pool(std::uint32_t dim_x, const row_window& window, const volume_geometry& vol_geo,
+                        std::size_t devices, std::size_t prefetch_depth, std::uint32_t pipeline_depth) -> void
+    {
+        // every device holds up to pipeline_depth projections while uploading and publishing them
+        auto projection_size = static_cast<std::size_t>(dim_x) * window.rows * sizeof(float);
+        backend::set_host_pool_size(devices * pipeline_depth * projection_size
+                                    + staging_memory(dim_x, window.rows, vol_geo, prefetch_depth));
+    }
+}
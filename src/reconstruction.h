@@ -0,0 +1,84 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#ifndef PARIS_RECONSTRUCTION_H_
+#define PARIS_RECONSTRUCTION_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "backend.h"
+#include "geometry.h"
+#include "projection_cache.h"
+#include "scheduler.h"
+#include "sink.h"
+
+namespace paris
+{
+    /*
+     * Long-lived threads, one per device (and host worker). The backends keep their per-device streams, buffers
+     * and plans in thread local storage, so reconstructions which run on the same threads find them warm.
+     */
+    class worker_pool
+    {
+        public:
+            worker_pool();
+            ~worker_pool();
+
+            worker_pool(const worker_pool&) = delete;
+            auto operator=(const worker_pool&) -> worker_pool& = delete;
+
+            // runs f(i) on worker i for all i < n and waits for them, the first exception is rethrown
+            auto run(std::size_t n, const std::function<void(std::size_t)>& f) -> void;
+
+        private:
+            struct worker;
+            std::vector<std::unique_ptr<worker>> workers_;
+    };
+
+    /*
+     * Reconstructs the tasks of sched on all devices -- and on the host's cores if host_worker is set -- and
+     * saves the subvolumes to sink. Returns once every task is done; the caller still has to flush the sink.
+     * Without a pool every reconstruction starts its own threads.
+     */
+    auto reconstruct(scheduler& sched, std::vector<backend::device_handle>& devices, bool host_worker,
+                     projection_cache& cache, sink& sink, std::uint32_t pipeline_depth, std::uint32_t batch_size,
+                     worker_pool* pool = nullptr)
+    -> void;
+
+    // host memory taken by the source's prefetched projections with dim_x * rows pixels and the sink's staging slabs
+    auto staging_memory(std::uint32_t dim_x, std::uint32_t rows, const volume_geometry& vol_geo,
+                        std::size_t prefetch_depth) noexcept -> std::size_t;
+
+    /*
+     * Sizes the backend's pool of host buffers so that the projections in flight -- the source's prefetched
+     * ones and those being uploaded to the devices -- and the sink's staging slabs are recycled instead of
+     * being allocated anew. Projections have dim_x columns and the rows of window.
+     */
+    auto size_host_pool(std::uint32_t dim_x, const row_window& window, const volume_geometry& vol_geo,
+                        std::size_t devices, std::size_t prefetch_depth, std::uint32_t pipeline_depth) -> void;
+}
+
+#endif /* PARIS_RECONSTRUCTION_H_ */
@@ -0,0 +1,122 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <queue>
+#include <utility>
+
+#include <boost/log/trivial.hpp>
+
+#include "scheduler.h"
+#include "task.h"
+
+namespace paris
+{
+    scheduler::scheduler(std::queue<task> tasks, std::size_t devices)
+    : devices_(devices, device_state{clock::time_point{}, clock::duration::zero(), 0u, false, false})
+    {
+        while(!tasks.empty())
+        {
+            tasks_.push_back(std::move(tasks.front()));
+            tasks.pop();
+        }
+    }
+
+    auto scheduler::next(std::size_t d, task& t) -> bool
+    {
+        auto&& lock = std::lock_guard<std::mutex>{mutex_};
+        auto now = clock::now();
+
+        if(tasks_.empty() || worth_waiting(d, now))
+        {
+            auto& s = devices_[d];
+            s.retired = true;
+            if(s.finished > 0u)
+                BOOST_LOG_TRIVIAL(info) << "Device #" << d << " reconstructed " << s.finished << " subvolumes, "
+                    << std::chrono::duration_cast<std::chrono::milliseconds>(average(s)).count() << " ms each";
+            return false;
+        }
+
+        t = std::move(tasks_.front());
+        tasks_.pop_front();
+
+        devices_[d].started = now;
+        devices_[d].busy = true;
+        return true;
+    }
+
+    auto scheduler::done(std::size_t d) -> void
+    {
+        auto&& lock = std::lock_guard<std::mutex>{mutex_};
+        auto& s = devices_[d];
+        s.total += clock::now() - s.started;
+        ++s.finished;
+        s.busy = false;
+    }
+
+    auto scheduler::average(const device_state& s) const noexcept -> clock::duration
+    {
+        return s.total / s.finished;
+    }
+
+    auto scheduler::worth_waiting(std::size_t d, clock::time_point now) const noexcept -> bool
+    {
+        // without measurements there is nothing to compare
+        auto& self = devices_[d];
+        if(self.finished == 0u)
+            return false;
+
+        auto finish = now + average(self);
+
+        /*
+         * count the subvolumes the other devices would complete before d could complete the next one. Retired
+         * devices won't take any more, so the last device which is still active never waits.
+         */
+        auto faster = std::size_t{0};
+        for(auto e = std::size_t{0}; e < devices_.size(); ++e)
+        {
+            auto& other = devices_[e];
+            if(e == d || other.retired || other.finished == 0u)
+                continue;
+
+            auto avg = average(other);
+            if(avg <= clock::duration::zero())
+                continue;
+
+            auto free = other.busy ? other.started + avg : now;
+            if(free < now)
+                free = now;
+
+            for(auto f = free + avg; f <= finish; f += avg)
+            {
+                ++faster;
+                if(faster >= tasks_.size())
+                    return true;
+            }
+        }
+
+        return false;
+    }
+}
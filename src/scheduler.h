@@ -0,0 +1,74 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#ifndef PARIS_SCHEDULER_H_
+#define PARIS_SCHEDULER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <queue>
+#include <vector>
+
+#include "task.h"
+
+namespace paris
+{
+    /*
+     * Hands out subvolumes to the devices on a first come, first served basis. The time each device needs for a
+     * subvolume is measured. Near the end a device stops taking work if faster devices would finish the
+     * remaining subvolumes earlier than it would, so all devices finish at about the same time.
+     */
+    class scheduler
+    {
+        public:
+            scheduler(std::queue<task> tasks, std::size_t devices);
+
+            // fetches the next subvolume for device d, returns false if there is nothing left for d
+            auto next(std::size_t d, task& t) -> bool;
+
+            // device d finished the subvolume it fetched last
+            auto done(std::size_t d) -> void;
+
+        private:
+            using clock = std::chrono::steady_clock;
+
+            struct device_state
+            {
+                clock::time_point started;
+                clock::duration total;
+                std::uint32_t finished;
+                bool busy;
+                bool retired;   // next() returned false, the device won't ask again
+            };
+
+            auto average(const device_state& s) const noexcept -> clock::duration;
+            auto worth_waiting(std::size_t d, clock::time_point now) const noexcept -> bool;
+
+            std::deque<task> tasks_;
+            std::vector<device_state> devices_;
+            std::mutex mutex_;
+    };
+}
+
+#endif /* PARIS_SCHEDULER_H_ */
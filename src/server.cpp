@@ -0,0 +1,134 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 15 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#include <chrono>
+#include <csignal>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <boost/log/trivial.hpp>
+
+#include "exception.h"
+#include "filesystem.h"
+#include "program_options.h"
+#include "server.h"
+
+namespace paris
+{
+    namespace
+    {
+        volatile std::sig_atomic_t stop_requested = 0;
+
+        auto request_stop(int) -> void
+        {
+            stop_requested = 1;
+        }
+
+        const auto job_extension = std::string{".job"};
+
+        auto is_job(const std::string& path) -> bool
+        {
+            return path.size() > job_extension.size() &&
+                   path.compare(path.size() - job_extension.size(), job_extension.size(), job_extension) == 0;
+        }
+
+        auto exists(const std::string& path) -> bool
+        {
+            return ::access(path.c_str(), F_OK) == 0;
+        }
+
+        auto finished(const std::string& job) -> bool
+        {
+            auto base = job.substr(0u, job.size() - job_extension.size());
+            return exists(base + ".done") || exists(base + ".failed");
+        }
+
+        auto execute(const std::string& job, const std::function<void(program_options&)>& run) -> void
+        {
+            auto base = job.substr(0u, job.size() - job_extension.size());
+            BOOST_LOG_TRIVIAL(info) << "Starting job " << job;
+
+            auto start = std::chrono::steady_clock::now();
+            try
+            {
+                auto in = std::ifstream{job};
+                if(!in)
+                    throw std::runtime_error{"could not read " + job};
+
+                auto args = std::string{std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{}};
+                auto po = make_job_options(args);
+                run(po);
+            }
+            catch(const std::exception& e)
+            {
+                BOOST_LOG_TRIVIAL(error) << "Job " << job << " failed: " << e.what();
+                auto out = std::ofstream{base + ".failed"};
+                out << e.what() << '\n';
+                return;
+            }
+
+            auto seconds = std::chrono::duration<double>{std::chrono::steady_clock::now() - start};
+            BOOST_LOG_TRIVIAL(info) << "Finished job " << job << " in " << seconds.count() << " s";
+            auto out = std::ofstream{base + ".done"};
+            if(!out)
+                BOOST_LOG_TRIVIAL(warning) << "Could not mark " << job << " as done";
+        }
+    }
+
+    auto serve(const std::string& dir, const std::function<void(program_options&)>& run) -> void
+    {
+        if(!create_directory(dir))
+            throw stage_construction_error{"Could not create the job directory " + dir};
+
+        std::signal(SIGINT, request_stop);
+        std::signal(SIGTERM, request_stop);
+
+        // watch first, a job written while the existing ones are run would be missed otherwise
+        auto&& watcher = directory_watcher{dir};
+        auto pending = read_directory(dir);
+
+        BOOST_LOG_TRIVIAL(info) << "Waiting for jobs in " << dir;
+        while(stop_requested == 0)
+        {
+            for(auto&& job : pending)
+            {
+                if(stop_requested != 0)
+                    break;
+
+                if(is_job(job) && !finished(job))
+                    execute(job, run);
+            }
+            pending.clear();
+
+            watcher.poll(pending, std::chrono::milliseconds{500});
+        }
+
+        BOOST_LOG_TRIVIAL(info) << "Stopping the server";
+    }
+}
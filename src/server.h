@@ -0,0 +1,43 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 15 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#ifndef PARIS_SERVER_H_
+#define PARIS_SERVER_H_
+
+#include <functional>
+#include <string>
+
+#include "program_options.h"
+
+namespace paris
+{
+    /*
+     * Reconstruction server. Every <name>.job file in dir holds the command line of a run without the program name.
+     * The jobs are handed to run one after the other in the order of their names -- those already in dir first,
+     * then the ones written to (or moved into) it later. A job which returns ends in an empty <name>.done,
+     * a job which throws in <name>.failed with the error message; jobs with either file are not run again.
+     * Returns after SIGINT or SIGTERM once the current job is done.
+     */
+    auto serve(const std::string& dir, const std::function<void(program_options&)>& run) -> void;
+}
+
+#endif /* PARIS_SERVER_H_ */
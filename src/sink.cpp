@@ -20,9 +20,16 @@
  * Authors: Jan Stephan <j.stephan@hzdr.de>
  */
 
+#include <algorithm>
+#include <condition_variable>
 #include <cstddef>
-#include <stdexcept>
+#include <cstdint>
+#include <exception>
+#include <functional>
 #include <mutex>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
 #include <utility>
 
 #include <boost/log/trivial.hpp>
@@ -30,14 +37,35 @@
 #include "backend.h"
 #include "exception.h"
 #include "filesystem.h"
+#include "journal.h"
+#include "metrics.h"
 #include "sink.h"
 #include "ddbvf.h"
 #include "volume.h"
 
 namespace paris
 {
-    sink::sink(const std::string& path, const std::string& prefix, const volume_geometry& vol_geo)
-    : path_{path}, vol_geo_(vol_geo)
+    namespace
+    {
+        // staging memory: staging_buffers slabs of roughly chunk_size bytes each, shared by all devices
+        constexpr auto staging_buffers = 8u;
+        constexpr auto chunk_size = std::size_t{64u} << 20u;
+
+        // slabs are written with positional writes, so several of them can be in flight at once
+        constexpr auto writer_threads = 4u;
+
+        auto chunk_slices(const volume_geometry& vol_geo) noexcept -> std::uint32_t
+        {
+            auto slice_size = static_cast<std::size_t>(vol_geo.dim_x) * vol_geo.dim_y * sizeof(float);
+            auto slices = std::max(chunk_size / slice_size, std::size_t{1u});
+            return static_cast<std::uint32_t>(std::min(slices, static_cast<std::size_t>(vol_geo.dim_z)));
+        }
+    }
+
+    sink::sink(const std::string& path, const std::string& prefix, const volume_geometry& vol_geo,
+               const ddbvf::format& fmt, bool attach, bool map, journal* written)
+    : path_{path}, attached_{attach}, mapped_{false}, journal_{written}, vol_geo_(vol_geo), allocated_{0u},
+      writing_{0u}, done_{false}
     {
         try
         {
@@ -52,7 +80,19 @@ namespace paris
                 throw stage_construction_error{"sink::sink() failed"};
             }
 
-            handle_ = ddbvf::create(path_, vol_geo_.dim_x, vol_geo_.dim_y, vol_geo_.dim_z);
+            if(attach)
+                handle_ = ddbvf::attach(path_, vol_geo_.dim_x, vol_geo_.dim_y, vol_geo_.dim_z);
+            else
+                handle_ = ddbvf::create(path_, vol_geo_.dim_x, vol_geo_.dim_y, vol_geo_.dim_z, fmt);
+
+            if(map)
+            {
+                auto pos = std::uint64_t{};
+                mapped_ = backend::maps_volumes && ddbvf::mapping(handle_, 0u, pos) != -1;
+                if(!mapped_)
+                    BOOST_LOG_TRIVIAL(warning) << "Only uncompressed f32 volumes of host backends can be mapped, "
+                                                  "writing the volume instead";
+            }
         }
         catch(const std::system_error& se)
         {
@@ -67,18 +107,76 @@ namespace paris
             throw stage_construction_error{"sink::sink() failed"};
         }
 
+        start();
+    }
+
+    sink::sink(const volume_geometry& vol_geo, consumer_type consume)
+    : consume_{std::move(consume)}, attached_{false}, mapped_{false}, journal_{nullptr}, vol_geo_(vol_geo),
+      allocated_{0u}, writing_{0u}, done_{false}
+    {
+        start();
+    }
+
+    sink::~sink()
+    {
+        {
+            auto&& lock = std::lock_guard<std::mutex>{mutex_};
+            done_ = true;
+        }
+        cv_.notify_all();
+
+        for(auto&& w : writers_)
+            w.join();
+    }
+
+    auto sink::mapped() const noexcept -> bool
+    {
+        return mapped_;
+    }
+
+    auto sink::make_volume(std::uint32_t first, std::uint32_t dim_z) -> backend::volume_device_type
+    {
+        auto pos = std::uint64_t{};
+        auto fd = ddbvf::mapping(handle_, first, pos);
+        auto v = backend::map_volume(fd, pos, vol_geo_.dim_x, vol_geo_.dim_y, dim_z);
+        v.off = first;
+
+        // the backprojection accumulates, a slab which a crashed run didn't finish must not keep its partial sums
+        if(attached_)
+            backend::fill(v, 0.f);
+        return v;
     }
 
     auto sink::save(const backend::volume_device_type& v) -> void
     {
+        auto bytes = static_cast<std::uint64_t>(v.dim_x) * v.dim_y * v.dim_z * sizeof(float);
+        metrics::count_bytes_written(bytes);
+
+        // the backprojection has written straight into the file, the page cache keeps it beyond a crash of ours
+        if(mapped_)
+        {
+            if(journal_ != nullptr)
+                journal_->record(v.off, v.dim_z);
+            return;
+        }
+
         try
         {
-            auto host_v = backend::make_volume_host(v.dim_x, v.dim_y, v.dim_z);
-            backend::copy_d2h(v, host_v);
+            for(auto first = 0u; first < v.dim_z; first += chunk_slices_)
+            {
+                auto buf = acquire();
+                buf.dim_z = std::min(chunk_slices_, v.dim_z - first);
+                {
+                    auto&& t = metrics::timer{metrics::stage::download};
+                    backend::copy_d2h(v, buf, first);
+                }
 
-            static auto&& m = std::mutex{};
-            auto&& lock = std::lock_guard<std::mutex>{m};
-            ddbvf::write(handle_, host_v, host_v.off);
+                {
+                    auto&& lock = std::lock_guard<std::mutex>{mutex_};
+                    pending_.push(std::move(buf));
+                }
+                cv_.notify_all();
+            }
         }
         catch(const std::system_error& se)
         {
@@ -92,4 +190,135 @@ namespace paris
             throw stage_runtime_error{"sink::save() failed"};
         }
     }
+
+    auto sink::save(const float* v, std::uint32_t dim_z, std::uint32_t off) -> void
+    {
+        auto slice = static_cast<std::size_t>(vol_geo_.dim_x) * vol_geo_.dim_y;
+        metrics::count_bytes_written(static_cast<std::uint64_t>(slice) * dim_z * sizeof(float));
+
+        for(auto first = 0u; first < dim_z; first += chunk_slices_)
+        {
+            auto buf = acquire();
+            buf.dim_z = std::min(chunk_slices_, dim_z - first);
+            buf.off = off + first;
+            std::copy_n(v + first * slice, buf.dim_z * slice, buf.buf.get());
+            {
+                auto&& lock = std::lock_guard<std::mutex>{mutex_};
+                pending_.push(std::move(buf));
+            }
+            cv_.notify_all();
+        }
+    }
+
+    auto sink::flush() -> void
+    {
+        try
+        {
+            auto&& lock = std::unique_lock<std::mutex>{mutex_};
+            cv_.wait(lock, [this]() { return (pending_.empty() && writing_ == 0u) || error_ != nullptr; });
+
+            if(error_ != nullptr)
+                std::rethrow_exception(error_);
+
+            if(!consume_)
+                ddbvf::close(handle_);
+        }
+        catch(const std::system_error& se)
+        {
+            BOOST_LOG_TRIVIAL(fatal) << "sink::flush(): system error while writing volume: "
+                                        << se.code() << " - " << se.what();
+            throw stage_runtime_error{"sink::flush() failed"};
+        }
+        catch(const std::runtime_error& re)
+        {
+            BOOST_LOG_TRIVIAL(fatal) << "sink::flush(): runtime error while writing volume: " << re.what();
+            throw stage_runtime_error{"sink::flush() failed"};
+        }
+    }
+
+    auto sink::staging_size(const volume_geometry& vol_geo) noexcept -> std::size_t
+    {
+        auto slice_size = static_cast<std::size_t>(vol_geo.dim_x) * vol_geo.dim_y * sizeof(float);
+        return staging_buffers * chunk_slices(vol_geo) * slice_size;
+    }
+
+    auto sink::start() -> void
+    {
+        chunk_slices_ = chunk_slices(vol_geo_);
+
+        for(auto i = 0u; i < writer_threads; ++i)
+            writers_.emplace_back(&sink::write, this);
+    }
+
+    auto sink::acquire() -> backend::volume_host_type
+    {
+        auto&& lock = std::unique_lock<std::mutex>{mutex_};
+        while(true)
+        {
+            if(error_ != nullptr)
+                std::rethrow_exception(error_);
+
+            if(!free_.empty())
+            {
+                auto buf = std::move(free_.back());
+                free_.pop_back();
+                return buf;
+            }
+
+            // the pool grows on demand
+            if(allocated_ < staging_buffers)
+            {
+                ++allocated_;
+                lock.unlock();
+                return backend::make_volume_host(vol_geo_.dim_x, vol_geo_.dim_y, chunk_slices_);
+            }
+
+            cv_.wait(lock);
+        }
+    }
+
+    auto sink::write() -> void
+    {
+        while(true)
+        {
+            auto buf = backend::volume_host_type{};
+            {
+                auto&& lock = std::unique_lock<std::mutex>{mutex_};
+                cv_.wait(lock, [this]() { return done_ || !pending_.empty(); });
+                if(pending_.empty())
+                    return;
+
+                buf = std::move(pending_.front());
+                pending_.pop();
+                ++writing_;
+            }
+
+            auto err = std::exception_ptr{};
+            try
+            {
+                auto&& t = metrics::timer{metrics::stage::write};
+                if(consume_)
+                    consume_(buf.buf.get(), buf.dim_z, buf.off);
+                else
+                {
+                    ddbvf::write(handle_, buf, buf.off);
+                    if(journal_ != nullptr)
+                        journal_->record(buf.off, buf.dim_z);
+                }
+            }
+            catch(...)
+            {
+                err = std::current_exception();
+            }
+
+            {
+                auto&& lock = std::lock_guard<std::mutex>{mutex_};
+                if(err != nullptr)
+                    error_ = err;
+                free_.push_back(std::move(buf));
+                --writing_;
+            }
+            cv_.notify_all();
+        }
+    }
 }
@@ -23,27 +23,94 @@
 #ifndef PARIS_SINK_H_
 #define PARIS_SINK_H_
 
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <queue>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "backend.h"
 #include "ddbvf.h"
 #include "geometry.h"
+#include "journal.h"
 #include "volume.h"
 
 namespace paris
 {
+    /*
+     * Downloads subvolumes slab-wise into a pool of staging buffers which are written to disk by a few writer
+     * threads. save() returns as soon as the device volume isn't needed anymore.
+     */
     class sink
     {
         public:
-            sink(const std::string& path, const std::string& prefix, const volume_geometry& vol_geo);
+            /*
+             * With attach the volume file has already been created by another process. With map the volumes are
+             * mapped from the file if the backend keeps them in host memory and the file is uncompressed f32.
+             * Mapped slabs of an attached file are cleared first, they may hold the partial sums of a crashed run.
+             * Slices which have been written are recorded in written unless it is nullptr.
+             */
+            sink(const std::string& path, const std::string& prefix, const volume_geometry& vol_geo,
+                 const ddbvf::format& fmt, bool attach = false, bool map = false, journal* written = nullptr);
+
+            /*
+             * Hands the volume to consume slab by slab instead of writing it to disk. consume receives dim_z
+             * slices starting at slice first and may be called from several threads at once for different slabs.
+             */
+            using consumer_type = std::function<void(const float* slices, std::uint32_t dim_z, std::uint32_t first)>;
+            sink(const volume_geometry& vol_geo, consumer_type consume);
+            ~sink();
+
+            sink(const sink&) = delete;
+            auto operator=(const sink&) -> sink& = delete;
+
+            // true if make_volume() maps the slices from the file, saving them is done by the page cache then
+            auto mapped() const noexcept -> bool;
+            auto make_volume(std::uint32_t first, std::uint32_t dim_z) -> backend::volume_device_type;
+
             auto save(const backend::volume_device_type& v) -> void;
 
+            // saves dim_z slices starting at slice off which already reside in host memory
+            auto save(const float* v, std::uint32_t dim_z, std::uint32_t off) -> void;
+
+            // waits until all saved volumes have been written and finishes the file
+            auto flush() -> void;
+
+            // host memory taken by the staging buffers of a sink for vol_geo
+            static auto staging_size(const volume_geometry& vol_geo) noexcept -> std::size_t;
+
+        private:
+            auto start() -> void;
+            auto acquire() -> backend::volume_host_type;
+            auto write() -> void;
+
         private:
             std::string path_;
             std::string prefix_;
             ddbvf::handle_type handle_;
+            consumer_type consume_;
+            bool attached_;
+            bool mapped_;
+            journal* journal_;
 
             volume_geometry vol_geo_;
+            std::uint32_t chunk_slices_;
+
+            std::vector<backend::volume_host_type> free_;
+            std::queue<backend::volume_host_type> pending_;
+            std::uint32_t allocated_;
+            std::uint32_t writing_;
+            bool done_;
+            std::exception_ptr error_;
+
+            std::mutex mutex_;
+            std::condition_variable cv_;
+            std::vector<std::thread> writers_;
     };
 }
 
@@ -21,116 +21,399 @@
  */
 
 #include <algorithm>
-#include <fstream>
-#include <iterator>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
 #include <boost/log/trivial.hpp>
 
+#include "angles.h"
 #include "backend.h"
 #include "exception.h"
 #include "filesystem.h"
-#include "his.h"
+#include "flat_field.h"
+#include "geometry.h"
+#include "metrics.h"
 #include "projection.h"
+#include "reader.h"
 #include "source.h"
 
 namespace paris
 {
     namespace
     {
-        auto read_angles(const std::string& path) -> std::vector<float>
+        // the projection files in dir, without the sidecars describing them
+        auto list_projections(const std::string& dir) -> std::vector<std::string>
         {
-            auto angles = std::vector<float>{};
+            auto paths = read_directory(dir);
+            paths.erase(std::remove_if(std::begin(paths), std::end(paths), &reader::is_sidecar), std::end(paths));
+            return paths;
+        }
 
-            auto&& file = std::ifstream{path.c_str()};
-            if(!file.is_open())
-            {
-                BOOST_LOG_TRIVIAL(warning) << "Could not open angle file at " << path << ", using default values.";
-                return angles;
-            }
+        auto backoff(std::uint32_t& spins) -> void
+        {
+            // spin briefly, then give the other side some time to catch up
+            if(++spins < 64u)
+                std::this_thread::yield();
+            else
+                std::this_thread::sleep_for(std::chrono::microseconds{100});
+        }
+    }
 
-            auto angle_string = std::string{};
-            std::getline(file, angle_string);
+    source::source(const std::string& proj_dir, const row_window& window, std::uint32_t binning,
+                   angle_table angles,
+                   std::uint16_t quality, std::size_t prefetch_depth,
+                   std::uint32_t stream_count, std::uint32_t stream_timeout, std::uint32_t io_threads,
+                   flat_field_ptr correction)
+    : paths_{list_projections(proj_dir)}, queue_{std::max(prefetch_depth, std::size_t{1u})}, window_(window),
+      binning_{binning}, angles_{std::move(angles)}, quality_{quality}, correction_{std::move(correction)},
+      stream_count_{stream_count}, stream_timeout_{stream_timeout},
+      io_threads_{std::max(io_threads, 1u)}, ahead_{std::max(prefetch_depth, std::size_t{1u})}, done_{false},
+      stop_{false}
+    {
+        if(stream_count_ > 0u)
+        {
+            // watch first so that no file slips through between the listing and the first event
+            watcher_ = std::unique_ptr<directory_watcher>{new directory_watcher{proj_dir}};
+            paths_ = list_projections(proj_dir);
+            BOOST_LOG_TRIVIAL(info) << "Streaming " << stream_count_ << " projections from " << proj_dir;
+        }
 
-            auto loc = std::locale{};
-            if(angle_string.find(',') != std::string::npos)
-                loc = std::locale{"de_DE.UTF-8"};
+        thread_ = std::thread{&source::prefetch, this};
+    }
 
-            file.seekg(0, std::ios_base::beg);
-            file.imbue(loc);
+    source::source(const float* stack, std::uint32_t dim_x, std::uint32_t dim_y, std::uint32_t num,
+                   const float* angles, const row_window& window, std::uint16_t quality, std::size_t prefetch_depth)
+    : queue_{std::max(prefetch_depth, std::size_t{1u})}, window_(window), binning_{1u},
+      quality_{quality}, stream_count_{0u}, stream_timeout_{0u}, io_threads_{1u}, ahead_{1u},
+      stack_{stack}, stack_dim_x_{dim_x}, stack_dim_y_{dim_y}, stack_num_{num}, done_{false}, stop_{false}
+    {
+        if(angles != nullptr)
+            angles_ = std::make_shared<const std::vector<float>>(angles, angles + num);
 
-            while(!file.eof())
-            {
-                auto angle = 0.f;
-                file >> angle;
-                angles.push_back(angle);
-            }
+        thread_ = std::thread{&source::prefetch, this};
+    }
+
+    source::~source()
+    {
+        {
+            // under the lock so that no waiting reader misses the notification
+            auto&& lock = std::lock_guard<std::mutex>{read_mutex_};
+            stop_ = true;
+        }
+        read_cv_.notify_all();
+
+        if(thread_.joinable())
+            thread_.join();
+    }
+
+    auto source::push(output_type& p) -> bool
+    {
+        if(angles_ != nullptr && p.idx < angles_->size())
+            p.phi = (*angles_)[p.idx];
 
-            return angles;
+        // wait for a free slot
+        auto spins = 0u;
+        while(!queue_.try_push(p))
+        {
+            if(stop_)
+                return false;
+            backoff(spins);
         }
+        return true;
     }
 
-    source::source(const std::string& proj_dir,
-                   bool enable_angles, const std::string& angle_file,
-                   std::uint16_t quality) noexcept
-    : drained_{true}, enable_angles_{enable_angles}, quality_{quality}
+    auto source::load_stack() -> bool
     {
-        paths_ = read_directory(proj_dir);
-        if(!paths_.empty())
-            drained_ = false;
+        // only the rows inside the window are copied into the pipeline
+        const auto first = std::min(window_.first, stack_dim_y_ - 1u);
+        const auto rows = std::min(window_.rows, stack_dim_y_ - first);
+        const auto frame = static_cast<std::size_t>(stack_dim_x_) * stack_dim_y_;
+        const auto band = static_cast<std::size_t>(stack_dim_x_) * rows;
 
-        if(enable_angles_)
-            angles_ = read_angles(angle_file);
+        for(auto i = 0u; i < stack_num_; i += quality_)
+        {
+            auto p = backend::make_projection_host(stack_dim_x_, rows);
+            std::copy_n(stack_ + i * frame + static_cast<std::size_t>(first) * stack_dim_x_, band, p.buf.get());
+            p.first_row = first;
+            p.idx = i;
+
+            if(!push(p))
+                return false;
+        }
+        return true;
     }
 
-    auto source::load_next() -> output_type
+    auto source::load_file(const std::string& path, std::uint32_t& i) -> bool
     {
-        thread_local static auto i = 0u;
-        if(queue_.empty())
+        // includes the time spent waiting for room in the queue
+        auto&& t = metrics::timer{metrics::stage::load, 0u};
+
+        // frames are handed to the queue as soon as they are decoded
+        auto frames = reader::load(path, [this, &i](output_type& p)
         {
-            auto done = false;
-            while(!done)
+            // a stream ends with the expected number of projections
+            if(stream_count_ > 0u && i >= stream_count_)
+                return false;
+
+            auto idx = i++;
+            if(idx % quality_ != 0u)
+                return true;
+
+            p.idx = idx;
+            return push(p);
+        }, window_, binning_, correction_.get());
+        t.set_items(frames);
+
+        if(stop_)
+            return false;
+
+        if(frames == 0u)
+            BOOST_LOG_TRIVIAL(warning) << "Skipping invalid file at " << path;
+
+        return true;
+    }
+
+    auto source::deliver(std::vector<output_type>& frames, std::uint32_t& i) -> bool
+    {
+        for(auto&& p : frames)
+        {
+            // a stream ends with the expected number of projections
+            if(stream_count_ > 0u && i >= stream_count_)
+                return false;
+
+            auto idx = i++;
+            if(idx % quality_ != 0u)
+                continue;
+
+            p.idx = idx;
+            if(!push(p))
+                return false;
+        }
+
+        frames.clear();
+        return true;
+    }
+
+    auto source::read(std::uint32_t& i) -> void
+    {
+        // frames decoded ahead of this file's turn, i is only touched by the reader whose turn it is
+        auto frames = std::vector<output_type>{};
+        while(true)
+        {
+            auto n = std::size_t{0u};
             {
-                auto vec = his::load(paths_[0u]);
-                if(vec.empty())
+                auto&& lock = std::unique_lock<std::mutex>{read_mutex_};
+                read_cv_.wait(lock, [this]
                 {
-                    BOOST_LOG_TRIVIAL(warning) << "Skipping invalid file at " << paths_[0u];
-                }
-                else
+                    return stop_ || next_file_ >= paths_.size() || next_file_ < turn_ + io_threads_;
+                });
+
+                if(stop_ || next_file_ >= paths_.size())
+                    return;
+
+                n = next_file_++;
+            }
+
+            // includes the time spent waiting for this file's turn and for room in the queue
+            auto&& t = metrics::timer{metrics::stage::load, 0u};
+
+            auto more = true;
+            auto count = 0u;
+            auto error = std::exception_ptr{};
+            try
+            {
+                count = reader::load(paths_[n], [this, n, &i, &frames, &more](output_type& p)
                 {
-                    for(auto&& p : vec)
+                    frames.push_back(std::move(p));
                     {
-                        if(i % quality_ == 0u)
-                        {
-                            p.idx = i;
+                        auto&& lock = std::unique_lock<std::mutex>{read_mutex_};
+                        if(turn_ != n && frames.size() < ahead_)
+                            return !stop_;
 
-                            if(enable_angles_ && !angles_.empty())
-                                p.phi = angles_[i];
-
-                            queue_.push(std::move(p));
-                        }
-                        ++i;
+                        read_cv_.wait(lock, [this, n] { return stop_ || turn_ >= n; });
+                        if(stop_ || turn_ != n)
+                            return false;
                     }
-                    done = true;
+
+                    more = deliver(frames, i);
+                    return more;
+                }, window_, binning_, correction_.get());
+            }
+            catch(...)
+            {
+                error = std::current_exception();
+            }
+            t.set_items(count);
+
+            {
+                auto&& lock = std::unique_lock<std::mutex>{read_mutex_};
+                read_cv_.wait(lock, [this, n] { return stop_ || turn_ >= n; });
+                if(stop_ || turn_ != n)
+                    return;
+            }
+
+            if(error == nullptr && more)
+                more = deliver(frames, i);
+            frames.clear();
+
+            if(error == nullptr && count == 0u)
+                BOOST_LOG_TRIVIAL(warning) << "Skipping invalid file at " << paths_[n];
+
+            {
+                // errors and the end of a stream stop the other readers, too
+                auto&& lock = std::lock_guard<std::mutex>{read_mutex_};
+                read_error_ = error;
+                turn_ = (error == nullptr && more) ? n + 1u : paths_.size();
+                if(turn_ == paths_.size())
+                    next_file_ = paths_.size();
+            }
+            read_cv_.notify_all();
+        }
+    }
+
+    auto source::load_files(std::uint32_t& i) -> bool
+    {
+        for(auto t = 0u; t < io_threads_; ++t)
+            readers_.emplace_back(&source::read, this, std::ref(i));
+
+        // the readers have to be gone before we leave, whichever way that is
+        struct reader_guard
+        {
+            source& s;
+            ~reader_guard()
+            {
+                {
+                    auto&& lock = std::lock_guard<std::mutex>{s.read_mutex_};
+                    s.next_file_ = s.paths_.size();
+                    s.turn_ = s.paths_.size();
                 }
+                s.read_cv_.notify_all();
 
-                paths_.erase(std::begin(paths_));
+                for(auto&& r : s.readers_)
+                    r.join();
+                s.readers_.clear();
             }
+        } guard{*this};
+
+        {
+            auto&& lock = std::unique_lock<std::mutex>{read_mutex_};
+            read_cv_.wait(lock, [this] { return stop_ || turn_ >= paths_.size(); });
         }
 
-        auto p = std::move(queue_.front());
-        queue_.pop();
+        if(read_error_ != nullptr)
+            std::rethrow_exception(read_error_);
+
+        return !stop_;
+    }
+
+    auto source::stream(std::uint32_t& i) -> bool
+    {
+        auto seen = std::set<std::string>(std::begin(paths_), std::end(paths_));
+        auto last_file = std::chrono::steady_clock::now();
+
+        while(i < stream_count_)
+        {
+            if(stop_)
+                return false;
 
-        if(paths_.empty() && queue_.empty())
-            drained_ = true;
+            auto files = std::vector<std::string>{};
+            watcher_->poll(files, std::chrono::milliseconds{100});
+
+            for(auto&& path : files)
+            {
+                if(!seen.insert(path).second || reader::is_sidecar(path))
+                    continue;
+
+                if(!load_file(path, i))
+                    return false;
+
+                last_file = std::chrono::steady_clock::now();
+                BOOST_LOG_TRIVIAL(debug) << "Streamed " << path << ", " << i << " of " << stream_count_
+                                         << " projections";
+            }
+
+            if(std::chrono::steady_clock::now() - last_file > std::chrono::seconds{stream_timeout_})
+            {
+                BOOST_LOG_TRIVIAL(fatal) << "No new projections for " << stream_timeout_ << " s, received " << i
+                                         << " of " << stream_count_;
+                throw stage_runtime_error{"source::stream() timed out"};
+            }
+        }
+
+        return true;
+    }
+
+    auto source::prefetch() -> void
+    {
+        try
+        {
+            if(stack_ != nullptr && !load_stack())
+                return;
+
+            auto i = 0u;
+            if(io_threads_ > 1u && paths_.size() > 1u)
+            {
+                if(!load_files(i))
+                    return;
+            }
+            else
+            {
+                for(auto&& path : paths_)
+                {
+                    if(!load_file(path, i))
+                        return;
+                }
+            }
+
+            if(watcher_ != nullptr && !stream(i))
+                return;
+        }
+        catch(...)
+        {
+            error_ = std::current_exception();
+        }
+
+        done_ = true;
+    }
+
+    auto source::load_next() -> output_type
+    {
+        auto p = output_type{};
+
+        auto spins = 0u;
+        while(!queue_.try_pop(p))
+        {
+            if(done_ && queue_.empty())
+            {
+                if(error_ != nullptr)
+                    std::rethrow_exception(error_);
+
+                throw stage_runtime_error{"source::load_next() called on drained source"};
+            }
+            backoff(spins);
+        }
 
         return p;
     }
 
     auto source::drained() const noexcept -> bool
     {
-        return drained_;
+        // wait until we either have a projection or the I/O thread is finished
+        auto spins = 0u;
+        while(queue_.empty() && !done_)
+            backoff(spins);
+
+        // pending errors are reported by load_next()
+        return queue_.empty() && error_ == nullptr;
     }
 }
@@ -23,16 +23,43 @@
 #ifndef PARIS_SOURCE_H_
 #define PARIS_SOURCE_H_
 
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
 #include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
 #include <string>
-#include <queue>
+#include <thread>
 #include <vector>
 
+#include "angles.h"
 #include "backend.h"
+#include "bounded_queue.h"
+#include "filesystem.h"
+#include "flat_field.h"
+#include "geometry.h"
 #include "projection.h"
 
 namespace paris
 {
+    /*
+     * Loads projections (HIS, TIFF, raw or HDF5 files, see reader.h) on a dedicated I/O thread and keeps up to
+     * prefetch_depth of them ready for the reconstruction. Only one thread may consume projections at a time. The
+     * projections are binned by binning x binning pixels and only the (binned) detector rows inside the window are
+     * loaded.
+     *
+     * If stream_count is set the directory is watched for new files until that many projections were loaded, so
+     * the reconstruction can run while the scan is still in progress.
+     *
+     * With io_threads > 1 the files of proj_dir are decoded by that many readers at once, which hides the per-file
+     * latency of network filesystems. The reader of the oldest file hands its frames to the queue as they are
+     * decoded, the others keep up to prefetch_depth frames each until it is their turn, so the projections keep
+     * their order, indices and angles.
+     *
+     * A correction turns the raw counts of the files into line integrals while they are decoded.
+     */
     class source
     {
         private:
@@ -40,21 +67,73 @@ namespace paris
 
         public:
             source(const std::string& proj_dir,
-                   bool enable_angles = false,
-                   const std::string& angle_file = "",
-                   std::uint16_t quality = 1) noexcept;
+                   const row_window& window,
+                   std::uint32_t binning,
+                   angle_table angles = nullptr,
+                   std::uint16_t quality = 1,
+                   std::size_t prefetch_depth = 8,
+                   std::uint32_t stream_count = 0,
+                   std::uint32_t stream_timeout = 600,
+                   std::uint32_t io_threads = 1,
+                   flat_field_ptr correction = nullptr);
+
+            // projections in caller-owned memory: num frames of dim_x * dim_y pixels, angles [°] may be nullptr
+            source(const float* stack, std::uint32_t dim_x, std::uint32_t dim_y, std::uint32_t num,
+                   const float* angles, const row_window& window, std::uint16_t quality = 1,
+                   std::size_t prefetch_depth = 8);
+            ~source();
+
+            source(const source&) = delete;
+            auto operator=(const source&) -> source& = delete;
 
             auto load_next() -> output_type;
             auto drained() const noexcept -> bool;
 
+        private:
+            auto prefetch() -> void;
+            auto push(output_type& p) -> bool;
+            auto load_file(const std::string& path, std::uint32_t& i) -> bool;
+            auto load_files(std::uint32_t& i) -> bool;
+            auto read(std::uint32_t& i) -> void;
+            auto deliver(std::vector<output_type>& frames, std::uint32_t& i) -> bool;
+            auto load_stack() -> bool;
+            auto stream(std::uint32_t& i) -> bool;
+
         private:
             std::vector<std::string> paths_;
-            std::queue<output_type> queue_;
-            bool drained_;
-            
-            bool enable_angles_;
-            std::vector<float> angles_;
+            bounded_queue<output_type> queue_;
+            row_window window_;
+            std::uint32_t binning_;
+
+            angle_table angles_;    // nullptr keeps the angles calculated from the geometry
             std::uint16_t quality_;
+            flat_field_ptr correction_;     // nullptr reads the files as they are
+
+            // a stream waits for files to appear until it has stream_count_ projections
+            std::uint32_t stream_count_;
+            std::uint32_t stream_timeout_;  // [s]
+            std::unique_ptr<directory_watcher> watcher_;
+
+            // parallel readers, only the reader of file turn_ may hand frames to the queue
+            std::uint32_t io_threads_;
+            std::size_t ahead_;                 // frames a reader keeps back until it is its turn
+            std::size_t next_file_ = 0u;        // the next file claimed by a reader
+            std::size_t turn_ = 0u;             // the file whose frames go to the queue, paths_.size() ends reading
+            std::exception_ptr read_error_;
+            std::mutex read_mutex_;
+            std::condition_variable read_cv_;
+            std::vector<std::thread> readers_;
+
+            // in-memory projections
+            const float* stack_ = nullptr;
+            std::uint32_t stack_dim_x_ = 0u;
+            std::uint32_t stack_dim_y_ = 0u;
+            std::uint32_t stack_num_ = 0u;
+
+            std::atomic<bool> done_;
+            std::atomic<bool> stop_;
+            std::exception_ptr error_;
+            std::thread thread_;
     };
 }
 
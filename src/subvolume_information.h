@@ -23,14 +23,38 @@
 #ifndef PARIS_SUBVOLUME_INFORMATION_H_
 #define PARIS_SUBVOLUME_INFORMATION_H_
 
+#include <cstddef>
+#include <cstdint>
+
 #include "geometry.h"
 
 namespace paris
 {
+    // what the pipeline keeps on each device next to the subvolume
+    struct memory_parameters
+    {
+        std::size_t budget;             // [bytes] per device, 0 uses 90% of the free memory
+        std::uint32_t rows;             // detector rows of the loaded projections
+        std::uint32_t pipeline_depth;
+        std::uint32_t batch_size;
+        std::size_t reserved;           // [bytes] taken by other stages, only counted if they share the memory
+    };
+
+    // device memory needed by each device [bytes]
+    struct memory_plan
+    {
+        std::size_t budget;         // the smallest budget of all devices
+        std::size_t volume;         // the largest subvolume
+        std::size_t projections;    // projection buffers in flight
+        std::size_t filtering;      // weights, filter, FFT buffers and workspaces
+        std::size_t backprojection; // projection textures
+    };
+
     struct subvolume_info
     {
         subvolume_geometry geo;
         int num;
+        memory_plan plan;
     };
 }
 
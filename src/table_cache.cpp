@@ -0,0 +1,173 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/log/trivial.hpp>
+
+#include "table_cache.h"
+
+namespace paris
+{
+    namespace table_cache
+    {
+        namespace
+        {
+            constexpr char magic[4] = {'P', 'T', 'B', 'L'};
+            constexpr auto version = std::uint32_t{1u};
+
+            // followed by count * width floats in host byte order
+            struct table_header
+            {
+                char magic[4];
+                std::uint32_t version;
+                std::uint32_t width;    // values per projection
+                std::uint32_t count;    // projections
+
+                // the text file the table was parsed from
+                std::int64_t text_mtime;
+                std::uint64_t text_size;
+            };
+
+            using stat_type = struct ::stat;
+
+            auto sidecar_path(const std::string& path) -> std::string
+            {
+                return path + ".bin";
+            }
+        }
+
+        auto load(const std::string& path, std::uint32_t width, std::vector<float>& values) -> bool
+        {
+            const auto bin_path = sidecar_path(path);
+            auto bin_st = stat_type{};
+            if(::stat(bin_path.c_str(), &bin_st) == -1)
+                return false;
+
+            auto fd = ::open(bin_path.c_str(), O_RDONLY);
+            if(fd == -1)
+                return false;
+
+            const auto size = static_cast<std::size_t>(bin_st.st_size);
+            if(size < sizeof(table_header))
+            {
+                ::close(fd);
+                return false;
+            }
+
+            auto ptr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if(ptr == MAP_FAILED)
+            {
+                BOOST_LOG_TRIVIAL(warning) << "Could not map " << bin_path << ": " << std::strerror(errno);
+                return false;
+            }
+
+            auto header = table_header{};
+            std::memcpy(&header, ptr, sizeof(header));
+
+            const auto expected = sizeof(table_header) + sizeof(float) * header.count * header.width;
+            auto valid = std::memcmp(header.magic, magic, sizeof(magic)) == 0 && header.version == version &&
+                         header.width == width && header.count > 0u && size == expected;
+            if(!valid)
+                BOOST_LOG_TRIVIAL(warning) << bin_path << " isn't a valid table of " << width << " values per entry";
+
+            // a sidecar may also be used without its text file
+            auto text_st = stat_type{};
+            if(valid && ::stat(path.c_str(), &text_st) == 0 &&
+               (header.text_mtime != static_cast<std::int64_t>(text_st.st_mtime) ||
+                header.text_size != static_cast<std::uint64_t>(text_st.st_size)))
+            {
+                BOOST_LOG_TRIVIAL(info) << path << " changed since it was cached in " << bin_path;
+                valid = false;
+            }
+
+            if(valid)
+            {
+                const auto data = reinterpret_cast<const float*>(static_cast<const char*>(ptr) + sizeof(header));
+                values.assign(data, data + static_cast<std::size_t>(header.count) * header.width);
+                BOOST_LOG_TRIVIAL(info) << "Using the " << header.count << " cached entries from " << bin_path;
+            }
+
+            ::munmap(ptr, size);
+            return valid;
+        }
+
+        auto store(const std::string& path, std::uint32_t width, const std::vector<float>& values) -> void
+        {
+            const auto bin_path = sidecar_path(path);
+
+            auto text_st = stat_type{};
+            if(::stat(path.c_str(), &text_st) == -1)
+                return;
+
+            // write a temporary file and move it into place so that concurrent readers never see a partial table
+            const auto tmp_path = bin_path + "." + std::to_string(::getpid());
+            {
+                auto&& file = std::ofstream{tmp_path.c_str(), std::ios_base::binary | std::ios_base::trunc};
+                if(file)
+                {
+                    auto header = table_header{};
+                    std::memcpy(header.magic, magic, sizeof(magic));
+                    header.version = version;
+                    header.width = width;
+                    header.count = static_cast<std::uint32_t>(values.size() / width);
+                    header.text_mtime = static_cast<std::int64_t>(text_st.st_mtime);
+                    header.text_size = static_cast<std::uint64_t>(text_st.st_size);
+
+                    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+                    file.write(reinterpret_cast<const char*>(values.data()),
+                               static_cast<std::streamsize>(sizeof(float) * values.size()));
+                }
+
+                if(!file)
+                {
+                    BOOST_LOG_TRIVIAL(debug) << "Could not write " << tmp_path << ", not caching " << path;
+                    std::remove(tmp_path.c_str());
+                    return;
+                }
+            }
+
+            if(std::rename(tmp_path.c_str(), bin_path.c_str()) != 0)
+            {
+                BOOST_LOG_TRIVIAL(debug) << "Could not move " << tmp_path << " to " << bin_path << ": "
+                                         << std::strerror(errno);
+                std::remove(tmp_path.c_str());
+                return;
+            }
+
+            BOOST_LOG_TRIVIAL(info) << "Cached " << path << " in " << bin_path;
+        }
+    }
+}
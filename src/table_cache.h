@@ -0,0 +1,47 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#ifndef PARIS_TABLE_CACHE_H_
+#define PARIS_TABLE_CACHE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace paris
+{
+    /*
+     * Binary sidecars for the per-projection text files (angles, projection matrices). The sidecar <path>.bin holds
+     * a small header followed by width floats per projection and is mapped instead of parsing the text again, as
+     * long as the text file wasn't modified since.
+     */
+    namespace table_cache
+    {
+        // the cached values of the text file at path, false if there is no valid and up-to-date sidecar
+        auto load(const std::string& path, std::uint32_t width, std::vector<float>& values) -> bool;
+
+        // writes the sidecar for the text file at path, failures are only logged
+        auto store(const std::string& path, std::uint32_t width, const std::vector<float>& values) -> void;
+    }
+}
+
+#endif /* PARIS_TABLE_CACHE_H_ */
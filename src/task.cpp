@@ -21,30 +21,66 @@
  */
 
 #include <cstdint>
+#include <memory>
 #include <queue>
 
 #include "geometry.h"
+#include "journal.h"
 #include "program_options.h"
 #include "subvolume_information.h"
 #include "task.h"
+#include "trajectory.h"
 
 namespace paris
 {
-    auto make_tasks(const program_options& po, const volume_geometry& vol_geo, const subvolume_info& subvol_info)
+    auto make_tasks(const program_options& po, const volume_geometry& vol_geo, const subvolume_info& subvol_info,
+                    int part, int parts, const journal* written)
     -> std::queue<task>
     {
         auto q = std::queue<task>{};
 
-        for(auto i = 0; i < subvol_info.num; ++i)
+        // read once, all tasks share the matrices
+        auto matrices = std::shared_ptr<trajectory>{};
+        if(po.enable_trajectory)
+        {
+            matrices = std::make_shared<trajectory>(read_trajectory(po.trajectory_path));
+            if(po.preview > 1u)
+                bin_trajectory(*matrices, po.preview);
+        }
+
+        // every part gets a contiguous range of subvolumes, the first ones take the remainder
+        auto share = subvol_info.num / parts;
+        auto extra = subvol_info.num % parts;
+        auto first = part * share + (part < extra ? part : extra);
+        auto last = first + share + (part < extra ? 1 : 0);
+
+        for(auto i = first; i < last; ++i)
         {
             auto subvol_geo = subvol_info.geo;
+
+            // the last subvolume also contains the remaining slices
+            auto offset = static_cast<std::uint32_t>(i) * subvol_geo.dim_z;
+            auto slices = subvol_geo.dim_z + (i + 1 == subvol_info.num ? subvol_geo.remainder : 0u);
+            if(written != nullptr && written->covers(offset, slices))
+                continue;
+
+            auto z_first = (po.enable_roi ? po.roi.z1 : 0u) + offset;
+            auto window = calculate_row_window(po.det_geo, vol_geo, po.enable_roi, po.roi, z_first, slices);
+
+            // the rows hit by an arbitrary trajectory aren't known in advance
+            if(po.enable_trajectory)
+                window = row_window{0u, po.det_geo.n_col};
+
             q.emplace(task{static_cast<std::uint32_t>(i),
                             static_cast<std::uint32_t>(subvol_info.num),
                             po.input_path,
-                            po.det_geo, vol_geo, subvol_geo,
+                            po.det_geo, vol_geo, subvol_geo, window,
                             po.enable_roi, po.roi,
                             po.enable_angles, po.angle_path,
-                            po.quality});
+                            matrices,
+                            po.filter,
+                            po.quality,
+                            po.interp});
         }
 
         return q;
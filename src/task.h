@@ -24,13 +24,18 @@
 #define PARIS_TASK_H_
 
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <queue>
 
+#include "filter_config.h"
 #include "geometry.h"
+#include "interpolation.h"
+#include "journal.h"
 #include "program_options.h"
 #include "region_of_interest.h"
 #include "subvolume_information.h"
+#include "trajectory.h"
 
 namespace paris
 {
@@ -44,17 +49,28 @@ namespace paris
         detector_geometry det_geo;
         volume_geometry vol_geo;
         subvolume_geometry subvol_geo;
+        row_window window;      // detector rows needed for this subvolume
 
         bool enable_roi;
         region_of_interest roi;
 
         bool enable_angles;
         std::string angle_path;
-        
+
+        std::shared_ptr<const trajectory> matrices; // nullptr for the circular trajectory
+
+        filter_config filter;
+
         std::uint16_t quality;
+        interpolation interp;
     };
 
-    auto make_tasks(const program_options& po, const volume_geometry& vol_geo, const subvolume_info& subvol_info)
+    /*
+     * creates the tasks of the given part if the subvolumes are split into parts (e.g. between MPI ranks), the
+     * subvolumes covered by written have been reconstructed by an earlier run and are skipped
+     */
+    auto make_tasks(const program_options& po, const volume_geometry& vol_geo, const subvolume_info& subvol_info,
+                    int part = 0, int parts = 1, const journal* written = nullptr)
     -> std::queue<task>;
 }
 
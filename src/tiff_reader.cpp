@@ -0,0 +1,195 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 15 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef PARIS_ENABLE_TIFF
+#include <tiffio.h>
+#endif
+
+#include <boost/log/trivial.hpp>
+
+#include "geometry.h"
+#include "metrics.h"
+#include "reader.h"
+#include "tiff_reader.h"
+
+namespace paris
+{
+    namespace tiff
+    {
+#ifdef PARIS_ENABLE_TIFF
+        namespace
+        {
+            struct tiff_deleter
+            {
+                auto operator()(TIFF* t) const noexcept -> void { TIFFClose(t); }
+            };
+
+            // the converter for rows of the given sample format, nullptr for unsupported ones
+            auto converter(std::uint16_t format, std::uint16_t bits) noexcept
+            -> void (*)(const std::uint8_t*, float*, std::size_t)
+            {
+                switch(format)
+                {
+                    case SAMPLEFORMAT_UINT:
+                        switch(bits)
+                        {
+                            case 8:     return &reader::convert<std::uint8_t>;
+                            case 16:    return &reader::convert<std::uint16_t>;
+                            case 32:    return &reader::convert<std::uint32_t>;
+                            default:    return nullptr;
+                        }
+
+                    case SAMPLEFORMAT_INT:
+                        switch(bits)
+                        {
+                            case 8:     return &reader::convert<std::int8_t>;
+                            case 16:    return &reader::convert<std::int16_t>;
+                            case 32:    return &reader::convert<std::int32_t>;
+                            default:    return nullptr;
+                        }
+
+                    case SAMPLEFORMAT_IEEEFP:
+                        switch(bits)
+                        {
+                            case 32:    return &reader::convert<float>;
+                            case 64:    return &reader::convert<double>;
+                            default:    return nullptr;
+                        }
+
+                    default:
+                        return nullptr;
+                }
+            }
+        }
+
+        auto load(const std::string& path, const reader::consumer_type& f, const row_window& window,
+                  std::uint32_t binning, const flat_field* correction) -> std::uint32_t
+        {
+            // libtiff reports problems on stderr, we log our own
+            TIFFSetWarningHandler(nullptr);
+
+            auto tif = std::unique_ptr<TIFF, tiff_deleter>{TIFFOpen(path.c_str(), "r")};
+            if(tif == nullptr)
+            {
+                BOOST_LOG_TRIVIAL(warning) << "tiff::load() could not open non-TIFF file at " << path;
+                return 0u;
+            }
+
+            auto b = std::max(binning, 1u);
+            auto strip = std::vector<std::uint8_t>{};
+            auto scratch = std::vector<float>{};
+            auto frames = 0u;
+            do
+            {
+                auto width = std::uint32_t{0u};
+                auto height = std::uint32_t{0u};
+                auto spp = std::uint16_t{1u};
+                auto bits = std::uint16_t{1u};
+                auto format = std::uint16_t{SAMPLEFORMAT_UINT};
+                TIFFGetField(tif.get(), TIFFTAG_IMAGEWIDTH, &width);
+                TIFFGetField(tif.get(), TIFFTAG_IMAGELENGTH, &height);
+                TIFFGetFieldDefaulted(tif.get(), TIFFTAG_SAMPLESPERPIXEL, &spp);
+                TIFFGetFieldDefaulted(tif.get(), TIFFTAG_BITSPERSAMPLE, &bits);
+                TIFFGetFieldDefaulted(tif.get(), TIFFTAG_SAMPLEFORMAT, &format);
+
+                auto convert = converter(format, bits);
+                if(width == 0u || height == 0u || spp != 1u || convert == nullptr || TIFFIsTiled(tif.get()))
+                {
+                    BOOST_LOG_TRIVIAL(warning) << "tiff::load() encountered an unsupported image (page " << frames
+                                               << ") at " << path;
+                    break;
+                }
+
+                auto rows_per_strip = height;
+                TIFFGetFieldDefaulted(tif.get(), TIFFTAG_ROWSPERSTRIP, &rows_per_strip);
+                rows_per_strip = std::min(std::max(rows_per_strip, 1u), height);
+
+                const auto row_size = static_cast<std::size_t>(width) * (bits / 8u);
+                strip.resize(static_cast<std::size_t>(TIFFStripSize(tif.get())));
+
+                auto rows = reader::unbin(window, b, height);
+                auto ok = true;
+                auto loaded = std::numeric_limits<std::uint32_t>::max();
+                auto img = reader::decode_frame(width, rows, b, scratch, correction,
+                                                [&](float* dest, std::uint32_t block_first, std::uint32_t count)
+                {
+                    // decode the strips holding the block and convert the rows we need, a strip is decoded once
+                    const auto last = rows.first + block_first + count;
+                    for(auto s = (rows.first + block_first) / rows_per_strip; ok && s * rows_per_strip < last; ++s)
+                    {
+                        if(s != loaded)
+                        {
+                            const auto size = static_cast<tmsize_t>(strip.size());
+                            if(TIFFReadEncodedStrip(tif.get(), s, strip.data(), size) < 0)
+                            {
+                                ok = false;
+                                return;
+                            }
+                            loaded = s;
+
+                            const auto raw = TIFFRawStripSize(tif.get(), s);
+                            if(raw > 0)
+                                metrics::count_bytes_read(static_cast<std::uint64_t>(raw));
+                        }
+
+                        const auto strip_first = s * rows_per_strip;
+                        const auto first = std::max(strip_first, rows.first + block_first);
+                        const auto end = std::min(strip_first + rows_per_strip, last);
+                        for(auto y = first; y < end; ++y)
+                            convert(strip.data() + (y - strip_first) * row_size,
+                                    dest + static_cast<std::size_t>(y - rows.first - block_first) * width, width);
+                    }
+                });
+
+                if(!ok)
+                {
+                    BOOST_LOG_TRIVIAL(warning) << "tiff::load() could not decode page " << frames << " of " << path;
+                    break;
+                }
+
+                ++frames;
+                if(!f(img))
+                    break;
+            }
+            while(TIFFReadDirectory(tif.get()));
+
+            return frames;
+        }
+#else
+        auto load(const std::string& path, const reader::consumer_type&, const row_window&, std::uint32_t,
+                  const flat_field*) -> std::uint32_t
+        {
+            BOOST_LOG_TRIVIAL(fatal) << "Cannot read " << path;
+            throw std::runtime_error{"tiff::load(): compiled without support for TIFF projections"};
+        }
+#endif
+    }
+}
@@ -0,0 +1,46 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 15 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#ifndef PARIS_TIFF_READER_H_
+#define PARIS_TIFF_READER_H_
+
+#include <cstdint>
+#include <string>
+
+#include "flat_field.h"
+#include "geometry.h"
+#include "reader.h"
+
+namespace paris
+{
+    namespace tiff
+    {
+        /*
+         * Every page of a (multi-page) TIFF file is a frame. Supports strip-organised grayscale images with unsigned,
+         * signed or floating point samples. Only the strips holding the requested rows are decoded.
+         */
+        auto load(const std::string& path, const reader::consumer_type& f, const row_window& window,
+                  std::uint32_t binning, const flat_field* correction = nullptr) -> std::uint32_t;
+    }
+}
+
+#endif /* PARIS_TIFF_READER_H_ */
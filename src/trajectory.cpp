@@ -0,0 +1,109 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <locale>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/log/trivial.hpp>
+
+#include "exception.h"
+#include "table_cache.h"
+#include "trajectory.h"
+
+namespace paris
+{
+    namespace
+    {
+        auto make_trajectory(const std::vector<float>& values) -> trajectory
+        {
+            auto traj = trajectory(values.size() / 12u);
+            for(auto i = std::size_t{0u}; i < traj.size(); ++i)
+                std::copy_n(values.data() + 12u * i, 12u, traj[i].m);
+            return traj;
+        }
+    }
+
+    auto read_trajectory(const std::string& path) -> trajectory
+    {
+        auto values = std::vector<float>{};
+        if(table_cache::load(path, 12u, values))
+            return make_trajectory(values);
+
+        auto&& file = std::ifstream{path.c_str()};
+        if(!file.is_open())
+        {
+            BOOST_LOG_TRIVIAL(fatal) << "Could not open projection matrix file at " << path;
+            throw stage_construction_error{"read_trajectory() failed"};
+        }
+
+        auto line = std::string{};
+        auto line_num = std::size_t{0u};
+        while(std::getline(file, line))
+        {
+            ++line_num;
+            if(line.empty() || line.front() == '#')
+                continue;
+
+            std::replace(std::begin(line), std::end(line), ',', ' ');
+            auto&& stream = std::istringstream{line};
+            stream.imbue(std::locale::classic());
+            auto value = 0.f;
+            while(stream >> value)
+                values.push_back(value);
+
+            if(!stream.eof())
+            {
+                BOOST_LOG_TRIVIAL(fatal) << "Could not parse line " << line_num << " of " << path;
+                throw stage_construction_error{"read_trajectory() failed"};
+            }
+        }
+
+        if(values.empty() || values.size() % 12u != 0u)
+        {
+            BOOST_LOG_TRIVIAL(fatal) << path << " holds " << values.size()
+                                     << " values, expected 12 for every projection";
+            throw stage_construction_error{"read_trajectory() failed"};
+        }
+
+        BOOST_LOG_TRIVIAL(info) << "Read " << values.size() / 12u << " projection matrices from " << path;
+        table_cache::store(path, 12u, values);
+        return make_trajectory(values);
+    }
+
+    auto bin_trajectory(trajectory& traj, std::uint32_t factor) noexcept -> void
+    {
+        // the binned pixel j covers the pixels [j * factor, (j + 1) * factor), its centre lies in between
+        const auto f = static_cast<float>(factor);
+        const auto shift = (f - 1.f) / 2.f;
+        for(auto&& mat : traj)
+        {
+            for(auto i = 0u; i < 8u; ++i)
+                mat.m[i] = (mat.m[i] - shift * mat.m[8u + i % 4u]) / f;
+        }
+    }
+}
@@ -0,0 +1,56 @@
+/*
+ * This file is part of the PARIS reconstruction program.
+ *
+ * Copyright (C) 2016 Helmholtz-Zentrum Dresden-Rossendorf
+ *
+ * PARIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PARIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PARIS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Date: 14 October 2026
+ * Authors: Jan Stephan <j.stephan@hzdr.de>
+ */
+
+#ifndef PARIS_TRAJECTORY_H_
+#define PARIS_TRAJECTORY_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace paris
+{
+    /*
+     * Maps the homogeneous volume coordinates (x, y, z, 1) [mm] -- volume centre at the origin, the same axes as
+     * the circular geometry -- to (h * w, v * w, w). h is the detector column and v the detector row, both in pixels
+     * of the full detector with the first pixel's centre at 0. w is the voxel's distance from the source along the
+     * central ray [mm], the FDK weight of a voxel is (d_so / w)^2. Row-major.
+     */
+    struct projection_matrix
+    {
+        float m[12];
+    };
+
+    // one matrix per projection file, indexed like the projections
+    using trajectory = std::vector<projection_matrix>;
+
+    /*
+     * Reads 12 values per projection (the rows of its matrix one after another) separated by whitespace or commas.
+     * Lines starting with '#' are comments.
+     */
+    auto read_trajectory(const std::string& path) -> trajectory;
+
+    // adapts the matrices to a detector binned by factor x factor pixels, see bin_detector()
+    auto bin_trajectory(trajectory& traj, std::uint32_t factor) noexcept -> void;
+}
+
+#endif /* PARIS_TRAJECTORY_H_ */
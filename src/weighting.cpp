@@ -29,18 +29,31 @@
 
 namespace paris
 {
-    auto weight(backend::projection_device_type& p, const detector_geometry& det_geo)
-        noexcept(true && noexcept(backend::weight))
-        -> void
+    auto make_weights(const detector_geometry& det_geo, const row_window& window) -> backend::weight_buffer_type
     {
-        // the following variables are static and valid for the entire program -> initialise once
-        static const auto n_row_f = static_cast<float>(det_geo.n_row);
-        static const auto n_col_f = static_cast<float>(det_geo.n_col);
+        const auto n_row_f = static_cast<float>(det_geo.n_row);
+        const auto n_col_f = static_cast<float>(det_geo.n_col);
 
-        static const auto h_min = (det_geo.delta_s * det_geo.l_px_row) - ((n_row_f * det_geo.l_px_row) / 2);
-        static const auto v_min = (det_geo.delta_t * det_geo.l_px_col) - ((n_col_f * det_geo.l_px_col) / 2);
-        static const auto d_sd = std::abs(det_geo.d_so) + std::abs(det_geo.d_od);
+        const auto h_min = (det_geo.delta_s * det_geo.l_px_row) - ((n_row_f * det_geo.l_px_row) / 2);
+        const auto v_min = (det_geo.delta_t * det_geo.l_px_col) - ((n_col_f * det_geo.l_px_col) / 2)
+                           + static_cast<float>(window.first) * det_geo.l_px_col;
+        const auto d_sd = std::abs(det_geo.d_so) + std::abs(det_geo.d_od);
 
-        backend::weight(p, h_min, v_min, d_sd, det_geo.l_px_row, det_geo.l_px_col);
+        switch(det_geo.beam)
+        {
+            // the rays of a fan only diverge within the detector row
+            case beam_geometry::fan:
+                return backend::make_weights(det_geo.n_row, window.rows, h_min, 0.f, d_sd, det_geo.l_px_row, 0.f);
+
+            // parallel rays hit every pixel perpendicularly -> all weights are 1
+            case beam_geometry::parallel:
+                return backend::make_weights(det_geo.n_row, window.rows, 0.f, 0.f, 1.f, 0.f, 0.f);
+
+            case beam_geometry::cone:
+                break;
+        }
+
+        return backend::make_weights(det_geo.n_row, window.rows, h_min, v_min, d_sd, det_geo.l_px_row,
+                                     det_geo.l_px_col);
     }
 }
@@ -29,9 +29,8 @@
 
 namespace paris
 {
-    auto weight(backend::projection_device_type& p, const detector_geometry& det_geo)
-        noexcept(true && noexcept(backend::weight))
-        -> void; 
+    // the weight map for the detector rows inside window, filter() applies it
+    auto make_weights(const detector_geometry& det_geo, const row_window& window) -> backend::weight_buffer_type;
 }
 
 #endif /* PARIS_WEIGHTING_H_ */